@@ -36,6 +36,10 @@ public:
         return _version;
     }
 
+    int64_t total_rows() {
+        return _total_rows;
+    }
+
     std::shared_ptr<CMsketchColumn> get_cmsketchcolumn_ptr(int field_id) {
         if (field_id <= 0) {
             return nullptr;
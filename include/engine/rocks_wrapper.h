@@ -15,6 +15,8 @@
 #pragma once
  
 #include <string>
+#include <map>
+#include <vector>
 #include "rocksdb/db.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/cache.h"
@@ -56,6 +58,12 @@ public:
     rocksdb::Status write(const rocksdb::WriteOptions& options, rocksdb::WriteBatch* updates) {
         return _txn_db->Write(options, updates);  
     }
+    // TransactionDB对batch加锁时不支持DeleteRange，带范围删除的batch跳过并发控制直接写
+    rocksdb::Status write_skip_lock(const rocksdb::WriteOptions& options, rocksdb::WriteBatch* updates) {
+        rocksdb::TransactionDBWriteOptimizations optimizations;
+        optimizations.skip_concurrency_control = true;
+        return _txn_db->Write(options, optimizations, updates);
+    }
     rocksdb::Status write(const rocksdb::WriteOptions& options, 
                             rocksdb::ColumnFamilyHandle* column_family,
                             const std::vector<std::string>& keys,
@@ -134,6 +142,13 @@ public:
     rocksdb::ColumnFamilyHandle* get_raft_log_handle();
 
     rocksdb::ColumnFamilyHandle* get_data_handle();
+    // 按表路由到独立的数据column family，未配置时返回DATA_CF
+    rocksdb::ColumnFamilyHandle* get_data_handle(int64_t table_id);
+    // DATA_CF以及所有独立的数据column family，按region删除/flush时需要遍历
+    std::vector<rocksdb::ColumnFamilyHandle*> get_data_handles();
+    bool is_data_cf(const std::string& cf_name) const {
+        return cf_name == DATA_CF || cf_name.compare(0, DATA_CF.size() + 1, DATA_CF + "_") == 0;
+    }
 
     rocksdb::ColumnFamilyHandle* get_meta_info_handle();
 
@@ -152,6 +167,15 @@ public:
         return _txn_db->GetDBOptions();
     }
 
+    size_t get_data_prefix_len() const {
+        return _data_prefix_len;
+    }
+    // [lower, upper)内的key是否共享data cf的prefix，是则可以用prefix seek
+    bool is_same_data_prefix(const rocksdb::Slice& lower, const rocksdb::Slice& upper) const {
+        return lower.size() >= _data_prefix_len && upper.size() >= _data_prefix_len
+            && memcmp(lower.data(), upper.data(), _data_prefix_len) == 0;
+    }
+
     rocksdb::Cache* get_cache() {
         return _cache;
     }
@@ -167,6 +191,7 @@ public:
 private:
 
     RocksWrapper();
+    int parse_data_cf_conf(const rocksdb::BlockBasedTableOptions& table_options);
 
     std::string _db_path;
 
@@ -174,11 +199,17 @@ private:
 
     rocksdb::TransactionDB* _txn_db;
     rocksdb::Cache*         _cache;
+    size_t                  _data_prefix_len = sizeof(int64_t) * 2;
 
     std::map<std::string, rocksdb::ColumnFamilyHandle*> _column_families;
 
     rocksdb::ColumnFamilyOptions _log_cf_option;
     rocksdb::ColumnFamilyOptions _data_cf_option;
     rocksdb::ColumnFamilyOptions _meta_info_option;
+
+    // 独立的数据column family, cf_name => options
+    std::map<std::string, rocksdb::ColumnFamilyOptions> _isolated_cf_options;
+    std::map<int64_t, std::string> _table_data_cf;
+    std::map<std::string, std::string> _resource_tag_data_cf;
 };
 }
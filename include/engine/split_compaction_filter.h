@@ -20,6 +20,7 @@
 #include "type_utils.h"
 #include "schema_factory.h"
 #include "transaction.h"
+#include "ttl_compaction_filter.h"
 
 namespace baikaldb {
 class SplitCompactionFilter : public rocksdb::CompactionFilter {
@@ -39,15 +40,25 @@ public:
     // A return value of false indicates that the kv should be preserved 
     // a return value of true indicates that this key-value should be removed from the
     // output of the compaction. 
-    bool Filter(int /*level*/,
+    bool Filter(int level,
                 const rocksdb::Slice& key,
                 const rocksdb::Slice& value,
-                std::string* /*new_value*/,
-                bool* /*value_changed*/) const override {
+                std::string* new_value,
+                bool* value_changed) const override {
         static int prefix_len = sizeof(int64_t) * 2;
         if ((int)key.size() < prefix_len) {
             return false;
         }
+        // data cf只能挂一个filter，region范围内的kv再按ttl丢弃，ttl只统计region自己的行
+        if (out_of_range(key, value)) {
+            return true;
+        }
+        return _ttl_filter->Filter(level, key, value, new_value, value_changed);
+    }
+
+    // 分裂后不再属于本region的kv
+    bool out_of_range(const rocksdb::Slice& key, const rocksdb::Slice& value) const {
+        static int prefix_len = sizeof(int64_t) * 2;
         TableKey table_key(key);
         int64_t region_id = table_key.extract_i64(0);
         //std::string start_key;
@@ -114,11 +125,13 @@ public:
 private:
     SplitCompactionFilter() {
         _factory = SchemaFactory::get_instance();
+        _ttl_filter = TtlCompactionFilter::get_instance();
     }
 
     // region_id => end_key
     mutable DoubleBufKey _range_key_map;
     SchemaFactory* _factory;
+    TtlCompactionFilter* _ttl_filter;
 };
 }//namespace
 
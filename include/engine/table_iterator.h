@@ -14,6 +14,7 @@
 
 #pragma once
  
+#include <pthread.h>
 #include "rocks_wrapper.h"
 #include "schema_factory.h"
 #include "mut_table_key.h"
@@ -26,6 +27,32 @@ class TableIterator;
 class IndexIterator;
 typedef std::shared_ptr<Transaction> SmartTransaction;
 
+// 扫描类型，大范围顺序扫描不填充block cache，避免冲掉OLTP的热数据
+enum ScanClass {
+    SCAN_OLTP    = 0,
+    SCAN_EXPORT  = 1, // 全量导出
+    SCAN_ANALYZE = 2, // analyze采样
+    SCAN_BACKUP  = 3, // 备份dump
+    SCAN_CLASS_NUM
+};
+
+// 按扫描类型设置fill_cache/readahead
+void set_scan_read_options(ScanClass scan_class, rocksdb::ReadOptions* read_options);
+
+// 统计一段export/analyze/backup扫描的block cache命中/未命中，按扫描类型汇总到bvar
+// rocksdb perf_context是线程局部的，只读不改perf level，bthread切换了pthread时放弃本次统计
+class ScanCacheStat {
+public:
+    explicit ScanCacheStat(ScanClass scan_class);
+    ~ScanCacheStat();
+private:
+    ScanClass _scan_class;
+    bool _enabled = false;
+    pthread_t _tid;
+    uint64_t _hit_count = 0;
+    uint64_t _miss_count = 0;
+};
+
 //前缀的=传 [key, key],双闭区间
 struct IndexRange {
     // input bound in TableRecord format
@@ -51,6 +78,8 @@ struct IndexRange {
 
     bool like_prefix = false;
 
+    ScanClass scan_class = SCAN_OLTP;
+
     IndexRange() {}
 
     IndexRange(TableRecord* _left, 
@@ -147,6 +176,7 @@ protected:
     rocksdb::Transaction*   _txn = nullptr;
     bool                    _need_check_region;
     bool                    _forward;
+    ScanClass               _scan_class = SCAN_OLTP;
     rocksdb::ColumnFamilyHandle* _data_cf;
     std::map<int32_t, FieldInfo*>    _fields;
     std::vector<int32_t> _field_slot;
@@ -160,6 +160,16 @@ public:
             std::map<int32_t, FieldInfo*>& fields,
             bool            check_region);
 
+    // 批量点查主键，只支持GET_ONLY，key排序后走rocksdb batched MultiGet
+    // rets与records一一对应，含义与get_update_primary的返回值相同
+    int multi_get_primary(
+            int64_t         region,
+            IndexInfo&      pk_index,
+            std::vector<SmartRecord>& records,
+            std::map<int32_t, FieldInfo*>& fields,
+            bool            check_region,
+            std::vector<int>* rets);
+
     int get_update_primary_columns(
             const TableKey& primary_key,
             GetMode         mode,
@@ -293,26 +303,7 @@ public:
         return 0;
     }
 
-    void set_region_info(pb::RegionInfo* region_info) {
-        _region_info = region_info;
-        if (_region_info == nullptr) {
-            DB_WARNING("no region_info");
-            return;
-        }
-        // _is_global_index
-        if (_region_info->has_main_table_id() && _region_info->main_table_id() != 0 &&
-                    _region_info->table_id() != _region_info->main_table_id()) {
-            return;
-        }
-        _table_info = SchemaFactory::get_instance()->get_table_info_ptr(_region_info->table_id());
-        _pri_info = SchemaFactory::get_instance()->get_index_info_ptr(_region_info->table_id());
-        if (is_cstore()) {
-           _pri_field_ids.clear();
-           for (auto& field_info : _pri_info->fields) {
-                 _pri_field_ids.insert(field_info.id);
-           }
-       }
-    }
+    void set_region_info(pb::RegionInfo* region_info);
     bool is_cstore() {
         if (_table_info.get() == nullptr) {
             // _is_global_index
@@ -39,7 +39,7 @@ public:
 
     TransactionPool() : _num_prepared_txn(0), _txn_count(0) {}
 
-    int init(int64_t region_id, bool use_ttl);
+    int init(int64_t region_id, bool use_ttl, rocksdb::ColumnFamilyHandle* data_cf = nullptr);
 
     // -1 means insert error (already exists)
     int begin_txn(uint64_t txn_id, SmartTransaction& txn, int64_t primary_region_id);
@@ -86,6 +86,11 @@ public:
         return _use_ttl;
     }
 
+    // region init时确定并记录在meta中的数据column family
+    rocksdb::ColumnFamilyHandle* data_cf() const {
+        return _data_cf;
+    }
+
     void clear_transactions(Region* region);
 
     void on_leader_stop_rollback();
@@ -119,6 +124,7 @@ public:
 private:
     int64_t _region_id = 0;
     bool _use_ttl = false;
+    rocksdb::ColumnFamilyHandle* _data_cf = nullptr;
 
     // txn_id => txn handler mapping
     std::unordered_map<uint64_t, SmartTransaction>  _txn_map;
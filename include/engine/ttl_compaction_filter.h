@@ -0,0 +1,109 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include <rocksdb/compaction_filter.h>
+#include <gflags/gflags.h>
+#include "key_encoder.h"
+#include "table_key.h"
+#include "schema_factory.h"
+#include "transaction.h"
+
+namespace baikaldb {
+DECLARE_bool(ttl_compaction_filter);
+
+// ttl表的主键和二级索引value前8字节为过期时间，compaction时直接丢弃过期的kv
+// 读路径仍按ttl过滤，这里只负责回收空间
+class TtlCompactionFilter : public rocksdb::CompactionFilter {
+public:
+    static TtlCompactionFilter* get_instance() {
+        static TtlCompactionFilter _instance;
+        return &_instance;
+    }
+    ~TtlCompactionFilter() {
+    }
+    const char* Name() const override {
+        return "TtlCompactionFilter";
+    }
+    bool Filter(int /*level*/,
+                const rocksdb::Slice& key,
+                const rocksdb::Slice& value,
+                std::string* /*new_value*/,
+                bool* /*value_changed*/) const override {
+        static int prefix_len = sizeof(int64_t) * 2;
+        if (!FLAGS_ttl_compaction_filter) {
+            return false;
+        }
+        if ((int)key.size() < prefix_len || value.size() < sizeof(uint64_t)) {
+            return false;
+        }
+        TableKey table_key(key);
+        int64_t index_id = table_key.extract_i64(sizeof(int64_t));
+        // cstore列的key: index_id = table_id(32byte) + field_id(32byte)
+        // 列值没有ttl前缀，留给ttl_remove_expired_data按主键删除
+        if ((index_id & SIGN_MASK_32) != 0) {
+            return false;
+        }
+        auto index_info = _factory->get_index_info_ptr(index_id);
+        if (index_info == nullptr) {
+            return false;
+        }
+        if (index_info->type != pb::I_PRIMARY
+                && index_info->type != pb::I_UNIQ
+                && index_info->type != pb::I_KEY) {
+            return false;
+        }
+        // 表的ttl创建后不会改变，按主表取配置
+        if (_factory->get_ttl_duration(index_info->pk) <= 0) {
+            return false;
+        }
+        if (ttl_decode(value) >= butil::gettimeofday_us()) {
+            return false;
+        }
+        if (index_info->type == pb::I_PRIMARY || index_info->is_global) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++_expired_lines[table_key.extract_i64(0)];
+        }
+        return true;
+    }
+
+    // 取走compaction丢弃的行数(主键或全局索引)，region据此调整num_table_lines
+    // 同一行的多个版本可能被分别丢弃，只能作为估算
+    int64_t take_expired_lines(int64_t region_id) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto iter = _expired_lines.find(region_id);
+        if (iter == _expired_lines.end()) {
+            return 0;
+        }
+        int64_t lines = iter->second;
+        _expired_lines.erase(iter);
+        return lines;
+    }
+
+private:
+    TtlCompactionFilter() {
+        _factory = SchemaFactory::get_instance();
+    }
+
+    SchemaFactory* _factory;
+    mutable std::mutex _mutex;
+    // region_id => 丢弃的行数
+    mutable std::unordered_map<int64_t, int64_t> _expired_lines;
+};
+}//namespace
+
+/* vim: set expandtab ts=4 sw=4 sts=4 tw=100: */
@@ -26,6 +26,8 @@
 #include "exec_node.h"
 #include "agg_fn_call.h"
 #include "mut_table_key.h"
+#include "spill_file.h"
+#include "fixed_key_hash_map.h"
 
 namespace baikaldb {
 class AggNode : public ExecNode {
@@ -45,13 +47,31 @@ public:
     virtual void find_place_holder(std::map<int, ExprNode*>& placeholders);
     virtual int open(RuntimeState* state);
     virtual int get_next(RuntimeState* state, RowBatch* batch, bool* eos);
+    virtual int get_next_column(RuntimeState* state, ColumnBatch* batch, bool* eos);
     virtual void close(RuntimeState* state);
     virtual void transfer_pb(int64_t region_id, pb::PlanNode* pb_node);
     void encode_agg_key(MemRow* row, MutTableKey& key);
-    void process_row_batch(RowBatch& batch);
+    int process_row_batch(RuntimeState* state, RowBatch& batch);
+    int process_column_batch(RuntimeState* state, ColumnBatch& batch);
     std::vector<ExprNode*>& group_exprs() {
         return _group_exprs;
     }
+private:
+    // 新分组计入内存预算，超出时hash表按分区落盘
+    int64_t group_bytes(int64_t key_size, MemRow* row);
+    int add_group_bytes(RuntimeState* state, MutTableKey& key, MemRow* row);
+    int spill(RuntimeState* state);
+    // 逐个读取落盘分区重新merge到_hash_map
+    int load_next_partition(RuntimeState* state);
+    void merge_spill_batch(RuntimeState* state, RowBatch& batch);
+    // 分组列都是定长类型时用FixedKey查找分组，不存在时插入nullptr
+    MemRow** seek_fixed_group(MemRow* row);
+    template <size_t N>
+    MemRow** seek_fixed_group(MemRow* row, FixedKeyHashMap<N, MemRow*>* hash_map);
+    bool has_next_group();
+    // 取出下一个分组行，所有权转移给调用方
+    MemRow* pop_next_group();
+
 private:
     //需要推导_agg_tuple_id内部slot的类型
     std::vector<ExprNode*> _group_exprs;
@@ -63,6 +83,23 @@ private:
     //用于分组和get_next的定位,用map可与mysql保持一致
     butil::FlatMap<std::string, MemRow*> _hash_map;
     butil::FlatMap<std::string, MemRow*>::iterator _iter;
+    // 列存路径复用的行，新分组时转移到_hash_map
+    std::unique_ptr<MemRow> _scratch_row;
+    // 定长key的word数，0表示使用_hash_map
+    size_t _fixed_key_words = 0;
+    FixedKeyHashMap<2, MemRow*> _fixed_map2;
+    FixedKeyHashMap<4, MemRow*> _fixed_map4;
+    FixedKeyHashMap<8, MemRow*> _fixed_map8;
+    // 定长key时按插入顺序保存分组，用于输出
+    std::vector<MemRow*> _fixed_groups;
+    size_t _fixed_idx = 0;
+    // 落盘使用
+    bool _can_spill = false;
+    int64_t _mem_bytes = 0;
+    std::vector<std::shared_ptr<SpillFile>> _partitions;
+    size_t _partition_idx = 0;
+    int64_t _spill_bytes = 0;
+    int _spill_times = 0;
 };
 }
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
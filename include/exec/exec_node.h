@@ -18,6 +18,7 @@
 #include "table_record.h"
 #include "expr_node.h"
 #include "row_batch.h"
+#include "column_batch.h"
 #include "proto/plan.pb.h"
 #include "proto/meta.interface.pb.h"
 #include "mem_row_descriptor.h"
@@ -70,6 +71,9 @@ public:
         *eos = true;
         return 0;
     }
+    // 列存接口，batch由调用方init，每次调用前clear
+    // 默认实现通过get_next转换，没有列存实现的节点走这里
+    virtual int get_next_column(RuntimeState* state, ColumnBatch* batch, bool* eos);
     virtual void close(RuntimeState* state) {
         _num_rows_returned = 0;
         for (auto e : _children) {
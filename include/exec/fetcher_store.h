@@ -29,6 +29,13 @@ enum ErrorType {
     E_RETURN    // primary region已经rollback是使用
 };
 
+// store端未读完的分页select
+struct RegionCursor {
+    int64_t cursor_id = 0;
+    int64_t region_version = 0;
+    std::string addr;
+};
+
 struct TraceDesc {
     int64_t region_id;
     std::shared_ptr<pb::TraceNode> trace_node = nullptr;
@@ -45,6 +52,7 @@ public:
     
     void clear() {
         region_batch.clear();
+        region_columnar_rows.clear();
         index_records.clear();
         start_key_sort.clear();
         error = E_OK;
@@ -53,6 +61,9 @@ public:
         scan_rows = 0;
         filter_rows = 0;
         row_cnt = 0;
+        region_cursors.clear();
+        pending_regions.clear();
+        probe_regions.clear();
     }
 
     // send (cached) cmds with seq_id >= start_seq_id
@@ -95,8 +106,34 @@ public:
         return run(state, region_infos, store_request, start_seq_id, start_seq_id, op_type);
     }
     void choose_opt_instance(pb::RegionInfo& info, std::string& addr);
+
+    // stream_select为true时run只取每个region的第一页，剩余的页由调用方按需读取
+    bool has_more_pages(int64_t region_id) {
+        return region_cursors.count(region_id) > 0;
+    }
+    // column_result为true且store按列存返回时，这一页放在columnar_rows里，不解码到batch
+    int fetch_next_page(RuntimeState* state, int64_t region_id, RowBatch* batch,
+                        std::shared_ptr<pb::ColumnarRows>* columnar_rows = nullptr);
+    // 提前结束(如达到limit)时释放store端游标
+    void close_cursors(RuntimeState* state);
+    // 按start_key顺序取下一个region的第一页，推迟的region在这里打开；没有region时返回1
+    int next_stream_region(RuntimeState* state, int64_t* region_id,
+                           std::shared_ptr<RowBatch>* batch,
+                           std::shared_ptr<pb::ColumnarRows>* columnar_rows = nullptr);
+    // 按store返回的列填充MemRow
+    int decode_columnar_rows(RuntimeState* state, const pb::ColumnarRows& rows, RowBatch* batch);
+private:
+    int open_pending_regions(RuntimeState* state);
+    ErrorType send_page_request(RuntimeState* state, int64_t region_id, RegionCursor& cursor,
+                                bool close_cursor, RowBatch* batch,
+                                std::shared_ptr<pb::ColumnarRows>* columnar_rows = nullptr);
+    // columnar_rows不为空时列存结果原样取走，否则解码到batch
+    int take_rows(RuntimeState* state, pb::StoreRes& res, RowBatch* batch,
+                  std::shared_ptr<pb::ColumnarRows>* columnar_rows);
 public:
     std::map<int64_t, std::shared_ptr<RowBatch>> region_batch;
+    // column_result时store按列存返回的第一页
+    std::map<int64_t, std::shared_ptr<pb::ColumnarRows>> region_columnar_rows;
     std::map<int64_t, std::vector<SmartRecord>>  index_records; //key: index_id
 
     std::map<std::string, int64_t> start_key_sort;
@@ -108,6 +145,17 @@ public:
     std::atomic<int> affected_rows;
     std::atomic<int> scan_rows;
     std::atomic<int> filter_rows;
+    bool stream_select = false;
+    // 流式读的结果交给列存流水线，列存格式的页不转换成MemRow
+    bool column_result = false;
+    std::map<int64_t, RegionCursor> region_cursors;
+    // 还没打开游标的region，start_key => region
+    std::map<std::string, pb::RegionInfo> pending_regions;
+    std::set<int64_t> probe_regions;
+private:
+    ExecNode* _stream_request = nullptr;
+    int _stream_start_seq_id = 0;
+    int _stream_current_seq_id = 0;
 };
 }
 
@@ -40,6 +40,7 @@ public:
     }
     virtual int open(RuntimeState* state);
     virtual int get_next(RuntimeState* state, RowBatch* batch, bool* eos);
+    virtual int get_next_column(RuntimeState* state, ColumnBatch* batch, bool* eos);
     virtual void close(RuntimeState* state);
     virtual void transfer_pb(int64_t region_id, pb::PlanNode* pb_node);
 
@@ -58,6 +59,8 @@ public:
     virtual void show_explain(std::vector<std::map<std::string, std::string>>& output);
 private:
     bool need_copy(MemRow* row);
+    // 条件都支持eval_batch时整批计算，返回过滤掉的行数
+    int64_t filter_column_batch(ColumnBatch* batch);
 
 private:
     std::vector<ExprNode*> _conjuncts;
@@ -65,6 +68,12 @@ private:
     RowBatch _child_row_batch;
     size_t  _child_row_idx = 0;
     bool    _child_eos = false;
+    // 列存路径，只把条件用到的slot填进_scratch_row再计算
+    std::vector<std::pair<int32_t, int32_t>> _conjunct_slots;
+    bool _need_full_row = false;
+    bool _eval_batch = false;
+    std::unique_ptr<MemRow> _scratch_row;
+    std::vector<uint32_t> _selection;
 };
 }
 
@@ -21,6 +21,8 @@
 #include <butil/containers/flat_map.h>
 #endif
 #include "slot_ref.h"
+#include "fixed_key_hash_map.h"
+#include "spill_file.h"
 
 namespace baikaldb {
 class JoinNode : public ExecNode {
@@ -49,6 +51,8 @@ public:
     void convert_to_inner_join(std::vector<ExprNode*>& input_exprs);
     int get_next_for_other_join(RuntimeState* state, RowBatch* batch, bool* eos);
     int get_next_for_inner_join(RuntimeState* state, RowBatch* batch, bool* eos);
+    int get_next_for_hash_join(RuntimeState* state, RowBatch* batch, bool* eos);
+    int get_next_for_batch_join(RuntimeState* state, RowBatch* batch, bool* eos);
     bool outer_contains_expr(ExprNode* expr) {
         return expr_in_tuple_ids(_outer_tuple_ids, expr);
     }
@@ -124,6 +128,21 @@ private:
     void _encode_hash_key(MemRow* row,
                           const std::vector<ExprNode*>& slot_ref_exprs,
                           MutTableKey& key);
+    //等值列都是定长类型时使用FixedKey的hash表
+    void _init_fixed_key_words();
+    template <size_t N>
+    void _encode_fixed_key(MemRow* row,
+                           const std::vector<ExprNode*>& slot_ref_exprs,
+                           FixedKey<N>* key);
+    template <size_t N>
+    void _construct_fixed_hash_map(const std::vector<MemRow*>& tuple_data,
+                                   const std::vector<ExprNode*>& slot_refs,
+                                   FixedKeyHashMap<N, std::vector<MemRow*>>* hash_map);
+    template <size_t N>
+    std::vector<MemRow*>* _seek_fixed_hash_map(MemRow* row,
+                                   const std::vector<ExprNode*>& slot_refs,
+                                   FixedKeyHashMap<N, std::vector<MemRow*>>* hash_map);
+    std::vector<MemRow*>* _seek_hash_map(MemRow* row, const std::vector<ExprNode*>& slot_refs);
     void _save_join_value(const std::vector<MemRow*>& tuple_data,
                           const std::vector<ExprNode*>& slot_ref_exprs);
 
@@ -133,6 +152,33 @@ private:
                                bool inner_join);
     int _construct_null_result_batch(RowBatch* batch, MemRow* outer_mem_row);
 
+    //驱动表较大时不做in条件下推，内表建hash表，驱动表流式探测
+    int _fetch_outer_table(RuntimeState* state, int64_t max_rows, bool* eos);
+    int _open_hash_join(RuntimeState* state);
+    int _fetch_build_table(RuntimeState* state, ExecNode* build_node);
+    int64_t _row_bytes(MemRow* row);
+    int _init_join_partitions(RuntimeState* state, int level);
+    int _append_partition(std::vector<std::shared_ptr<SpillFile>>& partitions, size_t begin,
+                          MemRow* row, const std::vector<ExprNode*>& slot_refs, int level);
+    int _spill_probe_table(RuntimeState* state);
+    //返回1表示分区超过内存预算，已加载的行已释放
+    int _load_build_partition(RuntimeState* state, SpillFile* partition);
+    int _repartition(RuntimeState* state, size_t idx);
+    int _load_next_partition(RuntimeState* state);
+    int _fetch_probe_batch(RuntimeState* state);
+    void _clear_hash_map();
+
+    //in条件下推后重新做索引选择和路由选择
+    void _reselect_inner_index(RuntimeState* state);
+    //驱动表分批下推in条件，每批只访问这批key路由到的region
+    int _fetch_inner_batch(RuntimeState* state, size_t begin, size_t end,
+                           std::vector<MemRow*>& tuple_data);
+    int _reset_in_values(ExprNode* in_expr, std::vector<std::vector<ExprValue>>& in_values);
+    void _prefetch_inner_batch(RuntimeState* state);
+    //等待预取结束，把预取的子state合并回state
+    void _join_prefetch(RuntimeState* state);
+    int _next_join_batch(RuntimeState* state);
+
     virtual void show_explain(std::vector<std::map<std::string, std::string>>& output);
 private:
     pb::JoinType _join_type;
@@ -157,6 +203,11 @@ private:
 
     //目前只支持等值join（a.id = b.id and a.name = b.name）
     butil::FlatMap<std::string, std::vector<MemRow*>> _hash_map;
+    //定长key的word数，0表示使用_hash_map
+    size_t _fixed_key_words = 0;
+    FixedKeyHashMap<2, std::vector<MemRow*>> _fixed_map2;
+    FixedKeyHashMap<4, std::vector<MemRow*>> _fixed_map4;
+    FixedKeyHashMap<8, std::vector<MemRow*>> _fixed_map8;
     size_t _hash_mapped_index = 0;
 
     std::vector<MemRow*>::iterator _outer_iter;
@@ -166,6 +217,39 @@ private:
     
     RowBatch _inner_row_batch;
     bool    _child_eos = false;
+
+    //hash join使用
+    bool _use_hash_join = false;
+    ExecNode* _probe_node = nullptr;
+    std::vector<ExprNode*>* _build_equal_slot = nullptr;
+    std::vector<ExprNode*>* _probe_equal_slot = nullptr;
+    std::vector<MemRow*>* _build_tuple_data = nullptr;
+    RowBatch _probe_batch;
+    bool _probe_eos = false;
+    //_outer_tuple_data中下一个要探测的行，切换到hash join前已取到的驱动表行先探测
+    size_t _pending_probe_idx = 0;
+    int64_t _build_bytes = 0;
+    //build侧超过内存预算时两侧按key hash分区落盘(grace hash join)
+    std::vector<std::shared_ptr<SpillFile>> _build_partitions;
+    std::vector<std::shared_ptr<SpillFile>> _probe_partitions;
+    //分区被再次切分的次数，再次切分时换hash种子
+    std::vector<int> _partition_levels;
+    std::shared_ptr<SpillFile> _probe_reader;
+    size_t _partition_idx = 0;
+
+    //分批join使用，_outer_tuple_data中[_outer_iter, _batch_end)为当前批
+    bool _use_batch_join = false;
+    size_t _batch_end = 0;
+    //下推到内表的in条件，由内表的filter node持有
+    ExprNode* _batch_in_expr = nullptr;
+    //后台预取下一批内表数据，与当前批的探测并行
+    Bthread _prefetch_bth;
+    bool _is_prefetching = false;
+    //预取bthread使用的state，不和探测共享state
+    std::unique_ptr<RuntimeState> _prefetch_state;
+    int _prefetch_ret = 0;
+    size_t _prefetch_end = 0;
+    std::vector<MemRow*> _prefetch_tuple_data;
 };
 }
 
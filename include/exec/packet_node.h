@@ -46,6 +46,9 @@ public:
     size_t field_count() {
         return _fields.size();
     }
+    const std::vector<ResultField>& fields() const {
+        return _fields;
+    }
     int pack_fields(DataBuffer* buffer, int& packet_id);
     
     // COM_STMT_EXECUTE use ProtocolBinary for result set
@@ -61,6 +64,8 @@ private:
     int open_cmsketch(RuntimeState* state);
     int open_analyze(RuntimeState* state);
     int open_trace(RuntimeState* state);
+    int open_column(RuntimeState* state);
+    int stream_send(RuntimeState* state);
     int handle_trace(RuntimeState* state);
     int handle_trace2(RuntimeState* state);
     void pack_trace2(std::vector<std::map<std::string, std::string>>& info, const pb::TraceNode& trace_node,
@@ -73,6 +78,9 @@ private:
     int pack_fields();
     int pack_vector_row(const std::vector<std::string>& row);
     int pack_text_row(MemRow* row);
+    int pack_text_row(ColumnBatch* batch, size_t idx);
+    int pack_text_row_head();
+    int pack_text_row_len(int start_pos);
     int pack_binary_row(MemRow* row);
     int pack_eof();
 
@@ -84,6 +92,7 @@ private:
     NetworkSocket* _client = nullptr;
     MysqlWrapper* _wrapper = nullptr;
     DataBuffer* _send_buf = nullptr;
+    bool _streaming = false;
 };
 }
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
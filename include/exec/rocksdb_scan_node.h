@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include "scan_node.h"
 #include "table_record.h"
 #include "table_iterator.h"
@@ -24,6 +26,25 @@
 
 namespace baikaldb {
 class ReverseIndexBase;
+// 并发扫描的一个主键子范围，worker按ROW_BATCH_CAPACITY攒批放入chunks
+struct ParallelScanRange {
+    ParallelScanRange() {
+        bthread_mutex_init(&mutex, NULL);
+        bthread_cond_init(&cond, NULL);
+    }
+    ~ParallelScanRange() {
+        delete iter;
+        bthread_cond_destroy(&cond);
+        bthread_mutex_destroy(&mutex);
+    }
+    TableIterator* iter = nullptr;
+    std::deque<std::vector<std::unique_ptr<MemRow>>> chunks;
+    bool finished = false;
+    bthread_mutex_t mutex;
+    bthread_cond_t cond;
+};
+typedef std::shared_ptr<ParallelScanRange> SmartParallelRange;
+
 class RocksdbScanNode : public ScanNode {
 public:
     RocksdbScanNode() {
@@ -31,6 +52,7 @@ public:
     RocksdbScanNode(pb::Engine engine): ScanNode(engine) {
     }
     virtual ~RocksdbScanNode() {
+        stop_parallel_scan();
         for (auto expr : _index_conjuncts) {
             ExprNode::destroy_tree(expr);
         }
@@ -47,6 +69,7 @@ public:
     int index_condition_pushdown();
     virtual int open(RuntimeState* state);
     virtual int get_next(RuntimeState* state, RowBatch* batch, bool* eos);
+    virtual int get_next_column(RuntimeState* state, ColumnBatch* batch, bool* eos);
     virtual void close(RuntimeState* state);
     bool contain_condition(ExprNode* expr) {
         std::unordered_set<int32_t> related_tuple_ids;
@@ -83,6 +106,17 @@ private:
     int get_next_by_table_seek(RuntimeState* state, RowBatch* batch, bool* eos);
     int get_next_by_index_get(RuntimeState* state, RowBatch* batch, bool* eos);
     int get_next_by_index_seek(RuntimeState* state, RowBatch* batch, bool* eos);
+    // 一次批量点查的key数，不超过batch和limit的剩余行数
+    size_t multi_get_count(size_t free_rows, size_t remain_keys);
+    // 大region的主键范围扫描按近似大小拆成多个子范围，并发读取，按子范围顺序输出
+    int get_next_by_parallel_seek(RuntimeState* state, RowBatch* batch, bool* eos);
+    int split_parallel_bounds(RuntimeState* state, std::vector<std::string>* bounds);
+    int open_parallel_scan(RuntimeState* state);
+    void parallel_scan_worker(ParallelScanRange* range);
+    void stop_parallel_scan();
+    // 主键点查/扫描直接写列存
+    int get_next_by_table_get(RuntimeState* state, ColumnBatch* batch, bool* eos);
+    int get_next_by_table_seek(RuntimeState* state, ColumnBatch* batch, bool* eos);
     int choose_index(RuntimeState* state);
     int select_index_for_store();
 
@@ -134,9 +168,19 @@ private:
     size_t _idx = 0;
     //后续做下推用
     std::vector<ExprNode*> _index_conjuncts;
+    // 列存扫描复用的行，只用于解码和索引条件过滤
+    std::unique_ptr<MemRow> _scratch_row;
     IndexIterator* _index_iter = nullptr;
     TableIterator* _table_iter = nullptr;
     ReverseIndexBase* _reverse_index = nullptr;
+    // 并发扫描，_parallel_ranges已按扫描方向排序
+    bool _parallel_checked = false;
+    std::vector<SmartParallelRange> _parallel_ranges;
+    size_t _parallel_idx = 0;
+    std::vector<std::unique_ptr<MemRow>> _parallel_rows;
+    size_t _parallel_row_idx = 0;
+    std::atomic<bool> _parallel_stop {false};
+    BthreadCond _parallel_cond;
 
     SmartTable       _table_info;
     SmartIndex       _pri_info;
@@ -34,13 +34,19 @@ public:
     }
     virtual int open(RuntimeState* state);
     virtual int get_next(RuntimeState* state, RowBatch* batch, bool* eos);
+    virtual int get_next_column(RuntimeState* state, ColumnBatch* batch, bool* eos);
     virtual void close(RuntimeState* state) {
         ExecNode::close(state);
         for (auto expr : _slot_order_exprs) {
             expr->close();
         }
         _sorter = nullptr;
+        _fetcher_store.close_cursors(state);
         _fetcher_store.clear();
+        _stream_select = false;
+        _cur_region_id = -1;
+        _cur_batch = nullptr;
+        _cur_columnar_rows = nullptr;
     }
     int init_sort_info(const pb::PlanNode& node) {
         for (auto& expr : node.derive_node().sort_node().slot_order_exprs()) {
@@ -69,6 +75,11 @@ public:
                           ExecNode* exec_node,
                           int64_t main_table_id);
 private:
+    //不需要排序时按region顺序输出，region的后续分页在读完当前页后再取
+    int get_next_stream(RuntimeState* state, RowBatch* batch, bool* eos);
+    // 取当前region的下一页或下一个region的第一页，没有数据时返回1
+    int next_page(RuntimeState* state);
+
     //允许fetcher回来后排序
     std::vector<ExprNode*> _slot_order_exprs;
     std::vector<bool> _is_asc;
@@ -78,6 +89,10 @@ private:
     FetcherStore    _fetcher_store;
     std::map<int32_t, int32_t> _index_slot_field_map;
     SchemaFactory*  _factory = nullptr;
+    bool _stream_select = false;
+    int64_t _cur_region_id = -1;
+    std::shared_ptr<RowBatch> _cur_batch;
+    std::shared_ptr<pb::ColumnarRows> _cur_columnar_rows;
 };
 }
 
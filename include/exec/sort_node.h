@@ -16,6 +16,7 @@
 
 #include "exec_node.h"
 #include "sorter.h"
+#include "topn_sorter.h"
 #include "mem_row_compare.h"
 #include "property.h"
 
@@ -111,6 +112,7 @@ private:
     std::vector<bool> _is_null_first;
     std::shared_ptr<MemRowCompare> _mem_row_compare;
     std::shared_ptr<Sorter> _sorter;
+    std::shared_ptr<TopNSorter> _topn_sorter;
     bool _monotonic = true; //是否单调(全部升序或降序)
 };
 }
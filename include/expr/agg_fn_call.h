@@ -47,6 +47,9 @@ public:
         return row->get_value(_tuple_id, _final_slot_id);
     }
 
+    bool is_distinct() const {
+        return _is_distinct;
+    }
     bool is_initialize(MemRow* dst);
     // 聚合函数逻辑
     // 初始化分配内存
@@ -21,6 +21,8 @@
 #include "proto/expr.pb.h"
 
 namespace baikaldb {
+class ColumnBatch;
+class ColumnVector;
 class ExprNode {
 public:
     ExprNode() {}
@@ -112,6 +114,16 @@ public:
     virtual ExprValue get_value(MemRow* row) { //对每行计算表达式
         return ExprValue::Null();
     } 
+    // 列存批量计算，open之后调用
+    // out由调用方按batch->size()resize，结果转成out->type()写入selection对应的行
+    // selection为nullptr表示计算batch所有行
+    virtual bool can_eval_batch() {
+        return false;
+    }
+    virtual int eval_batch(ColumnBatch* batch, const std::vector<uint32_t>* selection,
+            ColumnVector* out) {
+        return -1;
+    }
     //释放open创建的资源
     virtual void close() {
         for (auto e : _children) {
@@ -204,6 +216,8 @@ public:
     void get_all_tuple_ids(std::unordered_set<int32_t>& tuple_ids);
     void get_all_slot_ids(std::unordered_set<int32_t>& slot_ids);
     void get_all_field_ids(std::unordered_set<int32_t>& field_ids);
+    // (tuple_id, slot_id)
+    void get_all_slot_refs(std::set<std::pair<int32_t, int32_t>>& slot_refs);
     int32_t tuple_id() const {
         return _tuple_id;
     }
@@ -18,6 +18,7 @@
 #include "expr_value.h"
 #include "proto/expr.pb.h"
 #include "object_manager.h"
+#include "operators.h"
 
 namespace baikaldb {
 class FunctionManager : public ObjectManager<
@@ -26,6 +27,13 @@ class FunctionManager : public ObjectManager<
 public:
     int init();
     bool swap_op(pb::Function& fn);
+    // 没有批量实现时返回NULL
+    BatchFnCall get_batch_object(const std::string& name) {
+        if (_batch_objects.count(name) == 1) {
+            return _batch_objects[name];
+        }
+        return NULL;
+    }
     static int complete_fn(pb::Function& fn, std::vector<pb::PrimitiveType> types);
     static void complete_common_fn(pb::Function& fn, std::vector<pb::PrimitiveType>& types);
 private:
@@ -34,6 +42,8 @@ private:
             pb::PrimitiveType arg_type, pb::PrimitiveType ret_type);
     static void complete_fn(pb::Function& fn, int num_args, 
             pb::PrimitiveType arg_type, pb::PrimitiveType ret_type);
+
+    std::unordered_map<std::string, BatchFnCall> _batch_objects;
 };
 }
 
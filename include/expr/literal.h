@@ -14,6 +14,7 @@
 
 #pragma once
 #include "expr_node.h"
+#include "column_batch.h"
 //#include "sql_parser.h"
 
 namespace baikaldb {
@@ -182,6 +183,14 @@ public:
     virtual ExprValue get_value(MemRow* row) {
         return _value.cast_to(_col_type);
     }
+    virtual bool can_eval_batch() {
+        return true;
+    }
+    virtual int eval_batch(ColumnBatch* batch, const std::vector<uint32_t>* selection,
+            ColumnVector* out) {
+        out->fill_value(get_value(nullptr), selection);
+        return 0;
+    }
 
 private:
     ExprValue _value;
@@ -66,6 +66,47 @@ BINARY_OP_PREDICATE_ALL_TYPES_DEFINE(le);
 BINARY_OP_DEFINE(logic_and, bool);
 BINARY_OP_DEFINE(logic_or, bool);
 //BINARY_OP_DEFINE(logic_xor, bool);
+
+// 列存批量版本，left/right/out已按参数和返回类型准备好
+// selection为nullptr表示计算所有行
+class ColumnVector;
+typedef void (*BatchFnCall)(const ColumnVector& left, const ColumnVector& right,
+        const std::vector<uint32_t>* selection, ColumnVector* out);
+#define BINARY_OP_BATCH_DEFINE(NAME, TYPE) \
+    void NAME##_##TYPE##_##TYPE##_batch(const ColumnVector& left, const ColumnVector& right, \
+            const std::vector<uint32_t>* selection, ColumnVector* out);
+#define BINARY_OP_ALL_TYPES_BATCH_DEFINE(NAME) \
+    BINARY_OP_BATCH_DEFINE(NAME, int); \
+    BINARY_OP_BATCH_DEFINE(NAME, uint); \
+    BINARY_OP_BATCH_DEFINE(NAME, double);
+#define BINARY_OP_PREDICATE_ALL_TYPES_BATCH_DEFINE(NAME) \
+    BINARY_OP_BATCH_DEFINE(NAME, int); \
+    BINARY_OP_BATCH_DEFINE(NAME, uint); \
+    BINARY_OP_BATCH_DEFINE(NAME, double); \
+    BINARY_OP_BATCH_DEFINE(NAME, string); \
+    BINARY_OP_BATCH_DEFINE(NAME, datetime); \
+    BINARY_OP_BATCH_DEFINE(NAME, time); \
+    BINARY_OP_BATCH_DEFINE(NAME, date); \
+    BINARY_OP_BATCH_DEFINE(NAME, timestamp); 
+BINARY_OP_ALL_TYPES_BATCH_DEFINE(add);
+BINARY_OP_ALL_TYPES_BATCH_DEFINE(minus);
+BINARY_OP_ALL_TYPES_BATCH_DEFINE(multiplies);
+BINARY_OP_ALL_TYPES_BATCH_DEFINE(divides);
+BINARY_OP_BATCH_DEFINE(mod, int);
+BINARY_OP_BATCH_DEFINE(mod, uint);
+BINARY_OP_BATCH_DEFINE(left_shift, uint);
+BINARY_OP_BATCH_DEFINE(right_shift, uint);
+BINARY_OP_BATCH_DEFINE(bit_and, uint);
+BINARY_OP_BATCH_DEFINE(bit_or, uint);
+BINARY_OP_BATCH_DEFINE(bit_xor, uint);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_DEFINE(eq);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_DEFINE(ne);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_DEFINE(gt);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_DEFINE(ge);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_DEFINE(lt);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_DEFINE(le);
+BINARY_OP_BATCH_DEFINE(logic_and, bool);
+BINARY_OP_BATCH_DEFINE(logic_or, bool);
 }
 
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -48,6 +48,9 @@ public:
         }
         return ExprValue::True();
     }
+    virtual bool can_eval_batch();
+    virtual int eval_batch(ColumnBatch* batch, const std::vector<uint32_t>* selection,
+            ColumnVector* out);
 };
 
 class OrPredicate : public ScalarFnCall {
@@ -66,6 +69,9 @@ public:
         }
         return ExprValue::False();
     }
+    virtual bool can_eval_batch();
+    virtual int eval_batch(ColumnBatch* batch, const std::vector<uint32_t>* selection,
+            ColumnVector* out);
 };
 
 class XorPredicate : public ScalarFnCall {
@@ -110,6 +116,9 @@ public:
     InPredicate() {}
     virtual int open();
     virtual ExprValue get_value(MemRow* row);
+    virtual bool can_eval_batch();
+    virtual int eval_batch(ColumnBatch* batch, const std::vector<uint32_t>* selection,
+            ColumnVector* out);
 
 private:
     int singel_open();
@@ -26,6 +26,9 @@ public:
     virtual void children_swap();
     virtual int open();
     virtual ExprValue get_value(MemRow* row);
+    virtual bool can_eval_batch();
+    virtual int eval_batch(ColumnBatch* batch, const std::vector<uint32_t>* selection,
+            ColumnVector* out);
     pb::Function fn() {
         return _fn;
     }
@@ -112,6 +115,7 @@ protected:
     pb::Function _fn;
     bool _is_row_expr = false;
     std::function<ExprValue(const std::vector<ExprValue>&)> _fn_call;
+    BatchFnCall _fn_batch_call = NULL;
 };
 }
 
@@ -14,6 +14,7 @@
 
 #pragma once
 #include "expr_node.h"
+#include "column_batch.h"
 
 namespace baikaldb {
 class SlotRef : public ExprNode {
@@ -34,6 +35,24 @@ public:
         }
         return row->get_value(_tuple_id, _slot_id).cast_to(_col_type);
     }
+    virtual bool can_eval_batch() {
+        return true;
+    }
+    virtual int eval_batch(ColumnBatch* batch, const std::vector<uint32_t>* selection,
+            ColumnVector* out) {
+        ColumnVector* column = batch->get_column(_tuple_id, _slot_id);
+        if (column == nullptr) {
+            return 0;
+        }
+        if (column_type_compatible(column->type(), _col_type)) {
+            out->copy_from(*column, selection);
+            return 0;
+        }
+        for_each_selected(out->size(), selection, [this, column, out](size_t idx) {
+            out->set_value(idx, column->get_value(idx).cast_to(_col_type));
+        });
+        return 0;
+    }
 
     SlotRef* clone() {
         SlotRef* s = new SlotRef;
@@ -0,0 +1,86 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Brief:  process-wide plan cache for COM_QUERY (keyed by literal-stripped sql)
+//         and shared prepared statement plans
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <bvar/bvar.h>
+#include "lru_cache.h"
+#include "query_context.h"
+
+namespace baikaldb {
+
+struct PlanCacheEntry {
+    // 带placeholder的模板，只读，命中后拷贝pb plan绑定参数
+    std::shared_ptr<QueryContext> prepare_ctx;
+    // prepare ok包用到的结果列和参数个数，连接上的句柄不需要自己的执行树
+    std::vector<ResultField> fields;
+    size_t num_params = 0;
+    // table_id => version，schema变更后失效
+    std::map<int64_t, int64_t> table_versions;
+    std::string normalized_sql;
+    std::string resource_tag;
+    // 不能缓存的sql也记录下来，避免每次都尝试生成模板
+    bool cacheable = false;
+};
+typedef std::shared_ptr<PlanCacheEntry> SmartPlanCacheEntry;
+
+class PlanCache {
+public:
+    static PlanCache* get_instance() {
+        static PlanCache _instance;
+        return &_instance;
+    }
+    // 返回0: 已通过cache生成ctx的plan; 1: 不走cache; -1: 出错
+    int analyze(QueryContext* ctx);
+
+    // 把比较运算符右侧以及IN/VALUES列表中的数字和字符串字面量替换为?
+    // 字面量按顺序转成pb::ExprNode放到params中，不支持的sql返回-1
+    static int normalize_sql(const std::string& sql, std::string* normalized,
+            std::vector<pb::ExprNode>* params);
+
+    // 全局prepare plan，相同sql的prepare语句在所有连接之间共享同一个模板
+    // handle为连接上的prepare句柄，提供sql/db/用户等信息，错误信息写到ctx
+    SmartPlanCacheEntry get_prepared_plan(QueryContext* handle, QueryContext* ctx);
+
+    // 模板中的表有DDL后返回false
+    bool check_version(const SmartPlanCacheEntry& entry);
+
+private:
+    PlanCache();
+    std::string make_key(QueryContext* ctx, const std::string& sql);
+    int create_template(QueryContext* ctx, const std::string& sql, PlanCacheEntry* entry,
+            QueryContext* err_ctx);
+    SmartPlanCacheEntry build_entry(QueryContext* ctx, const std::string& normalized_sql,
+            size_t num_params);
+
+    Cache<std::string, SmartPlanCacheEntry> _cache;
+    bvar::Adder<int64_t> _hit_count;
+    bvar::Adder<int64_t> _miss_count;
+
+    // 只保存弱引用，所有连接关闭prepare句柄后模板自动释放
+    std::mutex _prepared_mutex;
+    std::unordered_map<std::string, std::weak_ptr<PlanCacheEntry>> _prepared_plans;
+    size_t _prepared_sweep_size = 1024;
+    bvar::Adder<int64_t> _prepared_hit_count;
+};
+} //namespace baikaldb
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
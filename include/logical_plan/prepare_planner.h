@@ -29,7 +29,18 @@ public:
 
     virtual int plan();
 
+    // 解析带placeholder的sql并生成模板plan，prepare和plan cache共用
+    int create_prepare_ctx(const std::string& stmt_sql, std::shared_ptr<QueryContext>& prepare_ctx);
+    // 绑定参数到模板plan，reuse_select_plan为false时select也拷贝pb plan重新建树
+    int execute_prepare_ctx(std::shared_ptr<QueryContext> prepare_ctx,
+            std::vector<pb::ExprNode>& params, bool reuse_select_plan);
+
 private:
+    // 连接上的句柄只引用共享模板
+    void attach_shared_plan(std::shared_ptr<QueryContext> prepare_ctx,
+            std::shared_ptr<PlanCacheEntry> shared_plan);
+    // 从共享模板生成句柄自己的select执行树，之后的execute复用
+    int create_select_tree(std::shared_ptr<QueryContext> prepare_ctx);
     int stmt_prepare(const std::string& stmt_name, const std::string& stmt_sql);
     int stmt_execute(const std::string& stmt_name, std::vector<pb::ExprNode>& params);
     int stmt_close(const std::string& stmt_name);
@@ -24,6 +24,7 @@ namespace baikaldb {
 DECLARE_bool(default_2pc);
 
 class ExecNode;
+struct PlanCacheEntry;
 
 // notice日志信息统计结构
 struct QueryStat {
@@ -223,6 +224,8 @@ public:
     std::unordered_map<uint64_t, std::string> long_data_vars;
     std::vector<SignedType> param_type;
     std::set<int64_t> index_ids;
+    // 连接上的prepare句柄引用的全局共享plan
+    std::shared_ptr<PlanCacheEntry> shared_plan;
 
 private:
     std::vector<pb::TupleDescriptor> _tuple_descs;
@@ -14,6 +14,7 @@
 
 #pragma once
 #include "common.h"
+#include <memory>
 #include <unordered_set>
 #include "expr_value.h"
 #include "message_helper.h"
@@ -25,6 +26,8 @@ namespace baikaldb {
 class TableKey;
 class IndexInfo;
 class MemRowDescriptor;
+struct MemRowLayout;
+typedef std::shared_ptr<MemRowLayout> SmartMemRowLayout;
 //internal memory row meta-data for a query
 class MemRow final {
 friend MemRowDescriptor;
@@ -32,12 +35,7 @@ public:
     explicit MemRow(int size) : _tuples(size) {
     }
 
-    ~MemRow() {
-        for (auto& t : _tuples) {
-            delete t;
-            t = nullptr;
-        }
-    }
+    ~MemRow();
     google::protobuf::Message* get_tuple(int32_t tuple_id) {
         return _tuples[tuple_id];
     }
@@ -128,6 +126,8 @@ public:
 
     private:
     std::vector<google::protobuf::Message*> _tuples;
+    // fetch_mem_row生成的行持有layout，析构时tuple留给后续的行复用
+    SmartMemRowLayout _layout;
 };
 }
 
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <map>
 #include <memory>
 #include "common.h"
 #include "proto/common.pb.h"
@@ -26,17 +27,25 @@ using google::protobuf::FieldDescriptorProto;
 
 namespace baikaldb {
 class MemRow;
+// 由tuple描述编译出的动态protobuf类型，只读，slot布局相同的查询共享同一份
+struct MemRowLayout {
+    ~MemRowLayout() {
+        delete factory;
+        factory = nullptr;
+    }
+    google::protobuf::DescriptorPool          pool;
+    google::protobuf::DynamicMessageFactory*  factory = nullptr;
+    // kv: tuple_id => DescriptorProto (message, tuple)
+    std::map<int32_t, const google::protobuf::Message*> id_tuple_mapping;
+};
+typedef std::shared_ptr<MemRowLayout> SmartMemRowLayout;
+
 //internal memory row meta-data for a query
 class MemRowDescriptor {
 public:
-    MemRowDescriptor() : _factory(nullptr), _proto(nullptr) {}
+    MemRowDescriptor() {}
 
-    virtual ~MemRowDescriptor() {
-        delete _proto;
-        _proto = nullptr;
-        delete _factory;
-        _factory = nullptr;
-    }
+    virtual ~MemRowDescriptor() {}
 
     int32_t init(std::vector<pb::TupleDescriptor>& tuple_desc);
 
@@ -44,18 +53,23 @@ public:
 
     std::unique_ptr<MemRow> fetch_mem_row();
 
+    // fetch_mem_row生成的行析构时调用，tuple Clear后放到当前线程的空闲列表给后续的行复用
+    // 行持有layout的引用，可以晚于descriptor释放
+    static void release_tuples(const SmartMemRowLayout& layout,
+            std::vector<google::protobuf::Message*>& tuples);
+
     int tuple_size() {
-        return _id_tuple_mapping.size();
+        if (_layout == nullptr) {
+            return 0;
+        }
+        return _layout->id_tuple_mapping.size();
     }
 
 private:
-    google::protobuf::DescriptorPool          _pool;
-    google::protobuf::DynamicMessageFactory*  _factory;
-    google::protobuf::FileDescriptorProto*    _proto;
-    
-    // kv: tuple_id => DescriptorProto (message, tuple)
-    std::map<int32_t, const google::protobuf::Message*> _id_tuple_mapping;
+    static int build_layout(const std::vector<pb::TupleDescriptor>& tuple_desc,
+            MemRowLayout* layout);
 
+    SmartMemRowLayout _layout;
 };
 }
 
@@ -57,6 +57,8 @@ public:
     int real_read_header(SmartSocket sock, int want_len, int* real_read_len);
     int real_read(SmartSocket sock, int we_want, int* ret_read_len);
     int real_write(SmartSocket sock);
+    // 在当前bthread里写完send_buf，socket写满时挂起在EPOLLOUT上
+    int blocking_write(NetworkSocket* sock, int64_t timeout_us);
 
     bool is_shutdown_command(uint8_t command);
     bool is_prepare_command(uint8_t command);
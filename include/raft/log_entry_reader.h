@@ -14,9 +14,18 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
 #include "rocks_wrapper.h"
 
 namespace baikaldb {
+struct RaftLogEntry {
+    int64_t index = 0;
+    int64_t term = 0;
+    int type = 0;
+    std::string data;
+};
+
 class LogEntryReader {
 public:
     virtual ~LogEntryReader() {}
@@ -39,10 +48,20 @@ public:
         txn_ids.insert(txn_id);
         return read_log_entry(region_id, start_log_index, end_log_index, txn_ids, log_entrys);
     }
+    // 从start_log_index开始按顺序读取最多max_num条日志，兼容rocksdb和segment两种存储
+    // 返回1: 后面还有日志 0: 已读到最后一条 -1: 出错
+    int read_log_entries(int64_t region_id, int64_t start_log_index, int max_num,
+        std::vector<RaftLogEntry>& entries);
     int read_txn_last_log_entry(int64_t region_id, int64_t start_log_index, int64_t end_log_index,
         std::set<uint64_t>& txn_ids, std::map<uint64_t, std::string>& log_entrys);
 private:
     LogEntryReader() {}
+    // -1: 解析失败 0: 不是txn_ids中事务的日志 1: 命中
+    int _parse_txn_id(int64_t region_id, const rocksdb::Slice& value,
+        const std::set<uint64_t>& txn_ids, uint64_t* txn_id);
+    // raft log使用segment存储时按index逐条读取
+    int _read_segment_txn_entry(int64_t region_id, int64_t start_log_index, int64_t end_log_index,
+        const std::set<uint64_t>& txn_ids, std::map<int64_t, std::pair<uint64_t, std::string>>& log_entrys);
 
 private:
     RocksWrapper*       _rocksdb;
@@ -254,6 +254,16 @@ public:
     virtual void close_snapshot(const std::string& snapshot_path) override;
 
     void close(const std::string& path);
+    // region按表路由后的数据column family
+    void set_data_cf(rocksdb::ColumnFamilyHandle* data_cf) {
+        _data_cf = data_cf;
+    }
+    rocksdb::ColumnFamilyHandle* get_data_cf() {
+        if (_data_cf == nullptr) {
+            return RocksWrapper::get_instance()->get_data_handle();
+        }
+        return _data_cf;
+    }
 private:
     braft::FileAdaptor* open_reader_adaptor(const std::string& path, int oflag,
                               const ::google::protobuf::Message* file_meta,
@@ -266,6 +276,7 @@ private:
 
 private:
     int64_t             _region_id;
+    rocksdb::ColumnFamilyHandle* _data_cf = nullptr;
     bthread_mutex_t     _snapshot_mutex;
     BthreadCond         _mutil_snapshot_cond;
     typedef std::map<std::string, std::pair<SnapshotContextPtr, int64_t>> SnapshotMap;
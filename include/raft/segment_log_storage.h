@@ -0,0 +1,213 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <bthread/mutex.h>
+#ifdef BAIDU_INTERNAL
+#include <base/iobuf.h>
+#include <raft/storage.h>
+#else
+#include <butil/iobuf.h>
+#include <braft/storage.h>
+#endif
+
+namespace baikaldb {
+
+/* 一个store上所有region共享的追加写日志文件，按大小切分成segment
+ * 文件名: log_<segment_id>
+ * Record: RecordHead + data
+ * RecordHead: magic(4) + kind(4) + region_id(8) + index(8) + term(8) + data_len(4) + crc(4)
+ * kind: braft::EntryType 或者 truncate/reset/remove 标记
+ * crc: crc32c(RecordHead前36字节 + data)
+ */
+enum SegmentRecordKind {
+    SEGMENT_TRUNCATE_PREFIX = 101,
+    SEGMENT_TRUNCATE_SUFFIX = 102,
+    SEGMENT_RESET           = 103,
+    SEGMENT_REMOVE_REGION   = 104
+};
+
+struct SegmentEntryPos {
+    int64_t segment_id;
+    int64_t offset;
+    uint32_t size;
+    int32_t type;
+    int64_t term;
+};
+
+// 单个region的内存索引，entries[i]对应日志index = first_index + i
+struct SegmentRegionLog {
+    SegmentRegionLog() {
+        bthread_mutex_init(&mutex, NULL);
+    }
+    ~SegmentRegionLog() {
+        bthread_mutex_destroy(&mutex);
+    }
+    int64_t last_index() const {
+        return first_index + (int64_t)entries.size() - 1;
+    }
+    bthread_mutex_t mutex;
+    int64_t first_index = 1;
+    std::deque<SegmentEntryPos> entries;
+};
+typedef std::shared_ptr<SegmentRegionLog> SmartRegionLog;
+
+struct LogSegment {
+    ~LogSegment();
+    int64_t id = 0;
+    int fd = -1;
+    int64_t size = 0;
+    std::string path;
+    // region_id => 该segment中写入的最大index，用于判断segment能否回收
+    std::map<int64_t, int64_t> region_max_index;
+};
+typedef std::shared_ptr<LogSegment> SmartSegment;
+
+// 一次append请求，多个region并发append时由一个bthread合并写盘和fsync
+struct SegmentAppendTask {
+    int64_t region_id = 0;
+    int64_t max_index = 0;
+    butil::IOBuf data;
+    int64_t segment_id = 0;
+    int64_t offset = 0;
+    int ret = 0;
+    bool done = false;
+};
+
+class SegmentLogManager {
+public:
+    static const size_t RECORD_HEAD_SIZE = 40;
+    static const uint32_t RECORD_MAGIC = 0x42444C47;
+
+    static SegmentLogManager* get_instance() {
+        static SegmentLogManager _instance;
+        return &_instance;
+    }
+    // 打开目录并扫描所有segment重建内存索引，只执行一次
+    int init();
+    bool is_inited() const {
+        return _is_inited.load();
+    }
+    SmartRegionLog get_region_log(int64_t region_id);
+
+    static void encode_record(uint32_t kind, int64_t region_id, int64_t index, int64_t term,
+                              const butil::IOBuf& data, butil::IOBuf* record);
+    // group commit，返回后task->segment_id/offset为写入位置
+    int append(SegmentAppendTask* task);
+    int append_marker(int64_t region_id, SegmentRecordKind kind, int64_t index);
+    int read_record(const SegmentEntryPos& pos, int64_t region_id, int64_t index,
+                    std::string* data);
+    // LogEntryReader使用
+    int read_entry(int64_t region_id, int64_t index, int* type, std::string* data) {
+        int64_t term = 0;
+        return read_entry(region_id, index, type, &term, data);
+    }
+    int read_entry(int64_t region_id, int64_t index, int* type, int64_t* term,
+                   std::string* data);
+    // region不存在时返回0
+    int64_t last_log_index(int64_t region_id);
+    // region被删除后不再阻塞segment回收
+    void remove_region(int64_t region_id);
+    // 从最老的segment开始回收，所有region都不再引用的segment直接删除
+    void gc_segments();
+
+private:
+    SegmentLogManager() {
+        bthread_mutex_init(&_mutex, NULL);
+        bthread_mutex_init(&_write_mutex, NULL);
+        bthread_cond_init(&_write_cond, NULL);
+    }
+    ~SegmentLogManager() {
+        bthread_cond_destroy(&_write_cond);
+        bthread_mutex_destroy(&_write_mutex);
+        bthread_mutex_destroy(&_mutex);
+    }
+    int _recover();
+    int _recover_segment(const SmartSegment& segment, bool is_last);
+    void _apply_record(int64_t segment_id, int64_t offset, uint32_t size, uint32_t kind,
+                       int64_t region_id, int64_t index, int64_t term);
+    // create为true时新建文件并fsync目录，保证宕机后目录项还在
+    SmartSegment _open_segment(int64_t segment_id, bool create);
+    int _sync_dir();
+    int _write_batch(const std::vector<SegmentAppendTask*>& tasks);
+    int _flush(const SmartSegment& segment, butil::IOBuf* buf);
+    bool _can_remove(const SmartSegment& segment);
+
+    std::atomic<bool> _is_inited {false};
+    std::string _path;
+    // 保护_segments _active _regions 以及segment的region_max_index
+    bthread_mutex_t _mutex;
+    std::map<int64_t, SmartSegment> _segments;
+    SmartSegment _active;
+    int64_t _next_segment_id = 1;
+    std::unordered_map<int64_t, SmartRegionLog> _regions;
+
+    // group commit
+    bthread_mutex_t _write_mutex;
+    bthread_cond_t _write_cond;
+    bool _writing = false;
+    std::vector<SegmentAppendTask*> _pending;
+};
+
+// Implementation of LogStorage based on shared segment files
+// log_uri: mysegmentlog://my_raft_log?id=
+class SegmentLogStorage : public braft::LogStorage {
+public:
+    SegmentLogStorage() {}
+    ~SegmentLogStorage() {}
+
+    int init(braft::ConfigurationManager* configuration_manager) override;
+
+    int64_t first_log_index() override;
+
+    int64_t last_log_index() override;
+
+    braft::LogEntry* get_entry(const int64_t index) override;
+
+    int64_t get_term(const int64_t index) override;
+
+    int append_entry(const braft::LogEntry* entry) override;
+
+    int append_entries(const std::vector<braft::LogEntry*>& entries,
+            braft::IOMetric* metric) override;
+
+    int truncate_prefix(const int64_t first_index_kept) override;
+
+    int truncate_suffix(const int64_t last_index_kept) override;
+
+    int reset(const int64_t next_log_index) override;
+
+    LogStorage* new_instance(const std::string& uri) const override;
+
+private:
+    explicit SegmentLogStorage(int64_t region_id) : _region_id(region_id) {}
+
+    int _parse_meta(braft::LogEntry* entry, const std::string& value);
+
+    int64_t _region_id = 0;
+    SegmentLogManager* _manager = nullptr;
+    SmartRegionLog _log;
+};
+
+} //namespace baikaldb
+
+/* vim: set expandtab ts=4 sw=4 sts=4 tw=100: */
@@ -122,7 +122,8 @@ public:
                        const std::string& merge_term,
                        bool del = false, 
                        RocksWrapper* rocksdb = NULL,
-                       rocksdb::Transaction* txn = NULL) : 
+                       rocksdb::Transaction* txn = NULL,
+                       rocksdb::ColumnFamilyHandle* data_cf = NULL) : 
                            _iter(iter),
                            _merge_term(merge_term),
                            _first(true),
@@ -130,7 +131,8 @@ public:
                            _key_range(key_range),
                            _del(del),
                            _rocksdb(rocksdb),
-                           _txn(txn) {}
+                           _txn(txn),
+                           _data_cf(data_cf) {}
     virtual int next(std::string& key, bool& res);
     virtual void fill_node(ReverseNode* node);
     virtual pb::ReverseNodeType get_flag();
@@ -150,6 +152,7 @@ private:
     bool _del;
     RocksWrapper* _rocksdb;
     rocksdb::Transaction* _txn;
+    rocksdb::ColumnFamilyHandle* _data_cf;
 };
 
 //add_node对arrow进行特化
@@ -80,7 +80,7 @@ int FirstLevelMSIterator<ReverseNode, ReverseList>::next(std::string& key, bool&
         rocksdb::Status s;
         rocksdb::ReadOptions read_opt;
         rocksdb::PinnableSlice pin_slice;
-        auto data_cf = _rocksdb->get_data_handle();
+        auto data_cf = _data_cf != nullptr ? _data_cf : _rocksdb->get_data_handle();
         s = _txn->GetForUpdate(read_opt, data_cf, _iter->key(), &pin_slice);
         if (!s.ok()) {
            DB_WARNING("get for update failed:%s, term:%s, key:%s", s.ToString().c_str(), 
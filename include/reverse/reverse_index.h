@@ -197,6 +197,12 @@ public:
                         _cached_list_length(cached_list_length) {
         _sync_prefix_0 = 0;
         _sync_prefix_1 = 0;
+        auto index_info = SchemaFactory::get_instance()->get_index_info_ptr(index_id);
+        if (index_info != nullptr) {
+            _data_cf = _rocksdb->get_data_handle(index_info->pk);
+        } else {
+            _data_cf = _rocksdb->get_data_handle();
+        }
         if (is_over_cache) {
             _cache.init(cache_size);
         }
@@ -332,6 +338,7 @@ private:
     std::atomic<long>    _sync_prefix_1;
     int                 _second_level_length;
     RocksWrapper*       _rocksdb;
+    rocksdb::ColumnFamilyHandle* _data_cf = nullptr;
     KeyRange            _key_range;
     bool                _prefix_0_succ = false;
     bool                _merge_success_flag = true;
@@ -66,9 +66,10 @@ int ReverseIndex<Schema>::reverse_merge_func(pb::RegionInfo info, bool need_remo
     end_key.append((char*)&max, sizeof(uint64_t));
     rocksdb::Slice upper_bound_slice = end_key;
     roptions.iterate_upper_bound = &upper_bound_slice;
-    roptions.prefix_same_as_start = true;
-    roptions.total_order_seek = false;
-    auto data_cf = _rocksdb->get_data_handle();
+    // 倒排key比data cf的prefix短，用上界代替prefix_same_as_start
+    roptions.prefix_same_as_start = false;
+    roptions.total_order_seek = true;
+    auto data_cf = _data_cf;
     if (data_cf == nullptr) {
         DB_WARNING("get rocksdb data column family failed");
         return -1;
@@ -220,9 +221,16 @@ int ReverseIndex<Schema>::get_reverse_list_two(
                                     ReverseListSptr& list_new_ptr,
                                     ReverseListSptr& list_old_ptr,
                                     bool is_fast) {
+    std::string end_key;
+    _create_reverse_key_prefix(_reverse_prefix, end_key);
+    const uint64_t max = UINT64_MAX;
+    end_key.append((char*)&max, sizeof(uint64_t));
+    rocksdb::Slice upper_bound_slice = end_key;
     rocksdb::ReadOptions roptions;
-    roptions.prefix_same_as_start = true;
-    auto data_cf = _rocksdb->get_data_handle();
+    roptions.iterate_upper_bound = &upper_bound_slice;
+    roptions.prefix_same_as_start = false;
+    roptions.total_order_seek = true;
+    auto data_cf = _data_cf;
     if (data_cf == nullptr) {
         DB_WARNING("get rocksdb data column family failed");
         return 0;
@@ -336,8 +344,9 @@ int ReverseIndex<Schema>::_reverse_remove_range_for_third_level(uint8_t prefix)
     //2. scan every term
     rocksdb::ReadOptions roptions;
     roptions.iterate_upper_bound = &upper_bound_slice;
-    roptions.prefix_same_as_start = true;
-    auto data_cf = _rocksdb->get_data_handle();
+    roptions.prefix_same_as_start = false;
+    roptions.total_order_seek = true;
+    auto data_cf = _data_cf;
     if (data_cf == nullptr) {
         DB_WARNING("get rocksdb data column family failed");
         return -1;
@@ -459,13 +468,13 @@ int ReverseIndex<Schema>::_reverse_merge_to_second_level(
     //get merge term
     std::string merge_term = get_term_from_reverse_key(iterator->key());
     FirstLevelMSIterator<ReverseNode, ReverseList> first_iter(iterator, prefix, 
-                                        _key_range, merge_term, true, _rocksdb, txn->get_txn());
+                                        _key_range, merge_term, true, _rocksdb, txn->get_txn(), _data_cf);
     //create second level key
     std::string second_level_key;
     _create_reverse_key_prefix(2, second_level_key);
     second_level_key.append(merge_term);
     //get second level reverse list
-    auto data_cf = _rocksdb->get_data_handle();
+    auto data_cf = _data_cf;
     if (data_cf == nullptr) {
         DB_WARNING("get rocksdb data column family failed");
         return -1;
@@ -579,7 +588,7 @@ int ReverseIndex<Schema>::_get_level_reverse_list(
     _create_reverse_key_prefix(level, key);
     key.append(term);
     rocksdb::ReadOptions roptions;
-    auto data_cf = _rocksdb->get_data_handle();
+    auto data_cf = _data_cf;
     if (data_cf == nullptr) {
         DB_WARNING("get rocksdb data column family failed");
         return -1;
@@ -642,7 +651,7 @@ int ReverseIndex<Schema>::_delete_level_reverse_list(
     std::string key;
     _create_reverse_key_prefix(level, key);
     key.append(term);
-    auto data_cf = _rocksdb->get_data_handle();
+    auto data_cf = _data_cf;
     if (data_cf == nullptr) {
         DB_WARNING("get rocksdb data column family failed");
         return -1;
@@ -676,7 +685,7 @@ int ReverseIndex<Schema>::_insert_one_reverse_node(
         return -1;
     }
     // 3. put to RocksDB
-    auto data_cf = _rocksdb->get_data_handle();
+    auto data_cf = _data_cf;
     if (data_cf == nullptr) {
         DB_WARNING("get rocksdb data column family failed");
         return -1;
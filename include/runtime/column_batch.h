@@ -0,0 +1,290 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include "expr_value.h"
+#include "mem_row.h"
+#include "mem_row_descriptor.h"
+#include "row_batch.h"
+#include "proto/store.interface.pb.h"
+
+namespace baikaldb {
+// 列存物理类型，同一类存储的PrimitiveType共用一个数组
+enum ColumnStorage {
+    CS_INT    = 0, // BOOL INT8 INT16 INT32 INT64 TIME
+    CS_UINT   = 1, // UINT8 UINT16 UINT32 UINT64 DATE DATETIME TIMESTAMP
+    CS_DOUBLE = 2, // FLOAT DOUBLE
+    CS_STRING = 3  // STRING HLL
+};
+
+inline ColumnStorage column_storage(pb::PrimitiveType type) {
+    switch (type) {
+        case pb::BOOL:
+        case pb::INT8:
+        case pb::INT16:
+        case pb::INT32:
+        case pb::INT64:
+        case pb::TIME:
+            return CS_INT;
+        case pb::UINT8:
+        case pb::UINT16:
+        case pb::UINT32:
+        case pb::UINT64:
+        case pb::DATE:
+        case pb::DATETIME:
+        case pb::TIMESTAMP:
+            return CS_UINT;
+        case pb::FLOAT:
+        case pb::DOUBLE:
+            return CS_DOUBLE;
+        default:
+            return CS_STRING;
+    }
+}
+
+// from类型的列数据可以直接按存储拷贝为to类型(不需要cast)
+inline bool column_type_compatible(pb::PrimitiveType from, pb::PrimitiveType to) {
+    if (from == to) {
+        return true;
+    }
+    switch (to) {
+        case pb::INT64:
+            return from == pb::BOOL || from == pb::INT8 || from == pb::INT16 || from == pb::INT32;
+        case pb::UINT64:
+            return from == pb::UINT8 || from == pb::UINT16 || from == pb::UINT32;
+        case pb::DOUBLE:
+            return from == pb::FLOAT;
+        default:
+            return false;
+    }
+}
+
+// 按selection遍历行下标，selection为nullptr时遍历[0, size)
+// 连续遍历的分支里func内联后可以被编译器向量化
+template <typename Func>
+inline void for_each_selected(size_t size, const std::vector<uint32_t>* selection, Func func) {
+    if (selection == nullptr) {
+        for (size_t i = 0; i < size; i++) {
+            func(i);
+        }
+    } else {
+        for (uint32_t idx : *selection) {
+            func(idx);
+        }
+    }
+}
+
+// 单列数据，定长类型连续存放，null用bitmap标记(1为null)
+class ColumnVector {
+public:
+    explicit ColumnVector(pb::PrimitiveType type = pb::STRING) :
+            _type(type), _storage(column_storage(type)) {}
+
+    pb::PrimitiveType type() const {
+        return _type;
+    }
+    ColumnStorage storage() const {
+        return _storage;
+    }
+    size_t size() const {
+        return _size;
+    }
+    void reserve(size_t capacity);
+    void clear() {
+        _int_data.clear();
+        _uint_data.clear();
+        _double_data.clear();
+        _string_data.clear();
+        _null_bitmap.clear();
+        _size = 0;
+    }
+    void resize(size_t size);
+
+    bool is_null(size_t idx) const {
+        return (_null_bitmap[idx >> 6] >> (idx & 63)) & 0x01;
+    }
+    void set_null(size_t idx) {
+        _null_bitmap[idx >> 6] |= (1ULL << (idx & 63));
+    }
+    void set_not_null(size_t idx) {
+        _null_bitmap[idx >> 6] &= ~(1ULL << (idx & 63));
+    }
+    void append_null() {
+        resize(_size + 1);
+    }
+    void append_value(const ExprValue& value) {
+        append_null();
+        set_value(_size - 1, value);
+    }
+    // value会被转成列的类型
+    void set_value(size_t idx, const ExprValue& value);
+    ExprValue get_value(size_t idx) const;
+    // 用常量填充selection对应的行
+    void fill_value(const ExprValue& value, const std::vector<uint32_t>* selection);
+    // 拷贝src中selection对应的行，类型不兼容时逐行cast
+    void copy_from(const ColumnVector& src, const std::vector<uint32_t>* selection);
+    // 把src中selection对应的行追加到末尾
+    void append_from(const ColumnVector& src, const std::vector<uint32_t>* selection);
+    // null = left.null | right.null，按word处理
+    void merge_null(const ColumnVector& left, const ColumnVector& right) {
+        for (size_t i = 0; i < _null_bitmap.size(); i++) {
+            _null_bitmap[i] = left._null_bitmap[i] | right._null_bitmap[i];
+        }
+    }
+    // 网络传输格式，重复值多的字符串列用字典编码
+    void to_pb(pb::ColumnValues* values) const;
+    int from_pb(const pb::ColumnValues& values, size_t size);
+
+    int64_t* int_data() {
+        return _int_data.data();
+    }
+    uint64_t* uint_data() {
+        return _uint_data.data();
+    }
+    double* double_data() {
+        return _double_data.data();
+    }
+    std::string* string_data() {
+        return _string_data.data();
+    }
+    uint64_t* null_bitmap() {
+        return _null_bitmap.data();
+    }
+    const int64_t* int_data() const {
+        return _int_data.data();
+    }
+    const uint64_t* uint_data() const {
+        return _uint_data.data();
+    }
+    const double* double_data() const {
+        return _double_data.data();
+    }
+    const std::string* string_data() const {
+        return _string_data.data();
+    }
+    const uint64_t* null_bitmap() const {
+        return _null_bitmap.data();
+    }
+    size_t null_bitmap_words() const {
+        return _null_bitmap.size();
+    }
+
+private:
+    pb::PrimitiveType _type;
+    ColumnStorage _storage;
+    size_t _size = 0;
+    std::vector<int64_t> _int_data;
+    std::vector<uint64_t> _uint_data;
+    std::vector<double> _double_data;
+    std::vector<std::string> _string_data;
+    std::vector<uint64_t> _null_bitmap;
+};
+
+// 列存RowBatch，列布局与MemRowDescriptor的tuple/slot一一对应
+// _selection记录有效行的物理下标，filter只修改selection不移动数据
+class ColumnBatch {
+public:
+    ColumnBatch() {}
+    int init(const std::vector<pb::TupleDescriptor>& tuple_descs);
+    bool is_inited() const {
+        return _is_inited;
+    }
+    ColumnVector* get_column(int32_t tuple_id, int32_t slot_id) {
+        if (tuple_id < 0 || tuple_id >= (int32_t)_columns.size()) {
+            return nullptr;
+        }
+        if (slot_id < 1 || slot_id > (int32_t)_columns[tuple_id].size()) {
+            return nullptr;
+        }
+        return &_columns[tuple_id][slot_id - 1];
+    }
+    ExprValue get_value(size_t idx, int32_t tuple_id, int32_t slot_id) {
+        ColumnVector* column = get_column(tuple_id, slot_id);
+        if (column == nullptr || column->is_null(idx)) {
+            return ExprValue::Null();
+        }
+        return column->get_value(idx);
+    }
+    void set_capacity(size_t capacity) {
+        _capacity = capacity;
+    }
+    size_t capacity() const {
+        return _capacity;
+    }
+    // 物理行数
+    size_t size() const {
+        return _size;
+    }
+    bool is_full() const {
+        return _size >= _capacity;
+    }
+    // 追加一行全null，返回物理下标
+    size_t add_row();
+    void clear();
+
+    // selection vector
+    bool all_selected() const {
+        return _all_selected;
+    }
+    size_t selected_size() const {
+        return _all_selected ? _size : _selection.size();
+    }
+    size_t selected_idx(size_t i) const {
+        return _all_selected ? i : _selection[i];
+    }
+    // 全选时返回nullptr，配合for_each_selected使用
+    const std::vector<uint32_t>* selection() const {
+        return _all_selected ? nullptr : &_selection;
+    }
+    std::vector<uint32_t>* mutable_selection();
+    void set_selection(std::vector<uint32_t>& selection) {
+        _selection.swap(selection);
+        _all_selected = false;
+    }
+    void skip_rows(size_t num_skip_rows);
+    void keep_first_rows(size_t num_keep_rows);
+
+    // MemRow转换层，给还没有列存实现的节点使用
+    int append_row(MemRow* row);
+    int append_tuple(int32_t tuple_id, MemRow* row, size_t idx);
+    int append_row_batch(RowBatch& batch);
+    // 按列追加src中被选中的行，列布局需要一致
+    int append_batch(const ColumnBatch& src);
+    void fill_row(size_t idx, MemRow* row);
+    void fill_slots(size_t idx, const std::vector<std::pair<int32_t, int32_t>>& slots, MemRow* row);
+    std::unique_ptr<MemRow> to_mem_row(size_t idx, MemRowDescriptor* desc);
+    // 只转换被选中的行
+    int to_row_batch(MemRowDescriptor* desc, RowBatch* batch);
+
+    // 按物理行编码，调用方保证全选
+    void to_pb(pb::ColumnarRows* rows) const;
+    // 需要先init
+    int from_pb(const pb::ColumnarRows& rows);
+
+private:
+    bool _is_inited = false;
+    bool _all_selected = true;
+    size_t _size = 0;
+    size_t _capacity = ROW_BATCH_CAPACITY;
+    // tuple_id => slot_id - 1 => column
+    std::vector<std::vector<ColumnVector>> _columns;
+    std::vector<uint32_t> _selection;
+};
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
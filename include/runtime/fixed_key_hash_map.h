@@ -0,0 +1,202 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "expr_value.h"
+#include "column_batch.h"
+
+namespace baikaldb {
+// 定长列值编码成8字节，同一存储类型的值编码一致
+inline uint64_t fixed_key_word(const ExprValue& value) {
+    switch (column_storage(value.type)) {
+        case CS_INT:
+            return (uint64_t)value.get_numberic<int64_t>();
+        case CS_UINT:
+            return value.get_numberic<uint64_t>();
+        case CS_DOUBLE: {
+            double d = value.get_numberic<double>();
+            // -0.0与0.0视为相同
+            if (d == 0) {
+                d = 0;
+            }
+            uint64_t word = 0;
+            memcpy(&word, &d, sizeof(word));
+            return word;
+        }
+        default:
+            return 0;
+    }
+}
+
+// 定长group/join key，words[0]为null标记(第i列为null则第i位为1)，之后每列占一个word
+// null值编码与MutTableKey一致，null与null相等
+template <size_t N>
+struct FixedKey {
+    uint64_t words[N];
+
+    void clear() {
+        memset(words, 0, sizeof(words));
+    }
+    void set_value(size_t idx, const ExprValue& value) {
+        if (value.is_null()) {
+            words[0] |= (1ULL << idx);
+            return;
+        }
+        words[idx + 1] = fixed_key_word(value);
+    }
+    bool operator==(const FixedKey& other) const {
+        return memcmp(words, other.words, sizeof(words)) == 0;
+    }
+    uint64_t hash() const {
+        uint64_t h = 0;
+        for (size_t i = 0; i < N; i++) {
+            h ^= words[i] + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        }
+        // murmur3 fmix64，低位用于定位slot，需要充分混合
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb93fe53f5ae5ULL;
+        h ^= h >> 33;
+        return h;
+    }
+};
+
+// 所有列都是定长类型时返回FixedKey需要的word数(2/4/8)，否则返回0走字符串key
+inline size_t fixed_key_words(const std::vector<pb::PrimitiveType>& types) {
+    if (types.empty()) {
+        return 0;
+    }
+    for (auto type : types) {
+        if (column_storage(type) == CS_STRING) {
+            return 0;
+        }
+    }
+    size_t words = types.size() + 1;
+    if (words <= 2) {
+        return 2;
+    } else if (words <= 4) {
+        return 4;
+    } else if (words <= 8) {
+        return 8;
+    }
+    return 0;
+}
+
+inline bool is_unsigned_int_type(pb::PrimitiveType type) {
+    return type == pb::UINT8 || type == pb::UINT16 || type == pb::UINT32 || type == pb::UINT64;
+}
+
+// join两侧列类型不同时，定长编码相等需要与转成字符串后相等一致
+inline bool fixed_key_type_compatible(pb::PrimitiveType left, pb::PrimitiveType right) {
+    ColumnStorage storage = column_storage(left);
+    if (storage == CS_STRING || storage != column_storage(right)) {
+        return false;
+    }
+    if (left == right) {
+        return true;
+    }
+    if (storage == CS_INT) {
+        return left != pb::TIME && right != pb::TIME;
+    }
+    if (storage == CS_UINT) {
+        return is_unsigned_int_type(left) && is_unsigned_int_type(right);
+    }
+    return false;
+}
+
+// 线性探测的开放寻址hash表，只支持插入和查找
+// 容量为2的幂，负载超过1/2时扩容
+template <size_t N, typename Value>
+class FixedKeyHashMap {
+public:
+    typedef FixedKey<N> Key;
+
+    Value* seek(const Key& key) {
+        if (_slots.empty()) {
+            return nullptr;
+        }
+        size_t pos = key.hash() & _mask;
+        while (_slots[pos].used) {
+            if (_slots[pos].key == key) {
+                return &_slots[pos].value;
+            }
+            pos = (pos + 1) & _mask;
+        }
+        return nullptr;
+    }
+    // key不存在时插入Value()，返回的引用在下次插入前有效
+    Value& operator[](const Key& key) {
+        if ((_size + 1) * 2 > _slots.size()) {
+            rehash(std::max(_slots.size() * 2, (size_t)16));
+        }
+        size_t pos = key.hash() & _mask;
+        while (_slots[pos].used) {
+            if (_slots[pos].key == key) {
+                return _slots[pos].value;
+            }
+            pos = (pos + 1) & _mask;
+        }
+        Slot& slot = _slots[pos];
+        slot.used = true;
+        slot.key = key;
+        ++_size;
+        return slot.value;
+    }
+    size_t size() const {
+        return _size;
+    }
+    void clear() {
+        _slots.clear();
+        _mask = 0;
+        _size = 0;
+    }
+
+private:
+    struct Slot {
+        Key key;
+        Value value = Value();
+        bool used = false;
+    };
+    void rehash(size_t capacity) {
+        std::vector<Slot> old_slots(capacity);
+        old_slots.swap(_slots);
+        _mask = capacity - 1;
+        for (auto& old_slot : old_slots) {
+            if (!old_slot.used) {
+                continue;
+            }
+            size_t pos = old_slot.key.hash() & _mask;
+            while (_slots[pos].used) {
+                pos = (pos + 1) & _mask;
+            }
+            _slots[pos].used = true;
+            _slots[pos].key = old_slot.key;
+            _slots[pos].value = std::move(old_slot.value);
+        }
+    }
+
+private:
+    std::vector<Slot> _slots;
+    size_t _mask = 0;
+    size_t _size = 0;
+};
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <atomic>
 #include "mem_row_descriptor.h"
 #include "data_buffer.h"
 #include "proto/store.interface.pb.h"
@@ -32,6 +33,7 @@ using google::protobuf::RepeatedPtrField;
 
 namespace baikaldb {
 DECLARE_int32(per_txn_max_num_locks);
+DECLARE_int64(query_memory_limit);
 struct TxnLimitMap {
     static TxnLimitMap* get_instance() {
         static TxnLimitMap _instance;
@@ -84,6 +86,11 @@ public:
     // baikaldb init
     int init(QueryContext* ctx, DataBuffer* send_buf);
 
+    // baikaldb后台bthread(如join预取内表)使用的子state，共享连接和tuple描述
+    // 子state写入的错误信息和扫描行数在bthread结束后由merge_sub_state合并
+    int init(RuntimeState* parent);
+    void merge_sub_state(RuntimeState* sub);
+
     // for prepared txn recovery in BaikalDB
     //int init(const pb::CachePlan& commit_plan);
 
@@ -188,21 +195,25 @@ public:
         return _num_returned_rows;
     }
     void set_num_scan_rows(int num) {
-        _num_scan_rows = num;
+        _num_scan_rows.store(num, std::memory_order_relaxed);
+    }
+    // 子state的扫描行数在merge_sub_state中累加到父state
+    void inc_num_scan_rows(int num) {
+        _num_scan_rows.fetch_add(num, std::memory_order_relaxed);
     }
     int num_scan_rows() {
-        return _num_scan_rows;
+        return _num_scan_rows.load(std::memory_order_relaxed);
     }
 
     void set_num_filter_rows(int num) {
-        _num_filter_rows = num;
+        _num_filter_rows.store(num, std::memory_order_relaxed);
     }
-    void inc_num_filter_rows() {
-        _num_filter_rows++;
+    void inc_num_filter_rows(int num = 1) {
+        _num_filter_rows.fetch_add(num, std::memory_order_relaxed);
     }
 
     int num_filter_rows() {
-        return _num_filter_rows;
+        return _num_filter_rows.load(std::memory_order_relaxed);
     }
 
     void set_log_id(uint64_t logid) {
@@ -221,6 +232,26 @@ public:
         return _log_id;
     }
 
+    // sort/agg/join等算子共享的单sql内存预算，超过预算的算子需要落盘
+    // 返回false表示预算不足，此时不计入
+    bool try_consume_memory(int64_t bytes) {
+        if (FLAGS_query_memory_limit > 0 && 
+                _used_memory.load() + bytes > FLAGS_query_memory_limit) {
+            return false;
+        }
+        _used_memory += bytes;
+        return true;
+    }
+    void consume_memory(int64_t bytes) {
+        _used_memory += bytes;
+    }
+    void release_memory(int64_t bytes) {
+        _used_memory -= bytes;
+    }
+    int64_t used_memory() {
+        return _used_memory.load();
+    }
+
     size_t multiple_row_batch_capacity() {
         if (_row_batch_capacity * _multiple < ROW_BATCH_CAPACITY) {
             //两倍扩散
@@ -308,6 +339,7 @@ public:
     MysqlErrCode      error_code = ER_ERROR_FIRST;
     std::ostringstream error_msg;
     bool              is_full_export = false;
+    ScanClass         scan_class = SCAN_OLTP;
     bool              is_separate = false; //是否为计算存储分离模式
     bool              use_ttl = false;
     BthreadCond       txn_cond;
@@ -335,9 +367,10 @@ private:
     int _num_increase_rows = 0; //存储净新增行数
     int _num_affected_rows = 0; //存储baikaldb写影响的行数
     int _num_returned_rows = 0; //存储baikaldb读返回的行数
-    int _num_scan_rows     = 0; //存储baikalStore扫描行数
-    int _num_filter_rows   = 0; //存储过滤行数
+    std::atomic<int> _num_scan_rows{0};   //存储baikalStore扫描行数
+    std::atomic<int> _num_filter_rows{0}; //存储过滤行数
     int64_t _log_id = 0;
+    std::atomic<int64_t> _used_memory{0};
 
     bool              _single_sql_autocommit = true;     // used for baikaldb and store
     bool              _optimize_1pc = false;  // 2pc de-generates to 1pc when autocommit=true and
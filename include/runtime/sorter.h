@@ -16,36 +16,64 @@
 
 #include <algorithm> 
 #include <vector>
+#include <map>
 #include "common.h"
 #include "row_batch.h"
 #include "mem_row_compare.h"
+#include "spill_file.h"
 
 namespace baikaldb {
+class RuntimeState;
+
 //对每个batch并行的做sort后，再用heap做归并
+//enable_spill后超过内存预算的数据排序后写成run，最后和内存中的数据一起k路归并
 class Sorter {
 public:
     Sorter(MemRowCompare* comp) : _comp(comp), _idx(0) {
     }
-    void add_batch(std::shared_ptr<RowBatch>& batch) {
-        batch->reset();
-        _min_heap.push_back(batch);
+    ~Sorter();
+    void enable_spill(RuntimeState* state, MemRowDescriptor* mem_row_desc) {
+        _state = state;
+        _mem_row_desc = mem_row_desc;
     }
-    void sort();
+    int add_batch(std::shared_ptr<RowBatch>& batch);
+    int sort();
     void merge_sort();
     int get_next(RowBatch* batch, bool* eos);
 
     size_t batch_size() {
         return _min_heap.size();
     }
+    int64_t spill_bytes() const {
+        return _spill_bytes;
+    }
+    size_t spill_runs() const {
+        return _runs.size();
+    }
+    int64_t merge_time() const {
+        return _merge_time;
+    }
 private:
     void multi_sort();
     void make_heap();
     void shiftdown(size_t index);
+    int merge_next(RowBatch* batch, bool* eos);
+    int64_t estimate_bytes(RowBatch* batch);
+    int spill();
 
 private:
     MemRowCompare* _comp;
     std::vector<std::shared_ptr<RowBatch>> _min_heap;
     size_t _idx;
+    // 落盘使用
+    RuntimeState* _state = nullptr;
+    MemRowDescriptor* _mem_row_desc = nullptr;
+    int64_t _mem_bytes = 0;
+    std::vector<std::shared_ptr<SpillFile>> _runs;
+    // 归并时run对应的读缓冲batch
+    std::map<RowBatch*, std::shared_ptr<SpillFile>> _run_readers;
+    int64_t _spill_bytes = 0;
+    int64_t _merge_time = 0;
 };
 }
 
@@ -0,0 +1,57 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <string>
+#include <fstream>
+#include "common.h"
+#include "row_batch.h"
+#include "mem_row_descriptor.h"
+
+namespace baikaldb {
+DECLARE_string(spill_dir);
+
+// sort/agg落盘的行文件，每行按tuple顺序写 [uint32 len][tuple序列化]，len为0表示空tuple
+class SpillFile {
+public:
+    SpillFile(const std::string& path, MemRowDescriptor* mem_row_desc) : 
+            _path(path), _mem_row_desc(mem_row_desc) {
+    }
+    ~SpillFile();
+    int open_write();
+    int append(MemRow* row);
+    int finish_write();
+    int open_read();
+    // 最多读batch->capacity()行，读完后batch为空
+    int read(RowBatch* batch);
+    // 在spill_dir下生成唯一文件名，目录不存在时创建，失败返回空串
+    static std::string make_path(const std::string& prefix, uint64_t log_id);
+    // 进程启动时删除spill_dir下上次异常退出残留的落盘文件
+    static void clean_spill_dir();
+    int64_t bytes() const {
+        return _bytes;
+    }
+
+private:
+    std::string _path;
+    MemRowDescriptor* _mem_row_desc;
+    std::ofstream _out;
+    std::ifstream _in;
+    std::string _buf;
+    int64_t _bytes = 0;
+};
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -0,0 +1,50 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <vector>
+#include "common.h"
+#include "row_batch.h"
+#include "mem_row_compare.h"
+
+namespace baikaldb {
+// ORDER BY ... LIMIT使用，只保留前limit行
+// _heap按comp构成大顶堆，堆顶为当前保留的最大行，新行比堆顶小时替换堆顶
+class TopNSorter {
+public:
+    TopNSorter(MemRowCompare* comp, int64_t limit) : _comp(comp), _limit(limit) {
+    }
+    // batch中的行会被move走
+    void add_batch(RowBatch* batch);
+    void sort();
+    int get_next(RowBatch* batch, bool* eos);
+
+    size_t size() const {
+        return _heap.size();
+    }
+    int64_t discard_rows() const {
+        return _discard_rows;
+    }
+
+private:
+    MemRowCompare* _comp;
+    int64_t _limit;
+    std::vector<std::unique_ptr<MemRow>> _heap;
+    size_t _idx = 0;
+    int64_t _discard_rows = 0;
+};
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
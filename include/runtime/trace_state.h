@@ -128,6 +128,24 @@ public:
         }
     }
 
+    void set_spill_bytes(int64_t bytes) {
+        if (_trace_node != nullptr) {
+            _local_node->set_spill_bytes(bytes);
+        }
+    }
+
+    void set_spill_runs(int64_t runs) {
+        if (_trace_node != nullptr) {
+            _local_node->set_spill_runs(runs);
+        }
+    }
+
+    void set_merge_time(int64_t time_cost) {
+        if (_trace_node != nullptr) {
+            _local_node->set_merge_time(time_cost);
+        }
+    }
+
     static int64_t get_scan_rows(pb::TraceNode* trace_node) {
         int64_t rows = 0;
         if (trace_node == nullptr) {
@@ -36,6 +36,7 @@ public:
     static const std::string DOING_SNAPSHOT_IDENTIFY; 
     static const std::string REGION_DDL_INFO_IDENTIFY;
     static const std::string ROLLBACKED_TXN_IDENTIFY;
+    static const std::string DATA_CF_IDENTIFY;
 
     virtual ~MetaWriter() {}
    
@@ -54,7 +55,8 @@ public:
     int update_apply_index(int64_t region_id, int64_t applied_index);
     int write_pre_commit(int64_t region_id, uint64_t txn_id, int64_t num_table_lines, int64_t applied_index);
     int write_doing_snapshot(int64_t region_id);
-    int write_batch(rocksdb::WriteBatch* updates, int64_t region_id);
+    int update_data_cf(int64_t region_id, const std::string& cf_name);
+    int write_batch(rocksdb::WriteBatch* updates, int64_t region_id, bool skip_lock = false);
     int write_meta_after_commit(int64_t region_id, int64_t num_table_lines,
                                 int64_t applied_index, uint64_t txn_id, bool need_write_rollback);
     int write_meta_begin_index(int64_t region_id, int64_t log_index, uint64_t txn_id);
@@ -79,6 +81,8 @@ public:
     int read_region_info(int64_t region_id, pb::RegionInfo& region_info);
     int read_pre_commit_key(int64_t region_id, uint64_t txn_id, int64_t& num_table_lines, int64_t& applied_index);
     int read_doing_snapshot(int64_t region_id);
+    // 没有记录时返回1
+    int read_data_cf(int64_t region_id, std::string& cf_name);
     int read_transcation_rollbacked_tag(int64_t region_id, uint64_t txn_id) ;
 public:
     std::string region_info_key(int64_t region_id) const;
@@ -92,6 +96,7 @@ public:
     std::string pre_commit_key_prefix(int64_t region_id) const;
     std::string pre_commit_key(int64_t region_id, uint64_t txn_id) const;
     std::string doing_snapshot_key(int64_t region_id) const;
+    std::string data_cf_key(int64_t region_id) const;
     std::string encode_applied_index(int64_t index) const;
     std::string encode_num_table_lines(int64_t line) const;
     std::string encode_region_info(const pb::RegionInfo& region_info) const;
@@ -55,6 +55,7 @@
 #include "ddl_common.h"
 #include "exec_node.h"
 #include "backup.h"
+#include "log_entry_reader.h"
 
 using google::protobuf::Message;
 using google::protobuf::RepeatedPtrField;
@@ -68,6 +69,51 @@ struct StatisticsInfo {
     int64_t time_cost_sum;
     int64_t end_time_us;
 };
+// 分页select未读完时保留执行树和事务，下一页请求继续get_next
+struct SelectCursor {
+    SmartState state;
+    ExecNode* root = nullptr;
+    SmartTransaction txn;
+    // 发起查询的baikaldb连接，按这个连接是否还在读分页判断游标是否过期
+    uint64_t db_conn_id = 0;
+    TimeCost active_time;
+    int64_t scan_rows = 0;
+    int64_t filter_rows = 0;
+    ~SelectCursor() {
+        if (root != nullptr) {
+            root->close(state.get());
+            ExecNode::destroy_tree(root);
+        }
+        if (txn != nullptr) {
+            txn->rollback();
+        }
+    }
+};
+typedef std::shared_ptr<SelectCursor> SmartCursor;
+// 记录每个baikaldb连接最近一次在本store读分页的时间，所有region共用
+// 查询还在读其他region时，它在窗口内预先打开的游标不算空闲
+class SelectCursorConsumers {
+public:
+    static SelectCursorConsumers* get_instance() {
+        static SelectCursorConsumers instance;
+        return &instance;
+    }
+    void touch(uint64_t db_conn_id);
+    // 连接超过timeout_us没有读分页时返回true
+    bool is_idle(uint64_t db_conn_id, int64_t timeout_us);
+private:
+    SelectCursorConsumers() {}
+    std::mutex _mutex;
+    std::unordered_map<uint64_t, TimeCost> _active_time;
+    TimeCost _last_sweep;
+};
+// on_apply中攒批的1pc dml，同一批共用一个rocksdb事务提交
+struct Apply1pcEntry {
+    pb::StoreReq request;
+    braft::Closure* done = nullptr;
+    int64_t index = 0;
+    int64_t term = 0;
+};
 class region;
 class ScopeProcStatus {
 public:
@@ -196,13 +242,20 @@ public:
             pb::StoreRes& response,
             int64_t applied_index,
             int64_t term);
+    // 连续的非事务dml合并成一个WriteBatch提交，applied_index只写一次
+    bool can_batch_1pc(const pb::StoreReq& request);
+    void dml_1pc_batch(std::vector<Apply1pcEntry>& entries);
 
     void select(const pb::StoreReq& request, pb::StoreRes& response);
     void select(const pb::StoreReq& request, 
             const pb::Plan& plan,
             const RepeatedPtrField<pb::TupleDescriptor>& tuples,
             pb::StoreRes& response);
-    int select_normal(RuntimeState& state, ExecNode* root, pb::StoreRes& response);
+    // page_rows > 0时读满一页即返回，page_eos表示是否已读完
+    int select_normal(RuntimeState& state, ExecNode* root, pb::StoreRes& response,
+            int64_t page_rows = 0, bool* page_eos = nullptr, bool columnar_rows = false);
+    void select_cursor(const pb::StoreReq& request, pb::StoreRes& response);
+    void clear_expired_cursors();
     int select_sample(RuntimeState& state, ExecNode* root, const pb::AnalyzeInfo& analyze_info, pb::StoreRes& response); 
     virtual void on_apply(braft::Iterator& iter);
    
@@ -304,6 +357,11 @@ public:
     
     //split第二步，发送迭代器数据
     void write_local_rocksdb_for_split();
+    // 把分裂出去的范围的DeleteRange加到batch中，和version一起原子写入
+    // 返回加入的DeleteRange个数
+    int remove_split_range(const std::string& start_key, const std::string& end_key,
+            rocksdb::WriteBatch* batch);
+    void get_split_sub_ranges(const std::string& start_key, int n, std::vector<std::string>* bounds);
 
     int replay_txn_for_recovery(
             const std::unordered_map<uint64_t, pb::TransactionInfo>& prepared_txn);
@@ -326,8 +384,12 @@ public:
             const int64_t expected_term,
             std::vector<pb::StoreReq>& requests, 
             int64_t& split_end_index);
+    // 把一条raft日志转成发给新region的请求，-1: 不能分裂 0: 非数据日志跳过 1: 成功
+    static int parse_split_log_entry(const RaftLogEntry& entry, int64_t expected_term,
+            int64_t new_region_id, pb::StoreReq* store_req);
     
     int get_split_key(std::string& split_key);
+    int get_split_key_by_sst_meta(std::string& split_key);
     
     int64_t get_region_id() const {
         return _region_id;
@@ -565,6 +627,7 @@ public:
         }
         _multi_thread_cond.increase();
         _txn_pool.clear_transactions(this);
+        clear_expired_cursors();
         _multi_thread_cond.decrease_signal();
     }
     void recovery_when_leader_start(std::map<uint64_t, SmartTransaction> replay_txns);
@@ -794,6 +857,9 @@ private:
     TimeCost                            _removed_time_cost;
     TransactionPool                     _txn_pool;
     RuntimeStatePool                    _state_pool;
+    std::mutex                          _cursor_mutex;
+    std::map<int64_t, SmartCursor>      _select_cursors;
+    std::atomic<int64_t>                _cursor_id_gen{0};
 
     // shared_ptr is not thread safe when assign
     std::mutex  _ptr_mutex;
@@ -16,6 +16,7 @@
 
 #include <atomic>
 #include "common.h"
+#include "rocks_wrapper.h"
 #include "proto/store.interface.pb.h"
 
 namespace baikaldb {
@@ -30,7 +31,8 @@ public:
     static int remove_meta(int64_t drop_region_id);
     static int remove_snapshot_path(int64_t drop_region_id);
     static int clear_all_infos_for_region(int64_t drop_region_id);
-    static int ingest_data_sst(const std::string& data_sst_file, int64_t region_id);
+    static int ingest_data_sst(const std::string& data_sst_file, int64_t region_id,
+            rocksdb::ColumnFamilyHandle* data_cf = nullptr);
     static int ingest_meta_sst(const std::string& meta_sst_file, int64_t region_id);
 
     RegionControl(Region* region, int64_t region_id): _region(region), _region_id(region_id) {}
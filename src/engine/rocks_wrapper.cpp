@@ -16,9 +16,11 @@
 #include "rocksdb/table.h"
 #include "rocksdb/filter_policy.h"
 #include <iostream>
+#include <boost/algorithm/string.hpp>
 #include "common.h"
 #include "mut_table_key.h"
 #include "table_key.h"
+#include "schema_factory.h"
 #include "raft_log_compaction_filter.h"
 #include "split_compaction_filter.h"
 namespace baikaldb {
@@ -42,6 +44,16 @@ DEFINE_int32(max_background_jobs, 24, "max_background_jobs");
 DEFINE_int32(max_write_buffer_number, 6, "max_write_buffer_number");
 DEFINE_int32(write_buffer_size, 128 * 1024 * 1024, "write_buffer_size");
 DEFINE_int32(min_write_buffer_number_to_merge, 2, "min_write_buffer_number_to_merge");
+DEFINE_bool(ttl_compaction_filter, false, "also drop expired ttl rows in data cf compaction");
+DEFINE_int64(ttl_periodic_compaction_s, 24 * 3600, "with ttl_compaction_filter, data sst files "
+        "older than this(s) are recompacted so that expired ttl rows are dropped");
+DEFINE_int32(rocks_data_prefix_len, 24, "prefix bloom length of data column families: "
+        "regionid(8) + indexid(8) + leading index columns, min 16");
+DEFINE_string(rocks_data_cf_conf, "", "isolated data column families, "
+        "format: name:key=value,key=value;name2:...  keys: block_cache_mb(0 share global cache) "
+        "block_size bloom_bits compression(none/snappy/lz4/zstd) compaction(level/universal) "
+        "table_ids(id1|id2) resource_tags(tag1|tag2). "
+        "routing of an existing table must not change without migrating its regions");
 
 const std::string RocksWrapper::RAFT_LOG_CF = "raft_log";
 const std::string RocksWrapper::DATA_CF = "data";
@@ -107,10 +119,12 @@ int32_t RocksWrapper::init(const std::string& path) {
     _log_cf_option.write_buffer_size = FLAGS_write_buffer_size;
     _log_cf_option.min_write_buffer_number_to_merge = FLAGS_min_write_buffer_number_to_merge;
 
-    //todo
-    // prefix length: regionid(8 Bytes) tableid(8 Bytes)
+    // prefix length: regionid(8 Bytes) indexid(8 Bytes) + 索引前几列
+    // 二级索引等值查询时prefix bloom可以过滤sst，长度变更后旧sst的prefix bloom不再使用
+    // 遍历整个index时不能依赖prefix_same_as_start，需要total_order_seek加上界
+    _data_prefix_len = std::max(FLAGS_rocks_data_prefix_len, (int32_t)(sizeof(int64_t) * 2));
     _data_cf_option.prefix_extractor.reset(
-            rocksdb::NewFixedPrefixTransform(sizeof(int64_t) * 2));
+            rocksdb::NewFixedPrefixTransform(_data_prefix_len));
     _data_cf_option.OptimizeLevelStyleCompaction();
     _data_cf_option.compaction_pri = rocksdb::kByCompensatedSize;
     _data_cf_option.compaction_filter = SplitCompactionFilter::get_instance();
@@ -126,6 +140,14 @@ int32_t RocksWrapper::init(const std::string& path) {
     _data_cf_option.max_write_buffer_number = FLAGS_max_write_buffer_number;
     _data_cf_option.write_buffer_size = FLAGS_write_buffer_size;
     _data_cf_option.min_write_buffer_number_to_merge = FLAGS_min_write_buffer_number_to_merge;
+    if (FLAGS_ttl_compaction_filter) {
+        // 过期数据只靠compaction回收，冷数据所在的sst也要定期compaction
+        _data_cf_option.periodic_compaction_seconds = FLAGS_ttl_periodic_compaction_s;
+    }
+
+    if (parse_data_cf_conf(table_options) != 0) {
+        return -1;
+    }
 
     //todo
     //prefix: 0x01-0xFF,分别用来存储不同的meta信息
@@ -150,6 +172,13 @@ int32_t RocksWrapper::init(const std::string& path) {
                 column_family_desc.push_back(rocksdb::ColumnFamilyDescriptor(DATA_CF, _data_cf_option));
             } else if (column_family_name == METAINFO_CF) {
                 column_family_desc.push_back(rocksdb::ColumnFamilyDescriptor(METAINFO_CF, _meta_info_option));
+            } else if (_isolated_cf_options.count(column_family_name) == 1) {
+                column_family_desc.push_back(rocksdb::ColumnFamilyDescriptor(column_family_name,
+                            _isolated_cf_options[column_family_name]));
+            } else if (is_data_cf(column_family_name)) {
+                // 已经不在配置中的独立数据cf，按data cf打开，保证数据能被删除
+                column_family_desc.push_back(rocksdb::ColumnFamilyDescriptor(column_family_name,
+                            _data_cf_option));
             } else {
                 column_family_desc.push_back(
                         rocksdb::ColumnFamilyDescriptor(column_family_name, 
@@ -220,10 +249,123 @@ int32_t RocksWrapper::init(const std::string& path) {
             return -1;
         }
     }
+    for (auto& pair : _isolated_cf_options) {
+        if (_column_families.count(pair.first) == 1) {
+            continue;
+        }
+        rocksdb::ColumnFamilyHandle* handle = nullptr;
+        s = _txn_db->CreateColumnFamily(pair.second, pair.first, &handle);
+        if (s.ok()) {
+            DB_WARNING("create column family success, column family:%s", pair.first.c_str());
+            _column_families[pair.first] = handle;
+        } else {
+            DB_FATAL("create column family fail, column family:%s, err_message:%s",
+                    pair.first.c_str(), s.ToString().c_str());
+            return -1;
+        }
+    }
     _is_init = true;
     DB_WARNING("rocksdb init success");
     return 0;
 }
+// 解析FLAGS_rocks_data_cf_conf, 每个独立cf基于_data_cf_option，可单独配置block cache等
+int RocksWrapper::parse_data_cf_conf(const rocksdb::BlockBasedTableOptions& table_options) {
+    if (FLAGS_rocks_data_cf_conf.empty()) {
+        return 0;
+    }
+    std::vector<std::string> cf_confs;
+    boost::split(cf_confs, FLAGS_rocks_data_cf_conf, boost::is_any_of(";"));
+    for (auto& cf_conf : cf_confs) {
+        boost::trim(cf_conf);
+        if (cf_conf.empty()) {
+            continue;
+        }
+        size_t pos = cf_conf.find(':');
+        std::string name = cf_conf.substr(0, pos);
+        boost::trim(name);
+        if (name.empty()) {
+            DB_FATAL("invalid rocks_data_cf_conf: %s", cf_conf.c_str());
+            return -1;
+        }
+        std::string cf_name = DATA_CF + "_" + name;
+        if (_isolated_cf_options.count(cf_name) == 1) {
+            DB_FATAL("duplicate data column family: %s", cf_name.c_str());
+            return -1;
+        }
+        rocksdb::ColumnFamilyOptions cf_option = _data_cf_option;
+        rocksdb::BlockBasedTableOptions cf_table_options = table_options;
+        int bloom_bits = 10;
+        std::vector<std::string> items;
+        if (pos != std::string::npos) {
+            std::string conf_items = cf_conf.substr(pos + 1);
+            boost::split(items, conf_items, boost::is_any_of(","));
+        }
+        for (auto& item : items) {
+            std::vector<std::string> kv;
+            boost::split(kv, item, boost::is_any_of("="));
+            if (kv.size() != 2) {
+                continue;
+            }
+            boost::trim(kv[0]);
+            boost::trim(kv[1]);
+            const std::string& key = kv[0];
+            const std::string& value = kv[1];
+            if (key == "block_cache_mb") {
+                int64_t cache_mb = strtoll(value.c_str(), NULL, 10);
+                if (cache_mb > 0) {
+                    cf_table_options.block_cache = rocksdb::NewLRUCache(cache_mb * 1024 * 1024, 8);
+                }
+            } else if (key == "block_size") {
+                cf_table_options.block_size = strtoull(value.c_str(), NULL, 10);
+            } else if (key == "bloom_bits") {
+                bloom_bits = strtol(value.c_str(), NULL, 10);
+            } else if (key == "compression") {
+                if (value == "none") {
+                    cf_option.compression = rocksdb::kNoCompression;
+                } else if (value == "snappy") {
+                    cf_option.compression = rocksdb::kSnappyCompression;
+                } else if (value == "lz4") {
+                    cf_option.compression = rocksdb::kLZ4Compression;
+                } else if (value == "zstd") {
+                    cf_option.compression = rocksdb::kZSTD;
+                } else {
+                    DB_FATAL("unknown compression: %s, cf: %s", value.c_str(), cf_name.c_str());
+                    return -1;
+                }
+            } else if (key == "compaction") {
+                if (value == "universal") {
+                    cf_option.compaction_style = rocksdb::kCompactionStyleUniversal;
+                } else {
+                    cf_option.compaction_style = rocksdb::kCompactionStyleLevel;
+                }
+            } else if (key == "table_ids") {
+                std::vector<std::string> ids;
+                boost::split(ids, value, boost::is_any_of("|"));
+                for (auto& id : ids) {
+                    if (!id.empty()) {
+                        _table_data_cf[strtoll(id.c_str(), NULL, 10)] = cf_name;
+                    }
+                }
+            } else if (key == "resource_tags") {
+                std::vector<std::string> tags;
+                boost::split(tags, value, boost::is_any_of("|"));
+                for (auto& tag : tags) {
+                    if (!tag.empty()) {
+                        _resource_tag_data_cf[tag] = cf_name;
+                    }
+                }
+            } else {
+                DB_WARNING("unknown data cf conf key: %s, cf: %s", key.c_str(), cf_name.c_str());
+            }
+        }
+        cf_table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(bloom_bits, true));
+        cf_option.table_factory.reset(rocksdb::NewBlockBasedTableFactory(cf_table_options));
+        _isolated_cf_options[cf_name] = cf_option;
+        DB_WARNING("isolated data column family: %s, conf: %s", cf_name.c_str(), cf_conf.c_str());
+    }
+    return 0;
+}
+
 int32_t RocksWrapper::delete_column_family(std::string cf_name) {
     if (_column_families.count(cf_name) == 0) {
         DB_FATAL("column_family: %s not exist", cf_name.c_str());
@@ -286,6 +428,42 @@ rocksdb::ColumnFamilyHandle* RocksWrapper::get_data_handle() {
     }
     return _column_families[DATA_CF];
 }
+rocksdb::ColumnFamilyHandle* RocksWrapper::get_data_handle(int64_t table_id) {
+    if (_table_data_cf.empty() && _resource_tag_data_cf.empty()) {
+        return get_data_handle();
+    }
+    std::string cf_name = DATA_CF;
+    auto table_iter = _table_data_cf.find(table_id);
+    if (table_iter != _table_data_cf.end()) {
+        cf_name = table_iter->second;
+    } else if (!_resource_tag_data_cf.empty()) {
+        auto table_info = SchemaFactory::get_instance()->get_table_info_ptr(table_id);
+        if (table_info != nullptr) {
+            auto tag_iter = _resource_tag_data_cf.find(table_info->resource_tag);
+            if (tag_iter != _resource_tag_data_cf.end()) {
+                cf_name = tag_iter->second;
+            }
+        }
+    }
+    auto iter = _column_families.find(cf_name);
+    if (iter == _column_families.end()) {
+        return get_data_handle();
+    }
+    return iter->second;
+}
+std::vector<rocksdb::ColumnFamilyHandle*> RocksWrapper::get_data_handles() {
+    std::vector<rocksdb::ColumnFamilyHandle*> handles;
+    if (!_is_init) {
+        DB_FATAL("rocksdb has not been inited");
+        return handles;
+    }
+    for (auto& pair : _column_families) {
+        if (is_data_cf(pair.first)) {
+            handles.push_back(pair.second);
+        }
+    }
+    return handles;
+}
 rocksdb::ColumnFamilyHandle* RocksWrapper::get_meta_info_handle() {
     if (!_is_init) {
         DB_FATAL("rocksdb has not been inited");
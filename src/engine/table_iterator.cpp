@@ -13,10 +13,100 @@
 // limitations under the License.
 
 #include "table_iterator.h"
+#include "rocksdb/perf_context.h"
+#include "rocksdb/perf_level.h"
 #include "transaction.h"
 #include "tuple_record.h"
 
 namespace baikaldb {
+DEFINE_bool(bulk_scan_fill_cache, false, "whether export/analyze/backup scans fill block cache");
+DEFINE_int64(bulk_scan_readahead_size, 2 * 1024 * 1024LL,
+        "readahead size(bytes) of export/analyze/backup scans, 0 means rocksdb default");
+DEFINE_bool(scan_cache_metric, false, "collect block cache hit ratio of export/analyze/backup scans");
+
+namespace {
+// 最近60s的block cache命中率
+struct ScanCacheMetric {
+    explicit ScanCacheMetric(const std::string& name) :
+            hit_window(&hit, 60),
+            miss_window(&miss, 60),
+            hit_ratio(name + "_block_cache_hit_ratio", get_hit_ratio, this) {
+        hit.expose(name + "_block_cache_hit");
+        miss.expose(name + "_block_cache_miss");
+    }
+    static double get_hit_ratio(void* arg) {
+        ScanCacheMetric* metric = static_cast<ScanCacheMetric*>(arg);
+        int64_t hit = metric->hit_window.get_value();
+        int64_t miss = metric->miss_window.get_value();
+        // 没有扫描时为0，不能当作全部命中
+        if (hit + miss == 0) {
+            return 0;
+        }
+        return (double)hit / (hit + miss);
+    }
+    bvar::Adder<int64_t> hit;
+    bvar::Adder<int64_t> miss;
+    bvar::Window<bvar::Adder<int64_t>> hit_window;
+    bvar::Window<bvar::Adder<int64_t>> miss_window;
+    bvar::PassiveStatus<double> hit_ratio;
+};
+
+// OLTP扫描不统计，没有对应的指标
+ScanCacheMetric* get_scan_cache_metric(ScanClass scan_class) {
+    static ScanCacheMetric* metrics[SCAN_CLASS_NUM] = {
+        nullptr,
+        new ScanCacheMetric("scan_export"),
+        new ScanCacheMetric("scan_analyze"),
+        new ScanCacheMetric("scan_backup")
+    };
+    return metrics[scan_class];
+}
+}
+
+void set_scan_read_options(ScanClass scan_class, rocksdb::ReadOptions* read_options) {
+    if (scan_class == SCAN_OLTP) {
+        return;
+    }
+    read_options->fill_cache = FLAGS_bulk_scan_fill_cache;
+    if (FLAGS_bulk_scan_readahead_size > 0) {
+        read_options->readahead_size = FLAGS_bulk_scan_readahead_size;
+    }
+}
+
+ScanCacheStat::ScanCacheStat(ScanClass scan_class) : _scan_class(scan_class) {
+    // OLTP扫描不统计；perf level是pthread局部的，bthread可能切换pthread，
+    // 这里不修改perf level，低于kEnableCount(rocksdb默认值)时不统计
+    if (!FLAGS_scan_cache_metric || scan_class == SCAN_OLTP) {
+        return;
+    }
+    if (rocksdb::GetPerfLevel() < rocksdb::PerfLevel::kEnableCount) {
+        return;
+    }
+    _enabled = true;
+    _tid = pthread_self();
+    rocksdb::PerfContext* perf_context = rocksdb::get_perf_context();
+    _hit_count = perf_context->block_cache_hit_count;
+    _miss_count = perf_context->block_read_count;
+}
+
+ScanCacheStat::~ScanCacheStat() {
+    if (!_enabled || !pthread_equal(_tid, pthread_self())) {
+        return;
+    }
+    rocksdb::PerfContext* perf_context = rocksdb::get_perf_context();
+    uint64_t hit_count = perf_context->block_cache_hit_count;
+    uint64_t miss_count = perf_context->block_read_count;
+    if (hit_count < _hit_count || miss_count < _miss_count) {
+        // perf_context被其他地方reset
+        return;
+    }
+    ScanCacheMetric* metric = get_scan_cache_metric(_scan_class);
+    if (metric == nullptr) {
+        return;
+    }
+    metric->hit << (int64_t)(hit_count - _hit_count);
+    metric->miss << (int64_t)(miss_count - _miss_count);
+}
 
 TableIterator* Iterator::scan_primary(
         SmartTransaction        txn,
@@ -68,6 +158,7 @@ int Iterator::open(const IndexRange& range, std::map<int32_t, FieldInfo*>& field
     _pri_info    = range.pri_info;
     _region_info = range.region_info;
     _region      = range.region_info->region_id();
+    _scan_class  = range.scan_class;
     _fields      = fields;
     _field_slot  = field_slot;
     if (txn != nullptr) {
@@ -87,7 +178,7 @@ int Iterator::open(const IndexRange& range, std::map<int32_t, FieldInfo*>& field
         DB_WARNING("get rocksdb instance failed");
         return -1;
     }
-    if (nullptr == (_data_cf = _db->get_data_handle())) {
+    if (nullptr == (_data_cf = _db->get_data_handle(_index_info->pk))) {
         DB_WARNING("get rocksdb data column family failed");
         return -1;
     }
@@ -258,21 +349,28 @@ int Iterator::open(const IndexRange& range, std::map<int32_t, FieldInfo*>& field
     // 通过rocksdb来过滤边界
     // TODO 自己判断边界是否可以省略
     if (_forward) {
-        read_options.prefix_same_as_start = true;
-        read_options.total_order_seek = false;
+        // 上下界在同一个prefix内(如二级索引前缀等值)时走prefix seek，可以用prefix bloom过滤sst
+        if (_db->is_same_data_prefix(_lower_bound_slice, _upper_bound_slice)) {
+            read_options.prefix_same_as_start = true;
+            read_options.total_order_seek = false;
+        } else {
+            read_options.prefix_same_as_start = false;
+            read_options.total_order_seek = true;
+        }
         read_options.iterate_upper_bound = &_upper_bound_slice;
     } else {
         read_options.prefix_same_as_start = false;
         read_options.total_order_seek = true;
         read_options.iterate_lower_bound = &_lower_bound_slice;
     }
+    set_scan_read_options(_scan_class, &read_options);
 
 
     if (txn != nullptr) {
         read_options.snapshot = txn->get_snapshot();
         _iter = txn->get_txn()->GetIterator(read_options, _data_cf);
     } else {
-        _iter = _db->new_iterator(read_options, RocksWrapper::DATA_CF);
+        _iter = _db->new_iterator(read_options, _data_cf);
     }
     if (!_iter) {
         DB_FATAL("create iterator failed: %ld", index_id);
@@ -312,14 +410,11 @@ int Iterator::open(const IndexRange& range, std::map<int32_t, FieldInfo*>& field
 
 // for cstore only
 int Iterator::open_columns(std::map<int32_t, FieldInfo*>& fields, SmartTransaction txn) {
+    // 列的key比data cf的prefix短时不能用prefix seek，越界由_fits_prefix判断
     rocksdb::ReadOptions read_options;
-    if (_forward) {
-        read_options.prefix_same_as_start = true;
-        read_options.total_order_seek = false;
-    } else {
-        read_options.prefix_same_as_start = false;
-        read_options.total_order_seek = true;
-    }
+    read_options.prefix_same_as_start = false;
+    read_options.total_order_seek = true;
+    set_scan_read_options(_scan_class, &read_options);
     std::set<int32_t>    pri_field_ids;
     for (auto& field_info : _pri_info->fields) {
         pri_field_ids.insert(field_info.id);
@@ -337,7 +432,7 @@ int Iterator::open_columns(std::map<int32_t, FieldInfo*>& fields, SmartTransacti
         if (_txn != nullptr) {
             iter = _txn->GetIterator(read_options, _data_cf);
         } else {
-            iter = _db->new_iterator(read_options, RocksWrapper::DATA_CF);
+            iter = _db->new_iterator(read_options, _data_cf);
         }
         if (!iter) {
             DB_FATAL("create iterator failed: %ld", field_id);
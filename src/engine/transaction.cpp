@@ -15,6 +15,7 @@
 #include "transaction.h"
 #include "transaction_pool.h"
 #include "tuple_record.h"
+#include <algorithm>
 #include <boost/scoped_array.hpp>
 #include <gflags/gflags.h>
 
@@ -23,6 +24,37 @@ DEFINE_bool(disable_wal, false, "disable rocksdb interanal WAL log, only use raf
 // DEFINE_int32(rocks_transaction_expiration_ms, 600 * 1000, 
 //         "rocksdb transaction_expiration timeout(us)");
 
+void Transaction::set_region_info(pb::RegionInfo* region_info) {
+    _region_info = region_info;
+    if (_region_info == nullptr) {
+        DB_WARNING("no region_info");
+        return;
+    }
+    int64_t main_table_id = _region_info->table_id();
+    if (_region_info->has_main_table_id() && _region_info->main_table_id() != 0) {
+        main_table_id = _region_info->main_table_id();
+    }
+    // 优先使用region记录的column family，避免schema变化后路由到别的cf
+    if (_pool != nullptr && _pool->data_cf() != nullptr) {
+        _data_cf = _pool->data_cf();
+    } else {
+        _data_cf = RocksWrapper::get_instance()->get_data_handle(main_table_id);
+    }
+    // _is_global_index
+    if (_region_info->has_main_table_id() && _region_info->main_table_id() != 0 &&
+                _region_info->table_id() != _region_info->main_table_id()) {
+        return;
+    }
+    _table_info = SchemaFactory::get_instance()->get_table_info_ptr(_region_info->table_id());
+    _pri_info = SchemaFactory::get_instance()->get_index_info_ptr(_region_info->table_id());
+    if (is_cstore()) {
+       _pri_field_ids.clear();
+       for (auto& field_info : _pri_info->fields) {
+             _pri_field_ids.insert(field_info.id);
+       }
+   }
+}
+
 int Transaction::begin() {
     rocksdb::TransactionOptions txn_opt;
     return begin(txn_opt);
@@ -33,7 +65,8 @@ int Transaction::begin(rocksdb::TransactionOptions txn_opt) {
         DB_WARNING("get rocksdb instance failed");
         return -1;
     }
-    if (nullptr == (_data_cf = _db->get_data_handle())) {
+    // set_region_info中已经按表路由过data cf
+    if (_data_cf == nullptr && nullptr == (_data_cf = _db->get_data_handle())) {
         DB_WARNING("get rocksdb data column family failed");
         return -1;
     }
@@ -64,7 +97,8 @@ int Transaction::begin(rocksdb::Transaction* txn) {
         DB_WARNING("get rocksdb instance failed");
         return -1;
     }
-    if (nullptr == (_data_cf = _db->get_data_handle())) {
+    // set_region_info中已经按表路由过data cf
+    if (_data_cf == nullptr && nullptr == (_data_cf = _db->get_data_handle())) {
         DB_WARNING("get rocksdb data column family failed");
         return -1;
     }
@@ -592,6 +626,104 @@ int Transaction::get_update_primary(
     return 0;
 }
 
+int Transaction::multi_get_primary(
+        int64_t             region,
+        IndexInfo&          pk_index,
+        std::vector<SmartRecord>& records,
+        std::map<int32_t, FieldInfo*>& fields,
+        bool                check_region,
+        std::vector<int>*   rets) {
+    rets->assign(records.size(), -1);
+    if (pk_index.type != pb::I_PRIMARY) {
+        DB_WARNING("invalid index type: %d", pk_index.type);
+        return -1;
+    }
+    // 列存的非主键列分散在多个key上，逐个get
+    if (is_cstore()) {
+        for (size_t i = 0; i < records.size(); ++i) {
+            (*rets)[i] = get_update_primary(region, pk_index, records[i], fields, GET_ONLY, check_region);
+        }
+        return 0;
+    }
+    BAIDU_SCOPED_LOCK(_txn_mutex);
+    if (_region_info == nullptr) {
+        DB_WARNING("no region_info");
+        return -1;
+    }
+    last_active_time = butil::gettimeofday_us();
+    std::vector<std::string> keys(records.size());
+    std::vector<size_t> pos;
+    pos.reserve(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        MutTableKey pure_key;
+        //full key, no prefix allowed
+        if (0 != pure_key.append_index(pk_index, records[i].get(), -1, false)) {
+            DB_WARNING("Fail to append_index, reg:%ld, tab:%ld", region, pk_index.id);
+            continue;
+        }
+        if (check_region) {
+            rocksdb::Slice value;
+            if (!fits_region_range(pure_key.data(), value,
+                &_region_info->start_key(), &_region_info->end_key(), pk_index, pk_index)) {
+                (*rets)[i] = -3;
+                continue;
+            }
+        }
+        MutTableKey key;
+        key.append_i64(region).append_i64(pk_index.id).append_index(pure_key.data());
+        keys[i] = key.data();
+        pos.push_back(i);
+    }
+    if (pos.empty()) {
+        return 0;
+    }
+    // 排好序的key在rocksdb里可以按sst顺序批量查找
+    std::sort(pos.begin(), pos.end(), [&keys](size_t l, size_t r) {
+        return keys[l] < keys[r];
+    });
+    size_t num_keys = pos.size();
+    boost::scoped_array<rocksdb::Slice> key_slices(new rocksdb::Slice[num_keys]);
+    boost::scoped_array<rocksdb::PinnableSlice> values(new rocksdb::PinnableSlice[num_keys]);
+    boost::scoped_array<rocksdb::Status> statuses(new rocksdb::Status[num_keys]);
+    for (size_t i = 0; i < num_keys; ++i) {
+        key_slices[i] = keys[pos[i]];
+    }
+    rocksdb::ReadOptions read_opt;
+    read_opt.snapshot = _snapshot;
+    _txn->MultiGet(read_opt, _data_cf, num_keys, key_slices.get(), values.get(), statuses.get(), true);
+
+    for (size_t i = 0; i < num_keys; ++i) {
+        int& ret = (*rets)[pos[i]];
+        rocksdb::Status& res = statuses[i];
+        if (res.IsNotFound()) {
+            ret = -2;
+            continue;
+        } else if (!res.ok()) {
+            DB_WARNING("unknown error: %d, %s", res.code(), res.ToString().c_str());
+            ret = -1;
+            continue;
+        }
+        rocksdb::Slice value_slice(values[i]);
+        if (_use_ttl && _read_ttl_timestamp_us > 0) {
+            int64_t row_ttl_timestamp_us = ttl_decode(value_slice);
+            if (_read_ttl_timestamp_us > row_ttl_timestamp_us) {
+                //expired
+                ret = -4;
+                continue;
+            }
+            value_slice.remove_prefix(sizeof(uint64_t));
+        }
+        TupleRecord tuple_record(value_slice);
+        if (0 != tuple_record.decode_fields(fields, records[pos[i]])) {
+            DB_WARNING("decode value failed: %d", pk_index.id);
+            ret = -1;
+            continue;
+        }
+        ret = 0;
+    }
+    return 0;
+}
+
 //TODO: update return status
 int Transaction::get_update_secondary(
         int64_t             region, 
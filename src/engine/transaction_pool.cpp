@@ -35,9 +35,10 @@ DEFINE_int64(clean_finished_txn_interval_us, 600 * 1000 * 1000LL,
 DEFINE_int32(transaction_query_primary_region_interval_ms, 10 * 1000,
         "interval duration send request to primary region");
 
-int TransactionPool::init(int64_t region_id, bool use_ttl) {
+int TransactionPool::init(int64_t region_id, bool use_ttl, rocksdb::ColumnFamilyHandle* data_cf) {
     _region_id = region_id;
     _use_ttl = use_ttl;
+    _data_cf = data_cf;
     _meta_writer = MetaWriter::get_instance();
     return 0;
 }
@@ -16,6 +16,13 @@
 #include "runtime_state.h"
 
 namespace baikaldb {
+DECLARE_bool(use_column_batch);
+DEFINE_int32(agg_spill_partitions, 16, "partition number when agg spill to disk");
+DEFINE_int64(agg_spill_min_bytes, 16 * 1024 * 1024LL, "agg keeps at least this much memory before "
+        "spilling, even if other operators have used up query_memory_limit");
+DEFINE_bool(use_fixed_hash_key, true, "use fixed width key in agg/join hash table "
+        "when all key columns are fixed length");
+
 int AggNode::init(const pb::PlanNode& node) {
     int ret = 0;
     ret = ExecNode::init(node);
@@ -97,7 +104,12 @@ int AggNode::expr_optimize(std::vector<pb::TupleDescriptor>* tuple_descs) {
 }
 
 int AggNode::open(RuntimeState* state) {
-    START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), OPEN_TRACE, nullptr);
+    START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), OPEN_TRACE, ([this](TraceLocalNode& local_node) {
+        if (_spill_times > 0) {
+            local_node.set_spill_bytes(_spill_bytes);
+            local_node.set_spill_runs(_partitions.size());
+        }
+    }));
     int ret = 0;
     ret = ExecNode::open(state);
     if (ret < 0) {
@@ -119,11 +131,33 @@ int AggNode::open(RuntimeState* state) {
         }
     }
     _mem_row_desc = state->mem_row_desc();
+    // distinct agg的merge实际是update，中间状态不能再次merge，不落盘
+    _can_spill = FLAGS_query_memory_limit > 0 && _group_exprs.size() > 0;
+    for (auto agg : _agg_fn_calls) {
+        if (agg->is_distinct()) {
+            _can_spill = false;
+        }
+    }
+    if (FLAGS_use_fixed_hash_key) {
+        std::vector<pb::PrimitiveType> group_types;
+        for (auto expr : _group_exprs) {
+            group_types.push_back(expr->col_type());
+        }
+        _fixed_key_words = fixed_key_words(group_types);
+    }
 
     TimeCost cost;
     int64_t agg_time = 0;
     int64_t scan_time = 0;
     int row_cnt = 0;
+    ColumnBatch column_batch;
+    if (FLAGS_use_column_batch) {
+        ret = column_batch.init(state->tuple_descs());
+        if (ret < 0) {
+            DB_WARNING_STATE(state, "column_batch init fail, ret:%d", ret);
+            return ret;
+        }
+    }
     for (auto child : _children) {
         bool eos = false;
         do {
@@ -132,6 +166,24 @@ int AggNode::open(RuntimeState* state) {
                 return 0;
             }
             TimeCost cost;
+            if (FLAGS_use_column_batch) {
+                column_batch.clear();
+                ret = child->get_next_column(state, &column_batch, &eos);
+                if (ret < 0) {
+                    DB_WARNING_STATE(state, "child->get_next_column fail, ret:%d", ret);
+                    return ret;
+                }
+                scan_time += cost.get_time();
+                cost.reset();
+                ret = process_column_batch(state, column_batch);
+                if (ret < 0) {
+                    DB_WARNING_STATE(state, "process_column_batch fail, ret:%d", ret);
+                    return ret;
+                }
+                agg_time += cost.get_time();
+                row_cnt += column_batch.selected_size();
+                continue;
+            }
             RowBatch batch;
             ret = child->get_next(state, &batch, &eos);
             if (ret < 0) {
@@ -140,7 +192,11 @@ int AggNode::open(RuntimeState* state) {
             }
             scan_time += cost.get_time();
             cost.reset();
-            process_row_batch(batch);
+            ret = process_row_batch(state, batch);
+            if (ret < 0) {
+                DB_WARNING_STATE(state, "process_row_batch fail, ret:%d", ret);
+                return ret;
+            }
             agg_time += cost.get_time();
             row_cnt += batch.size();
             // 对于用order by分组的特殊优化
@@ -149,8 +205,27 @@ int AggNode::open(RuntimeState* state) {
             //}
         } while (!eos);
     }
+    // 落盘过则剩余分组也写入分区，之后逐个分区merge输出
+    if (_spill_times > 0) {
+        ret = spill(state);
+        if (ret < 0) {
+            return ret;
+        }
+        for (auto& partition : _partitions) {
+            ret = partition->finish_write();
+            if (ret < 0) {
+                return ret;
+            }
+            _spill_bytes += partition->bytes();
+        }
+        ret = load_next_partition(state);
+        if (ret < 0) {
+            return ret;
+        }
+    }
     LOCAL_TRACE_DESC << "agg time cost:" << agg_time << 
-        " scan time cost:" << scan_time << " rows:" << row_cnt;
+        " scan time cost:" << scan_time << " rows:" << row_cnt << 
+        " spill_times:" << _spill_times << " spill_bytes:" << _spill_bytes;
     DB_WARNING_STATE(state, "region:%ld, agg time:%ld ,scan time:%ld total:%ld, row_cnt:%d", 
         state->region_id(), agg_time, scan_time, cost.get_time(), row_cnt);
 
@@ -182,34 +257,281 @@ void AggNode::encode_agg_key(MemRow* row, MutTableKey& key) {
     key.replace_u8(null_flag, 0);
 }
 
-void AggNode::process_row_batch(RowBatch& batch) {
+int AggNode::process_row_batch(RuntimeState* state, RowBatch& batch) {
     for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
         std::unique_ptr<MemRow>& row = batch.get_row();
         MutTableKey key;
         MemRow* cur_row = row.get();
-        encode_agg_key(cur_row, key);
-        MemRow** agg_row = _hash_map.seek(key.data());
+        MemRow** agg_row = nullptr;
+        if (_fixed_key_words > 0) {
+            agg_row = seek_fixed_group(cur_row);
+        } else {
+            encode_agg_key(cur_row, key);
+            agg_row = _hash_map.seek(key.data());
+        }
+        bool is_new_group = agg_row == nullptr || *agg_row == nullptr;
         
-        if (agg_row == nullptr) { //不存在则新建
+        if (is_new_group) { //不存在则新建
             cur_row = row.release();
-            agg_row = &cur_row;
             // fix bug: 多个store agg，有无数据会造条空数据(L157)
             // merge多个store时，去除这种造的数据
             // 以便于 select id,count(*) from t where id>1;这种sql时id不会时造出来的null
             if (_is_merger && _group_exprs.size() == 0) {
-                if (AggFnCall::all_is_initialize(_agg_fn_calls, *agg_row)) {
+                if (AggFnCall::all_is_initialize(_agg_fn_calls, cur_row)) {
                     continue;
                 }
             }
-            AggFnCall::initialize_all(_agg_fn_calls, *agg_row);
-            // 可能会rehash
-            _hash_map.insert(key.data(), *agg_row);
+            AggFnCall::initialize_all(_agg_fn_calls, cur_row);
+            if (agg_row != nullptr) {
+                // 定长key已经插入了占位
+                *agg_row = cur_row;
+                _fixed_groups.push_back(cur_row);
+            } else {
+                // 可能会rehash
+                _hash_map.insert(key.data(), cur_row);
+            }
+            agg_row = &cur_row;
         }
         if (_is_merger) {
             AggFnCall::merge_all(_agg_fn_calls, cur_row, *agg_row);
         } else {
             AggFnCall::update_all(_agg_fn_calls, cur_row, *agg_row);
         }
+        if (is_new_group) {
+            int ret = add_group_bytes(state, key, *agg_row);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+int AggNode::process_column_batch(RuntimeState* state, ColumnBatch& batch) {
+    size_t selected = batch.selected_size();
+    for (size_t i = 0; i < selected; i++) {
+        if (_scratch_row == nullptr) {
+            _scratch_row = _mem_row_desc->fetch_mem_row();
+        }
+        MemRow* cur_row = _scratch_row.get();
+        batch.fill_row(batch.selected_idx(i), cur_row);
+        MutTableKey key;
+        MemRow** agg_row = nullptr;
+        if (_fixed_key_words > 0) {
+            agg_row = seek_fixed_group(cur_row);
+        } else {
+            encode_agg_key(cur_row, key);
+            agg_row = _hash_map.seek(key.data());
+        }
+        bool is_new_group = agg_row == nullptr || *agg_row == nullptr;
+        if (is_new_group) {
+            if (_is_merger && _group_exprs.size() == 0) {
+                if (AggFnCall::all_is_initialize(_agg_fn_calls, cur_row)) {
+                    continue;
+                }
+            }
+            cur_row = _scratch_row.release();
+            AggFnCall::initialize_all(_agg_fn_calls, cur_row);
+            if (agg_row != nullptr) {
+                *agg_row = cur_row;
+                _fixed_groups.push_back(cur_row);
+            } else {
+                _hash_map.insert(key.data(), cur_row);
+            }
+            agg_row = &cur_row;
+        }
+        if (_is_merger) {
+            AggFnCall::merge_all(_agg_fn_calls, cur_row, *agg_row);
+        } else {
+            AggFnCall::update_all(_agg_fn_calls, cur_row, *agg_row);
+        }
+        if (is_new_group) {
+            int ret = add_group_bytes(state, key, *agg_row);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+template <size_t N>
+MemRow** AggNode::seek_fixed_group(MemRow* row, FixedKeyHashMap<N, MemRow*>* hash_map) {
+    FixedKey<N> key;
+    key.clear();
+    for (uint32_t i = 0; i < _group_exprs.size(); i++) {
+        key.set_value(i, _group_exprs[i]->get_value(row));
+    }
+    return &(*hash_map)[key];
+}
+
+MemRow** AggNode::seek_fixed_group(MemRow* row) {
+    switch (_fixed_key_words) {
+        case 2:
+            return seek_fixed_group(row, &_fixed_map2);
+        case 4:
+            return seek_fixed_group(row, &_fixed_map4);
+        default:
+            return seek_fixed_group(row, &_fixed_map8);
+    }
+}
+
+bool AggNode::has_next_group() {
+    if (_fixed_key_words > 0) {
+        return _fixed_idx < _fixed_groups.size();
+    }
+    return _iter != _hash_map.end();
+}
+
+MemRow* AggNode::pop_next_group() {
+    MemRow* row = nullptr;
+    if (_fixed_key_words > 0) {
+        row = _fixed_groups[_fixed_idx];
+        _fixed_groups[_fixed_idx++] = nullptr;
+        return row;
+    }
+    row = _iter->second;
+    _iter->second = nullptr;
+    _iter++;
+    return row;
+}
+
+int64_t AggNode::group_bytes(int64_t key_size, MemRow* row) {
+    static const int64_t GROUP_OVERHEAD = 64;
+    int64_t bytes = key_size + GROUP_OVERHEAD;
+    for (int32_t tuple_id = 0; tuple_id < _mem_row_desc->tuple_size(); tuple_id++) {
+        auto tuple = row->get_tuple(tuple_id);
+        if (tuple != nullptr) {
+            bytes += tuple->ByteSize();
+        }
+    }
+    return bytes;
+}
+
+int AggNode::add_group_bytes(RuntimeState* state, MutTableKey& key, MemRow* row) {
+    if (!_can_spill) {
+        return 0;
+    }
+    int64_t key_size = _fixed_key_words > 0 ? 
+        _fixed_key_words * sizeof(uint64_t) : key.data().size();
+    int64_t bytes = group_bytes(key_size, row);
+    if (state->try_consume_memory(bytes)) {
+        _mem_bytes += bytes;
+        return 0;
+    }
+    // 预算被其他算子占满时仍保留最小内存，避免每来一个分组就落盘一次
+    if (_mem_bytes + bytes <= FLAGS_agg_spill_min_bytes) {
+        state->consume_memory(bytes);
+        _mem_bytes += bytes;
+        return 0;
+    }
+    return spill(state);
+}
+
+// 按key的hash把所有分组的中间状态写到对应分区，多次落盘追加到同一组分区文件
+int AggNode::spill(RuntimeState* state) {
+    TimeCost cost;
+    int ret = 0;
+    if (_partitions.empty()) {
+        int partition_num = std::max(FLAGS_agg_spill_partitions, 1);
+        for (int i = 0; i < partition_num; i++) {
+            std::string path = SpillFile::make_path("agg", state->log_id());
+            if (path.empty()) {
+                return -1;
+            }
+            std::shared_ptr<SpillFile> partition = std::make_shared<SpillFile>(path, _mem_row_desc);
+            ret = partition->open_write();
+            if (ret < 0) {
+                return ret;
+            }
+            _partitions.push_back(partition);
+        }
+    }
+    std::hash<std::string> hasher;
+    size_t groups = _hash_map.size() + _fixed_groups.size();
+    // 定长key的分组重新编码字符串key分区，回读时统一走_hash_map
+    for (auto row : _fixed_groups) {
+        MutTableKey key;
+        encode_agg_key(row, key);
+        ret = _partitions[hasher(key.data()) % _partitions.size()]->append(row);
+        if (ret < 0) {
+            return ret;
+        }
+        delete row;
+    }
+    _fixed_groups.clear();
+    _fixed_map2.clear();
+    _fixed_map4.clear();
+    _fixed_map8.clear();
+    for (auto iter = _hash_map.begin(); iter != _hash_map.end(); iter++) {
+        if (iter->second == nullptr) {
+            continue;
+        }
+        ret = _partitions[hasher(iter->first) % _partitions.size()]->append(iter->second);
+        if (ret < 0) {
+            return ret;
+        }
+        delete iter->second;
+        iter->second = nullptr;
+    }
+    _hash_map.clear();
+    _iter = _hash_map.end();
+    state->release_memory(_mem_bytes);
+    _mem_bytes = 0;
+    _spill_times++;
+    DB_WARNING_STATE(state, "agg spill groups:%lu times:%d cost:%ld", 
+            groups, _spill_times, cost.get_time());
+    return 0;
+}
+
+int AggNode::load_next_partition(RuntimeState* state) {
+    _fixed_key_words = 0;
+    _hash_map.clear();
+    // 上一个分区的分组已经全部返回
+    state->release_memory(_mem_bytes);
+    _mem_bytes = 0;
+    while (_partition_idx < _partitions.size()) {
+        std::shared_ptr<SpillFile> partition = _partitions[_partition_idx];
+        // 读完即删除文件
+        _partitions[_partition_idx++] = nullptr;
+        int ret = partition->open_read();
+        if (ret < 0) {
+            return ret;
+        }
+        while (true) {
+            RowBatch batch;
+            ret = partition->read(&batch);
+            if (ret < 0) {
+                return ret;
+            }
+            if (batch.size() == 0) {
+                break;
+            }
+            merge_spill_batch(state, batch);
+        }
+        if (_hash_map.size() > 0) {
+            break;
+        }
+    }
+    _iter = _hash_map.begin();
+    return 0;
+}
+
+// 落盘的都是中间状态，同一分组只需merge；回读的分区不能再落盘，只计入内存
+void AggNode::merge_spill_batch(RuntimeState* state, RowBatch& batch) {
+    for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+        std::unique_ptr<MemRow>& row = batch.get_row();
+        MutTableKey key;
+        encode_agg_key(row.get(), key);
+        MemRow** agg_row = _hash_map.seek(key.data());
+        if (agg_row == nullptr) {
+            int64_t bytes = group_bytes(key.data().size(), row.get());
+            state->consume_memory(bytes);
+            _mem_bytes += bytes;
+            _hash_map.insert(key.data(), row.release());
+            continue;
+        }
+        AggFnCall::merge_all(_agg_fn_calls, row.get(), *agg_row);
     }
 }
 
@@ -224,18 +546,55 @@ int AggNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
             *eos = true;
             return 0;
         }
-        if (reached_limit() || _iter == _hash_map.end()) {
+        if (!has_next_group() && _partition_idx < _partitions.size()) {
+            int ret = load_next_partition(state);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+        if (reached_limit() || !has_next_group()) {
             *eos = true;
             return 0;
         }
         if (batch->is_full()) {
             return 0;
         }
-        AggFnCall::finalize_all(_agg_fn_calls, _iter->second);
-        batch->move_row(std::move(std::unique_ptr<MemRow>(_iter->second)));
+        MemRow* row = pop_next_group();
+        AggFnCall::finalize_all(_agg_fn_calls, row);
+        batch->move_row(std::move(std::unique_ptr<MemRow>(row)));
         _num_rows_returned++;
-        _iter->second = nullptr;
-        _iter++;
+    }
+}
+
+int AggNode::get_next_column(RuntimeState* state, ColumnBatch* batch, bool* eos) {
+    START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), GET_NEXT_TRACE, ([this](TraceLocalNode& local_node) {
+        local_node.set_affect_rows(_num_rows_returned);
+    }));
+
+    while (1) {
+        if (state->is_cancelled()) {
+            DB_WARNING_STATE(state, "cancelled");
+            *eos = true;
+            return 0;
+        }
+        if (!has_next_group() && _partition_idx < _partitions.size()) {
+            int ret = load_next_partition(state);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+        if (reached_limit() || !has_next_group()) {
+            *eos = true;
+            return 0;
+        }
+        if (batch->is_full()) {
+            return 0;
+        }
+        MemRow* row = pop_next_group();
+        AggFnCall::finalize_all(_agg_fn_calls, row);
+        batch->append_row(row);
+        _num_rows_returned++;
+        delete row;
     }
 }
 
@@ -250,6 +609,19 @@ void AggNode::close(RuntimeState* state) {
     for (; _iter != _hash_map.end(); _iter++) {
         delete _iter->second;
     }
+    for (; _fixed_idx < _fixed_groups.size(); _fixed_idx++) {
+        delete _fixed_groups[_fixed_idx];
+    }
+    _fixed_groups.clear();
+    _fixed_idx = 0;
+    _fixed_map2.clear();
+    _fixed_map4.clear();
+    _fixed_map8.clear();
+    _scratch_row.reset();
+    state->release_memory(_mem_bytes);
+    _mem_bytes = 0;
+    _partitions.clear();
+    _partition_idx = 0;
 }
 void AggNode::transfer_pb(int64_t region_id, pb::PlanNode* pb_node) {
     ExecNode::transfer_pb(region_id, pb_node);
@@ -167,6 +167,16 @@ int ExecNode::open(RuntimeState* state) {
     return num_affected_rows;
 }
 
+int ExecNode::get_next_column(RuntimeState* state, ColumnBatch* batch, bool* eos) {
+    RowBatch row_batch;
+    row_batch.set_capacity(batch->capacity());
+    int ret = get_next(state, &row_batch, eos);
+    if (ret < 0) {
+        return ret;
+    }
+    return batch->append_row_batch(row_batch);
+}
+
 void ExecNode::transfer_pb(int64_t region_id, pb::PlanNode* pb_node) {
     _pb_node.set_node_type(_node_type);
     _pb_node.set_limit(_limit);
@@ -760,8 +760,8 @@ int FetcherStore::run(RuntimeState* state,
             }
         }
     }
-    state->set_num_scan_rows(state->num_scan_rows() + scan_rows.load());
-    state->set_num_filter_rows(state->num_filter_rows() + filter_rows.load());
+    state->inc_num_scan_rows(scan_rows.load());
+    state->inc_num_filter_rows(filter_rows.load());
     //DB_WARNING("fetcher time:%ld, txn_id: %lu, log_id:%lu, batch_size:%lu", 
     //        cost.get_time(), state->txn_id, log_id, region_batch.size());
     return affected_rows.load();
@@ -22,6 +22,7 @@
 #include "network_socket.h"
 #include "dml_node.h"
 #include "trace_state.h"
+#include "column_batch.h"
 
 namespace baikaldb {
 
@@ -33,6 +34,12 @@ DEFINE_int32(fetcher_request_timeout, 100000,
                     "store as server request timeout, default:10000ms");
 DEFINE_int32(fetcher_connect_timeout, 1000,
                     "store as server connect timeout, default:1000ms");
+DEFINE_bool(select_columnar_rows, false, "store returns select result in columnar format");
+DEFINE_bool(select_compress_response, false, "store compresses select result with snappy");
+DEFINE_int64(select_page_rows, 10000, "rows per page when store returns select result by cursor, "
+                    "0 means return all rows in one response");
+DEFINE_int32(select_stream_region_window, 4, "streaming select keeps store cursors open on at most "
+                    "this many regions, later regions are opened when they are consumed");
                     
 ErrorType FetcherStore::send_request(
         RuntimeState* state,
@@ -185,6 +192,13 @@ ErrorType FetcherStore::send_request(
     }
     int64_t entry_ms3 = butil::gettimeofday_ms() % 1000;
     ExecNode::create_pb_plan(old_region_id, req.mutable_plan(), store_request);
+    if (op_type == pb::OP_SELECT) {
+        req.set_columnar_rows(FLAGS_select_columnar_rows);
+        req.set_compress_response(FLAGS_select_compress_response);
+        if (state->is_full_export) {
+            req.set_full_export(true);
+        }
+    }
     int64_t entry_ms4 = butil::gettimeofday_ms() % 1000;
 
     brpc::Channel channel;
@@ -201,6 +215,12 @@ ErrorType FetcherStore::send_request(
             choose_opt_instance(info, addr);
         }
         req.set_select_without_leader(true);
+        // 只有流式读分页，需要全部数据时一次返回
+        if (stream_select && FLAGS_select_page_rows > 0 && trace_node == nullptr
+                && !req.has_analyze_info()) {
+            req.set_page_rows(FLAGS_select_page_rows);
+            req.set_probe_page(probe_regions.count(old_region_id) > 0);
+        }
     }
     ret = channel.Init(addr.c_str(), &option);
     if (ret != 0) {
@@ -461,13 +481,24 @@ ErrorType FetcherStore::send_request(
     }
     cost.reset();
     std::shared_ptr<RowBatch> batch = std::make_shared<RowBatch>();
-    for (auto& pb_row : *res.mutable_row_values()) {
-        std::unique_ptr<MemRow> row = state->mem_row_desc()->fetch_mem_row();
-        for (int i = 0; i < res.tuple_ids_size(); i++) {
-            int32_t tuple_id = res.tuple_ids(i);
-            row->from_string(tuple_id, pb_row.tuple_values(i));
-        }
-        batch->move_row(std::move(row));
+    std::shared_ptr<pb::ColumnarRows> columnar_rows;
+    if (take_rows(state, res, batch.get(), column_result ? &columnar_rows : nullptr) < 0) {
+        DB_FATAL("parse row values fail, region_id:%ld, log_id:%lu", region_id, log_id);
+        return E_FATAL;
+    }
+    if (res.page_incomplete()) {
+        // 窗口外的region一页读不完，消费到时再打开游标
+        BAIDU_SCOPED_LOCK(region_lock);
+        pending_regions[info.start_key()] = info;
+        return E_OK;
+    }
+    if (res.cursor_id() != 0) {
+        RegionCursor cursor;
+        cursor.cursor_id = res.cursor_id();
+        cursor.region_version = info.version();
+        cursor.addr = addr;
+        BAIDU_SCOPED_LOCK(region_lock);
+        region_cursors[region_id] = cursor;
     }
     if (res.has_cmsketch() && state->cmsketch != nullptr) {
         state->cmsketch->add_proto(res.cmsketch());
@@ -481,6 +512,10 @@ ErrorType FetcherStore::send_request(
         region_batch[region_id] = batch;
         lock_tm= lock.get_time();
         row_cnt += batch->size();
+        if (columnar_rows != nullptr) {
+            region_columnar_rows[region_id] = columnar_rows;
+            row_cnt += columnar_rows->row_count();
+        }
         // TODO reduce mem used by streaming
         if ((!state->is_full_export) && (row_cnt > FLAGS_max_select_rows)) {
             DB_FATAL("_row_cnt:%ld > max_select_rows", row_cnt, FLAGS_max_select_rows);
@@ -494,6 +529,232 @@ ErrorType FetcherStore::send_request(
     return E_OK;
 }
 
+int FetcherStore::take_rows(RuntimeState* state, pb::StoreRes& res, RowBatch* batch,
+        std::shared_ptr<pb::ColumnarRows>* columnar_rows) {
+    if (res.has_columnar_rows()) {
+        if (columnar_rows != nullptr) {
+            // 留给列存流水线直接解码
+            columnar_rows->reset(new pb::ColumnarRows);
+            (*columnar_rows)->Swap(res.mutable_columnar_rows());
+            return 0;
+        }
+        return decode_columnar_rows(state, res.columnar_rows(), batch);
+    }
+    for (auto& pb_row : *res.mutable_row_values()) {
+        std::unique_ptr<MemRow> row = state->mem_row_desc()->fetch_mem_row();
+        for (int i = 0; i < res.tuple_ids_size(); i++) {
+            int32_t tuple_id = res.tuple_ids(i);
+            row->from_string(tuple_id, pb_row.tuple_values(i));
+        }
+        batch->move_row(std::move(row));
+    }
+    return 0;
+}
+
+int FetcherStore::decode_columnar_rows(RuntimeState* state, const pb::ColumnarRows& rows,
+        RowBatch* batch) {
+    ColumnBatch column_batch;
+    int ret = column_batch.init(state->tuple_descs());
+    if (ret < 0) {
+        return ret;
+    }
+    ret = column_batch.from_pb(rows);
+    if (ret < 0) {
+        return ret;
+    }
+    // 只填store返回的列，其他tuple和slot保持不变
+    std::vector<std::pair<int32_t, int32_t>> slots;
+    for (auto& values : rows.columns()) {
+        slots.emplace_back(values.tuple_id(), values.slot_id());
+    }
+    MemRowDescriptor* desc = state->mem_row_desc();
+    for (size_t i = 0; i < column_batch.size(); i++) {
+        std::unique_ptr<MemRow> row = desc->fetch_mem_row();
+        column_batch.fill_slots(i, slots, row.get());
+        batch->move_row(std::move(row));
+    }
+    return 0;
+}
+
+// 游标只存在于返回第一页的store实例上，且读下一页不幂等(超时时store可能已经读走一页)，
+// 这里不做重试，由调用方重新扫描或返回错误
+ErrorType FetcherStore::send_page_request(RuntimeState* state, int64_t region_id,
+        RegionCursor& cursor, bool close_cursor, RowBatch* batch,
+        std::shared_ptr<pb::ColumnarRows>* columnar_rows) {
+    uint64_t log_id = state->log_id();
+    pb::StoreReq req;
+    pb::StoreRes res;
+    brpc::Controller cntl;
+    cntl.set_log_id(log_id);
+    req.set_op_type(pb::OP_SELECT);
+    req.set_region_id(region_id);
+    req.set_region_version(cursor.region_version);
+    req.set_log_id(log_id);
+    req.set_select_without_leader(true);
+    req.set_cursor_id(cursor.cursor_id);
+    req.set_page_rows(FLAGS_select_page_rows);
+    req.set_close_cursor(close_cursor);
+    req.set_db_conn_id(state->client_conn()->get_global_conn_id());
+    req.set_columnar_rows(FLAGS_select_columnar_rows);
+    req.set_compress_response(FLAGS_select_compress_response);
+    cursor.cursor_id = 0;
+
+    brpc::Channel channel;
+    brpc::ChannelOptions option;
+    option.max_retry = 0;
+    option.connect_timeout_ms = FLAGS_fetcher_connect_timeout; 
+    option.timeout_ms = FLAGS_fetcher_request_timeout;
+    int ret = channel.Init(cursor.addr.c_str(), &option);
+    if (ret != 0) {
+        DB_WARNING("channel init failed, addr:%s, ret:%d, region_id: %ld, log_id:%lu", 
+                cursor.addr.c_str(), ret, region_id, log_id);
+        return E_FATAL;
+    }
+    pb::StoreService_Stub(&channel).query(&cntl, &req, &res, NULL);
+    if (cntl.Failed()) {
+        DB_WARNING("call failed region_id: %ld, errcode:%d, error:%s, log_id:%lu", 
+                region_id, cntl.ErrorCode(), cntl.ErrorText().c_str(), log_id);
+        return E_FATAL;
+    }
+    if (res.errcode() != pb::SUCCESS) {
+        DB_WARNING("errcode:%d, msg:%s, failed, instance:%s region_id:%ld, log_id:%lu", 
+                res.errcode(), res.errmsg().c_str(), cursor.addr.c_str(), region_id, log_id);
+        return E_FATAL;
+    }
+    if (close_cursor) {
+        return E_OK;
+    }
+    if (res.has_scan_rows()) {
+        scan_rows += res.scan_rows();
+    }
+    if (res.has_filter_rows()) {
+        filter_rows += res.filter_rows();
+    }
+    if (take_rows(state, res, batch, columnar_rows) < 0) {
+        DB_FATAL("parse row values fail, region_id:%ld, log_id:%lu", region_id, log_id);
+        return E_FATAL;
+    }
+    cursor.cursor_id = res.cursor_id();
+    return E_OK;
+}
+
+int FetcherStore::fetch_next_page(RuntimeState* state, int64_t region_id, RowBatch* batch,
+        std::shared_ptr<pb::ColumnarRows>* columnar_rows) {
+    auto iter = region_cursors.find(region_id);
+    if (iter == region_cursors.end()) {
+        return 0;
+    }
+    scan_rows = 0;
+    filter_rows = 0;
+    auto ret = send_page_request(state, region_id, iter->second, false, batch,
+            column_result ? columnar_rows : nullptr);
+    if (iter->second.cursor_id == 0) {
+        region_cursors.erase(iter);
+    }
+    if (ret != E_OK) {
+        // 前面的页已经返回给客户端，无法从中间续读，返回可重试的错误
+        DB_WARNING("fetch next page fail, region_id:%ld, log_id:%lu", region_id, state->log_id());
+        state->error_code = ER_QUERY_INTERRUPTED;
+        state->error_msg.str("select cursor lost on store, please retry");
+        return -1;
+    }
+    state->inc_num_scan_rows(scan_rows.load());
+    state->inc_num_filter_rows(filter_rows.load());
+    row_cnt += batch->size();
+    if (columnar_rows != nullptr && *columnar_rows != nullptr) {
+        row_cnt += (*columnar_rows)->row_count();
+    }
+    if ((!state->is_full_export) && (row_cnt > FLAGS_max_select_rows)) {
+        DB_FATAL("_row_cnt:%ld > max_select_rows:%ld, log_id:%lu",
+                row_cnt, FLAGS_max_select_rows, state->log_id());
+        close_cursors(state);
+        state->error_code = ER_SQL_TOO_BIG;
+        state->error_msg.str("sql too big");
+        return -1;
+    }
+    return 0;
+}
+
+void FetcherStore::close_cursors(RuntimeState* state) {
+    for (auto& pair : region_cursors) {
+        send_page_request(state, pair.first, pair.second, true, nullptr);
+    }
+    region_cursors.clear();
+    pending_regions.clear();
+}
+
+int FetcherStore::next_stream_region(RuntimeState* state, int64_t* region_id,
+        std::shared_ptr<RowBatch>* batch, std::shared_ptr<pb::ColumnarRows>* columnar_rows) {
+    while (true) {
+        auto sort_iter = start_key_sort.begin();
+        auto pending_iter = pending_regions.begin();
+        if (sort_iter == start_key_sort.end() && pending_iter == pending_regions.end()) {
+            return 1;
+        }
+        if (pending_iter != pending_regions.end()
+                && (sort_iter == start_key_sort.end() || pending_iter->first < sort_iter->first)) {
+            if (open_pending_regions(state) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        *region_id = sort_iter->second;
+        *batch = region_batch[*region_id];
+        region_batch.erase(*region_id);
+        start_key_sort.erase(sort_iter);
+        auto columnar_iter = region_columnar_rows.find(*region_id);
+        if (columnar_iter != region_columnar_rows.end()) {
+            if (columnar_rows != nullptr) {
+                *columnar_rows = columnar_iter->second;
+            } else if (decode_columnar_rows(state, *columnar_iter->second, batch->get()) < 0) {
+                return -1;
+            }
+            region_columnar_rows.erase(columnar_iter);
+        }
+        return 0;
+    }
+}
+
+int FetcherStore::open_pending_regions(RuntimeState* state) {
+    std::vector<pb::RegionInfo> infos;
+    int window = std::max(FLAGS_select_stream_region_window, 1);
+    while (!pending_regions.empty() && (int)infos.size() < window) {
+        infos.push_back(pending_regions.begin()->second);
+        probe_regions.erase(infos.back().region_id());
+        pending_regions.erase(pending_regions.begin());
+    }
+    uint64_t log_id = state->log_id();
+    scan_rows = 0;
+    filter_rows = 0;
+    ConcurrencyBthread con_bth(infos.size(), &BTHREAD_ATTR_SMALL);
+    for (auto& info : infos) {
+        pb::RegionInfo* info_ptr = &info;
+        auto req_thread = [this, state, info_ptr, log_id]() {
+            int64_t region_id = info_ptr->region_id();
+            auto ret = send_request(state, _stream_request, *info_ptr, region_id, region_id, log_id,
+                    0, _stream_start_seq_id, _stream_current_seq_id, pb::OP_SELECT);
+            if (ret != E_OK) {
+                DB_WARNING("rpc error, region_id:%ld, log_id:%lu", region_id, log_id);
+                error = ret;
+            }
+        };
+        con_bth.run(req_thread);
+    }
+    con_bth.join();
+    if (error != E_OK) {
+        DB_WARNING("open pending regions fail, log_id:%lu", log_id);
+        if (error == E_BIG_SQL) {
+            state->error_code = ER_SQL_TOO_BIG;
+            state->error_msg.str("sql too big");
+        }
+        close_cursors(state);
+        return -1;
+    }
+    state->inc_num_scan_rows(scan_rows.load());
+    state->inc_num_filter_rows(filter_rows.load());
+    return 0;
+}
+
 void FetcherStore::choose_opt_instance(pb::RegionInfo& info, std::string& addr) {
     SchemaFactory* schema_factory = SchemaFactory::get_instance();
     std::string baikaldb_logical_room = schema_factory->get_logical_room();
@@ -526,6 +787,7 @@ int FetcherStore::run(RuntimeState* state,
     //DB_WARNING("start_seq_id: %d, current_seq_id: %d op_type: %s", start_seq_id,
     //        current_seq_id, pb::OpType_Name(op_type).c_str());
     region_batch.clear();
+    region_columnar_rows.clear();
     index_records.clear();
     start_key_sort.clear();
     error = E_OK;
@@ -534,6 +796,9 @@ int FetcherStore::run(RuntimeState* state,
     scan_rows = 0;
     filter_rows = 0;
     row_cnt = 0;
+    region_cursors.clear();
+    pending_regions.clear();
+    probe_regions.clear();
     auto client = state->client_conn();
     //TimeCost cost;
     if (region_infos.size() == 0) {
@@ -605,6 +870,26 @@ int FetcherStore::run(RuntimeState* state,
         skip_region_set.insert(primary_region_id);
     }
 
+    if (stream_select && op_type == pb::OP_SELECT && state->txn_id == 0) {
+        // 流式读只在前几个region上保留游标，其余region的第一页读不完时推迟到消费时再打开
+        std::map<std::string, int64_t> sorted_regions;
+        for (auto& pair : region_infos) {
+            if (skip_region_set.count(pair.first) == 0) {
+                sorted_regions[pair.second.start_key()] = pair.first;
+            }
+        }
+        int window = std::max(FLAGS_select_stream_region_window, 1);
+        for (auto& pair : sorted_regions) {
+            if (window > 0) {
+                --window;
+                continue;
+            }
+            probe_regions.insert(pair.second);
+        }
+        _stream_request = store_request;
+        _stream_start_seq_id = start_seq_id;
+        _stream_current_seq_id = current_seq_id;
+    }
     // 构造并发送请求
     std::map<std::string, std::set<std::shared_ptr<TraceDesc>>> send_region_ids_map; // leader ip => region_ids
     int send_region_count = 0;
@@ -760,8 +1045,8 @@ int FetcherStore::run(RuntimeState* state,
             }
         }
     }
-    state->set_num_scan_rows(state->num_scan_rows() + scan_rows.load());
-    state->set_num_filter_rows(state->num_filter_rows() + filter_rows.load());
+    state->inc_num_scan_rows(scan_rows.load());
+    state->inc_num_filter_rows(filter_rows.load());
     //DB_WARNING("fetcher time:%ld, txn_id: %lu, log_id:%lu, batch_size:%lu", 
     //        cost.get_time(), state->txn_id, log_id, region_batch.size());
     return affected_rows.load();
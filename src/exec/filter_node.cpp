@@ -336,6 +336,19 @@ int FilterNode::open(RuntimeState* state) {
         }
         _pruned_conjuncts.push_back(conjunct);
     }
+    std::set<std::pair<int32_t, int32_t>> slot_refs;
+    for (auto conjunct : _pruned_conjuncts) {
+        conjunct->get_all_slot_refs(slot_refs);
+    }
+    _conjunct_slots.assign(slot_refs.begin(), slot_refs.end());
+    // having条件里的聚合函数直接读agg tuple，需要整行
+    _need_full_row = (_node_type == pb::HAVING_FILTER_NODE);
+    _eval_batch = !_need_full_row;
+    for (auto conjunct : _pruned_conjuncts) {
+        if (!conjunct->can_eval_batch()) {
+            _eval_batch = false;
+        }
+    }
     return 0;
 }
 
@@ -405,6 +418,94 @@ int FilterNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
     return 0;
 }
 
+int FilterNode::get_next_column(RuntimeState* state, ColumnBatch* batch, bool* eos) {
+    int64_t where_filter_cnt = 0;
+    START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), GET_NEXT_TRACE, ([this, &where_filter_cnt](TraceLocalNode& local_node) {
+        local_node.add_where_filter_rows(where_filter_cnt);
+        local_node.set_affect_rows(_num_rows_returned);
+    }));
+
+    if (_scratch_row == nullptr) {
+        _scratch_row = state->mem_row_desc()->fetch_mem_row();
+    }
+    while (1) {
+        if (reached_limit()) {
+            *eos = true;
+            return 0;
+        }
+        batch->clear();
+        int ret = _children[0]->get_next_column(state, batch, eos);
+        if (ret < 0) {
+            DB_WARNING_STATE(state, "_children get_next_column fail");
+            return ret;
+        }
+        if (!_is_explain && !_pruned_conjuncts.empty() && _eval_batch) {
+            int64_t filter_cnt = filter_column_batch(batch);
+            if (filter_cnt < 0) {
+                DB_WARNING_STATE(state, "filter_column_batch fail");
+                return -1;
+            }
+            state->inc_num_filter_rows(filter_cnt);
+            where_filter_cnt += filter_cnt;
+        } else if (!_is_explain && !_pruned_conjuncts.empty()) {
+            size_t selected = batch->selected_size();
+            _selection.clear();
+            _selection.reserve(selected);
+            for (size_t i = 0; i < selected; i++) {
+                size_t idx = batch->selected_idx(i);
+                if (_need_full_row) {
+                    batch->fill_row(idx, _scratch_row.get());
+                } else {
+                    batch->fill_slots(idx, _conjunct_slots, _scratch_row.get());
+                }
+                if (need_copy(_scratch_row.get())) {
+                    _selection.push_back(idx);
+                } else {
+                    state->inc_num_filter_rows();
+                    ++where_filter_cnt;
+                }
+            }
+            batch->set_selection(_selection);
+        }
+        _num_rows_returned += batch->selected_size();
+        if (reached_limit()) {
+            batch->keep_first_rows(batch->selected_size() - (_num_rows_returned - _limit));
+            _num_rows_returned = _limit;
+            *eos = true;
+            return 0;
+        }
+        if (batch->selected_size() > 0 || *eos) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+int64_t FilterNode::filter_column_batch(ColumnBatch* batch) {
+    size_t before = batch->selected_size();
+    for (auto conjunct : _pruned_conjuncts) {
+        if (batch->selected_size() == 0) {
+            break;
+        }
+        ColumnVector result(pb::BOOL);
+        result.resize(batch->size());
+        int ret = conjunct->eval_batch(batch, batch->selection(), &result);
+        if (ret < 0) {
+            return ret;
+        }
+        // 后面的条件只计算前面留下的行
+        const int64_t* data = result.int_data();
+        _selection.clear();
+        for_each_selected(batch->size(), batch->selection(), [this, &result, data](size_t idx) {
+            if (!result.is_null(idx) && data[idx] != 0) {
+                _selection.push_back(idx);
+            }
+        });
+        batch->set_selection(_selection);
+    }
+    return before - batch->selected_size();
+}
+
 void FilterNode::close(RuntimeState* state) {
     ExecNode::close(state);
     for (auto conjunct : _conjuncts) {
@@ -414,6 +515,8 @@ void FilterNode::close(RuntimeState* state) {
     _child_row_batch.clear();
     _child_row_idx = 0;
     _child_eos = false;
+    _conjunct_slots.clear();
+    _scratch_row.reset();
 }
 void FilterNode::show_explain(std::vector<std::map<std::string, std::string>>& output) {
     ExecNode::show_explain(output);
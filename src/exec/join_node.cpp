@@ -21,8 +21,20 @@
 #include "plan_router.h"
 #include "logical_planner.h"
 #include "literal.h"
+#include "runtime_state.h"
+#include "schema_factory.h"
 
 namespace baikaldb {
+DECLARE_bool(use_fixed_hash_key);
+DEFINE_int64(hash_join_min_outer_rows, 0, "use build/probe hash join instead of "
+        "pushing in-list to inner table when fetched outer rows exceed this, 0 means never");
+DEFINE_int32(join_spill_partitions, 16, "partition number when hash join spill to disk");
+DEFINE_int32(join_spill_max_depth, 3, "max times a spilled hash join partition that still "
+        "exceeds query_memory_limit is re-partitioned before the query fails");
+DEFINE_int32(join_in_batch_size, 2000, "max driving table rows per in condition pushed down "
+        "to inner table, larger driving table is joined batch by batch, 0 means no limit");
+DEFINE_bool(join_batch_prefetch, true, "fetch next batch of inner table while probing current one");
+
 int JoinNode::init(const pb::PlanNode& node) {
     int ret = 0;
     ret = ExecNode::init(node);
@@ -253,15 +265,38 @@ int JoinNode::open(RuntimeState* state) {
     //DB_WARNING("when join, outer join open(fetcher data), time_cost:%ld", join_time_cost.get_time());
     join_time_cost.reset();
     //从左表中把全部数据拿出
-    ret = _fetcher_join_table(state, _outer_node, _outer_tuple_data);
+    //按实际取到的行数决定是否改用hash join，带过滤条件的大表驱动时仍走in条件下推
+    int64_t max_outer_rows = -1;
+    if (!_is_explain && FLAGS_hash_join_min_outer_rows > 0) {
+        max_outer_rows = FLAGS_hash_join_min_outer_rows;
+    }
+    bool outer_eos = false;
+    ret = _fetch_outer_table(state, max_outer_rows, &outer_eos);
     if (ret < 0) {
         DB_WARNING("ExecNode::join open fail when fetch left table");
         return ret;
     }
+    //驱动表很大时in条件过长，改为build/probe的hash join
+    if (!outer_eos) {
+        _use_hash_join = true;
+        return _open_hash_join(state);
+    }
     if (_outer_tuple_data.size() == 0) {
         _outer_table_is_null = true;
         return 0;
     }
+    //驱动表行数较多时in条件分批下推，避免一个超大的in条件发到所有store
+    if (!_is_explain && FLAGS_join_in_batch_size > 0 && _outer_equal_slot.size() > 0
+            && _outer_tuple_data.size() > (size_t)FLAGS_join_in_batch_size) {
+        _use_batch_join = true;
+        _prefetch_end = std::min((size_t)FLAGS_join_in_batch_size, _outer_tuple_data.size());
+        ret = _fetch_inner_batch(state, 0, _prefetch_end, _prefetch_tuple_data);
+        if (ret < 0) {
+            DB_WARNING("fetch inner batch fail");
+            return ret;
+        }
+        return _next_join_batch(state);
+    }
     //DB_WARNING("when join, fetch outer data size:%d, time_cost:%ld", 
     //            _outer_tuple_data.size(), join_time_cost.get_time());
     join_time_cost.reset();
@@ -289,6 +324,44 @@ int JoinNode::open(RuntimeState* state) {
     //            join_time_cost.get_time());
     join_time_cost.reset();
 
+    _reselect_inner_index(state);
+    //DB_WARNING("when join, index_selector and scan plan, time_cost:%ld",
+    //            join_time_cost.get_time());
+    join_time_cost.reset();
+    //_inner_node->print_all_exec_node();
+    //谓词下推后可能生成新的plannode重新生成tracenode
+    _inner_node->create_trace();
+    ret = _inner_node->open(state);
+    if (ret < 0) {
+        DB_WARNING("ExecNode::inner table open fial");
+        return -1;
+    }
+    //DB_WARNING("when join, _inner_node open(fetcher data), time_cost:%ld",
+    //            join_time_cost.get_time());
+    join_time_cost.reset();
+    if (_join_type == pb::LEFT_JOIN 
+            || _join_type == pb::RIGHT_JOIN) {
+        join_time_cost.reset();
+        ret = _fetcher_join_table(state, _inner_node, _inner_tuple_data);
+        if (ret < 0) {
+            DB_WARNING("fetcher inner node fail");
+            return ret;
+        }
+        //DB_WARNING("when join, fetch inner data size:%d, time_cost:%ld", 
+        //            _outer_tuple_data.size(), join_time_cost.get_time());
+        join_time_cost.reset();
+        _construct_hash_map(_inner_tuple_data, _inner_equal_slot);
+        //DB_WARNING("when join, _construct_hash_map time_cost:%ld", join_time_cost.get_time());
+        _outer_iter = _outer_tuple_data.begin();
+    } else {
+        join_time_cost.reset();
+        _construct_hash_map(_outer_tuple_data, _outer_equal_slot);
+        //DB_WARNING("when join, _construct_hash_map time_cost:%ld", join_time_cost.get_time());
+    } 
+    return 0;
+}
+
+void JoinNode::_reselect_inner_index(RuntimeState* state) {
     std::vector<ExecNode*> scan_nodes;
     _inner_node->get_node(pb::SCAN_NODE, scan_nodes);
     //重新做路由选择
@@ -326,40 +399,6 @@ int JoinNode::open(RuntimeState* state) {
             related_manager_node->set_region_infos(region_infos);
         }
     }
-    //DB_WARNING("when join, index_selector and scan plan, time_cost:%ld",
-    //            join_time_cost.get_time());
-    join_time_cost.reset();
-    //_inner_node->print_all_exec_node();
-    //谓词下推后可能生成新的plannode重新生成tracenode
-    _inner_node->create_trace();
-    ret = _inner_node->open(state);
-    if (ret < 0) {
-        DB_WARNING("ExecNode::inner table open fial");
-        return -1;
-    }
-    //DB_WARNING("when join, _inner_node open(fetcher data), time_cost:%ld",
-    //            join_time_cost.get_time());
-    join_time_cost.reset();
-    if (_join_type == pb::LEFT_JOIN 
-            || _join_type == pb::RIGHT_JOIN) {
-        join_time_cost.reset();
-        ret = _fetcher_join_table(state, _inner_node, _inner_tuple_data);
-        if (ret < 0) {
-            DB_WARNING("fetcher inner node fail");
-            return ret;
-        }
-        //DB_WARNING("when join, fetch inner data size:%d, time_cost:%ld", 
-        //            _outer_tuple_data.size(), join_time_cost.get_time());
-        join_time_cost.reset();
-        _construct_hash_map(_inner_tuple_data, _inner_equal_slot);
-        //DB_WARNING("when join, _construct_hash_map time_cost:%ld", join_time_cost.get_time());
-        _outer_iter = _outer_tuple_data.begin();
-    } else {
-        join_time_cost.reset();
-        _construct_hash_map(_outer_tuple_data, _outer_equal_slot);
-        //DB_WARNING("when join, _construct_hash_map time_cost:%ld", join_time_cost.get_time());
-    } 
-    return 0;
 }
 
 int JoinNode::_fill_equal_slot() {
@@ -513,6 +552,17 @@ int JoinNode::_fetcher_join_table(RuntimeState* state, ExecNode* child_node,
 
 void JoinNode::_construct_hash_map(const std::vector<MemRow*>& tuple_data, 
                                   const std::vector<ExprNode*>& slot_refs) {
+    _init_fixed_key_words();
+    switch (_fixed_key_words) {
+        case 2:
+            return _construct_fixed_hash_map(tuple_data, slot_refs, &_fixed_map2);
+        case 4:
+            return _construct_fixed_hash_map(tuple_data, slot_refs, &_fixed_map4);
+        case 8:
+            return _construct_fixed_hash_map(tuple_data, slot_refs, &_fixed_map8);
+        default:
+            break;
+    }
     for (auto& mem_row : tuple_data) {
         MutTableKey key;
         _encode_hash_key(mem_row, slot_refs, key);
@@ -543,11 +593,623 @@ void JoinNode::_encode_hash_key(MemRow* row,
     }
 }
 
+void JoinNode::_init_fixed_key_words() {
+    _fixed_key_words = 0;
+    if (!FLAGS_use_fixed_hash_key || _outer_equal_slot.size() != _inner_equal_slot.size()) {
+        return;
+    }
+    std::vector<pb::PrimitiveType> types;
+    for (size_t i = 0; i < _outer_equal_slot.size(); i++) {
+        pb::PrimitiveType outer_type = _outer_equal_slot[i]->col_type();
+        pb::PrimitiveType inner_type = _inner_equal_slot[i]->col_type();
+        if (!fixed_key_type_compatible(outer_type, inner_type)) {
+            return;
+        }
+        types.push_back(outer_type);
+    }
+    _fixed_key_words = fixed_key_words(types);
+}
+
+template <size_t N>
+void JoinNode::_encode_fixed_key(MemRow* row,
+                     const std::vector<ExprNode*>& slot_ref_exprs,
+                     FixedKey<N>* key) {
+    key->clear();
+    for (size_t i = 0; i < slot_ref_exprs.size(); i++) {
+        SlotRef* slot_ref = static_cast<SlotRef*>(slot_ref_exprs[i]);
+        key->set_value(i, row->get_value(slot_ref->tuple_id(), slot_ref->slot_id()));
+    }
+}
+
+template <size_t N>
+void JoinNode::_construct_fixed_hash_map(const std::vector<MemRow*>& tuple_data,
+                               const std::vector<ExprNode*>& slot_refs,
+                               FixedKeyHashMap<N, std::vector<MemRow*>>* hash_map) {
+    FixedKey<N> key;
+    for (auto& mem_row : tuple_data) {
+        _encode_fixed_key(mem_row, slot_refs, &key);
+        (*hash_map)[key].push_back(mem_row);
+    }
+}
+
+template <size_t N>
+std::vector<MemRow*>* JoinNode::_seek_fixed_hash_map(MemRow* row,
+                               const std::vector<ExprNode*>& slot_refs,
+                               FixedKeyHashMap<N, std::vector<MemRow*>>* hash_map) {
+    FixedKey<N> key;
+    _encode_fixed_key(row, slot_refs, &key);
+    return hash_map->seek(key);
+}
+
+std::vector<MemRow*>* JoinNode::_seek_hash_map(MemRow* row,
+                               const std::vector<ExprNode*>& slot_refs) {
+    switch (_fixed_key_words) {
+        case 2:
+            return _seek_fixed_hash_map(row, slot_refs, &_fixed_map2);
+        case 4:
+            return _seek_fixed_hash_map(row, slot_refs, &_fixed_map4);
+        case 8:
+            return _seek_fixed_hash_map(row, slot_refs, &_fixed_map8);
+        default:
+            break;
+    }
+    MutTableKey key;
+    _encode_hash_key(row, slot_refs, key);
+    return _hash_map.seek(key.data());
+}
+
+void JoinNode::_clear_hash_map() {
+    _hash_map.clear();
+    _fixed_map2.clear();
+    _fixed_map4.clear();
+    _fixed_map8.clear();
+}
+
+//取驱动表的行，max_rows>=0时超过max_rows就停止，eos表示是否已取完
+int JoinNode::_fetch_outer_table(RuntimeState* state, int64_t max_rows, bool* eos) {
+    *eos = false;
+    while (!*eos) {
+        if (max_rows >= 0 && _outer_tuple_data.size() > (size_t)max_rows) {
+            return 0;
+        }
+        RowBatch batch;
+        auto ret = _outer_node->get_next(state, &batch, eos);
+        if (ret < 0) {
+            DB_WARNING("children:get_next fail:%d", ret);
+            return ret;
+        }
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            _outer_tuple_data.push_back(batch.get_row().release());
+        }
+    }
+    return 0;
+}
+
+//驱动表已经打开，_outer_tuple_data中是已取到的行，先探测这些行再继续读驱动表
+//外连接需要保留驱动表的每一行，用内表建hash表
+int JoinNode::_open_hash_join(RuntimeState* state) {
+    ExecNode* build_node = _inner_node;
+    _probe_node = _outer_node;
+    _build_equal_slot = &_inner_equal_slot;
+    _probe_equal_slot = &_outer_equal_slot;
+    _build_tuple_data = &_inner_tuple_data;
+    _pending_probe_idx = 0;
+    TimeCost cost;
+    auto ret = build_node->open(state);
+    if (ret < 0) {
+        DB_WARNING("build node open fail");
+        return ret;
+    }
+    ret = _fetch_build_table(state, build_node);
+    if (ret < 0) {
+        DB_WARNING("fetch build table fail");
+        return ret;
+    }
+    if (_build_partitions.empty() && _build_tuple_data->empty() 
+            && _join_type == pb::INNER_JOIN) {
+        _outer_table_is_null = true;
+        return 0;
+    }
+    if (_build_partitions.empty()) {
+        _construct_hash_map(*_build_tuple_data, *_build_equal_slot);
+    } else {
+        //build侧已落盘，probe侧也全部按相同方式分区
+        ret = _spill_probe_table(state);
+        if (ret < 0) {
+            DB_WARNING("spill probe table fail");
+            return ret;
+        }
+    }
+    DB_WARNING("hash join open, build_rows:%lu partitions:%lu "
+            "time_cost:%ld, log_id:%lu", _build_tuple_data->size(), 
+            _build_partitions.size(), cost.get_time(), state->log_id());
+    return 0;
+}
+
+int64_t JoinNode::_row_bytes(MemRow* row) {
+    static const int64_t ROW_OVERHEAD = 64;
+    int64_t bytes = ROW_OVERHEAD;
+    for (int32_t tuple_id = 0; tuple_id < _mem_row_desc->tuple_size(); tuple_id++) {
+        auto tuple = row->get_tuple(tuple_id);
+        if (tuple != nullptr) {
+            bytes += tuple->ByteSize();
+        }
+    }
+    return bytes;
+}
+
+int JoinNode::_fetch_build_table(RuntimeState* state, ExecNode* build_node) {
+    bool eos = false;
+    do {
+        RowBatch batch;
+        auto ret = build_node->get_next(state, &batch, &eos);
+        if (ret < 0) {
+            DB_WARNING("children:get_next fail:%d", ret);
+            return ret;
+        }
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            std::unique_ptr<MemRow>& row = batch.get_row();
+            if (_build_partitions.empty()) {
+                int64_t bytes = _row_bytes(row.get());
+                if (state->try_consume_memory(bytes)) {
+                    _build_bytes += bytes;
+                    _build_tuple_data->push_back(row.release());
+                    continue;
+                }
+                ret = _init_join_partitions(state, 0);
+                if (ret < 0) {
+                    return ret;
+                }
+                //内存中已有的build行全部落盘
+                for (auto& mem_row : *_build_tuple_data) {
+                    ret = _append_partition(_build_partitions, 0, mem_row, *_build_equal_slot, 0);
+                    if (ret < 0) {
+                        return ret;
+                    }
+                    delete mem_row;
+                    mem_row = nullptr;
+                }
+                _build_tuple_data->clear();
+                state->release_memory(_build_bytes);
+                _build_bytes = 0;
+            }
+            ret = _append_partition(_build_partitions, 0, row.get(), *_build_equal_slot, 0);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    } while (!eos);
+    for (auto& partition : _build_partitions) {
+        auto ret = partition->finish_write();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+//在两侧分区列表末尾各追加一组分区
+int JoinNode::_init_join_partitions(RuntimeState* state, int level) {
+    int partition_num = std::max(FLAGS_join_spill_partitions, 2);
+    for (int i = 0; i < partition_num; i++) {
+        _partition_levels.push_back(level);
+        for (auto partitions : {&_build_partitions, &_probe_partitions}) {
+            std::string path = SpillFile::make_path("join", state->log_id());
+            if (path.empty()) {
+                return -1;
+            }
+            std::shared_ptr<SpillFile> partition = std::make_shared<SpillFile>(path, _mem_row_desc);
+            auto ret = partition->open_write();
+            if (ret < 0) {
+                return ret;
+            }
+            partitions->push_back(partition);
+        }
+    }
+    DB_WARNING("hash join build side exceed memory limit, spill to %d partitions, level:%d, "
+            "log_id:%lu", partition_num, level, state->log_id());
+    return 0;
+}
+
+//两侧都按转成字符串后的key分区，保证能匹配的行在同一个分区
+//写入partitions[begin, end)，再次切分时key后追加level，避免所有行又落到同一个分区
+int JoinNode::_append_partition(std::vector<std::shared_ptr<SpillFile>>& partitions, size_t begin,
+                                MemRow* row, const std::vector<ExprNode*>& slot_refs, int level) {
+    MutTableKey key;
+    _encode_hash_key(row, slot_refs, key);
+    if (level > 0) {
+        key.append_u8(level);
+    }
+    size_t idx = begin + std::hash<std::string>()(key.data()) % (partitions.size() - begin);
+    return partitions[idx]->append(row);
+}
+
+int JoinNode::_spill_probe_table(RuntimeState* state) {
+    for (auto& mem_row : _outer_tuple_data) {
+        auto ret = _append_partition(_probe_partitions, 0, mem_row, *_probe_equal_slot, 0);
+        if (ret < 0) {
+            return ret;
+        }
+        delete mem_row;
+        mem_row = nullptr;
+    }
+    _outer_tuple_data.clear();
+    bool eos = _probe_eos;
+    while (!eos) {
+        RowBatch batch;
+        auto ret = _probe_node->get_next(state, &batch, &eos);
+        if (ret < 0) {
+            DB_WARNING("children:get_next fail:%d", ret);
+            return ret;
+        }
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            ret = _append_partition(_probe_partitions, 0, batch.get_row().get(),
+                    *_probe_equal_slot, 0);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+    _probe_eos = false;
+    for (auto& partition : _probe_partitions) {
+        auto ret = partition->finish_write();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int JoinNode::_load_build_partition(RuntimeState* state, SpillFile* partition) {
+    auto ret = partition->open_read();
+    if (ret < 0) {
+        return ret;
+    }
+    while (true) {
+        RowBatch batch;
+        ret = partition->read(&batch);
+        if (ret < 0) {
+            return ret;
+        }
+        if (batch.size() == 0) {
+            break;
+        }
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            std::unique_ptr<MemRow>& row = batch.get_row();
+            int64_t bytes = _row_bytes(row.get());
+            if (!state->try_consume_memory(bytes)) {
+                for (auto& mem_row : *_build_tuple_data) {
+                    delete mem_row;
+                }
+                _build_tuple_data->clear();
+                state->release_memory(_build_bytes);
+                _build_bytes = 0;
+                return 1;
+            }
+            _build_bytes += bytes;
+            _build_tuple_data->push_back(row.release());
+        }
+    }
+    return 0;
+}
+
+//分区仍超过内存预算，两侧按新的hash种子切分成更小的分区追加到末尾
+int JoinNode::_repartition(RuntimeState* state, size_t idx) {
+    int level = _partition_levels[idx] + 1;
+    size_t begin = _build_partitions.size();
+    auto ret = _init_join_partitions(state, level);
+    if (ret < 0) {
+        return ret;
+    }
+    std::vector<std::pair<std::shared_ptr<SpillFile>, std::vector<std::shared_ptr<SpillFile>>*>>
+        sides = {{_build_partitions[idx], &_build_partitions},
+                 {_probe_partitions[idx], &_probe_partitions}};
+    for (auto& side : sides) {
+        auto& slot_refs = side.second == &_build_partitions ? *_build_equal_slot : *_probe_equal_slot;
+        ret = side.first->open_read();
+        if (ret < 0) {
+            return ret;
+        }
+        while (true) {
+            RowBatch batch;
+            ret = side.first->read(&batch);
+            if (ret < 0) {
+                return ret;
+            }
+            if (batch.size() == 0) {
+                break;
+            }
+            for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+                ret = _append_partition(*side.second, begin, batch.get_row().get(), slot_refs, level);
+                if (ret < 0) {
+                    return ret;
+                }
+            }
+        }
+        for (size_t i = begin; i < side.second->size(); i++) {
+            ret = (*side.second)[i]->finish_write();
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+//读入下一个build分区建hash表，并打开对应的probe分区
+//build分区超过内存预算时再次切分，超过join_spill_max_depth仍放不下则报错
+int JoinNode::_load_next_partition(RuntimeState* state) {
+    _clear_hash_map();
+    for (auto& mem_row : *_build_tuple_data) {
+        delete mem_row;
+    }
+    _build_tuple_data->clear();
+    state->release_memory(_build_bytes);
+    _build_bytes = 0;
+    _probe_reader = nullptr;
+    while (_partition_idx < _build_partitions.size()) {
+        size_t idx = _partition_idx++;
+        auto ret = _load_build_partition(state, _build_partitions[idx].get());
+        if (ret < 0) {
+            return ret;
+        }
+        if (ret == 0) {
+            _build_partitions[idx] = nullptr;
+            _probe_reader = _probe_partitions[idx];
+            _probe_partitions[idx] = nullptr;
+            _construct_hash_map(*_build_tuple_data, *_build_equal_slot);
+            return _probe_reader->open_read();
+        }
+        if (_partition_levels[idx] >= FLAGS_join_spill_max_depth) {
+            DB_WARNING("hash join partition exceed memory limit after %d re-partitions, "
+                    "partition_bytes:%ld, log_id:%lu", _partition_levels[idx],
+                    _build_partitions[idx]->bytes(), state->log_id());
+            state->error_code = ER_SQL_TOO_BIG;
+            state->error_msg.str("hash join partition exceeds query_memory_limit, "
+                    "join key may be heavily skewed");
+            return -1;
+        }
+        ret = _repartition(state, idx);
+        _build_partitions[idx] = nullptr;
+        _probe_partitions[idx] = nullptr;
+        if (ret < 0) {
+            DB_WARNING("repartition hash join partition fail, log_id:%lu", state->log_id());
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int JoinNode::_fetch_probe_batch(RuntimeState* state) {
+    _probe_batch.clear();
+    if (_build_partitions.empty()) {
+        //切换到hash join前已取到的驱动表行
+        if (_pending_probe_idx < _outer_tuple_data.size()) {
+            while (_pending_probe_idx < _outer_tuple_data.size() && !_probe_batch.is_full()) {
+                MemRow* mem_row = _outer_tuple_data[_pending_probe_idx];
+                _outer_tuple_data[_pending_probe_idx++] = nullptr;
+                _probe_batch.move_row(std::unique_ptr<MemRow>(mem_row));
+            }
+            return 0;
+        }
+        if (_probe_eos) {
+            return 0;
+        }
+        return _probe_node->get_next(state, &_probe_batch, &_probe_eos);
+    }
+    while (true) {
+        if (_probe_reader != nullptr) {
+            auto ret = _probe_reader->read(&_probe_batch);
+            if (ret < 0) {
+                return ret;
+            }
+            if (_probe_batch.size() > 0) {
+                return 0;
+            }
+        }
+        if (_partition_idx >= _build_partitions.size()) {
+            _probe_eos = true;
+            return 0;
+        }
+        auto ret = _load_next_partition(state);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int JoinNode::_fetch_inner_batch(RuntimeState* state, size_t begin, size_t end,
+                                 std::vector<MemRow*>& tuple_data) {
+    TimeCost cost;
+    std::vector<MemRow*> outer_batch(_outer_tuple_data.begin() + begin, 
+                                     _outer_tuple_data.begin() + end);
+    _outer_join_values.clear();
+    _save_join_value(outer_batch, _outer_equal_slot);
+    int ret = 0;
+    if (_batch_in_expr == nullptr) {
+        std::vector<ExprNode*> in_exprs;
+        ret = _construct_in_condition(_inner_equal_slot, _outer_join_values, in_exprs);
+        if (ret < 0 || in_exprs.size() != 1) {
+            DB_WARNING("create in condition for inner table fail");
+            return -1;
+        }
+        _batch_in_expr = in_exprs[0];
+        _inner_node->predicate_pushdown(in_exprs);
+        if (in_exprs.size() > 0) {
+            _inner_node->add_filter_node(in_exprs);
+        }
+        _inner_node->create_trace();
+    } else {
+        ret = _reset_in_values(_batch_in_expr, _outer_join_values);
+        if (ret < 0) {
+            DB_WARNING("reset in condition for inner table fail");
+            return ret;
+        }
+    }
+    _reselect_inner_index(state);
+    ret = _inner_node->open(state);
+    if (ret < 0) {
+        DB_WARNING("inner table open fail");
+        _inner_node->close(state);
+        return ret;
+    }
+    ret = _fetcher_join_table(state, _inner_node, tuple_data);
+    _inner_node->close(state);
+    if (ret < 0) {
+        DB_WARNING("fetcher inner node fail");
+        return ret;
+    }
+    DB_WARNING("join fetch inner batch, outer rows:[%lu, %lu), inner rows:%lu, time_cost:%ld, "
+            "log_id:%lu", begin, end, tuple_data.size(), cost.get_time(), state->log_id());
+    return 0;
+}
+
+//用新的值替换已下推的in条件中的常量，in条件的第0个孩子是slot_ref或row_expr
+int JoinNode::_reset_in_values(ExprNode* in_expr, std::vector<std::vector<ExprValue>>& in_values) {
+    std::vector<ExprNode*> in_exprs;
+    auto ret = _construct_in_condition(_inner_equal_slot, in_values, in_exprs);
+    if (ret < 0 || in_exprs.size() != 1) {
+        return -1;
+    }
+    ExprNode* new_expr = in_exprs[0];
+    while (in_expr->children_size() > 1) {
+        ExprNode::destroy_tree(in_expr->children(1));
+        in_expr->del_child(1);
+    }
+    while (new_expr->children_size() > 1) {
+        in_expr->add_child(new_expr->children(1));
+        new_expr->del_child(1);
+    }
+    ExprNode::destroy_tree(new_expr);
+    in_expr->type_inferer();
+    return 0;
+}
+
+void JoinNode::_prefetch_inner_batch(RuntimeState* state) {
+    size_t begin = _prefetch_end;
+    size_t end = std::min(begin + FLAGS_join_in_batch_size, _outer_tuple_data.size());
+    _prefetch_end = end;
+    if (!FLAGS_join_batch_prefetch) {
+        _prefetch_ret = _fetch_inner_batch(state, begin, end, _prefetch_tuple_data);
+        return;
+    }
+    //预取与当前批的探测并行，内表的open/fetch写子state，join后再合并
+    _prefetch_state.reset(new RuntimeState);
+    if (_prefetch_state->init(state) != 0) {
+        _prefetch_state.reset();
+        _prefetch_ret = -1;
+        return;
+    }
+    RuntimeState* prefetch_state = _prefetch_state.get();
+    auto fetch = [this, prefetch_state, begin, end]() {
+        _prefetch_ret = _fetch_inner_batch(prefetch_state, begin, end, _prefetch_tuple_data);
+    };
+    _is_prefetching = true;
+    _prefetch_bth.run(fetch);
+}
+
+void JoinNode::_join_prefetch(RuntimeState* state) {
+    if (!_is_prefetching) {
+        return;
+    }
+    if (state->is_cancelled()) {
+        _prefetch_state->cancel();
+    }
+    _prefetch_bth.join();
+    _is_prefetching = false;
+    state->merge_sub_state(_prefetch_state.get());
+    _prefetch_state.reset();
+}
+
+//切换到已取回的下一批内表数据，并开始预取再下一批
+int JoinNode::_next_join_batch(RuntimeState* state) {
+    _join_prefetch(state);
+    if (_prefetch_ret < 0) {
+        DB_WARNING("prefetch inner batch fail");
+        return _prefetch_ret;
+    }
+    for (auto& mem_row : _inner_tuple_data) {
+        delete mem_row;
+    }
+    _inner_tuple_data.clear();
+    _inner_tuple_data.swap(_prefetch_tuple_data);
+    _clear_hash_map();
+    _construct_hash_map(_inner_tuple_data, _inner_equal_slot);
+    _outer_iter = _outer_tuple_data.begin() + _batch_end;
+    _batch_end = _prefetch_end;
+    _hash_mapped_index = 0;
+    if (_prefetch_end < _outer_tuple_data.size()) {
+        _prefetch_inner_batch(state);
+    }
+    return 0;
+}
+
+int JoinNode::get_next_for_batch_join(RuntimeState* state, RowBatch* batch, bool* eos) {
+    while (1) {
+        if (_outer_iter == _outer_tuple_data.begin() + _batch_end) {
+            if (_batch_end >= _outer_tuple_data.size()) {
+                *eos = true;
+                return 0;
+            }
+            auto ret = _next_join_batch(state);
+            if (ret < 0) {
+                return ret;
+            }
+            continue;
+        }
+        auto inner_mem_rows = _seek_hash_map(*_outer_iter, _outer_equal_slot);
+        if (inner_mem_rows != NULL) {
+            for (; _hash_mapped_index < inner_mem_rows->size(); ++_hash_mapped_index) {
+                if (reached_limit()) {
+                    *eos = true;
+                    return 0;
+                }
+                if (batch->is_full()) {
+                    return 0;
+                }
+                auto ret = _construct_result_batch(batch,
+                                                   *_outer_iter,
+                                                   (*inner_mem_rows)[_hash_mapped_index],
+                                                   _join_type == pb::INNER_JOIN);
+                if (ret < 0) {
+                    DB_WARNING("construct result batch fail");
+                    return ret;
+                }
+                ++_num_rows_returned;
+            }
+        } else if (_join_type != pb::INNER_JOIN) {
+            if (reached_limit()) {
+                *eos = true;
+                return 0;
+            }
+            if (batch->is_full()) {
+                return 0;
+            }
+            auto ret = _construct_result_batch(batch, *_outer_iter, NULL, false);
+            if (ret < 0) {
+                DB_WARNING("construct result batch fail");
+                return ret;
+            }
+            ++_num_rows_returned;
+        }
+        _hash_mapped_index = 0;
+        ++_outer_iter;
+    }
+    return 0;
+}
+
 int JoinNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
     if (_outer_table_is_null) {
         *eos = true;
         return 0;
     }
+    if (_use_hash_join) {
+        return get_next_for_hash_join(state, batch, eos);
+    }
+    if (_use_batch_join) {
+        return get_next_for_batch_join(state, batch, eos);
+    }
     if (_join_type == pb::INNER_JOIN) {
         return get_next_for_inner_join(state, batch, eos);
     } else {
@@ -563,9 +1225,7 @@ int JoinNode::get_next_for_other_join(RuntimeState* state, RowBatch* batch, bool
             *eos = true;
             return 0;
         }
-        MutTableKey outer_key;
-        _encode_hash_key(*_outer_iter, _outer_equal_slot, outer_key);
-        auto inner_mem_rows = _hash_map.seek(outer_key.data());
+        auto inner_mem_rows = _seek_hash_map(*_outer_iter, _outer_equal_slot);
         if (inner_mem_rows != NULL) {
             for (; _hash_mapped_index < inner_mem_rows->size(); ++_hash_mapped_index) {
                 if (reached_limit()) {
@@ -635,9 +1295,7 @@ int JoinNode::get_next_for_inner_join(RuntimeState* state, RowBatch* batch, bool
             }
         }
         std::unique_ptr<MemRow>& inner_mem_row = _inner_row_batch.get_row();
-        MutTableKey inner_key;
-        _encode_hash_key(inner_mem_row.get(), _inner_equal_slot, inner_key);
-        auto outer_mem_rows = _hash_map.seek(inner_key.data());
+        auto outer_mem_rows = _seek_hash_map(inner_mem_row.get(), _inner_equal_slot);
         if (outer_mem_rows != NULL) {
             for (; _hash_mapped_index < outer_mem_rows->size(); ++_hash_mapped_index) {
                 if (reached_limit()) {
@@ -668,6 +1326,62 @@ int JoinNode::get_next_for_inner_join(RuntimeState* state, RowBatch* batch, bool
     }
     return 0;
 }
+int JoinNode::get_next_for_hash_join(RuntimeState* state, RowBatch* batch, bool* eos) {
+    while (1) {
+        if (_probe_batch.is_traverse_over()) {
+            auto ret = _fetch_probe_batch(state);
+            if (ret < 0) {
+                DB_WARNING("fetch probe batch fail");
+                return ret;
+            }
+            if (_probe_batch.size() == 0 && _probe_eos) {
+                *eos = true;
+                return 0;
+            }
+            continue;
+        }
+        MemRow* probe_mem_row = _probe_batch.get_row().get();
+        auto build_mem_rows = _seek_hash_map(probe_mem_row, *_probe_equal_slot);
+        if (build_mem_rows != NULL) {
+            for (; _hash_mapped_index < build_mem_rows->size(); ++_hash_mapped_index) {
+                if (reached_limit()) {
+                    *eos = true;
+                    return 0;
+                }
+                if (batch->is_full()) {
+                    return 0;
+                }
+                MemRow* build_mem_row = (*build_mem_rows)[_hash_mapped_index];
+                auto ret = _construct_result_batch(batch, probe_mem_row, build_mem_row, 
+                        _join_type == pb::INNER_JOIN);
+                if (ret < 0) {
+                    DB_WARNING("construct result batch fail");
+                    return ret;
+                }
+                ++_num_rows_returned;
+            }
+        } else if (_join_type != pb::INNER_JOIN) {
+            //探测侧是驱动表，外连接没匹配上补NULL
+            if (reached_limit()) {
+                *eos = true;
+                return 0;
+            }
+            if (batch->is_full()) {
+                return 0;
+            }
+            auto ret = _construct_result_batch(batch, probe_mem_row, NULL, false);
+            if (ret < 0) {
+                DB_WARNING("construct result batch fail");
+                return ret;
+            }
+            ++_num_rows_returned;
+        }
+        _hash_mapped_index = 0;
+        _probe_batch.next();
+    }
+    return 0;
+}
+
 inline bool JoinNode::_satisfy_filter(MemRow* row) {
     for (auto& condition : _conditions) {
         ExprValue value = condition->get_value(row);
@@ -726,6 +1440,8 @@ int JoinNode:: _construct_null_result_batch(RowBatch* batch, MemRow* outer_mem_r
 }
 
 void JoinNode::close(RuntimeState* state) {
+    //预取线程还在访问内表，需要先等它结束
+    _join_prefetch(state);
     ExecNode::close(state);
     _have_removed.clear();
     _outer_join_values.clear();
@@ -740,8 +1456,30 @@ void JoinNode::close(RuntimeState* state) {
         delete mem_row;
     }
     _inner_tuple_data.clear();
-    _hash_map.clear();
+    _clear_hash_map();
+    _fixed_key_words = 0;
     _hash_mapped_index = 0;
+    state->release_memory(_build_bytes);
+    _build_bytes = 0;
+    _use_hash_join = false;
+    _probe_node = nullptr;
+    _probe_batch.clear();
+    _probe_eos = false;
+    _pending_probe_idx = 0;
+    _build_partitions.clear();
+    _probe_partitions.clear();
+    _partition_levels.clear();
+    _probe_reader = nullptr;
+    _partition_idx = 0;
+    for (auto& mem_row : _prefetch_tuple_data) {
+        delete mem_row;
+    }
+    _prefetch_tuple_data.clear();
+    _use_batch_join = false;
+    _batch_end = 0;
+    _batch_in_expr = nullptr;
+    _prefetch_ret = 0;
+    _prefetch_end = 0;
     _outer_table_is_null = false;
     _inner_row_batch.clear();
     _child_eos = false;
@@ -16,9 +16,14 @@
 #include "full_export_node.h"
 #include "runtime_state.h"
 #include "network_socket.h"
+#include "query_context.h"
 
 namespace baikaldb {
 DEFINE_int32(expect_bucket_count, 100, "expect_bucket_count");
+DEFINE_int64(packet_stream_watermark, 4 * 1024 * 1024LL,
+        "send result to client when send buf exceeds this size, 0 means send after query finished");
+DEFINE_int64(packet_stream_timeout_us, 600 * 1000 * 1000LL, "max wait time for client socket writable");
+DECLARE_bool(use_column_batch);
 int PacketNode::init(const pb::PlanNode& node) {
     int ret = 0;
     ret = ExecNode::init(node);
@@ -267,9 +272,20 @@ int PacketNode::open(RuntimeState* state) {
     if (state->is_full_export) {
         return 0;
     }
+    // 只有结果直接写给客户端时才边执行边发送
+    _streaming = FLAGS_packet_stream_watermark > 0 && _client != nullptr
+            && _client->send_buf == _send_buf;
 
     bool eos = false;
     int64_t pack_time = 0;
+    if (FLAGS_use_column_batch && !_children.empty()) {
+        ret = open_column(state);
+        if (ret < 0) {
+            return ret;
+        }
+        pack_eof();
+        return 0;
+    }
     do {
         if (_children.empty()) {
             break;
@@ -296,12 +312,85 @@ int PacketNode::open(RuntimeState* state) {
                 return ret;
             }
         }
+        ret = stream_send(state);
+        if (ret < 0) {
+            return ret;
+        }
     } while (!eos);
     //DB_WARNING("txn_id: %lu, pack_time: %ld", state->txn_id, pack_time);
     pack_eof();
     return 0;
 }
 
+int PacketNode::open_column(RuntimeState* state) {
+    ColumnBatch batch;
+    int ret = batch.init(state->tuple_descs());
+    if (ret < 0) {
+        DB_WARNING("column_batch init fail:%d", ret);
+        return ret;
+    }
+    bool all_slot_ref = !_binary_protocol;
+    for (auto expr : _projections) {
+        if (!expr->is_slot_ref()) {
+            all_slot_ref = false;
+        }
+    }
+    std::unique_ptr<MemRow> row;
+    if (!all_slot_ref) {
+        row = state->mem_row_desc()->fetch_mem_row();
+    }
+    bool eos = false;
+    do {
+        batch.clear();
+        ret = _children[0]->get_next_column(state, &batch, &eos);
+        if (ret < 0) {
+            DB_WARNING("children:get_next_column fail:%d", ret);
+            return ret;
+        }
+        size_t selected = batch.selected_size();
+        for (size_t i = 0; i < selected; i++) {
+            size_t idx = batch.selected_idx(i);
+            if (all_slot_ref) {
+                ret = pack_text_row(&batch, idx);
+            } else {
+                batch.fill_row(idx, row.get());
+                if (_binary_protocol) {
+                    ret = pack_binary_row(row.get());
+                } else {
+                    ret = pack_text_row(row.get());
+                }
+            }
+            state->inc_num_returned_rows(1);
+            if (ret < 0) {
+                DB_WARNING("pack_row fail:%d", ret);
+                return ret;
+            }
+        }
+        ret = stream_send(state);
+        if (ret < 0) {
+            return ret;
+        }
+    } while (!eos);
+    return 0;
+}
+
+// send_buf超过水位时把已打包的行先发给客户端，内存占用不再随结果集增长
+// 客户端接收慢时当前bthread挂起在EPOLLOUT上，可写后继续执行
+int PacketNode::stream_send(RuntimeState* state) {
+    if (!_streaming || (int64_t)_send_buf->_size < FLAGS_packet_stream_watermark) {
+        return 0;
+    }
+    _client->query_ctx->stat_info.send_buf_size += _send_buf->_size;
+    int ret = _wrapper->blocking_write(_client, FLAGS_packet_stream_timeout_us);
+    if (ret != RET_SUCCESS) {
+        DB_WARNING("stream send fail, ret:%d, fd:%d", ret, _client->fd);
+        state->error_code = ER_NET_ERROR_ON_WRITE;
+        state->error_msg << "send result to client failed";
+        return -1;
+    }
+    return 0;
+}
+
 int PacketNode::open_trace(RuntimeState* state) {
     bool eos = false;
     int ret = 0;
@@ -661,13 +750,7 @@ int PacketNode::pack_vector_row(const std::vector<std::string>& row) {
 
 int PacketNode::pack_text_row(MemRow* row) {
     int start_pos = _send_buf->_size;
-    uint8_t bytes[4];
-    bytes[0] = '\x01';
-    bytes[1] = '\x00';
-    bytes[2] = '\x00';
-    bytes[3] = (++_client->packet_id) & 0xFF;
-    if (!_send_buf->byte_array_append_len(bytes, 4)) {
-        DB_FATAL("Failed to append len. value:[%s], len:[1]", bytes);
+    if (pack_text_row_head() < 0) {
         return -1;
     }
 
@@ -678,6 +761,39 @@ int PacketNode::pack_text_row(MemRow* row) {
             return -1;
         }
     }
+    return pack_text_row_len(start_pos);
+}
+
+// 投影全是slot ref时直接读列，不需要转MemRow
+int PacketNode::pack_text_row(ColumnBatch* batch, size_t idx) {
+    int start_pos = _send_buf->_size;
+    if (pack_text_row_head() < 0) {
+        return -1;
+    }
+    for (auto expr : _projections) {
+        ExprValue value = batch->get_value(idx, expr->tuple_id(), expr->slot_id());
+        if (!_send_buf->append_text_value(value.cast_to(expr->col_type()))) {
+            DB_FATAL("Failed to append table cell.");
+            return -1;
+        }
+    }
+    return pack_text_row_len(start_pos);
+}
+
+int PacketNode::pack_text_row_head() {
+    uint8_t bytes[4];
+    bytes[0] = '\x01';
+    bytes[1] = '\x00';
+    bytes[2] = '\x00';
+    bytes[3] = (++_client->packet_id) & 0xFF;
+    if (!_send_buf->byte_array_append_len(bytes, 4)) {
+        DB_FATAL("Failed to append len. value:[%s], len:[1]", bytes);
+        return -1;
+    }
+    return 0;
+}
+
+int PacketNode::pack_text_row_len(int start_pos) {
     uint32_t packet_body_len = _send_buf->_size - start_pos - 4;
     while (packet_body_len >= PACKET_LEN_MAX) {
         _send_buf->_data[start_pos] = PACKET_LEN_MAX & 0xff;
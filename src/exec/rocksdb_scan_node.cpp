@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <map>
 #include "rocksdb_scan_node.h"
 #include "filter_node.h"
@@ -23,6 +24,11 @@
 #include "parser.h"
 
 namespace baikaldb {
+DEFINE_int32(parallel_scan_concurrency, 4, "max sub ranges for parallel primary scan, <=1 means disable");
+DEFINE_int64(parallel_scan_min_bytes, 256 * 1024 * 1024LL,
+        "primary scan range smaller than this approximate size is not split");
+DEFINE_int32(multi_get_batch_size, 128, "max keys for one batched point lookup, 1 means get one by one");
+DEFINE_int32(parallel_scan_queue_chunks, 4, "max buffered row chunks for each parallel sub range");
 // TODO 临时代码，后面删除
 // 为了baikalStore能兼容老的baikaldb
 int RocksdbScanNode::select_index_for_store() {
@@ -537,9 +543,19 @@ int RocksdbScanNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
     ON_SCOPE_EXIT(([this, state]() {
         state->set_num_scan_rows(_scan_rows);
     }));
+    ScanCacheStat cache_stat(state->scan_class);
     if (_index_id == _table_id) {
         if (_use_get) {
             return get_next_by_table_get(state, batch, eos);
+        }
+        if (!_parallel_checked) {
+            _parallel_checked = true;
+            if (open_parallel_scan(state) < 0) {
+                return -1;
+            }
+        }
+        if (!_parallel_ranges.empty()) {
+            return get_next_by_parallel_seek(state, batch, eos);
         } else {
             return get_next_by_table_seek(state, batch, eos);
         }
@@ -553,7 +569,25 @@ int RocksdbScanNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
     return 0;
 }
 
+int RocksdbScanNode::get_next_column(RuntimeState* state, ColumnBatch* batch, bool* eos) {
+    // 二级索引和倒排走get_next再转换
+    if (_is_explain || _index_id != _table_id) {
+        return ExecNode::get_next_column(state, batch, eos);
+    }
+    ON_SCOPE_EXIT(([this, state]() {
+        state->set_num_scan_rows(_scan_rows);
+    }));
+    ScanCacheStat cache_stat(state->scan_class);
+    if (_use_get) {
+        return get_next_by_table_get(state, batch, eos);
+    } else {
+        return get_next_by_table_seek(state, batch, eos);
+    }
+}
+
 void RocksdbScanNode::close(RuntimeState* state) {
+    stop_parallel_scan();
+    _parallel_checked = false;
     ScanNode::close(state);
     for (auto expr : _index_conjuncts) {
         expr->close();
@@ -564,6 +598,7 @@ void RocksdbScanNode::close(RuntimeState* state) {
     _query_words.clear();
     _match_modes.clear();
     _reverse_indexes.clear();
+    _scratch_row.reset();
 }
 
 int RocksdbScanNode::get_next_by_table_get(RuntimeState* state, RowBatch* batch, bool* eos) {
@@ -575,7 +610,8 @@ int RocksdbScanNode::get_next_by_table_get(RuntimeState* state, RowBatch* batch,
         DB_WARNING_STATE(state, "txn is nullptr");
         return -1;
     }
-    SmartRecord record;
+    std::vector<SmartRecord> records;
+    std::vector<int> rets;
     while (1) {
         if (state->is_cancelled()) {
             DB_WARNING_STATE(state, "cancelled");
@@ -592,22 +628,33 @@ int RocksdbScanNode::get_next_by_table_get(RuntimeState* state, RowBatch* batch,
         if (_idx >= _left_records.size()) {
             *eos = true;
             return 0;
-        } else {
-            record = _left_records[_idx++];
         }
-        ++_scan_rows;
-        int ret = txn->get_update_primary(_region_id, *_pri_info, record, _field_ids, GET_ONLY, true);
-        if (ret < 0) {
-            continue;
+        // IN列表等多个主键一次MultiGet，不超过batch和limit的剩余行数
+        size_t num = multi_get_count(batch->capacity() - batch->size(), _left_records.size() - _idx);
+        records.assign(_left_records.begin() + _idx, _left_records.begin() + _idx + num);
+        _idx += num;
+        _scan_rows += num;
+        if (num == 1) {
+            rets.assign(1, txn->get_update_primary(_region_id, *_pri_info, records[0],
+                    _field_ids, GET_ONLY, true));
+        } else if (txn->multi_get_primary(_region_id, *_pri_info, records,
+                _field_ids, true, &rets) != 0) {
+            DB_WARNING_STATE(state, "multi get primary fail, table_id:%ld", _table_id);
+            return -1;
         }
-        std::unique_ptr<MemRow> row = _mem_row_desc->fetch_mem_row();
-        for (auto slot : _tuple_desc->slots()) {
-            auto field = record->get_field_by_tag(slot.field_id());
-            row->set_value(slot.tuple_id(), slot.slot_id(),
-                    record->get_value(field));
+        for (size_t i = 0; i < num; ++i) {
+            if (rets[i] < 0) {
+                continue;
+            }
+            std::unique_ptr<MemRow> row = _mem_row_desc->fetch_mem_row();
+            for (auto slot : _tuple_desc->slots()) {
+                auto field = records[i]->get_field_by_tag(slot.field_id());
+                row->set_value(slot.tuple_id(), slot.slot_id(),
+                        records[i]->get_value(field));
+            }
+            batch->move_row(std::move(row));
+            ++_num_rows_returned;
         }
-        batch->move_row(std::move(row));
-        ++_num_rows_returned;
     }
 }
 
@@ -623,7 +670,8 @@ int RocksdbScanNode::get_next_by_index_get(RuntimeState* state, RowBatch* batch,
         && _region_info->main_table_id() != _region_info->table_id()) {
         is_global_index = true;
     }
-    SmartRecord record;
+    std::vector<SmartRecord> records;
+    std::vector<int> rets;
     while (1) {
         if (state->is_cancelled()) {
             DB_WARNING_STATE(state, "cancelled");
@@ -640,36 +688,56 @@ int RocksdbScanNode::get_next_by_index_get(RuntimeState* state, RowBatch* batch,
         if (_idx >= _left_records.size()) {
             *eos = true;
             return 0;
-        } else {
-            record = _left_records[_idx++];
         }
+        size_t num = multi_get_count(batch->capacity() - batch->size(), _left_records.size() - _idx);
         auto txn = state->txn();
-        ++_scan_rows;
-        int ret = txn->get_update_secondary(_region_id, *_pri_info, *_index_info, record, GET_ONLY, true);
-        if (ret < 0) {
-            //DB_WARNING_STATE(state, "get index:%ld fail, not exist, ret:%d, record: %s", 
-            //        _table_id, ret, record->to_string().c_str());
-            continue;
-        }
-        if (!_is_covering_index && !is_global_index) {
-            ++get_primary_cnt;
-            ret = txn->get_update_primary(_region_id, *_pri_info, record, _field_ids, GET_ONLY, false);
+        records.clear();
+        for (size_t i = 0; i < num; ++i) {
+            SmartRecord record = _left_records[_idx++];
+            ++_scan_rows;
+            int ret = txn->get_update_secondary(_region_id, *_pri_info, *_index_info, record, GET_ONLY, true);
             if (ret < 0) {
+                //DB_WARNING_STATE(state, "get index:%ld fail, not exist, ret:%d, record: %s", 
+                //        _table_id, ret, record->to_string().c_str());
+                continue;
+            }
+            records.push_back(record);
+        }
+        rets.assign(records.size(), 0);
+        // 非覆盖索引回表的主键批量MultiGet
+        if (!_is_covering_index && !is_global_index && !records.empty()) {
+            get_primary_cnt += records.size();
+            if (txn->multi_get_primary(_region_id, *_pri_info, records,
+                    _field_ids, false, &rets) != 0) {
+                DB_WARNING_STATE(state, "multi get primary fail, table_id:%ld", _table_id);
+                return -1;
+            }
+        }
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (rets[i] < 0) {
                 DB_FATAL("get primary:%ld fail, not exist, ret:%d, record: %s", 
-                        _table_id, ret, record->to_string().c_str());
+                        _table_id, rets[i], records[i]->to_string().c_str());
                 continue;
             }
+            std::unique_ptr<MemRow> row = _mem_row_desc->fetch_mem_row();
+            for (auto slot : _tuple_desc->slots()) {
+                auto field = records[i]->get_field_by_tag(slot.field_id());
+                row->set_value(slot.tuple_id(), slot.slot_id(),
+                        records[i]->get_value(field));
+            }
+            batch->move_row(std::move(row));
+            ++_num_rows_returned;
         }
+    }
+}
 
-        std::unique_ptr<MemRow> row = _mem_row_desc->fetch_mem_row();
-        for (auto slot : _tuple_desc->slots()) {
-            auto field = record->get_field_by_tag(slot.field_id());
-            row->set_value(slot.tuple_id(), slot.slot_id(),
-                    record->get_value(field));
-        }
-        batch->move_row(std::move(row));
-        ++_num_rows_returned;
+size_t RocksdbScanNode::multi_get_count(size_t free_rows, size_t remain_keys) {
+    size_t num = std::min(remain_keys, free_rows);
+    if (_limit != -1) {
+        num = std::min(num, (size_t)(_limit - _num_rows_returned));
     }
+    num = std::min(num, (size_t)std::max(FLAGS_multi_get_batch_size, 1));
+    return std::max(num, (size_t)1);
 }
 
 int RocksdbScanNode::get_next_by_table_seek(RuntimeState* state, RowBatch* batch, bool* eos) {
@@ -706,6 +774,7 @@ int RocksdbScanNode::get_next_by_table_seek(RuntimeState* state, RowBatch* batch
                         _left_opens[_idx], 
                         _right_opens[_idx],
                         _like_prefixs[_idx]);
+                range.scan_class = state->scan_class;
                 delete _table_iter;
                 _table_iter = Iterator::scan_primary(
                         state->txn(), range, _field_ids, _field_slot, true, _scan_forward);
@@ -736,6 +805,405 @@ int RocksdbScanNode::get_next_by_table_seek(RuntimeState* state, RowBatch* batch
     }
 }
 
+// 以sst文件边界作为候选点，用GetApproximateSizes把主键范围切成数据量接近的子范围
+// bounds为去掉region_id+index_id前缀的主键，升序；范围太小或没有候选点时为空
+int RocksdbScanNode::split_parallel_bounds(RuntimeState* state, std::vector<std::string>* bounds) {
+    int concurrency = FLAGS_parallel_scan_concurrency;
+    // 显式事务/limit/列存/多个范围都不拆分
+    if (concurrency <= 1 || _left_records.size() != 1 || _like_prefixs[0] || _limit != -1
+            || state->txn_id != 0 || _table_info->engine == pb::ROCKSDB_CSTORE) {
+        return 0;
+    }
+    std::string lower = _region_info->start_key();
+    std::string upper = _region_info->end_key();
+    std::string left_key;
+    if (_left_field_cnts[0] > 0) {
+        MutTableKey key;
+        if (0 != _left_records[0]->encode_key(*_index_info, key, _left_field_cnts[0], false, false)) {
+            return 0;
+        }
+        left_key = key.data();
+        lower = std::max(lower, left_key);
+    }
+    if (_right_field_cnts[0] > 0) {
+        MutTableKey key;
+        if (0 != _right_records[0]->encode_key(*_index_info, key, _right_field_cnts[0], false, false)) {
+            return 0;
+        }
+        if (upper.empty() || key.data() < upper) {
+            upper = key.data();
+        }
+    }
+    RocksWrapper* rocksdb = RocksWrapper::get_instance();
+    rocksdb::ColumnFamilyHandle* data_cf = rocksdb->get_data_handle(_pri_info->id);
+    MutTableKey prefix;
+    prefix.append_i64(_region_id).append_i64(_index_id);
+    std::string start_key = prefix.data() + lower;
+    std::string end_key;
+    if (upper.empty()) {
+        MutTableKey end;
+        end.append_i64(_region_id).append_i64(_index_id + 1);
+        end_key = end.data();
+    } else {
+        end_key = prefix.data() + upper;
+    }
+    if (start_key >= end_key) {
+        return 0;
+    }
+    rocksdb::Slice prefix_slice(prefix.data());
+    std::vector<rocksdb::LiveFileMetaData> metas;
+    rocksdb->get_db()->GetLiveFilesMetaData(&metas);
+    std::vector<std::string> candidates;
+    for (auto& meta : metas) {
+        if (meta.column_family_name != data_cf->GetName()) {
+            continue;
+        }
+        for (auto* key : {&meta.smallestkey, &meta.largestkey}) {
+            if (!rocksdb::Slice(*key).starts_with(prefix_slice)
+                    || key->compare(start_key) <= 0 || key->compare(end_key) >= 0) {
+                continue;
+            }
+            // 左开区间时，以left_key为前缀的key都要跳过，不能作为中间子范围的左边界
+            rocksdb::Slice pure_key(key->data() + prefix_slice.size(), key->size() - prefix_slice.size());
+            if (_left_opens[0] && !left_key.empty() && pure_key.starts_with(left_key)) {
+                continue;
+            }
+            candidates.push_back(*key);
+        }
+    }
+    if (candidates.empty()) {
+        return 0;
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // ranges[0]为整个范围，其余为[start_key, candidate)
+    size_t range_count = candidates.size() + 1;
+    std::vector<rocksdb::Range> ranges(range_count);
+    std::vector<uint64_t> sizes(range_count, 0);
+    ranges[0] = rocksdb::Range(start_key, end_key);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        ranges[i + 1] = rocksdb::Range(start_key, candidates[i]);
+    }
+    rocksdb->get_db()->GetApproximateSizes(data_cf, ranges.data(), range_count,
+            sizes.data(), uint8_t(3));
+    uint64_t total_size = sizes[0];
+    if ((int64_t)total_size < FLAGS_parallel_scan_min_bytes) {
+        return 0;
+    }
+    size_t pos = 1;
+    for (int i = 1; i < concurrency; ++i) {
+        uint64_t target = total_size * i / concurrency;
+        while (pos < range_count && sizes[pos] < target) {
+            ++pos;
+        }
+        if (pos >= range_count) {
+            break;
+        }
+        std::string bound = candidates[pos - 1].substr(prefix_slice.size());
+        if (bounds->empty() || bounds->back() != bound) {
+            bounds->push_back(bound);
+        }
+        ++pos;
+    }
+    DB_WARNING_STATE(state, "parallel scan, total_size: %lu, candidates: %lu, sub ranges: %lu",
+            total_size, candidates.size(), bounds->size() + 1);
+    return 0;
+}
+
+int RocksdbScanNode::open_parallel_scan(RuntimeState* state) {
+    std::vector<std::string> bounds;
+    split_parallel_bounds(state, &bounds);
+    if (bounds.empty()) {
+        return 0;
+    }
+    // 迭代器都在当前bthread里创建，worker只访问各自的迭代器
+    size_t range_num = bounds.size() + 1;
+    for (size_t i = 0; i < range_num; ++i) {
+        bool first = (i == 0);
+        bool last = (i == range_num - 1);
+        // 首尾子范围沿用原始的左右边界，中间边界左闭右开
+        IndexRange range(first ? _left_records[0].get() : nullptr,
+                last ? _right_records[0].get() : nullptr,
+                _index_info.get(),
+                _pri_info.get(),
+                _region_info,
+                first ? _left_field_cnts[0] : 0,
+                last ? _right_field_cnts[0] : 0,
+                first ? _left_opens[0] : false,
+                last ? _right_opens[0] : true,
+                false);
+        TableKey left_key(first ? rocksdb::Slice() : rocksdb::Slice(bounds[i - 1]));
+        TableKey right_key(last ? rocksdb::Slice() : rocksdb::Slice(bounds[i]));
+        if (!first) {
+            range.left_key = &left_key;
+        }
+        if (!last) {
+            range.right_key = &right_key;
+        }
+        range.scan_class = state->scan_class;
+        SmartParallelRange sub_range(new ParallelScanRange);
+        sub_range->iter = Iterator::scan_primary(
+                state->txn(), range, _field_ids, _field_slot, true, _scan_forward);
+        if (sub_range->iter == nullptr) {
+            DB_WARNING_STATE(state, "open TableIterator fail, table_id:%ld", _index_id);
+            _parallel_ranges.clear();
+            return -1;
+        }
+        if (_is_covering_index) {
+            sub_range->iter->set_mode(KEY_ONLY);
+        }
+        _parallel_ranges.push_back(sub_range);
+    }
+    if (!_scan_forward) {
+        std::reverse(_parallel_ranges.begin(), _parallel_ranges.end());
+    }
+    _parallel_stop = false;
+    _parallel_idx = 0;
+    _parallel_rows.clear();
+    _parallel_row_idx = 0;
+    for (auto& sub_range : _parallel_ranges) {
+        ParallelScanRange* range = sub_range.get();
+        _parallel_cond.increase();
+        Bthread bth;
+        bth.run([this, range]() {
+            parallel_scan_worker(range);
+            _parallel_cond.decrease_signal();
+        });
+    }
+    return 0;
+}
+
+void RocksdbScanNode::parallel_scan_worker(ParallelScanRange* range) {
+    bool finished = false;
+    while (!finished && !_parallel_stop.load()) {
+        std::vector<std::unique_ptr<MemRow>> rows;
+        rows.reserve(ROW_BATCH_CAPACITY);
+        while (rows.size() < ROW_BATCH_CAPACITY && range->iter->valid()) {
+            // 多个worker bthread同时取行：descriptor只读，复用的tuple来自当前pthread的
+            // thread_local空闲列表，fetch_mem_row内不会让出，不会中途切换pthread；
+            // 行在消费方析构时回到消费方所在pthread的空闲列表
+            std::unique_ptr<MemRow> row = _mem_row_desc->fetch_mem_row();
+            if (range->iter->get_next(_tuple_id, row) < 0) {
+                continue;
+            }
+            rows.push_back(std::move(row));
+        }
+        finished = !range->iter->valid();
+        bthread_mutex_lock(&range->mutex);
+        // 消费方还没读到这个子范围时限制缓存的行数
+        while (!_parallel_stop.load()
+                && (int)range->chunks.size() >= FLAGS_parallel_scan_queue_chunks) {
+            bthread_cond_wait(&range->cond, &range->mutex);
+        }
+        range->chunks.push_back(std::move(rows));
+        bthread_cond_broadcast(&range->cond);
+        bthread_mutex_unlock(&range->mutex);
+    }
+    bthread_mutex_lock(&range->mutex);
+    range->finished = true;
+    bthread_cond_broadcast(&range->cond);
+    bthread_mutex_unlock(&range->mutex);
+}
+
+void RocksdbScanNode::stop_parallel_scan() {
+    if (_parallel_ranges.empty()) {
+        return;
+    }
+    _parallel_stop = true;
+    for (auto& range : _parallel_ranges) {
+        bthread_mutex_lock(&range->mutex);
+        bthread_cond_broadcast(&range->cond);
+        bthread_mutex_unlock(&range->mutex);
+    }
+    _parallel_cond.wait();
+    _parallel_ranges.clear();
+    _parallel_rows.clear();
+    _parallel_row_idx = 0;
+    _parallel_idx = 0;
+}
+
+int RocksdbScanNode::get_next_by_parallel_seek(RuntimeState* state, RowBatch* batch, bool* eos) {
+    int64_t index_filter_cnt = 0;
+    START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), GET_NEXT_TRACE, ([this, &index_filter_cnt](TraceLocalNode& local_node) {
+        local_node.add_index_filter_rows(index_filter_cnt);
+        local_node.set_scan_rows(_scan_rows);
+    }));
+    while (1) {
+        if (state->is_cancelled()) {
+            DB_WARNING_STATE(state, "cancelled");
+            *eos = true;
+            return 0;
+        }
+        if (reached_limit()) {
+            *eos = true;
+            return 0;
+        }
+        if (batch->is_full()) {
+            return 0;
+        }
+        if (_parallel_row_idx >= _parallel_rows.size()) {
+            if (_parallel_idx >= _parallel_ranges.size()) {
+                *eos = true;
+                return 0;
+            }
+            // 按子范围顺序消费，保证和单迭代器扫描的输出顺序一致
+            ParallelScanRange* range = _parallel_ranges[_parallel_idx].get();
+            _parallel_rows.clear();
+            _parallel_row_idx = 0;
+            bthread_mutex_lock(&range->mutex);
+            while (range->chunks.empty() && !range->finished) {
+                bthread_cond_wait(&range->cond, &range->mutex);
+            }
+            if (!range->chunks.empty()) {
+                _parallel_rows.swap(range->chunks.front());
+                range->chunks.pop_front();
+                bthread_cond_broadcast(&range->cond);
+            } else {
+                ++_parallel_idx;
+            }
+            bthread_mutex_unlock(&range->mutex);
+            continue;
+        }
+        ++_scan_rows;
+        std::unique_ptr<MemRow> row = std::move(_parallel_rows[_parallel_row_idx++]);
+        if (!need_copy(row.get(), _index_conjuncts)) {
+            state->inc_num_filter_rows();
+            ++index_filter_cnt;
+            continue;
+        }
+        batch->move_row(std::move(row));
+        ++_num_rows_returned;
+    }
+}
+
+int RocksdbScanNode::get_next_by_table_get(RuntimeState* state, ColumnBatch* batch, bool* eos) {
+    START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), GET_NEXT_TRACE, ([this](TraceLocalNode& local_node) {
+        local_node.set_scan_rows(_scan_rows);
+    }));
+    auto txn = state->txn();
+    if (txn == nullptr) {
+        DB_WARNING_STATE(state, "txn is nullptr");
+        return -1;
+    }
+    std::vector<SmartRecord> records;
+    std::vector<int> rets;
+    while (1) {
+        if (state->is_cancelled()) {
+            DB_WARNING_STATE(state, "cancelled");
+            *eos = true;
+            return 0;
+        }
+        if (reached_limit()) {
+            *eos = true;
+            return 0;
+        }
+        if (batch->is_full()) {
+            return 0;
+        }
+        if (_idx >= _left_records.size()) {
+            *eos = true;
+            return 0;
+        }
+        size_t num = multi_get_count(batch->capacity() - batch->size(), _left_records.size() - _idx);
+        records.assign(_left_records.begin() + _idx, _left_records.begin() + _idx + num);
+        _idx += num;
+        _scan_rows += num;
+        if (num == 1) {
+            rets.assign(1, txn->get_update_primary(_region_id, *_pri_info, records[0],
+                    _field_ids, GET_ONLY, true));
+        } else if (txn->multi_get_primary(_region_id, *_pri_info, records,
+                _field_ids, true, &rets) != 0) {
+            DB_WARNING_STATE(state, "multi get primary fail, table_id:%ld", _table_id);
+            return -1;
+        }
+        for (size_t i = 0; i < num; ++i) {
+            if (rets[i] < 0) {
+                continue;
+            }
+            size_t idx = batch->add_row();
+            for (auto& slot : _tuple_desc->slots()) {
+                ColumnVector* column = batch->get_column(slot.tuple_id(), slot.slot_id());
+                if (column == nullptr) {
+                    continue;
+                }
+                auto field = records[i]->get_field_by_tag(slot.field_id());
+                column->set_value(idx, records[i]->get_value(field));
+            }
+            ++_num_rows_returned;
+        }
+    }
+}
+
+int RocksdbScanNode::get_next_by_table_seek(RuntimeState* state, ColumnBatch* batch, bool* eos) {
+    int64_t index_filter_cnt = 0;
+    START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), GET_NEXT_TRACE, ([this, &index_filter_cnt](TraceLocalNode& local_node) {
+        local_node.add_index_filter_rows(index_filter_cnt);
+        local_node.set_scan_rows(_scan_rows);
+    }));
+    if (_scratch_row == nullptr) {
+        _scratch_row = _mem_row_desc->fetch_mem_row();
+    }
+    while (1) {
+        if (state->is_cancelled()) {
+            DB_WARNING_STATE(state, "cancelled");
+            *eos = true;
+            return 0;
+        }
+        if (reached_limit()) {
+            *eos = true;
+            return 0;
+        }
+        if (batch->is_full()) {
+            return 0;
+        }
+        if (_table_iter == nullptr || !_table_iter->valid()) {
+            if (_idx >= _left_records.size()) {
+                *eos = true;
+                return 0;
+            } else {
+                IndexRange range(_left_records[_idx].get(), 
+                        _right_records[_idx].get(), 
+                        _index_info.get(),
+                        _pri_info.get(),
+                        _region_info,
+                        _left_field_cnts[_idx], 
+                        _right_field_cnts[_idx], 
+                        _left_opens[_idx], 
+                        _right_opens[_idx],
+                        _like_prefixs[_idx]);
+                range.scan_class = state->scan_class;
+                delete _table_iter;
+                _table_iter = Iterator::scan_primary(
+                        state->txn(), range, _field_ids, _field_slot, true, _scan_forward);
+                if (_table_iter == nullptr) {
+                    DB_WARNING_STATE(state, "open TableIterator fail, table_id:%ld", _index_id);
+                    return -1;
+                }
+                if (_is_covering_index) {
+                    _table_iter->set_mode(KEY_ONLY);
+                }
+                _idx++;
+                continue;
+            }
+        }
+        ++_scan_rows;
+        // 解码只写非null字段，复用前先清空
+        _scratch_row->get_tuple(_tuple_id)->Clear();
+        int ret = _table_iter->get_next(_tuple_id, _scratch_row);
+        if (ret < 0) {
+            continue;
+        }
+        if (!need_copy(_scratch_row.get(), _index_conjuncts)) {
+            state->inc_num_filter_rows();
+            ++index_filter_cnt;
+            continue;
+        }
+        batch->append_tuple(_tuple_id, _scratch_row.get(), batch->add_row());
+        ++_num_rows_returned;
+    }
+}
+
 int RocksdbScanNode::get_next_by_index_seek(RuntimeState* state, RowBatch* batch, bool* eos) {
     int64_t index_filter_cnt = 0;
     int64_t get_primary_cnt = 0;
@@ -752,7 +1220,43 @@ int RocksdbScanNode::get_next_by_index_seek(RuntimeState* state, RowBatch* batch
         is_global_index = true;
     }
     int ret = 0;
+    bool need_get_primary = !_is_covering_index && !is_global_index;
     SmartRecord record = _factory->new_record(_table_id);
+    // 回表的主键攒批后MultiGet，record_pool复用攒批用的record
+    std::vector<SmartRecord> record_pool;
+    std::vector<SmartRecord> pending_records;
+    std::vector<std::unique_ptr<MemRow>> pending_rows;
+    std::vector<int> rets;
+    auto flush_pending = [&]() -> int {
+        if (pending_records.empty()) {
+            return 0;
+        }
+        get_primary_cnt += pending_records.size();
+        if (state->txn()->multi_get_primary(_region_id, *_pri_info, pending_records,
+                _field_ids, false, &rets) != 0) {
+            DB_WARNING_STATE(state, "multi get primary fail, table_id:%ld", _table_id);
+            return -1;
+        }
+        for (size_t i = 0; i < pending_records.size(); ++i) {
+            if (rets[i] < 0) {
+                if (_reverse_indexes.size() == 0 && _reverse_index == nullptr) {
+                    DB_FATAL("get primary:%ld fail, ret:%d, index primary may be not consistency: %s", 
+                            _table_id, rets[i], pending_records[i]->to_string().c_str());
+                }
+                continue;
+            }
+            for (auto slot : _tuple_desc->slots()) {
+                auto field = pending_records[i]->get_field_by_tag(slot.field_id());
+                pending_rows[i]->set_value(slot.tuple_id(), slot.slot_id(),
+                        pending_records[i]->get_value(field));
+            }
+            batch->move_row(std::move(pending_rows[i]));
+            ++_num_rows_returned;
+        }
+        pending_records.clear();
+        pending_rows.clear();
+        return 0;
+    };
     while (1) {
         if (state->is_cancelled()) {
             DB_WARNING_STATE(state, "cancelled");
@@ -769,18 +1273,18 @@ int RocksdbScanNode::get_next_by_index_seek(RuntimeState* state, RowBatch* batch
         if (_reverse_indexes.size() > 0) {
             if (!multi_valid(_storage_type)) {
                 *eos = true; 
-                return 0;
+                return flush_pending();
             }
         } else if (_reverse_index != nullptr) {
             if (!_reverse_index->valid()) {
                 *eos = true;
-                return 0;
+                return flush_pending();
             }
         } else {
             if (_index_iter == nullptr || !_index_iter->valid()) {
                 if (_idx >= _left_records.size()) {
                     *eos = true;
-                    return 0;
+                    return flush_pending();
                 } else {
                     IndexRange range(_left_records[_idx].get(), 
                             _right_records[_idx].get(), 
@@ -792,6 +1296,7 @@ int RocksdbScanNode::get_next_by_index_seek(RuntimeState* state, RowBatch* batch
                             _left_opens[_idx], 
                             _right_opens[_idx],
                             _like_prefixs[_idx]);
+                    range.scan_class = state->scan_class;
                     delete _index_iter;
                     _index_iter = Iterator::scan_secondary(state->txn(), range, _field_slot, true, _scan_forward);
                     if (_index_iter == nullptr) {
@@ -805,7 +1310,11 @@ int RocksdbScanNode::get_next_by_index_seek(RuntimeState* state, RowBatch* batch
         }
         //TimeCost cost;
         ++_scan_rows;
-        if (!_is_covering_index && !is_global_index) {
+        if (need_get_primary) {
+            if (pending_records.size() >= record_pool.size()) {
+                record_pool.push_back(_factory->new_record(_table_id));
+            }
+            record = record_pool[pending_records.size()];
             record->clear();
         }
         std::unique_ptr<MemRow> row = _mem_row_desc->fetch_mem_row();
@@ -836,7 +1345,7 @@ int RocksdbScanNode::get_next_by_index_seek(RuntimeState* state, RowBatch* batch
         // 倒排索引直接下推到了布尔引擎，但是主键条件未下推，因此也需要再次过滤
         // toto: 后续可以再次优化，把userid和source的条件干掉
         // 索引谓词过滤
-        if (!_is_covering_index && !is_global_index) {
+        if (need_get_primary) {
             for (auto& pair : _index_slot_field_map) {
                 auto field = record->get_field_by_tag(pair.second);
                 row->set_value(_tuple_id, pair.first, record->get_value(field));
@@ -850,22 +1359,16 @@ int RocksdbScanNode::get_next_by_index_seek(RuntimeState* state, RowBatch* batch
         }
         //DB_NOTICE("get index: %ld", cost.get_time());
         //cost.reset();
-        if (!_is_covering_index && !is_global_index) {
-            ++get_primary_cnt;
-            auto txn = state->txn();
-            ret = txn->get_update_primary(_region_id, *_pri_info, record, _field_ids, GET_ONLY, false);
-            if (ret < 0) {
-                if (_reverse_indexes.size() == 0 && _reverse_index == nullptr) {
-                    DB_FATAL("get primary:%ld fail, ret:%d, index primary may be not consistency: %s", 
-                            _table_id, ret, record->to_string().c_str());
+        if (need_get_primary) {
+            pending_records.push_back(record);
+            pending_rows.push_back(std::move(row));
+            if (pending_records.size() >= multi_get_count(batch->capacity() - batch->size(), SIZE_MAX)) {
+                ret = flush_pending();
+                if (ret < 0) {
+                    return ret;
                 }
-                continue;
-            }
-            for (auto slot : _tuple_desc->slots()) {
-                auto field = record->get_field_by_tag(slot.field_id());
-                row->set_value(slot.tuple_id(), slot.slot_id(),
-                        record->get_value(field));
             }
+            continue;
         }
         batch->move_row(std::move(row));
         ++_num_rows_returned;
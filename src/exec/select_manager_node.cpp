@@ -18,6 +18,8 @@
 #include "rocksdb_scan_node.h"
 
 namespace baikaldb {
+DECLARE_bool(use_column_batch);
+
 int SelectManagerNode::open(RuntimeState* state) {
     START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), OPEN_TRACE, ([state](TraceLocalNode& local_node) {
         local_node.set_scan_rows(state->num_scan_rows());
@@ -50,8 +52,14 @@ int SelectManagerNode::open(RuntimeState* state) {
     int64_t main_table_id = scan_node->table_id();
     //如果命中的不是全局二级索引，或者全局二级索引是covering_index, 则直接在主表或者索引表上做scan即可
     if (router_index_id == main_table_id || scan_node->covering_index()) {
+        _stream_select = _slot_order_exprs.empty();
+        _fetcher_store.stream_select = _stream_select;
+        _fetcher_store.column_result = _stream_select && FLAGS_use_column_batch;
         ret = _fetcher_store.run(state, _region_infos, _children[0], client_conn->seq_id, pb::OP_SELECT);
     } else {
+        _stream_select = false;
+        _fetcher_store.stream_select = false;
+        _fetcher_store.column_result = false;
         ret = open_global_index(state, scan_node, router_index_id, main_table_id);
     } 
     if (ret < 0) {
@@ -59,6 +67,11 @@ int SelectManagerNode::open(RuntimeState* state) {
                 state->txn_id, state->log_id());
         return ret;
     }
+    if (_stream_select) {
+        _cur_region_id = -1;
+        _cur_batch = nullptr;
+        return _fetcher_store.affected_rows.load();
+    }
     for (auto& pair : _fetcher_store.start_key_sort) {
         auto& batch = _fetcher_store.region_batch[pair.second];
         if (batch != NULL && batch->size() != 0) {
@@ -85,7 +98,11 @@ int SelectManagerNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos)
         return 0;
     }
     int ret = 0;
-    ret = _sorter->get_next(batch, eos);
+    if (_stream_select) {
+        ret = get_next_stream(state, batch, eos);
+    } else {
+        ret = _sorter->get_next(batch, eos);
+    }
     if (ret < 0) {
         DB_WARNING("sort get_next fail");
         return ret;
@@ -99,6 +116,115 @@ int SelectManagerNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos)
     return 0;
 }
 
+int SelectManagerNode::get_next_stream(RuntimeState* state, RowBatch* batch, bool* eos) {
+    while (!batch->is_full()) {
+        if (_cur_columnar_rows != nullptr) {
+            // 上层按行读取时在这里解码列存页
+            int ret = _fetcher_store.decode_columnar_rows(state, *_cur_columnar_rows, _cur_batch.get());
+            _cur_columnar_rows = nullptr;
+            if (ret < 0) {
+                DB_WARNING("decode columnar rows fail, log_id:%lu", state->log_id());
+                return ret;
+            }
+            _cur_batch->reset();
+            continue;
+        }
+        if (_cur_batch != nullptr && !_cur_batch->is_traverse_over()) {
+            batch->move_row(std::move(_cur_batch->get_row()));
+            _cur_batch->next();
+            continue;
+        }
+        int ret = next_page(state);
+        if (ret < 0) {
+            return ret;
+        }
+        if (ret > 0) {
+            *eos = true;
+            return 0;
+        }
+    }
+    return 0;
+}
+
+int SelectManagerNode::get_next_column(RuntimeState* state, ColumnBatch* batch, bool* eos) {
+    if (!_fetcher_store.column_result) {
+        return ExecNode::get_next_column(state, batch, eos);
+    }
+    if (state->is_cancelled()) {
+        DB_WARNING_STATE(state, "cancelled");
+        *eos = true;
+        return 0;
+    }
+    if (reached_limit()) {
+        *eos = true;
+        return 0;
+    }
+    // 列存页直接解码到上层的batch，不经过MemRow
+    batch->clear();
+    while (batch->size() == 0) {
+        if (_cur_columnar_rows != nullptr) {
+            int ret = batch->from_pb(*_cur_columnar_rows);
+            _cur_columnar_rows = nullptr;
+            if (ret < 0) {
+                DB_WARNING("decode columnar rows fail, log_id:%lu", state->log_id());
+                return ret;
+            }
+            continue;
+        }
+        if (_cur_batch != nullptr && !_cur_batch->is_traverse_over()) {
+            // store没有按列存返回
+            int ret = batch->append_row_batch(*_cur_batch);
+            _cur_batch = nullptr;
+            if (ret < 0) {
+                return ret;
+            }
+            continue;
+        }
+        int ret = next_page(state);
+        if (ret < 0) {
+            return ret;
+        }
+        if (ret > 0) {
+            *eos = true;
+            break;
+        }
+    }
+    _num_rows_returned += batch->selected_size();
+    if (reached_limit()) {
+        batch->keep_first_rows(batch->selected_size() - (_num_rows_returned - _limit));
+        _num_rows_returned = _limit;
+        *eos = true;
+    }
+    return 0;
+}
+
+int SelectManagerNode::next_page(RuntimeState* state) {
+    if (_fetcher_store.has_more_pages(_cur_region_id)) {
+        _cur_batch = std::make_shared<RowBatch>();
+        int ret = _fetcher_store.fetch_next_page(state, _cur_region_id, _cur_batch.get(),
+                &_cur_columnar_rows);
+        if (ret < 0) {
+            DB_WARNING("fetch next page fail, region_id:%ld, log_id:%lu", 
+                    _cur_region_id, state->log_id());
+        }
+        return ret;
+    }
+    //取走下一个region的第一页，读完即可释放
+    int ret = _fetcher_store.next_stream_region(state, &_cur_region_id, &_cur_batch,
+            &_cur_columnar_rows);
+    if (ret < 0) {
+        DB_WARNING("open next region fail, log_id:%lu", state->log_id());
+        return ret;
+    }
+    if (ret == 0) {
+        if (_cur_batch == nullptr) {
+            _cur_batch = std::make_shared<RowBatch>();
+        }
+        _cur_batch->reset();
+    }
+    return ret;
+}
+
 int SelectManagerNode::open_global_index(RuntimeState* state, ExecNode* exec_node, 
         int64_t global_index_id, int64_t main_table_id) {
     RocksdbScanNode* scan_node = static_cast<RocksdbScanNode*>(exec_node);
@@ -16,6 +16,12 @@
 #include "sort_node.h"
 
 namespace baikaldb {
+DECLARE_int64(topn_max_limit);
+}
+
+namespace baikaldb {
+DECLARE_bool(use_column_batch);
+
 int SortNode::init(const pb::PlanNode& node) {
     int ret = 0;
     ret = ExecNode::init(node);
@@ -117,7 +123,12 @@ int SortNode::expr_optimize(std::vector<pb::TupleDescriptor>* tuple_descs) {
 }
 
 int SortNode::open(RuntimeState* state) {
-    START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), OPEN_TRACE, nullptr);
+    START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), OPEN_TRACE, ([this](TraceLocalNode& local_node) {
+        if (_sorter != nullptr) {
+            local_node.set_spill_bytes(_sorter->spill_bytes());
+            local_node.set_spill_runs(_sorter->spill_runs());
+        }
+    }));
     int ret = 0;
     ret = ExecNode::open(state);
     if (ret < 0) {
@@ -145,17 +156,40 @@ int SortNode::open(RuntimeState* state) {
     _mem_row_desc = state->mem_row_desc();
     _mem_row_compare = std::make_shared<MemRowCompare>(
             _slot_order_exprs, _is_asc, _is_null_first);
-    _sorter = std::make_shared<Sorter>(_mem_row_compare.get());
+    // 有limit时只需要前limit行，用堆代替全排序
+    if (_limit > 0 && _limit <= FLAGS_topn_max_limit && !_mem_row_compare->need_not_compare()) {
+        _topn_sorter = std::make_shared<TopNSorter>(_mem_row_compare.get(), _limit);
+    } else {
+        _sorter = std::make_shared<Sorter>(_mem_row_compare.get());
+        _sorter->enable_spill(state, _mem_row_desc);
+    }
 
     bool eos = false;
     int count = 0;
+    ColumnBatch column_batch;
+    if (FLAGS_use_column_batch) {
+        ret = column_batch.init(state->tuple_descs());
+        if (ret < 0) {
+            DB_WARNING_STATE(state, "column_batch init fail, ret:%d", ret);
+            return ret;
+        }
+    }
     do {
         if (state->is_cancelled()) {
             DB_WARNING_STATE(state, "cancelled");
             return 0;
         }
         std::shared_ptr<RowBatch> batch = std::make_shared<RowBatch>();
-        ret = _children[0]->get_next(state, batch.get(), &eos);
+        if (FLAGS_use_column_batch) {
+            // sorter按行排序，列存batch在这里转回MemRow
+            column_batch.clear();
+            ret = _children[0]->get_next_column(state, &column_batch, &eos);
+            if (ret == 0) {
+                ret = column_batch.to_row_batch(_mem_row_desc, batch.get());
+            }
+        } else {
+            ret = _children[0]->get_next(state, batch.get(), &eos);
+        }
         if (ret < 0) {
             DB_WARNING_STATE(state, "child->get_next fail, ret:%d", ret);
             return ret;
@@ -166,18 +200,40 @@ int SortNode::open(RuntimeState* state) {
         }
         count += batch->size();
         fill_tuple(batch.get());
-        _sorter->add_batch(batch);
+        if (_topn_sorter != nullptr) {
+            _topn_sorter->add_batch(batch.get());
+            continue;
+        }
+        ret = _sorter->add_batch(batch);
+        if (ret < 0) {
+            DB_WARNING_STATE(state, "sorter add_batch fail, ret:%d", ret);
+            return ret;
+        }
     } while (!eos);
     //DB_WARNING_STATE(state, "sort_size:%d", count);
     TimeCost sort_time;
-    _sorter->sort();
-    LOCAL_TRACE_DESC <<  "sort time cost:" << sort_time.get_time() << " rows:" << count;  
+    if (_topn_sorter != nullptr) {
+        _topn_sorter->sort();
+        LOCAL_TRACE_DESC <<  "topn sort time cost:" << sort_time.get_time() << " rows:" << count
+            << " limit:" << _limit << " discard_rows:" << _topn_sorter->discard_rows();
+        return 0;
+    }
+    ret = _sorter->sort();
+    if (ret < 0) {
+        DB_WARNING_STATE(state, "sorter sort fail, ret:%d", ret);
+        return ret;
+    }
+    LOCAL_TRACE_DESC <<  "sort time cost:" << sort_time.get_time() << " rows:" << count
+        << " spill_runs:" << _sorter->spill_runs() << " spill_bytes:" << _sorter->spill_bytes();
     return 0;
 }
 
 int SortNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
     START_LOCAL_TRACE(get_trace(), state->get_trace_cost(), GET_NEXT_TRACE, ([this](TraceLocalNode& local_node) {
         local_node.set_affect_rows(_num_rows_returned);
+        if (_sorter != nullptr && _sorter->spill_runs() > 0) {
+            local_node.set_merge_time(_sorter->merge_time());
+        }
     }));
     
     if (state->is_cancelled()) {
@@ -193,6 +249,8 @@ int SortNode::get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
     TimeCost cost;
     if (state->sort_use_index()) {
         ret = _children[0]->get_next(state, batch, eos);
+    } else if (_topn_sorter != nullptr) {
+        ret = _topn_sorter->get_next(batch, eos);
     } else {
         ret = _sorter->get_next(batch, eos);
     }
@@ -219,6 +277,7 @@ void SortNode::close(RuntimeState* state) {
         expr->close();
     }
     _sorter = nullptr;
+    _topn_sorter = nullptr;
 }
 
 int SortNode::fill_tuple(RowBatch* batch) {
@@ -39,8 +39,9 @@ int TruncateNode::open(RuntimeState* state) {
         DB_WARNING_STATE(state, "get rocksdb instance failed");
         return -1;
     }
-    rocksdb::ColumnFamilyHandle* _data_cf = _db->get_data_handle();
-    if (_data_cf == nullptr) {
+    // 表可能被路由到独立的数据column family，按region范围清理所有数据cf
+    std::vector<rocksdb::ColumnFamilyHandle*> data_cfs = _db->get_data_handles();
+    if (data_cfs.empty()) {
         DB_WARNING_STATE(state, "get rocksdb data column family failed");
         return -1;
     }
@@ -56,14 +57,16 @@ int TruncateNode::open(RuntimeState* state) {
 
     rocksdb::Slice begin(region_start.data());
     rocksdb::Slice end(region_end.data());
-    auto res = _db->remove_range(write_options, _data_cf, begin, end);
-    if (!res.ok()) {
-        DB_WARNING_STATE(state, "truncate table failed: table:%ld, region:%ld, code=%d, msg=%s", 
-            _table_id, _region_id, res.code(), res.ToString().c_str());
-        return -1;
+    for (auto data_cf : data_cfs) {
+        auto res = _db->remove_range(write_options, data_cf, begin, end);
+        if (!res.ok()) {
+            DB_WARNING_STATE(state, "truncate table failed: table:%ld, region:%ld, code=%d, msg=%s", 
+                _table_id, _region_id, res.code(), res.ToString().c_str());
+            return -1;
+        }
     }
     /*
-    res = _db->compact_range(rocksdb::CompactRangeOptions(), _data_cf, &begin, &end);
+    res = _db->compact_range(rocksdb::CompactRangeOptions(), data_cf, &begin, &end);
     if (!res.ok()) {
         DB_WARNING_STATE(state, "compact after truncated failed: table:%ld, region:%ld, code=%d, msg=%s", 
             _table_id, _region_id, res.code(), res.ToString().c_str());
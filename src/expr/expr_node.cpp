@@ -142,6 +142,14 @@ void ExprNode::get_all_field_ids(std::unordered_set<int32_t>& field_ids) {
     }
 }
 
+void ExprNode::get_all_slot_refs(std::set<std::pair<int32_t, int32_t>>& slot_refs) {
+    if (_node_type == pb::SLOT_REF) {
+        slot_refs.insert(std::make_pair(_tuple_id, _slot_id));
+    }
+    for (auto& child : _children) {
+        child->get_all_slot_refs(slot_refs);
+    }
+}
 
 void ExprNode::transfer_pb(pb::ExprNode* pb_node) {
     pb_node->set_node_type(_node_type);
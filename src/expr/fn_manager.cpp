@@ -19,7 +19,8 @@
 
 namespace baikaldb {
 #define REGISTER_BINARY_OP(NAME, TYPE) \
-    register_object(#NAME"_"#TYPE"_"#TYPE, NAME##_##TYPE##_##TYPE);
+    register_object(#NAME"_"#TYPE"_"#TYPE, NAME##_##TYPE##_##TYPE); \
+    _batch_objects[#NAME"_"#TYPE"_"#TYPE] = NAME##_##TYPE##_##TYPE##_batch;
 #define REGISTER_BINARY_OP_ALL_TYPES(NAME) \
     REGISTER_BINARY_OP(NAME, int) \
     REGISTER_BINARY_OP(NAME, uint) \
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "operators.h"
+#include "column_batch.h"
 
 namespace baikaldb {
 #define UNARY_OP_FN(NAME, TYPE, PRIMITIVE_TYPE, VAL, OP) \
@@ -104,6 +105,73 @@ BINARY_OP_PREDICATE_ALL_TYPES_FN(le, <=);
 // && || ; not used, see predicate.h
 BINARY_OP_PREDICATE_FN(logic_and, bool, _u.bool_val, &&);
 BINARY_OP_PREDICATE_FN(logic_or, bool, _u.bool_val, ||);
+
+// 批量版本：按类型直接读写列数组，null按bitmap word合并
+#define BINARY_OP_BATCH_FN(NAME, TYPE, IN_DATA, OUT_DATA, OP) \
+    void NAME##_##TYPE##_##TYPE##_batch(const ColumnVector& left, const ColumnVector& right, \
+            const std::vector<uint32_t>* selection, ColumnVector* out) { \
+        auto l = left.IN_DATA(); \
+        auto r = right.IN_DATA(); \
+        auto o = out->OUT_DATA(); \
+        for_each_selected(out->size(), selection, [l, r, o](size_t i) { \
+            o[i] = l[i] OP r[i]; \
+        }); \
+        out->merge_null(left, right); \
+    }
+#define BINARY_OP_ALL_TYPES_BATCH_FN(NAME, OP) \
+    BINARY_OP_BATCH_FN(NAME, int, int_data, int_data, OP); \
+    BINARY_OP_BATCH_FN(NAME, uint, uint_data, uint_data, OP); \
+    BINARY_OP_BATCH_FN(NAME, double, double_data, double_data, OP);
+BINARY_OP_ALL_TYPES_BATCH_FN(add, +);
+BINARY_OP_ALL_TYPES_BATCH_FN(minus, -);
+BINARY_OP_ALL_TYPES_BATCH_FN(multiplies, *);
+
+// 除数为0时结果为null
+#define BINARY_OP_ZERO_BATCH_FN(NAME, TYPE, DATA, OP) \
+    void NAME##_##TYPE##_##TYPE##_batch(const ColumnVector& left, const ColumnVector& right, \
+            const std::vector<uint32_t>* selection, ColumnVector* out) { \
+        auto l = left.DATA(); \
+        auto r = right.DATA(); \
+        auto o = out->DATA(); \
+        out->merge_null(left, right); \
+        for_each_selected(out->size(), selection, [l, r, o, out](size_t i) { \
+            if (r[i] == 0) { \
+                o[i] = 0; \
+                out->set_null(i); \
+            } else { \
+                o[i] = l[i] OP r[i]; \
+            } \
+        }); \
+    }
+BINARY_OP_ZERO_BATCH_FN(divides, int, int_data, /);
+BINARY_OP_ZERO_BATCH_FN(divides, uint, uint_data, /);
+BINARY_OP_ZERO_BATCH_FN(divides, double, double_data, /);
+BINARY_OP_ZERO_BATCH_FN(mod, int, int_data, %);
+BINARY_OP_ZERO_BATCH_FN(mod, uint, uint_data, %);
+BINARY_OP_BATCH_FN(left_shift, uint, uint_data, uint_data, <<);
+BINARY_OP_BATCH_FN(right_shift, uint, uint_data, uint_data, >>);
+BINARY_OP_BATCH_FN(bit_and, uint, uint_data, uint_data, &);
+BINARY_OP_BATCH_FN(bit_or, uint, uint_data, uint_data, |);
+BINARY_OP_BATCH_FN(bit_xor, uint, uint_data, uint_data, ^);
+
+// 谓词结果为BOOL，存在int_data里
+#define BINARY_OP_PREDICATE_ALL_TYPES_BATCH_FN(NAME, OP) \
+    BINARY_OP_BATCH_FN(NAME, int, int_data, int_data, OP); \
+    BINARY_OP_BATCH_FN(NAME, uint, uint_data, int_data, OP); \
+    BINARY_OP_BATCH_FN(NAME, double, double_data, int_data, OP); \
+    BINARY_OP_BATCH_FN(NAME, string, string_data, int_data, OP); \
+    BINARY_OP_BATCH_FN(NAME, datetime, uint_data, int_data, OP); \
+    BINARY_OP_BATCH_FN(NAME, time, int_data, int_data, OP); \
+    BINARY_OP_BATCH_FN(NAME, date, uint_data, int_data, OP); \
+    BINARY_OP_BATCH_FN(NAME, timestamp, uint_data, int_data, OP);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_FN(eq, ==);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_FN(ne, !=);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_FN(gt, >);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_FN(ge, >=);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_FN(lt, <);
+BINARY_OP_PREDICATE_ALL_TYPES_BATCH_FN(le, <=);
+BINARY_OP_BATCH_FN(logic_and, bool, int_data, int_data, &&);
+BINARY_OP_BATCH_FN(logic_or, bool, int_data, int_data, ||);
 }
 
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -14,8 +14,107 @@
 
 #include "predicate.h"
 #include "parser.h"
+#include "column_batch.h"
 
 namespace baikaldb {
+static inline void set_bool_value(ColumnVector* out, size_t idx, bool val) {
+    if (out->storage() == CS_INT) {
+        out->int_data()[idx] = val;
+        out->set_not_null(idx);
+    } else {
+        out->set_value(idx, val ? ExprValue::True() : ExprValue::False());
+    }
+}
+
+// col为BOOL列
+static inline bool is_false(const ColumnVector& col, size_t idx) {
+    return !col.is_null(idx) && col.int_data()[idx] == 0;
+}
+
+static inline bool is_true(const ColumnVector& col, size_t idx) {
+    return !col.is_null(idx) && col.int_data()[idx] != 0;
+}
+
+bool AndPredicate::can_eval_batch() {
+    return _children.size() == 2 && 
+        _children[0]->can_eval_batch() && _children[1]->can_eval_batch();
+}
+
+int AndPredicate::eval_batch(ColumnBatch* batch, const std::vector<uint32_t>* selection,
+        ColumnVector* out) {
+    size_t size = out->size();
+    ColumnVector left(pb::BOOL);
+    left.resize(size);
+    int ret = _children[0]->eval_batch(batch, selection, &left);
+    if (ret < 0) {
+        return ret;
+    }
+    // short-circuit: 左边为false的行不再计算右边
+    std::vector<uint32_t> right_selection;
+    right_selection.reserve(selection == nullptr ? size : selection->size());
+    for_each_selected(size, selection, [&left, &right_selection](size_t idx) {
+        if (!is_false(left, idx)) {
+            right_selection.push_back(idx);
+        }
+    });
+    ColumnVector right(pb::BOOL);
+    right.resize(size);
+    ret = _children[1]->eval_batch(batch, &right_selection, &right);
+    if (ret < 0) {
+        return ret;
+    }
+    for_each_selected(size, selection, [&left, &right, out](size_t idx) {
+        if (is_false(left, idx) || is_false(right, idx)) {
+            set_bool_value(out, idx, false);
+        } else if (left.is_null(idx) || right.is_null(idx)) {
+            out->set_null(idx);
+        } else {
+            set_bool_value(out, idx, true);
+        }
+    });
+    return 0;
+}
+
+bool OrPredicate::can_eval_batch() {
+    return _children.size() == 2 && 
+        _children[0]->can_eval_batch() && _children[1]->can_eval_batch();
+}
+
+int OrPredicate::eval_batch(ColumnBatch* batch, const std::vector<uint32_t>* selection,
+        ColumnVector* out) {
+    size_t size = out->size();
+    ColumnVector left(pb::BOOL);
+    left.resize(size);
+    int ret = _children[0]->eval_batch(batch, selection, &left);
+    if (ret < 0) {
+        return ret;
+    }
+    // short-circuit: 左边为true的行不再计算右边
+    std::vector<uint32_t> right_selection;
+    right_selection.reserve(selection == nullptr ? size : selection->size());
+    for_each_selected(size, selection, [&left, &right_selection](size_t idx) {
+        if (!is_true(left, idx)) {
+            right_selection.push_back(idx);
+        }
+    });
+    ColumnVector right(pb::BOOL);
+    right.resize(size);
+    ret = _children[1]->eval_batch(batch, &right_selection, &right);
+    if (ret < 0) {
+        return ret;
+    }
+    for_each_selected(size, selection, [&left, &right, out](size_t idx) {
+        if (is_true(left, idx) || is_true(right, idx)) {
+            set_bool_value(out, idx, true);
+        } else if (left.is_null(idx) || right.is_null(idx)) {
+            out->set_null(idx);
+        } else {
+            set_bool_value(out, idx, false);
+        }
+    });
+    return 0;
+}
+
 int InPredicate::open() {
     int ret = 0;
     ret = ExprNode::open();
@@ -180,6 +279,68 @@ ExprValue InPredicate::get_value(MemRow* row) {
     return ExprValue::False();
 }
 
+bool InPredicate::can_eval_batch() {
+    return !_is_row_expr && _children[0]->can_eval_batch();
+}
+
+int InPredicate::eval_batch(ColumnBatch* batch, const std::vector<uint32_t>* selection,
+        ColumnVector* out) {
+    size_t size = out->size();
+    ColumnVector values(_map_type);
+    values.resize(size);
+    int ret = _children[0]->eval_batch(batch, selection, &values);
+    if (ret < 0) {
+        return ret;
+    }
+    switch (values.storage()) {
+        case CS_INT: {
+            const int64_t* data = values.int_data();
+            for_each_selected(size, selection, [this, &values, data, out](size_t idx) {
+                if (values.is_null(idx)) {
+                    out->set_null(idx);
+                } else {
+                    set_bool_value(out, idx, _int_set.count(data[idx]) == 1);
+                }
+            });
+            break;
+        }
+        case CS_UINT: {
+            const uint64_t* data = values.uint_data();
+            for_each_selected(size, selection, [this, &values, data, out](size_t idx) {
+                if (values.is_null(idx)) {
+                    out->set_null(idx);
+                } else {
+                    set_bool_value(out, idx, _int_set.count((int64_t)data[idx]) == 1);
+                }
+            });
+            break;
+        }
+        case CS_DOUBLE: {
+            const double* data = values.double_data();
+            for_each_selected(size, selection, [this, &values, data, out](size_t idx) {
+                if (values.is_null(idx)) {
+                    out->set_null(idx);
+                } else {
+                    set_bool_value(out, idx, _double_set.count(data[idx]) == 1);
+                }
+            });
+            break;
+        }
+        case CS_STRING: {
+            const std::string* data = values.string_data();
+            for_each_selected(size, selection, [this, &values, data, out](size_t idx) {
+                if (values.is_null(idx)) {
+                    out->set_null(idx);
+                } else {
+                    set_bool_value(out, idx, _str_set.count(data[idx]) == 1);
+                }
+            });
+            break;
+        }
+    }
+    return 0;
+}
+
 int LikePredicate::open() {
     int ret = 0;
     ret = ExprNode::open();
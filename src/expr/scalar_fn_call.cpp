@@ -16,6 +16,7 @@
 #include "slot_ref.h"
 #include "literal.h"
 #include "parser.h"
+#include "column_batch.h"
 
 namespace baikaldb {
 int ScalarFnCall::init(const pb::ExprNode& node) {
@@ -148,6 +149,7 @@ int ScalarFnCall::open() {
     }*/
     FunctionManager* fn_manager = FunctionManager::instance();
     _fn_call = fn_manager->get_object(_fn.name());
+    _fn_batch_call = fn_manager->get_batch_object(_fn.name());
     if (node_type() == pb::FUNCTION_CALL && _fn_call == NULL) {
         DB_WARNING("fn call is null, name:%s", _fn.name().c_str());
     }
@@ -186,5 +188,59 @@ ExprValue ScalarFnCall::get_value(MemRow* row) {
     }
     return _fn_call(args).cast_to(_col_type);
 }
+
+bool ScalarFnCall::can_eval_batch() {
+    if (_is_row_expr || _fn_call == NULL || node_type() != pb::FUNCTION_CALL) {
+        return false;
+    }
+    for (auto c : _children) {
+        if (!c->can_eval_batch()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int ScalarFnCall::eval_batch(ColumnBatch* batch, const std::vector<uint32_t>* selection,
+        ColumnVector* out) {
+    if (_fn_call == NULL) {
+        return 0;
+    }
+    // 参数先整列算出来并转成函数的参数类型
+    std::vector<ColumnVector> args;
+    args.reserve(_children.size());
+    for (size_t i = 0; i < _children.size(); i++) {
+        pb::PrimitiveType type = (int)i < _fn.arg_types_size() ? 
+            _fn.arg_types(i) : _children[i]->col_type();
+        args.emplace_back(type);
+        args.back().resize(out->size());
+        int ret = _children[i]->eval_batch(batch, selection, &args.back());
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    if (_fn_batch_call != NULL && args.size() == 2) {
+        if (_fn.return_type() == out->type() && _col_type == out->type()) {
+            _fn_batch_call(args[0], args[1], selection, out);
+            return 0;
+        }
+        ColumnVector result(_fn.return_type());
+        result.resize(out->size());
+        _fn_batch_call(args[0], args[1], selection, &result);
+        for_each_selected(out->size(), selection, [this, &result, out](size_t idx) {
+            out->set_value(idx, result.get_value(idx).cast_to(_col_type));
+        });
+        return 0;
+    }
+    // 没有批量实现的函数逐行调用，参数vector复用
+    std::vector<ExprValue> row_args(args.size());
+    for_each_selected(out->size(), selection, [this, &args, &row_args, out](size_t idx) {
+        for (size_t i = 0; i < args.size(); i++) {
+            row_args[i] = args[i].get_value(idx);
+        }
+        out->set_value(idx, _fn_call(row_args).cast_to(_col_type));
+    });
+    return 0;
+}
 }
 /* vim: set ts=4 sw=4 sts=4 tw=100 */
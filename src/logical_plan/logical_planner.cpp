@@ -28,6 +28,7 @@
 #include "transaction_planner.h"
 #include "kill_planner.h"
 #include "prepare_planner.h"
+#include "plan_cache.h"
 #include "predicate.h"
 #include "network_socket.h"
 #include "parser.h"
@@ -162,6 +163,11 @@ int LogicalPlanner::analyze(QueryContext* ctx) {
         }
         return 0;
     }
+    // 命中plan cache时不再解析sql
+    int ret = PlanCache::get_instance()->analyze(ctx);
+    if (ret <= 0) {
+        return ret;
+    }
     parser::SqlParser parser;
     parser.charset = ctx->charset;
     parser.parse(ctx->sql);
@@ -0,0 +1,537 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "plan_cache.h"
+#include <errno.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <gflags/gflags.h>
+#include "prepare_planner.h"
+#include "packet_node.h"
+#include "schema_factory.h"
+#include "network_socket.h"
+
+namespace baikaldb {
+DEFINE_int64(plan_cache_capacity, 1024, "max normalized sql in plan cache, 0 means disable");
+DEFINE_int32(plan_cache_max_params, 1024, "sql with more literals than this are not cached");
+DECLARE_string(log_plat_name);
+
+namespace {
+enum SqlTokenType {
+    TK_WORD        = 0,
+    TK_NUMBER      = 1,
+    TK_STRING      = 2,
+    TK_QUOTED_NAME = 3,
+    TK_OP          = 4
+};
+
+struct SqlToken {
+    SqlTokenType type;
+    size_t begin;
+    size_t end;
+    bool space_before;
+    // 字符串字面量去掉引号和转义后的值
+    std::string value;
+};
+
+enum ParenType {
+    PAREN_OTHER  = 0,
+    PAREN_IN     = 1,
+    PAREN_VALUES = 2
+};
+
+inline bool is_word_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '$' || (c & 0x80);
+}
+
+int tokenize(const std::string& sql, std::vector<SqlToken>* tokens) {
+    size_t n = sql.size();
+    size_t i = 0;
+    bool space = false;
+    while (i < n) {
+        char c = sql[i];
+        if (isspace((unsigned char)c)) {
+            space = true;
+            ++i;
+            continue;
+        }
+        // 注释，用户变量，原有的placeholder以及带转义的字符串都不处理
+        if (c == '#' || c == '?' || c == '@' || c == '"' || c == '\\') {
+            return -1;
+        }
+        if (i + 1 < n && ((c == '-' && sql[i + 1] == '-') || (c == '/' && sql[i + 1] == '*'))) {
+            return -1;
+        }
+        SqlToken token;
+        token.begin = i;
+        token.space_before = space;
+        space = false;
+        if (c == '\'') {
+            size_t j = i + 1;
+            while (true) {
+                if (j >= n || sql[j] == '\\') {
+                    return -1;
+                }
+                if (sql[j] == '\'') {
+                    if (j + 1 < n && sql[j + 1] == '\'') {
+                        token.value.push_back('\'');
+                        j += 2;
+                        continue;
+                    }
+                    break;
+                }
+                token.value.push_back(sql[j]);
+                ++j;
+            }
+            token.type = TK_STRING;
+            i = j + 1;
+        } else if (c == '`') {
+            size_t j = sql.find('`', i + 1);
+            while (j != std::string::npos && j + 1 < n && sql[j + 1] == '`') {
+                j = sql.find('`', j + 2);
+            }
+            if (j == std::string::npos) {
+                return -1;
+            }
+            token.type = TK_QUOTED_NAME;
+            i = j + 1;
+        } else if (isdigit((unsigned char)c) || (c == '.' && i + 1 < n
+                    && isdigit((unsigned char)sql[i + 1]) && !tokens->empty()
+                    && tokens->back().type == TK_OP && sql[tokens->back().begin] != ')')) {
+            size_t j = i;
+            while (j < n && isdigit((unsigned char)sql[j])) {
+                ++j;
+            }
+            if (j < n && sql[j] == '.') {
+                ++j;
+                while (j < n && isdigit((unsigned char)sql[j])) {
+                    ++j;
+                }
+            }
+            if (j < n && (sql[j] == 'e' || sql[j] == 'E')) {
+                size_t k = j + 1;
+                if (k < n && (sql[k] == '+' || sql[k] == '-')) {
+                    ++k;
+                }
+                if (k < n && isdigit((unsigned char)sql[k])) {
+                    j = k;
+                    while (j < n && isdigit((unsigned char)sql[j])) {
+                        ++j;
+                    }
+                }
+            }
+            token.type = TK_NUMBER;
+            // 0x1F 1abc之类按普通单词处理
+            if (j < n && is_word_char(sql[j])) {
+                token.type = TK_WORD;
+                while (j < n && is_word_char(sql[j])) {
+                    ++j;
+                }
+            }
+            i = j;
+        } else if (is_word_char(c)) {
+            size_t j = i;
+            while (j < n && is_word_char(sql[j])) {
+                ++j;
+            }
+            token.type = TK_WORD;
+            i = j;
+        } else {
+            static const char* ops[] = {"<=>", "<=", ">=", "!=", "<>", "||", "&&", ":=", "<<", ">>"};
+            size_t len = 1;
+            for (auto op : ops) {
+                size_t op_len = strlen(op);
+                if (sql.compare(i, op_len, op) == 0) {
+                    len = op_len;
+                    break;
+                }
+            }
+            token.type = TK_OP;
+            i += len;
+        }
+        token.end = i;
+        tokens->push_back(token);
+    }
+    return 0;
+}
+
+// 关键字开始的子句是否是条件，1:WHERE/ON/HAVING 0:其他子句 -1:不是子句关键字
+int predicate_clause(const std::string& word) {
+    static const char* predicate_words[] = {"where", "on", "having"};
+    static const char* other_words[] = {"select", "from", "join", "group", "order", "limit",
+        "union", "set", "update", "into", "values", "value"};
+    for (auto w : predicate_words) {
+        if (boost::iequals(word, w)) {
+            return 1;
+        }
+    }
+    for (auto w : other_words) {
+        if (boost::iequals(word, w)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+bool is_compare_op(const std::string& op) {
+    return op == "=" || op == "<" || op == ">" || op == "<=" || op == ">="
+        || op == "!=" || op == "<>" || op == "<=>";
+}
+
+// 字面量转成和create_term_literal_node一致的ExprNode
+bool literal_to_expr_node(const SqlToken& token, const std::string& text, pb::ExprNode* node) {
+    node->set_num_children(0);
+    if (token.type == TK_STRING) {
+        node->set_node_type(pb::STRING_LITERAL);
+        node->set_col_type(pb::STRING);
+        node->mutable_derive_node()->set_string_val(token.value);
+        return true;
+    }
+    errno = 0;
+    if (text.find_first_of(".eE") == std::string::npos) {
+        int64_t val = strtoll(text.c_str(), NULL, 10);
+        if (errno == ERANGE) {
+            // 超过int64的保留原文，由parser处理
+            return false;
+        }
+        node->set_node_type(pb::INT_LITERAL);
+        node->set_col_type(pb::INT64);
+        node->mutable_derive_node()->set_int_val(val);
+    } else {
+        double val = strtod(text.c_str(), NULL);
+        if (errno == ERANGE) {
+            return false;
+        }
+        node->set_node_type(pb::DOUBLE_LITERAL);
+        node->set_col_type(pb::DOUBLE);
+        node->mutable_derive_node()->set_double_val(val);
+    }
+    return true;
+}
+}
+
+PlanCache::PlanCache() {
+    _cache.init(FLAGS_plan_cache_capacity);
+    _hit_count.expose("plan_cache_hit_count");
+    _miss_count.expose("plan_cache_miss_count");
+    _prepared_hit_count.expose("prepared_plan_shared_count");
+}
+
+int PlanCache::normalize_sql(const std::string& sql, std::string* normalized,
+        std::vector<pb::ExprNode>* params) {
+    std::vector<SqlToken> tokens;
+    if (tokenize(sql, &tokens) != 0 || tokens.empty() || tokens[0].type != TK_WORD) {
+        return -1;
+    }
+    std::string first = sql.substr(tokens[0].begin, tokens[0].end - tokens[0].begin);
+    if (!boost::iequals(first, "select") && !boost::iequals(first, "insert")
+            && !boost::iequals(first, "replace") && !boost::iequals(first, "update")
+            && !boost::iequals(first, "delete")) {
+        return -1;
+    }
+    std::vector<std::string> texts;
+    texts.reserve(tokens.size());
+    for (auto& token : tokens) {
+        texts.push_back(sql.substr(token.begin, token.end - token.begin));
+    }
+    // 结尾的;不影响plan
+    while (!tokens.empty() && tokens.back().type == TK_OP && texts.back() == ";") {
+        tokens.pop_back();
+        texts.pop_back();
+    }
+
+    normalized->clear();
+    normalized->reserve(sql.size());
+    std::vector<ParenType> parens;
+    // 只替换条件子句里的字面量，select列表中的字面量会出现在结果列名里
+    std::vector<bool> outer_predicates;
+    bool in_predicate = false;
+    bool after_values = false;
+    bool between_pending = false;
+    bool prev_between_and = false;
+    for (size_t k = 0; k < tokens.size(); ++k) {
+        const SqlToken& token = tokens[k];
+        const std::string& text = texts[k];
+        bool between_and = false;
+        bool replace = false;
+        if ((token.type == TK_NUMBER || token.type == TK_STRING) && k > 0) {
+            const SqlToken& prev = tokens[k - 1];
+            const std::string& prev_text = texts[k - 1];
+            bool has_next = k + 1 < tokens.size();
+            const std::string& next_text = has_next ? texts[k + 1] : text;
+            bool in_list = !parens.empty() && (parens.back() == PAREN_VALUES
+                    || (parens.back() == PAREN_IN && in_predicate));
+            if (in_predicate && ((prev.type == TK_OP && is_compare_op(prev_text))
+                    || (prev.type == TK_WORD && boost::iequals(prev_text, "between"))
+                    || prev_between_and)) {
+                // 'a' 'b'相邻字符串会被拼接
+                replace = !has_next || tokens[k + 1].type != TK_STRING;
+            } else if (in_list && prev.type == TK_OP && (prev_text == "(" || prev_text == ",")) {
+                // IN/VALUES列表中单独的元素
+                replace = has_next && tokens[k + 1].type == TK_OP
+                    && (next_text == "," || next_text == ")");
+            }
+        }
+        if (replace) {
+            pb::ExprNode node;
+            // 字面量太多的sql不缓存，尽早放弃，不必再解析剩下的部分
+            if (params->size() >= (size_t)FLAGS_plan_cache_max_params) {
+                return -1;
+            }
+            if (literal_to_expr_node(token, text, &node)) {
+                params->push_back(node);
+            } else {
+                replace = false;
+            }
+        }
+        if (token.space_before && k > 0) {
+            normalized->push_back(' ');
+        }
+        normalized->append(replace ? "?" : text);
+
+        if (token.type == TK_OP && text == "(") {
+            ParenType type = PAREN_OTHER;
+            if (k > 0 && tokens[k - 1].type == TK_WORD && boost::iequals(texts[k - 1], "in")) {
+                type = PAREN_IN;
+            } else if (k > 0 && after_values && parens.empty()
+                    && ((tokens[k - 1].type == TK_WORD) || texts[k - 1] == ",")) {
+                type = PAREN_VALUES;
+            }
+            parens.push_back(type);
+            outer_predicates.push_back(in_predicate);
+        } else if (token.type == TK_OP && text == ")") {
+            if (parens.empty()) {
+                return -1;
+            }
+            parens.pop_back();
+            in_predicate = outer_predicates.back();
+            outer_predicates.pop_back();
+        } else if (token.type == TK_WORD) {
+            int clause = predicate_clause(text);
+            if (clause >= 0) {
+                in_predicate = clause == 1;
+            }
+            if (parens.empty()) {
+                after_values = boost::iequals(text, "values") || boost::iequals(text, "value");
+            }
+            if (boost::iequals(text, "between")) {
+                between_pending = true;
+            } else if (between_pending && boost::iequals(text, "and")) {
+                between_pending = false;
+                between_and = true;
+            }
+        }
+        prev_between_and = between_and;
+    }
+    if (!parens.empty()) {
+        return -1;
+    }
+    return 0;
+}
+
+bool PlanCache::check_version(const SmartPlanCacheEntry& entry) {
+    SchemaFactory* factory = SchemaFactory::get_instance();
+    for (auto& pair : entry->table_versions) {
+        auto table_ptr = factory->get_table_info_ptr(pair.first);
+        if (table_ptr == nullptr || table_ptr->version != pair.second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string PlanCache::make_key(QueryContext* ctx, const std::string& sql) {
+    // 权限变化时user_info的version会变
+    return ctx->user_info->namespace_ + "\t" + ctx->user_info->username + "\t"
+        + std::to_string(ctx->user_info->version) + "\t" + ctx->cur_db + "\t"
+        + ctx->charset + "\t" + std::to_string(ctx->row_ttl_duration) + "\t" + sql;
+}
+
+int PlanCache::create_template(QueryContext* ctx, const std::string& sql,
+        PlanCacheEntry* entry, QueryContext* err_ctx) {
+    // 在临时ctx上生成模板，不影响调用方的ctx
+    QueryContext tmp_ctx;
+    tmp_ctx.cur_db = ctx->cur_db;
+    tmp_ctx.charset = ctx->charset;
+    tmp_ctx.user_info = ctx->user_info;
+    tmp_ctx.client_conn = ctx->client_conn;
+    tmp_ctx.row_ttl_duration = ctx->row_ttl_duration;
+    PreparePlanner planner(&tmp_ctx);
+    std::shared_ptr<QueryContext> prepare_ctx;
+    if (planner.create_prepare_ctx(sql, prepare_ctx) != 0) {
+        if (err_ctx != nullptr) {
+            err_ctx->stat_info.error_code = tmp_ctx.stat_info.error_code;
+            err_ctx->stat_info.error_msg << tmp_ctx.stat_info.error_msg.str();
+        }
+        return -1;
+    }
+    SchemaFactory* factory = SchemaFactory::get_instance();
+    for (auto& tuple : prepare_ctx->tuple_descs()) {
+        if (!tuple.has_table_id() || tuple.table_id() <= 0) {
+            continue;
+        }
+        auto table_ptr = factory->get_table_info_ptr(tuple.table_id());
+        if (table_ptr == nullptr) {
+            DB_WARNING("table not found, table_id: %ld, sql: %s", tuple.table_id(), sql.c_str());
+            return -1;
+        }
+        entry->table_versions[tuple.table_id()] = table_ptr->version;
+    }
+    entry->num_params = prepare_ctx->placeholders.size();
+    PacketNode* packet_node = static_cast<PacketNode*>(prepare_ctx->root->get_node(pb::PACKET_NODE));
+    if (packet_node != nullptr) {
+        entry->fields = packet_node->fields();
+    }
+    // 模板会被多个连接共享，不能持有当前连接
+    prepare_ctx->client_conn = nullptr;
+    prepare_ctx->get_runtime_state()->set_client_conn(nullptr);
+    prepare_ctx->stmt = nullptr;
+    entry->prepare_ctx = prepare_ctx;
+    return 0;
+}
+
+SmartPlanCacheEntry PlanCache::build_entry(QueryContext* ctx, const std::string& normalized_sql,
+        size_t num_params) {
+    SmartPlanCacheEntry entry(new PlanCacheEntry);
+    entry->normalized_sql = normalized_sql;
+    // 生成失败时走正常流程，错误信息不写回ctx
+    if (create_template(ctx, normalized_sql, entry.get(), nullptr) != 0) {
+        entry->prepare_ctx = nullptr;
+        return entry;
+    }
+    auto prepare_ctx = entry->prepare_ctx;
+    if (prepare_ctx->placeholders.size() != num_params) {
+        // 参数绑定不上，模板不能用
+        entry->prepare_ctx = nullptr;
+        return entry;
+    }
+    // 以下情况模板可以执行本次sql，但不放入cache
+    if (prepare_ctx->stat_info.family.empty() || prepare_ctx->stat_info.table.empty()) {
+        return entry;
+    }
+    SchemaFactory* factory = SchemaFactory::get_instance();
+    int64_t table_id = -1;
+    if (0 != factory->get_table_id(ctx->user_info->namespace_ + "." + prepare_ctx->stat_info.family
+                + "." + prepare_ctx->stat_info.table, table_id)) {
+        return entry;
+    }
+    auto table_ptr = factory->get_table_info_ptr(table_id);
+    if (table_ptr == nullptr) {
+        return entry;
+    }
+    prepare_ctx->stat_info.table_id = table_ptr->id;
+    entry->resource_tag = table_ptr->resource_tag;
+    entry->cacheable = true;
+    return entry;
+}
+
+SmartPlanCacheEntry PlanCache::get_prepared_plan(QueryContext* handle, QueryContext* ctx) {
+    std::string key = make_key(handle, handle->sql);
+    SmartPlanCacheEntry entry;
+    {
+        std::lock_guard<std::mutex> lock(_prepared_mutex);
+        auto iter = _prepared_plans.find(key);
+        if (iter != _prepared_plans.end()) {
+            entry = iter->second.lock();
+        }
+    }
+    if (entry != nullptr && check_version(entry)) {
+        _prepared_hit_count << 1;
+        return entry;
+    }
+    entry.reset(new PlanCacheEntry);
+    if (create_template(handle, handle->sql, entry.get(), ctx) != 0) {
+        DB_WARNING("create prepare plan failed: %s", handle->sql.c_str());
+        return nullptr;
+    }
+    entry->cacheable = true;
+    std::lock_guard<std::mutex> lock(_prepared_mutex);
+    // 没有连接引用的plan已经释放，定期清理map
+    if (_prepared_plans.size() >= _prepared_sweep_size) {
+        for (auto iter = _prepared_plans.begin(); iter != _prepared_plans.end();) {
+            if (iter->second.expired()) {
+                iter = _prepared_plans.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+        _prepared_sweep_size = std::max(_prepared_plans.size() * 2, (size_t)1024);
+    }
+    _prepared_plans[key] = entry;
+    return entry;
+}
+
+int PlanCache::analyze(QueryContext* ctx) {
+    if (FLAGS_plan_cache_capacity <= 0 || ctx->mysql_cmd != COM_QUERY
+            || !ctx->comments.empty() || ctx->client_conn == nullptr || ctx->user_info == nullptr) {
+        return 1;
+    }
+    std::string normalized_sql;
+    std::vector<pb::ExprNode> params;
+    if (normalize_sql(ctx->sql, &normalized_sql, &params) != 0) {
+        return 1;
+    }
+    std::string key = make_key(ctx, normalized_sql);
+    SmartPlanCacheEntry entry;
+    bool hit = _cache.find(key, &entry) == 0 && check_version(entry);
+    std::shared_ptr<QueryContext> prepare_ctx;
+    if (!hit) {
+        _miss_count << 1;
+        entry = build_entry(ctx, normalized_sql, params.size());
+        prepare_ctx = entry->prepare_ctx;
+        if (!entry->cacheable) {
+            // cache中只记录不可缓存，不持有模板；表结构变化后重新判断
+            SmartPlanCacheEntry uncacheable(new PlanCacheEntry);
+            uncacheable->normalized_sql = normalized_sql;
+            uncacheable->table_versions = entry->table_versions;
+            _cache.add(key, uncacheable);
+        } else {
+            _cache.add(key, entry);
+        }
+    } else {
+        _hit_count << 1;
+        if (!entry->cacheable) {
+            return 1;
+        }
+        prepare_ctx = entry->prepare_ctx;
+    }
+    // 本次已经生成的模板即使不能缓存也直接用，不再重新解析生成plan
+    if (prepare_ctx == nullptr) {
+        return 1;
+    }
+    PreparePlanner planner(ctx);
+    if (planner.execute_prepare_ctx(prepare_ctx, params, false) != 0) {
+        DB_WARNING("execute cached plan failed, sql: %s", ctx->sql.c_str());
+        return -1;
+    }
+    auto stat_info = &(ctx->stat_info);
+    stat_info->hit_cache = hit;
+    stat_info->family = prepare_ctx->stat_info.family;
+    stat_info->table = prepare_ctx->stat_info.table;
+    stat_info->table_id = prepare_ctx->stat_info.table_id;
+    pb::OpType op_type = pb::OP_NONE;
+    if (ctx->plan.nodes_size() > 0 && ctx->plan.nodes(0).node_type() == pb::PACKET_NODE) {
+        op_type = ctx->plan.nodes(0).derive_node().packet_node().op_type();
+    }
+    stat_info->sample_sql << "family_table_tag_optype_plat=[" << stat_info->family << "\t"
+        << stat_info->table << "\t" << entry->resource_tag << "\t" << op_type << "\t"
+        << FLAGS_log_plat_name << "] sql=[" << entry->normalized_sql << "]";
+    return 0;
+}
+} //namespace baikaldb
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -22,6 +22,7 @@
 #include "packet_node.h"
 #include "literal.h"
 #include "expr_optimizer.h"
+#include "plan_cache.h"
 
 namespace baikaldb {
 
@@ -123,7 +124,64 @@ int PreparePlanner::stmt_prepare(const std::string& stmt_name, const std::string
         client->prepared_plans.erase(iter);
     }
     //DB_WARNING("stmt_name:%s stmt_sql:%s", stmt_name.c_str(), stmt_sql.c_str());
+    // 连接上只保存句柄，plan从全局共享
+    std::shared_ptr<QueryContext> prepare_ctx(new (std::nothrow)QueryContext());
+    if (prepare_ctx.get() == nullptr) {
+        DB_WARNING("create prepare context failed");
+        return -1;
+    }
+    prepare_ctx->is_prepared = true;
+    prepare_ctx->cur_db = _ctx->cur_db;
+    prepare_ctx->charset = _ctx->charset;
+    prepare_ctx->user_info = _ctx->user_info;
+    prepare_ctx->row_ttl_duration = _ctx->row_ttl_duration;
+    prepare_ctx->client_conn = client;
+    prepare_ctx->sql = stmt_sql;
+    auto shared_plan = PlanCache::get_instance()->get_prepared_plan(prepare_ctx.get(), _ctx);
+    if (shared_plan == nullptr) {
+        return -1;
+    }
+    attach_shared_plan(prepare_ctx, shared_plan);
+    client->prepared_plans[stmt_name] = prepare_ctx;
+    return 0;
+}
+
+void PreparePlanner::attach_shared_plan(std::shared_ptr<QueryContext> prepare_ctx,
+        std::shared_ptr<PlanCacheEntry> shared_plan) {
+    auto plan_ctx = shared_plan->prepare_ctx;
+    // 列信息和参数个数从模板取，老模板生成的执行树作废
+    if (prepare_ctx->need_destroy_tree) {
+        ExecNode::destroy_tree(prepare_ctx->root);
+        prepare_ctx->need_destroy_tree = false;
+    }
+    prepare_ctx->root = nullptr;
+    prepare_ctx->placeholders.clear();
+    prepare_ctx->plan.Clear();
+    prepare_ctx->runtime_state.reset();
+    prepare_ctx->shared_plan = shared_plan;
+    prepare_ctx->stmt_type = plan_ctx->stmt_type;
+    prepare_ctx->is_select = plan_ctx->is_select;
+    prepare_ctx->prepared_table_id = plan_ctx->prepared_table_id;
+}
+
+int PreparePlanner::create_select_tree(std::shared_ptr<QueryContext> prepare_ctx) {
+    auto plan_ctx = prepare_ctx->shared_plan->prepare_ctx;
+    prepare_ctx->plan.CopyFrom(plan_ctx->plan);
+    *prepare_ctx->mutable_tuple_descs() = plan_ctx->tuple_descs();
+    prepare_ctx->is_full_export = plan_ctx->is_full_export;
+    if (prepare_ctx->create_plan_tree() < 0) {
+        DB_WARNING("Failed to pb_plan to execnode, sql: %s", prepare_ctx->sql.c_str());
+        return -1;
+    }
+    prepare_ctx->root->find_place_holder(prepare_ctx->placeholders);
+    prepare_ctx->get_runtime_state()->set_client_conn(prepare_ctx->client_conn);
+    return 0;
+}
+
+int PreparePlanner::create_prepare_ctx(const std::string& stmt_sql,
+        std::shared_ptr<QueryContext>& prepare_ctx) {
     parser::SqlParser parser;
+    parser.charset = _ctx->charset;
     parser.parse(stmt_sql);
     if (parser.error != parser::SUCC) {
         _ctx->stat_info.error_code = ER_SYNTAX_ERROR;
@@ -145,7 +203,7 @@ int PreparePlanner::stmt_prepare(const std::string& stmt_name, const std::string
     }
 
     // create commit fetcher node
-    std::shared_ptr<QueryContext> prepare_ctx(new (std::nothrow)QueryContext());
+    prepare_ctx.reset(new (std::nothrow)QueryContext());
     if (prepare_ctx.get() == nullptr) {
         DB_WARNING("create prepare context failed");
         return -1;
@@ -157,8 +215,8 @@ int PreparePlanner::stmt_prepare(const std::string& stmt_name, const std::string
     prepare_ctx->cur_db = _ctx->cur_db;
     prepare_ctx->user_info = _ctx->user_info;
     prepare_ctx->row_ttl_duration = _ctx->row_ttl_duration;
-    prepare_ctx->client_conn = client;
-    prepare_ctx->get_runtime_state()->set_client_conn(client);
+    prepare_ctx->client_conn = _ctx->client_conn;
+    prepare_ctx->get_runtime_state()->set_client_conn(_ctx->client_conn);
     prepare_ctx->sql = stmt_sql;
 
     std::unique_ptr<LogicalPlanner> planner;
@@ -198,7 +256,6 @@ int PreparePlanner::stmt_prepare(const std::string& stmt_name, const std::string
         return ret;
     }
     */
-    client->prepared_plans[stmt_name] = prepare_ctx;
     return 0;
 }
 
@@ -215,6 +272,31 @@ int PreparePlanner::stmt_execute(const std::string& stmt_name, std::vector<pb::E
     }
 
     std::shared_ptr<QueryContext> prepare_ctx = iter->second;
+    if (prepare_ctx->shared_plan == nullptr) {
+        return execute_prepare_ctx(prepare_ctx, params, true);
+    }
+    auto shared_plan = prepare_ctx->shared_plan;
+    if (!PlanCache::get_instance()->check_version(shared_plan)) {
+        // 表结构变化后重新生成plan，老的plan在所有连接都切换后释放
+        shared_plan = PlanCache::get_instance()->get_prepared_plan(prepare_ctx.get(), _ctx);
+        if (shared_plan == nullptr) {
+            return -1;
+        }
+        attach_shared_plan(prepare_ctx, shared_plan);
+    }
+    if (!shared_plan->prepare_ctx->is_select) {
+        // dml每次从共享模板拷贝pb plan
+        return execute_prepare_ctx(shared_plan->prepare_ctx, params, false);
+    }
+    // select在连接上复用执行树，第一次execute时从共享模板生成
+    if (prepare_ctx->root == nullptr && create_select_tree(prepare_ctx) != 0) {
+        return -1;
+    }
+    return execute_prepare_ctx(prepare_ctx, params, true);
+}
+
+int PreparePlanner::execute_prepare_ctx(std::shared_ptr<QueryContext> prepare_ctx,
+        std::vector<pb::ExprNode>& params, bool reuse_select_plan) {
     if (params.size() != prepare_ctx->placeholders.size()) {
         _ctx->stat_info.error_code = ER_WRONG_ARGUMENTS;
         _ctx->stat_info.error_msg << "Incorrect arguments to EXECUTE: " 
@@ -232,7 +314,7 @@ int PreparePlanner::stmt_execute(const std::string& stmt_name, std::vector<pb::E
     _ctx->row_ttl_duration = prepare_ctx->row_ttl_duration;
     _ctx->mutable_tuple_descs()->assign(tuple_descs.begin(), tuple_descs.end());
     // TODO dml的plan复用
-    if (!prepare_ctx->is_select) {
+    if (!prepare_ctx->is_select || !reuse_select_plan) {
         _ctx->plan.CopyFrom(prepare_ctx->plan);
         int ret = _ctx->create_plan_tree();
         if (ret < 0) {
@@ -240,6 +322,12 @@ int PreparePlanner::stmt_execute(const std::string& stmt_name, std::vector<pb::E
             return -1;
         }
         _ctx->root->find_place_holder(_ctx->placeholders);
+        if (prepare_ctx->is_select) {
+            // plan cache中的模板会被多个连接共享，只复用pb plan
+            _ctx->is_select = true;
+            _ctx->is_full_export = prepare_ctx->is_full_export;
+            _ctx->get_runtime_state()->set_single_sql_autocommit(_ctx->client_conn->txn_id == 0);
+        }
     } else {
         // select prepare plan复用
         _ctx->runtime_state = prepare_ctx->runtime_state;
@@ -24,6 +24,17 @@ using google::protobuf::Descriptor;
 using google::protobuf::Message;
 using google::protobuf::Reflection;
 
+MemRow::~MemRow() {
+    if (_layout != nullptr) {
+        MemRowDescriptor::release_tuples(_layout, _tuples);
+        return;
+    }
+    for (auto& t : _tuples) {
+        delete t;
+        t = nullptr;
+    }
+}
+
 void MemRow::set_tuple(int32_t tuple_id, MemRowDescriptor* desc) {
     if (_tuples[tuple_id] == nullptr) {
         _tuples[tuple_id] = desc->new_tuple_message(tuple_id);
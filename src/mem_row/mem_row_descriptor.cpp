@@ -12,25 +12,68 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include "mem_row.h"
 #include "mem_row_descriptor.h"
+#include "lru_cache.h"
 
 namespace baikaldb {
+DEFINE_int64(mem_row_layout_cache_capacity, 4096,
+        "max compiled tuple layouts shared between queries, 0 means no cache");
+DEFINE_int32(mem_row_free_tuples, 256, "max cleared tuple messages of one tuple kept by a thread");
+DEFINE_int32(mem_row_thread_layouts, 4, "max layouts whose tuple messages are kept by a thread");
 
-int32_t MemRowDescriptor::init(std::vector<pb::TupleDescriptor>& tuple_desc) {
-    if (nullptr == (_factory 
-            = new (std::nothrow)google::protobuf::DynamicMessageFactory(&_pool))) {
-        return -1;
+// 线程内的空闲tuple，不需要加锁；持有layout保证message析构时factory仍有效
+struct TupleFreeList {
+    ~TupleFreeList() {
+        for (auto& free_tuples : tuples) {
+            for (auto t : free_tuples) {
+                delete t;
+            }
+        }
+    }
+    SmartMemRowLayout layout;
+    // 下标为tuple_id
+    std::vector<std::vector<google::protobuf::Message*>> tuples;
+};
+
+// 按最近使用排序，只保留少量layout
+static thread_local std::vector<std::unique_ptr<TupleFreeList>> tls_free_lists;
+
+static TupleFreeList* thread_free_list(const SmartMemRowLayout& layout, bool create) {
+    for (size_t i = 0; i < tls_free_lists.size(); ++i) {
+        if (tls_free_lists[i]->layout == layout) {
+            if (i != 0) {
+                std::swap(tls_free_lists[0], tls_free_lists[i]);
+            }
+            return tls_free_lists[0].get();
+        }
     }
-    if (nullptr == (_proto = new (std::nothrow)google::protobuf::FileDescriptorProto)) {
-        DB_WARNING("create FileDescriptorProto failed");
+    if (!create || FLAGS_mem_row_thread_layouts <= 0 || layout->id_tuple_mapping.empty()) {
+        return nullptr;
+    }
+    while ((int)tls_free_lists.size() >= FLAGS_mem_row_thread_layouts) {
+        tls_free_lists.pop_back();
+    }
+    std::unique_ptr<TupleFreeList> free_list(new TupleFreeList);
+    free_list->layout = layout;
+    free_list->tuples.resize(layout->id_tuple_mapping.rbegin()->first + 1);
+    tls_free_lists.insert(tls_free_lists.begin(), std::move(free_list));
+    return tls_free_lists[0].get();
+}
+
+int MemRowDescriptor::build_layout(const std::vector<pb::TupleDescriptor>& tuple_desc,
+        MemRowLayout* layout) {
+    if (nullptr == (layout->factory 
+            = new (std::nothrow)google::protobuf::DynamicMessageFactory(&layout->pool))) {
         return -1;
     }
-    _proto->set_name("mem_row.proto");
+    google::protobuf::FileDescriptorProto proto;
+    proto.set_name("mem_row.proto");
     std::vector<int32_t> tuples;
-    for (auto tuple : tuple_desc) {
+    for (auto& tuple : tuple_desc) {
         int32_t tuple_id = tuple.tuple_id();
-        google::protobuf::DescriptorProto* tuple_proto = _proto->add_message_type();
+        google::protobuf::DescriptorProto* tuple_proto = proto.add_message_type();
         tuple_proto->set_name("tuple_" + std::to_string(tuple_id));
         tuples.push_back(tuple_id);
 
@@ -50,7 +93,7 @@ int32_t MemRowDescriptor::init(std::vector<pb::TupleDescriptor>& tuple_desc) {
             field->set_label(FieldDescriptorProto::LABEL_OPTIONAL);
         }
     }
-    const google::protobuf::FileDescriptor *memrow_desc = _pool.BuildFile(*_proto);
+    const google::protobuf::FileDescriptor *memrow_desc = layout->pool.BuildFile(proto);
     if (!memrow_desc) {
         DB_WARNING("build memrow_desc failed.");
         return -1;
@@ -62,19 +105,57 @@ int32_t MemRowDescriptor::init(std::vector<pb::TupleDescriptor>& tuple_desc) {
             DB_WARNING("FindMessageTypeByName [%d] failed.", tuple);
             return -1;
         }
-        const google::protobuf::Message *message = _factory->GetPrototype(descriptor);
+        const google::protobuf::Message *message = layout->factory->GetPrototype(descriptor);
         if (!message) {
             DB_WARNING("create dynamic message failed.");
             return -1;
         }
-        _id_tuple_mapping.insert(std::make_pair(tuple, message));
+        layout->id_tuple_mapping.insert(std::make_pair(tuple, message));
+    }
+    return 0;
+}
+
+int32_t MemRowDescriptor::init(std::vector<pb::TupleDescriptor>& tuple_desc) {
+    // 动态类型只由tuple_id和slot的id/类型决定
+    std::string key;
+    for (auto& tuple : tuple_desc) {
+        key.append(std::to_string(tuple.tuple_id())).append(":");
+        for (auto& slot : tuple.slots()) {
+            key.append(std::to_string(slot.slot_id())).append(",");
+            key.append(std::to_string(slot.slot_type())).append(" ");
+        }
+        key.append(";");
+    }
+    static Cache<std::string, SmartMemRowLayout> layout_cache;
+    static std::once_flag cache_init;
+    std::call_once(cache_init, []() {
+        layout_cache.init(FLAGS_mem_row_layout_cache_capacity);
+    });
+    bool use_cache = FLAGS_mem_row_layout_cache_capacity > 0;
+    if (!use_cache || layout_cache.find(key, &_layout) != 0) {
+        SmartMemRowLayout layout(new (std::nothrow) MemRowLayout);
+        if (layout == nullptr) {
+            DB_WARNING("create MemRowLayout failed");
+            return -1;
+        }
+        if (build_layout(tuple_desc, layout.get()) < 0) {
+            return -1;
+        }
+        _layout = layout;
+        if (use_cache) {
+            layout_cache.add(key, _layout);
+        }
     }
     return 0;
 }
 
 google::protobuf::Message* MemRowDescriptor::new_tuple_message(int32_t tuple_id) {
-    auto iter = _id_tuple_mapping.find(tuple_id);
-    if (iter == _id_tuple_mapping.end()) {
+    if (_layout == nullptr) {
+        DB_WARNING("no tuple found: %d", tuple_id);
+        return nullptr;
+    }
+    auto iter = _layout->id_tuple_mapping.find(tuple_id);
+    if (iter == _layout->id_tuple_mapping.end()) {
         DB_WARNING("no tuple found: %d", tuple_id);
         return nullptr;
     }
@@ -86,10 +167,45 @@ google::protobuf::Message* MemRowDescriptor::new_tuple_message(int32_t tuple_id)
 }
 
 std::unique_ptr<MemRow> MemRowDescriptor::fetch_mem_row() {
-    std::unique_ptr<MemRow> tmp(new MemRow(_id_tuple_mapping.size()));
-    for (auto& pair : _id_tuple_mapping) {
-        tmp->_tuples[pair.first] = pair.second->New();
+    std::unique_ptr<MemRow> tmp(new MemRow(tuple_size()));
+    if (_layout == nullptr) {
+        return tmp;
+    }
+    tmp->_layout = _layout;
+    TupleFreeList* free_list = thread_free_list(_layout, false);
+    for (auto& pair : _layout->id_tuple_mapping) {
+        google::protobuf::Message* tuple = nullptr;
+        if (free_list != nullptr) {
+            auto& free_tuples = free_list->tuples[pair.first];
+            if (!free_tuples.empty()) {
+                tuple = free_tuples.back();
+                free_tuples.pop_back();
+            }
+        }
+        if (tuple == nullptr) {
+            tuple = pair.second->New();
+        }
+        tmp->_tuples[pair.first] = tuple;
     }
     return tmp;
 }
+
+void MemRowDescriptor::release_tuples(const SmartMemRowLayout& layout,
+        std::vector<google::protobuf::Message*>& tuples) {
+    TupleFreeList* free_list = thread_free_list(layout, true);
+    for (size_t tuple_id = 0; tuple_id < tuples.size(); ++tuple_id) {
+        auto& t = tuples[tuple_id];
+        if (t == nullptr) {
+            continue;
+        }
+        if (free_list != nullptr && tuple_id < free_list->tuples.size()
+                && (int)free_list->tuples[tuple_id].size() < FLAGS_mem_row_free_tuples) {
+            t->Clear();
+            free_list->tuples[tuple_id].push_back(t);
+        } else {
+            delete t;
+        }
+        t = nullptr;
+    }
+}
 }
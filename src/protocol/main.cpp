@@ -22,6 +22,7 @@
 #include "network_server.h"
 #include "fn_manager.h"
 #include "schema_factory.h"
+#include "spill_file.h"
 
 namespace baikaldb {
 
@@ -54,6 +55,8 @@ int main(int argc, char **argv) {
         DB_FATAL("SchemaFactory init failed");
         return -1;
     }
+    // 上次退出时没来得及删除的落盘文件
+    baikaldb::SpillFile::clean_spill_dir();
     // if (baikaldb::SQLParser::get_instance()->init() != 0) {
     //     DB_FATAL("SQLParser init failed");
     //     return -1;
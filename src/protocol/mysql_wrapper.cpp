@@ -14,9 +14,12 @@
 
 #include "mysql_wrapper.h"
 #include <unordered_set>
+#include <sys/epoll.h>
+#include <bthread/unstable.h>
 #include "network_socket.h"
 #include "query_context.h"
 #include "packet_node.h"
+#include "plan_cache.h"
 
 namespace baikaldb {
 
@@ -647,6 +650,40 @@ int MysqlWrapper::real_write(SmartSocket sock) {
     return RET_SUCCESS;
 }
 
+// 流式返回结果时由执行查询的bthread调用，EAGAIN时用bthread_fd_timedwait等待可写，
+// 只挂起当前bthread，不占用worker线程
+int MysqlWrapper::blocking_write(NetworkSocket* sock, int64_t timeout_us) {
+    if (sock == nullptr || sock->send_buf == nullptr) {
+        DB_FATAL("sock == NULL or sock->send_buf == NULL");
+        return RET_ERROR;
+    }
+    while (sock->send_buf_offset < (int)sock->send_buf->_size) {
+        int we_want = sock->send_buf->_size - sock->send_buf_offset;
+        int real_write = std::min(we_want, (int)MAX_WRITE_QUERY_RESULT_PACKET_LEN);
+        int len = write(sock->fd, sock->send_buf->_data + sock->send_buf_offset, real_write);
+        if (len > 0) {
+            sock->send_buf_offset += len;
+            continue;
+        } else if (len == 0) {
+            return RET_SHUTDOWN;
+        }
+        if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN) {
+            DB_WARNING("write fail, fd:%d, errno:%d", sock->fd, errno);
+            return RET_SHUTDOWN;
+        }
+        timespec abstime = butil::microseconds_from_now(timeout_us);
+        if (bthread_fd_timedwait(sock->fd, EPOLLOUT, &abstime) != 0) {
+            DB_WARNING("wait fd writable fail, fd:%d, errno:%d", sock->fd, errno);
+            return RET_ERROR;
+        }
+    }
+    sock->send_buf->byte_array_clear();
+    sock->send_buf_offset = 0;
+    return RET_SUCCESS;
+}
+
 bool MysqlWrapper::make_eof_packet(DataBuffer* send_buf, const int packet_id) {
     uint8_t bytes[4];
     bytes[0] = '\x05';
@@ -693,20 +730,29 @@ bool MysqlWrapper::make_stmt_prepare_ok_packet(SmartSocket sock) {
         return false;
     }
     auto query_ctx = iter->second;
-    ExecNode* plan = query_ctx->root;
-    if (plan == nullptr) {
-        DB_WARNING("prepare_stmt plan is null");
-        return false;
-    }
-    PacketNode* packet_node = static_cast<PacketNode*>(plan->get_node(pb::PACKET_NODE));
-    if (packet_node == nullptr) {
-        DB_WARNING("prepare_stmt plan packet node is null");
-        return false;
+    std::vector<ResultField> fields;
+    uint16_t parameters = 0;
+    if (query_ctx->shared_plan != nullptr) {
+        // 共享模板的句柄没有执行树
+        fields = query_ctx->shared_plan->fields;
+        parameters = query_ctx->shared_plan->num_params;
+    } else {
+        ExecNode* plan = query_ctx->root;
+        if (plan == nullptr) {
+            DB_WARNING("prepare_stmt plan is null");
+            return false;
+        }
+        PacketNode* packet_node = static_cast<PacketNode*>(plan->get_node(pb::PACKET_NODE));
+        if (packet_node == nullptr) {
+            DB_WARNING("prepare_stmt plan packet node is null");
+            return false;
+        }
+        fields = packet_node->fields();
+        parameters = query_ctx->placeholders.size();
     }
     uint8_t status = '\x00';
     uint32_t stmt_id = (uint32_t)sock->stmt_id;
-    uint16_t columns = packet_node->field_count();
-    uint16_t parameters = query_ctx->placeholders.size();
+    uint16_t columns = fields.size();
     // DB_WARNING("stmt_id: %u, columns: %u, params: %u", stmt_id, columns, parameters);
     DataBuffer tmp_buf;
     if (!tmp_buf.byte_array_append_len(&status, 1)) {
@@ -767,7 +813,13 @@ bool MysqlWrapper::make_stmt_prepare_ok_packet(SmartSocket sock) {
         make_eof_packet(sock->send_buf, ++sock->packet_id);        
     }
     if (columns > 0) {
-        packet_node->pack_fields(sock->send_buf, sock->packet_id);
+        for (auto& field : fields) {
+            if (!make_field_packet(sock->send_buf, &field, ++sock->packet_id)) {
+                DB_FATAL("Failed to append prepared_stmt column packet");
+                return false;
+            }
+        }
+        make_eof_packet(sock->send_buf, ++sock->packet_id);
     }
     return true;
 }
@@ -16,6 +16,7 @@
 #include <boost/algorithm/string.hpp>
 #include "network_server.h"
 #include "query_context.h"
+#include "plan_cache.h"
 #include <rapidjson/reader.h>
 #include <rapidjson/document.h>
 #include <boost/algorithm/string/join.hpp>
@@ -851,6 +852,10 @@ int StateMachine::_query_read_stmt_execute(SmartSocket sock) {
     }
     uint8_t new_parameter_bound_flag = 0;
     int num_params = prepare_ctx->placeholders.size();
+    if (prepare_ctx->shared_plan != nullptr) {
+        // 共享模板的句柄第一次execute时才生成执行树
+        num_params = prepare_ctx->shared_plan->num_params;
+    }
     //DB_WARNING("iteration_count is: %lu, param_count: %d", iteration_count, num_params);
 
     uint8_t* null_bitmap = nullptr;
@@ -2945,7 +2950,8 @@ bool StateMachine::_handle_client_query_common_query(SmartSocket client) {
             client->on_commit_rollback();
          } 
         client->query_ctx->stat_info.query_exec_time = cost.get_time();
-        client->query_ctx->stat_info.send_buf_size = client->send_buf->_size;
+        // 流式返回时已发送的部分在PacketNode里累加
+        client->query_ctx->stat_info.send_buf_size += client->send_buf->_size;
     } else {
         ret = PhysicalPlanner::full_export_start(client->query_ctx.get(), client->send_buf);
         client->query_ctx->stat_info.query_exec_time += cost.get_time();
@@ -14,6 +14,7 @@
 
 #include "log_entry_reader.h"
 #include "my_raft_log_storage.h"
+#include "segment_log_storage.h"
 #include "common.h"
 #include "table_key.h"
 #include "mut_table_key.h"
@@ -21,6 +22,18 @@
 
 namespace baikaldb {
 int LogEntryReader::read_log_entry(int64_t region_id, int64_t log_index, std::string& log_entry) {
+    if (SegmentLogManager::get_instance()->is_inited()) {
+        int type = 0;
+        if (SegmentLogManager::get_instance()->read_entry(region_id, log_index, &type, &log_entry) != 0) {
+            DB_FATAL("read log entry fail, region_id: %ld, log_index: %ld", region_id, log_index);
+            return -1;
+        }
+        if (type != braft::ENTRY_TYPE_DATA) {
+            DB_FATAL("log entry is not data, log_index:%ld, region_id: %ld", log_index, region_id);
+            return -1;
+        }
+        return 0;
+    }
     MutTableKey log_data_key;
     log_data_key.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(log_index);
     std::string log_value;
@@ -48,6 +61,16 @@ int LogEntryReader::read_log_entry(int64_t region_id, int64_t start_log_index, i
         DB_FATAL("region_id:%ld, start_log_index:%ld, end_log_index:%ld", region_id, start_log_index, end_log_index);
         return -1;
     }
+    if (SegmentLogManager::get_instance()->is_inited()) {
+        std::map<int64_t, std::pair<uint64_t, std::string>> txn_entrys;
+        if (_read_segment_txn_entry(region_id, start_log_index, end_log_index, txn_ids, txn_entrys) != 0) {
+            return -1;
+        }
+        for (auto& pair : txn_entrys) {
+            log_entrys[pair.first].swap(pair.second.second);
+        }
+        return 0;
+    }
     TimeCost cost;
     std::string log_entry;
     MutTableKey log_data_key;
@@ -81,33 +104,63 @@ int LogEntryReader::read_log_entry(int64_t region_id, int64_t start_log_index, i
             DB_WARNING("log entry is not data, region_id: %ld head.type: %d", region_id, head.type);
             continue;
         }
-        pb::StoreReq store_req;
-        if (!store_req.ParseFromArray(value_slice.data(), value_slice.size())) {
-            DB_FATAL("Fail to parse request fail, region_id: %ld", region_id);
+        uint64_t txn_id = 0;
+        int ret = _parse_txn_id(region_id, value_slice, txn_ids, &txn_id);
+        if (ret < 0) {
             return -1;
         }
-
-        if (store_req.op_type() != pb::OP_INSERT
-            && store_req.op_type() != pb::OP_DELETE
-            && store_req.op_type() != pb::OP_UPDATE
-            && store_req.op_type() != pb::OP_PREPARE
-            && store_req.op_type() != pb::OP_PREPARE_V2
-            && store_req.op_type() != pb::OP_ROLLBACK
-            && store_req.op_type() != pb::OP_COMMIT) {
-            //DB_WARNING("log entry is not txn, region_id: %ld head.type: %d", region_id, store_req.op_type());
-            continue;
+        if (ret > 0) {
+            log_entrys[log_index] = value_slice.ToString();
+            DB_WARNING("read txn log entry region_id:%ld, log_index:%ld, txn_id:%ld", region_id, log_index, txn_id);
         }
+    }
+    DB_WARNING("read txn log entry region_id:%ld, time_cost:%ld", region_id, cost.get_time());
+    return 0;
+}
 
-        if (store_req.txn_infos_size() > 0) {
-            uint64_t txn_id = store_req.txn_infos(0).txn_id();
-            if (txn_ids.count(txn_id) == 1) {
-                log_entrys[log_index] = value_slice.ToString();
-                DB_WARNING("read txn log entry region_id:%ld, log_index:%ld, txn_id:%ld", region_id, log_index, txn_id);
+int LogEntryReader::read_log_entries(int64_t region_id, int64_t start_log_index, int max_num,
+        std::vector<RaftLogEntry>& entries) {
+    SegmentLogManager* manager = SegmentLogManager::get_instance();
+    if (manager->is_inited()) {
+        int64_t last_log_index = manager->last_log_index(region_id);
+        int64_t log_index = start_log_index;
+        for (int i = 0; i < max_num && log_index <= last_log_index; ++i, ++log_index) {
+            RaftLogEntry entry;
+            entry.index = log_index;
+            if (manager->read_entry(region_id, log_index, &entry.type, &entry.term,
+                        &entry.data) != 0) {
+                DB_FATAL("read log entry fail, region_id: %ld, log_index: %ld",
+                        region_id, log_index);
+                return -1;
             }
+            entries.push_back(std::move(entry));
         }
+        return log_index <= last_log_index ? 1 : 0;
     }
-    DB_WARNING("read txn log entry region_id:%ld, time_cost:%ld", region_id, cost.get_time());
-    return 0;
+    MutTableKey log_data_key;
+    MutTableKey prefix;
+    log_data_key.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(start_log_index);
+    prefix.append_i64(region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY);
+    rocksdb::ReadOptions options;
+    options.prefix_same_as_start = true;
+    options.total_order_seek = false;
+    std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(options, _log_cf));
+    iter->Seek(log_data_key.data());
+    for (int i = 0; iter->Valid() && i < max_num; iter->Next(), i++) {
+        if (!iter->key().starts_with(prefix.data())) {
+            return 0;
+        }
+        rocksdb::Slice value_slice(iter->value());
+        LogHead head(value_slice);
+        value_slice.remove_prefix(MyRaftLogStorage::LOG_HEAD_SIZE);
+        RaftLogEntry entry;
+        entry.index = TableKey(iter->key()).extract_i64(sizeof(int64_t) + 1);
+        entry.term = head.term;
+        entry.type = head.type;
+        entry.data.assign(value_slice.data(), value_slice.size());
+        entries.push_back(std::move(entry));
+    }
+    return (iter->Valid() && iter->key().starts_with(prefix.data())) ? 1 : 0;
 }
 
 int LogEntryReader::read_txn_last_log_entry(int64_t region_id, int64_t start_log_index, int64_t end_log_index,
@@ -115,6 +168,17 @@ int LogEntryReader::read_txn_last_log_entry(int64_t region_id, int64_t start_log
     if (txn_ids.empty()) {
         return 0;
     }
+    if (SegmentLogManager::get_instance()->is_inited()) {
+        std::map<int64_t, std::pair<uint64_t, std::string>> txn_entrys;
+        if (_read_segment_txn_entry(region_id, start_log_index, end_log_index, txn_ids, txn_entrys) != 0) {
+            return -1;
+        }
+        // 按index升序覆盖，保留每个事务的最后一条
+        for (auto& pair : txn_entrys) {
+            log_entrys[pair.second.first].swap(pair.second.second);
+        }
+        return 0;
+    }
     TimeCost cost;
     std::string log_entry;
     MutTableKey log_data_key;
@@ -149,32 +213,70 @@ int LogEntryReader::read_txn_last_log_entry(int64_t region_id, int64_t start_log
             DB_WARNING("log entry is not data, region_id: %ld head.type: %d", region_id, head.type);
             continue;
         }
-        pb::StoreReq store_req;
-        if (!store_req.ParseFromArray(value_slice.data(), value_slice.size())) {
-            DB_FATAL("Fail to parse request fail, region_id: %ld", region_id);
+        uint64_t txn_id = 0;
+        int ret = _parse_txn_id(region_id, value_slice, txn_ids, &txn_id);
+        if (ret < 0) {
             return -1;
         }
+        if (ret > 0) {
+            log_entrys[txn_id] = value_slice.ToString();
+            DB_WARNING("read txn log entry region_id:%ld, log_index:%ld, txn_id:%ld", region_id, log_index, txn_id);
+        }
+    }
+    DB_WARNING("read txn log entry region_id:%ld, time_cost:%ld", region_id, cost.get_time());
+    return 0;
+}
 
-        if (store_req.op_type() != pb::OP_INSERT
-            && store_req.op_type() != pb::OP_DELETE
-            && store_req.op_type() != pb::OP_UPDATE
-            && store_req.op_type() != pb::OP_PREPARE
-            && store_req.op_type() != pb::OP_PREPARE_V2
-            && store_req.op_type() != pb::OP_ROLLBACK
-            && store_req.op_type() != pb::OP_COMMIT) {
-            //DB_WARNING("log entry is not txn, region_id: %ld head.type: %d", region_id, store_req.op_type());
+int LogEntryReader::_parse_txn_id(int64_t region_id, const rocksdb::Slice& value,
+        const std::set<uint64_t>& txn_ids, uint64_t* txn_id) {
+    pb::StoreReq store_req;
+    if (!store_req.ParseFromArray(value.data(), value.size())) {
+        DB_FATAL("Fail to parse request fail, region_id: %ld", region_id);
+        return -1;
+    }
+    if (store_req.op_type() != pb::OP_INSERT
+        && store_req.op_type() != pb::OP_DELETE
+        && store_req.op_type() != pb::OP_UPDATE
+        && store_req.op_type() != pb::OP_PREPARE
+        && store_req.op_type() != pb::OP_PREPARE_V2
+        && store_req.op_type() != pb::OP_ROLLBACK
+        && store_req.op_type() != pb::OP_COMMIT) {
+        return 0;
+    }
+    if (store_req.txn_infos_size() == 0) {
+        return 0;
+    }
+    *txn_id = store_req.txn_infos(0).txn_id();
+    return txn_ids.count(*txn_id) == 1 ? 1 : 0;
+}
+
+int LogEntryReader::_read_segment_txn_entry(int64_t region_id, int64_t start_log_index,
+        int64_t end_log_index, const std::set<uint64_t>& txn_ids,
+        std::map<int64_t, std::pair<uint64_t, std::string>>& log_entrys) {
+    TimeCost cost;
+    SegmentLogManager* manager = SegmentLogManager::get_instance();
+    for (int64_t log_index = start_log_index; log_index <= end_log_index; ++log_index) {
+        int type = 0;
+        std::string value;
+        if (manager->read_entry(region_id, log_index, &type, &value) != 0) {
+            DB_WARNING("read end info, region_id: %ld, log_index:%ld", region_id, log_index);
+            break;
+        }
+        if (type != braft::ENTRY_TYPE_DATA) {
             continue;
         }
-
-        if (store_req.txn_infos_size() > 0) {
-            uint64_t txn_id = store_req.txn_infos(0).txn_id();
-            if (txn_ids.count(txn_id) == 1) {
-                log_entrys[txn_id] = value_slice.ToString();
-                DB_WARNING("read txn log entry region_id:%ld, log_index:%ld, txn_id:%ld", region_id, log_index, txn_id);
-            }
+        uint64_t txn_id = 0;
+        int ret = _parse_txn_id(region_id, rocksdb::Slice(value), txn_ids, &txn_id);
+        if (ret < 0) {
+            return -1;
+        }
+        if (ret > 0) {
+            log_entrys[log_index].first = txn_id;
+            log_entrys[log_index].second.swap(value);
+            DB_WARNING("read txn log entry region_id:%ld, log_index:%ld, txn_id:%ld", region_id, log_index, txn_id);
         }
     }
-    DB_WARNING("read txn log entry region_id:%ld, time_cost:%ld", region_id, cost.get_time());
+    DB_WARNING("read segment txn log entry region_id:%ld, time_cost:%ld", region_id, cost.get_time());
     return 0;
 }
 }
@@ -14,6 +14,7 @@
 
 #include <my_raft_log.h>
 #include <my_raft_log_storage.h>
+#include <segment_log_storage.h>
 #include <my_raft_meta_storage.h>
 #include <pthread.h> 
 
@@ -23,12 +24,15 @@ static pthread_once_t g_register_once = PTHREAD_ONCE_INIT;
 
 struct MyRaftExtension {
     MyRaftLogStorage my_raft_log_storage;
+    SegmentLogStorage segment_log_storage;
     MyRaftMetaStorage my_raft_meta_storage;
 };
 
 static void register_once_or_die() {
     static MyRaftExtension* s_ext = new MyRaftExtension;
     braft::log_storage_extension()->RegisterOrDie("myraftlog", &s_ext->my_raft_log_storage);
+    // log_uri=mysegmentlog://my_raft_log?id= 使用共享segment文件
+    braft::log_storage_extension()->RegisterOrDie("mysegmentlog", &s_ext->segment_log_storage);
 #ifdef BAIDU_INTERNAL
     braft::stable_storage_extension()->RegisterOrDie("myraftmeta", &s_ext->my_raft_meta_storage);
 #else
@@ -409,7 +409,7 @@ braft::FileAdaptor* RocksdbFileSystemAdaptor::open_writer_adaptor(const std::str
     RocksWrapper* db = RocksWrapper::get_instance();
     rocksdb::Options options;
     if (is_snapshot_data_file(path)) {
-        options = db->get_options(db->get_data_handle()); 
+        options = db->get_options(get_data_cf()); 
     } else {
         options = db->get_options(db->get_meta_info_handle());
     }
@@ -473,7 +473,7 @@ braft::FileAdaptor* RocksdbFileSystemAdaptor::open_reader_adaptor(const std::str
             read_options.snapshot = sc->snapshot;
             read_options.total_order_seek = true;
             read_options.iterate_upper_bound = &iter_context->upper_bound_slice;
-            rocksdb::ColumnFamilyHandle* column_family = RocksWrapper::get_instance()->get_data_handle();
+            rocksdb::ColumnFamilyHandle* column_family = get_data_cf();
             iter_context->iter.reset(RocksWrapper::get_instance()->new_iterator(read_options, column_family));
             iter_context->iter->Seek(prefix);
             sc->data_context = iter_context;
@@ -0,0 +1,801 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "segment_log_storage.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <gflags/gflags.h>
+#ifdef BAIDU_INTERNAL
+#include <base/crc32c.h>
+#include <base/raw_pack.h>
+#include <raft/local_storage.pb.h>
+#else
+#include <butil/crc32c.h>
+#include <butil/raw_pack.h>
+#include <braft/local_storage.pb.h>
+#endif
+#include "common.h"
+
+namespace baikaldb {
+DEFINE_string(segment_log_path, "./raft_data/segment_log", "shared segment raft log directory");
+DEFINE_int64(segment_log_max_bytes, 256 * 1024 * 1024LL, "segment raft log file size, default: 256M");
+DEFINE_bool(segment_log_sync, true, "fdatasync segment raft log after each group commit");
+
+static int parse_segment_log_uri(const std::string& uri, std::string& id) {
+    size_t pos = uri.find("id=");
+    if (pos == 0 || pos == std::string::npos) {
+        return -1;
+    }
+    id = uri.substr(pos + 3);
+    return 0;
+}
+
+static uint32_t record_crc(const char* head, const butil::IOBuf& data) {
+    uint32_t crc = butil::crc32c::Value(head, SegmentLogManager::RECORD_HEAD_SIZE - 4);
+    for (size_t i = 0; i < data.backing_block_num(); ++i) {
+        butil::StringPiece block = data.backing_block(i);
+        crc = butil::crc32c::Extend(crc, block.data(), block.size());
+    }
+    return crc;
+}
+
+struct RecordHead {
+    explicit RecordHead(const char* raw) {
+        butil::RawUnpacker(raw)
+                .unpack32(magic)
+                .unpack32(kind)
+                .unpack64((uint64_t&)region_id)
+                .unpack64((uint64_t&)index)
+                .unpack64((uint64_t&)term)
+                .unpack32(data_len)
+                .unpack32(crc);
+    }
+    uint32_t magic;
+    uint32_t kind;
+    int64_t region_id;
+    int64_t index;
+    int64_t term;
+    uint32_t data_len;
+    uint32_t crc;
+};
+
+static bool check_record(const RecordHead& head, const char* raw) {
+    if (head.magic != SegmentLogManager::RECORD_MAGIC) {
+        return false;
+    }
+    uint32_t crc = butil::crc32c::Value(raw, SegmentLogManager::RECORD_HEAD_SIZE - 4);
+    crc = butil::crc32c::Extend(crc, raw + SegmentLogManager::RECORD_HEAD_SIZE, head.data_len);
+    return crc == head.crc;
+}
+
+static int pread_full(int fd, char* buf, size_t size, off_t offset) {
+    size_t read_size = 0;
+    while (read_size < size) {
+        ssize_t ret = ::pread(fd, buf + read_size, size - read_size, offset + read_size);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (ret == 0) {
+            break;
+        }
+        read_size += ret;
+    }
+    return read_size == size ? 0 : -1;
+}
+
+LogSegment::~LogSegment() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+int SegmentLogManager::init() {
+    BAIDU_SCOPED_LOCK(_mutex);
+    if (_is_inited.load()) {
+        return 0;
+    }
+    TimeCost cost;
+    _path = FLAGS_segment_log_path;
+    try {
+        boost::filesystem::create_directories(boost::filesystem::path(_path));
+    } catch (boost::filesystem::filesystem_error& e) {
+        DB_FATAL("create segment log path fail, path:%s, err:%s", _path.c_str(), e.what());
+        return -1;
+    }
+    if (_recover() != 0) {
+        DB_FATAL("recover segment log fail, path:%s", _path.c_str());
+        return -1;
+    }
+    if (_active == nullptr || _active->size >= FLAGS_segment_log_max_bytes) {
+        _active = _open_segment(_next_segment_id, true);
+        if (_active == nullptr) {
+            return -1;
+        }
+        _segments[_active->id] = _active;
+        ++_next_segment_id;
+    }
+    _is_inited.store(true);
+    DB_WARNING("segment log inited, path:%s, segments:%lu, regions:%lu, cost:%ld",
+            _path.c_str(), _segments.size(), _regions.size(), cost.get_time());
+    return 0;
+}
+
+int SegmentLogManager::_sync_dir() {
+    if (!FLAGS_segment_log_sync) {
+        return 0;
+    }
+    int dir_fd = ::open(_path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd < 0) {
+        DB_FATAL("open segment dir fail, path:%s, errno:%d", _path.c_str(), errno);
+        return -1;
+    }
+    int ret = ::fsync(dir_fd);
+    if (ret != 0) {
+        DB_FATAL("fsync segment dir fail, path:%s, errno:%d", _path.c_str(), errno);
+    }
+    ::close(dir_fd);
+    return ret == 0 ? 0 : -1;
+}
+
+SmartSegment SegmentLogManager::_open_segment(int64_t segment_id, bool create) {
+    SmartSegment segment(new LogSegment);
+    segment->id = segment_id;
+    char name[32];
+    snprintf(name, sizeof(name), "log_%020ld", segment_id);
+    segment->path = _path + "/" + name;
+    segment->fd = ::open(segment->path.c_str(), create ? (O_RDWR | O_CREAT) : O_RDWR, 0644);
+    if (segment->fd < 0) {
+        DB_FATAL("open segment fail, path:%s, errno:%d", segment->path.c_str(), errno);
+        return nullptr;
+    }
+    // 文件数据fdatasync了，但目录项没落盘的话宕机后整个segment会丢失
+    if (create && _sync_dir() != 0) {
+        return nullptr;
+    }
+    segment->size = ::lseek(segment->fd, 0, SEEK_END);
+    return segment;
+}
+
+int SegmentLogManager::_recover() {
+    std::map<int64_t, std::string> files;
+    boost::filesystem::directory_iterator end_iter;
+    for (boost::filesystem::directory_iterator iter(_path); iter != end_iter; ++iter) {
+        std::string name = iter->path().filename().string();
+        if (name.compare(0, 4, "log_") != 0) {
+            continue;
+        }
+        files[strtoll(name.c_str() + 4, NULL, 10)] = name;
+    }
+    for (auto iter = files.begin(); iter != files.end(); ++iter) {
+        SmartSegment segment = _open_segment(iter->first, false);
+        if (segment == nullptr) {
+            return -1;
+        }
+        _segments[segment->id] = segment;
+        bool is_last = (std::next(iter) == files.end());
+        if (_recover_segment(segment, is_last) != 0) {
+            return -1;
+        }
+        _active = segment;
+        _next_segment_id = segment->id + 1;
+    }
+    return 0;
+}
+
+int SegmentLogManager::_recover_segment(const SmartSegment& segment, bool is_last) {
+    int64_t offset = 0;
+    std::string buf;
+    char head_buf[RECORD_HEAD_SIZE];
+    while (offset + (int64_t)RECORD_HEAD_SIZE <= segment->size) {
+        if (pread_full(segment->fd, head_buf, RECORD_HEAD_SIZE, offset) != 0) {
+            break;
+        }
+        RecordHead head(head_buf);
+        size_t record_size = RECORD_HEAD_SIZE + head.data_len;
+        if (head.magic != RECORD_MAGIC || offset + (int64_t)record_size > segment->size) {
+            break;
+        }
+        buf.resize(record_size);
+        if (pread_full(segment->fd, &buf[0], record_size, offset) != 0
+                || !check_record(head, buf.data())) {
+            break;
+        }
+        _apply_record(segment->id, offset, record_size, head.kind,
+                head.region_id, head.index, head.term);
+        offset += record_size;
+    }
+    if (offset == segment->size) {
+        return 0;
+    }
+    // 只有最后一个segment可能因为宕机写了一半
+    if (!is_last) {
+        DB_FATAL("segment is corrupted, path:%s, offset:%ld, size:%ld",
+                segment->path.c_str(), offset, segment->size);
+        return -1;
+    }
+    DB_WARNING("truncate torn segment tail, path:%s, offset:%ld, size:%ld",
+            segment->path.c_str(), offset, segment->size);
+    if (::ftruncate(segment->fd, offset) != 0) {
+        DB_FATAL("ftruncate segment fail, path:%s, errno:%d", segment->path.c_str(), errno);
+        return -1;
+    }
+    segment->size = offset;
+    return 0;
+}
+
+void SegmentLogManager::_apply_record(int64_t segment_id, int64_t offset, uint32_t size,
+        uint32_t kind, int64_t region_id, int64_t index, int64_t term) {
+    if (kind == SEGMENT_REMOVE_REGION) {
+        _regions.erase(region_id);
+        for (auto& pair : _segments) {
+            pair.second->region_max_index.erase(region_id);
+        }
+        return;
+    }
+    SmartRegionLog& log = _regions[region_id];
+    if (log == nullptr) {
+        log.reset(new SegmentRegionLog);
+    }
+    switch (kind) {
+        case SEGMENT_TRUNCATE_PREFIX:
+            while (!log->entries.empty() && log->first_index < index) {
+                log->entries.pop_front();
+                ++log->first_index;
+            }
+            if (log->entries.empty()) {
+                log->first_index = index;
+            }
+            break;
+        case SEGMENT_TRUNCATE_SUFFIX:
+            while (!log->entries.empty() && log->last_index() > index) {
+                log->entries.pop_back();
+            }
+            break;
+        case SEGMENT_RESET:
+            log->entries.clear();
+            log->first_index = index;
+            break;
+        default:
+            if (index < log->first_index) {
+                return;
+            }
+            if (index > log->last_index() + 1) {
+                // 前面的segment已经回收，从第一条可见的日志开始
+                log->entries.clear();
+                log->first_index = index;
+            }
+            while (!log->entries.empty() && log->last_index() >= index) {
+                log->entries.pop_back();
+            }
+            log->entries.push_back({segment_id, offset, size, (int32_t)kind, term});
+            break;
+    }
+    auto iter = _segments.find(segment_id);
+    if (iter != _segments.end()) {
+        int64_t& max_index = iter->second->region_max_index[region_id];
+        max_index = std::max(max_index, index);
+    }
+}
+
+SmartRegionLog SegmentLogManager::get_region_log(int64_t region_id) {
+    BAIDU_SCOPED_LOCK(_mutex);
+    SmartRegionLog& log = _regions[region_id];
+    if (log == nullptr) {
+        log.reset(new SegmentRegionLog);
+    }
+    return log;
+}
+
+void SegmentLogManager::encode_record(uint32_t kind, int64_t region_id, int64_t index,
+        int64_t term, const butil::IOBuf& data, butil::IOBuf* record) {
+    char head[RECORD_HEAD_SIZE];
+    butil::RawPacker(head).pack32(RECORD_MAGIC)
+            .pack32(kind)
+            .pack64(region_id)
+            .pack64(index)
+            .pack64(term)
+            .pack32(data.size());
+    butil::RawPacker(head + RECORD_HEAD_SIZE - 4).pack32(record_crc(head, data));
+    record->append(head, RECORD_HEAD_SIZE);
+    record->append(data);
+}
+
+int SegmentLogManager::append(SegmentAppendTask* task) {
+    bthread_mutex_lock(&_write_mutex);
+    _pending.push_back(task);
+    while (!task->done) {
+        if (_writing) {
+            // 其他bthread正在写盘，等待它把本次task一起带走或者写完后接手
+            bthread_cond_wait(&_write_cond, &_write_mutex);
+            continue;
+        }
+        _writing = true;
+        std::vector<SegmentAppendTask*> tasks;
+        tasks.swap(_pending);
+        bthread_mutex_unlock(&_write_mutex);
+        int ret = _write_batch(tasks);
+        bthread_mutex_lock(&_write_mutex);
+        for (auto t : tasks) {
+            t->ret = ret;
+            t->done = true;
+        }
+        _writing = false;
+        bthread_cond_broadcast(&_write_cond);
+    }
+    bthread_mutex_unlock(&_write_mutex);
+    return task->ret;
+}
+
+int SegmentLogManager::_flush(const SmartSegment& segment, butil::IOBuf* buf) {
+    while (!buf->empty()) {
+        ssize_t ret = buf->pcut_into_file_descriptor(segment->fd, segment->size);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            DB_FATAL("write segment fail, path:%s, errno:%d", segment->path.c_str(), errno);
+            return -1;
+        }
+        segment->size += ret;
+    }
+    if (FLAGS_segment_log_sync && ::fdatasync(segment->fd) != 0) {
+        DB_FATAL("fdatasync segment fail, path:%s, errno:%d", segment->path.c_str(), errno);
+        return -1;
+    }
+    return 0;
+}
+
+// 只有持有_writing的bthread调用，_active的fd和size不需要额外加锁
+int SegmentLogManager::_write_batch(const std::vector<SegmentAppendTask*>& tasks) {
+    TimeCost cost;
+    SmartSegment segment;
+    {
+        BAIDU_SCOPED_LOCK(_mutex);
+        segment = _active;
+    }
+    butil::IOBuf buf;
+    size_t bytes = 0;
+    for (auto task : tasks) {
+        if (segment->size + (int64_t)(buf.size() + task->data.size()) > FLAGS_segment_log_max_bytes
+                && segment->size + buf.size() > 0) {
+            if (_flush(segment, &buf) != 0) {
+                return -1;
+            }
+            BAIDU_SCOPED_LOCK(_mutex);
+            SmartSegment new_segment = _open_segment(_next_segment_id, true);
+            if (new_segment == nullptr) {
+                return -1;
+            }
+            ++_next_segment_id;
+            _segments[new_segment->id] = new_segment;
+            _active = new_segment;
+            segment = new_segment;
+        }
+        task->segment_id = segment->id;
+        task->offset = segment->size + buf.size();
+        bytes += task->data.size();
+        buf.append(task->data);
+        BAIDU_SCOPED_LOCK(_mutex);
+        int64_t& max_index = segment->region_max_index[task->region_id];
+        max_index = std::max(max_index, task->max_index);
+    }
+    if (_flush(segment, &buf) != 0) {
+        return -1;
+    }
+    DB_DEBUG("segment group commit, tasks:%lu, bytes:%lu, cost:%ld",
+            tasks.size(), bytes, cost.get_time());
+    return 0;
+}
+
+int SegmentLogManager::append_marker(int64_t region_id, SegmentRecordKind kind, int64_t index) {
+    SegmentAppendTask task;
+    task.region_id = region_id;
+    task.max_index = index;
+    encode_record(kind, region_id, index, 0, butil::IOBuf(), &task.data);
+    return append(&task);
+}
+
+int SegmentLogManager::read_record(const SegmentEntryPos& pos, int64_t region_id,
+        int64_t index, std::string* data) {
+    SmartSegment segment;
+    {
+        BAIDU_SCOPED_LOCK(_mutex);
+        auto iter = _segments.find(pos.segment_id);
+        if (iter == _segments.end()) {
+            DB_WARNING("segment has been removed, segment_id:%ld, region_id: %ld, index:%ld",
+                    pos.segment_id, region_id, index);
+            return -1;
+        }
+        segment = iter->second;
+    }
+    std::string buf;
+    buf.resize(pos.size);
+    if (pos.size < RECORD_HEAD_SIZE
+            || pread_full(segment->fd, &buf[0], pos.size, pos.offset) != 0) {
+        DB_FATAL("read segment fail, path:%s, offset:%ld, region_id: %ld, index:%ld",
+                segment->path.c_str(), pos.offset, region_id, index);
+        return -1;
+    }
+    RecordHead head(buf.data());
+    if (head.region_id != region_id || head.index != index
+            || RECORD_HEAD_SIZE + head.data_len != pos.size || !check_record(head, buf.data())) {
+        DB_FATAL("record is corrupted, path:%s, offset:%ld, region_id: %ld, index:%ld",
+                segment->path.c_str(), pos.offset, region_id, index);
+        return -1;
+    }
+    data->assign(buf, RECORD_HEAD_SIZE, head.data_len);
+    return 0;
+}
+
+int64_t SegmentLogManager::last_log_index(int64_t region_id) {
+    SmartRegionLog log;
+    {
+        BAIDU_SCOPED_LOCK(_mutex);
+        auto iter = _regions.find(region_id);
+        if (iter == _regions.end()) {
+            return 0;
+        }
+        log = iter->second;
+    }
+    BAIDU_SCOPED_LOCK(log->mutex);
+    return log->last_index();
+}
+
+int SegmentLogManager::read_entry(int64_t region_id, int64_t index, int* type, int64_t* term,
+        std::string* data) {
+    SmartRegionLog log;
+    {
+        BAIDU_SCOPED_LOCK(_mutex);
+        auto iter = _regions.find(region_id);
+        if (iter == _regions.end()) {
+            return -1;
+        }
+        log = iter->second;
+    }
+    SegmentEntryPos pos;
+    {
+        BAIDU_SCOPED_LOCK(log->mutex);
+        if (index < log->first_index || index > log->last_index()) {
+            return -1;
+        }
+        pos = log->entries[index - log->first_index];
+    }
+    *type = pos.type;
+    *term = pos.term;
+    return read_record(pos, region_id, index, data);
+}
+
+void SegmentLogManager::remove_region(int64_t region_id) {
+    if (append_marker(region_id, SEGMENT_REMOVE_REGION, 0) != 0) {
+        DB_FATAL("append remove marker fail, region_id: %ld", region_id);
+        return;
+    }
+    {
+        BAIDU_SCOPED_LOCK(_mutex);
+        _regions.erase(region_id);
+        for (auto& pair : _segments) {
+            pair.second->region_max_index.erase(region_id);
+        }
+    }
+    DB_WARNING("remove region from segment log, region_id: %ld", region_id);
+    gc_segments();
+}
+
+// 调用方持有_mutex
+bool SegmentLogManager::_can_remove(const SmartSegment& segment) {
+    for (auto& pair : segment->region_max_index) {
+        auto iter = _regions.find(pair.first);
+        if (iter == _regions.end()) {
+            continue;
+        }
+        BAIDU_SCOPED_LOCK(iter->second->mutex);
+        if (iter->second->first_index <= pair.second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SegmentLogManager::gc_segments() {
+    std::vector<SmartSegment> removed;
+    {
+        BAIDU_SCOPED_LOCK(_mutex);
+        // 只回收最老的连续segment，保证恢复时truncate/reset标记不会先于它作用的日志被删除
+        while (!_segments.empty()) {
+            SmartSegment segment = _segments.begin()->second;
+            if (segment == _active || !_can_remove(segment)) {
+                break;
+            }
+            removed.push_back(segment);
+            _segments.erase(_segments.begin());
+        }
+    }
+    for (auto& segment : removed) {
+        if (::unlink(segment->path.c_str()) != 0) {
+            DB_WARNING("unlink segment fail, path:%s, errno:%d", segment->path.c_str(), errno);
+            continue;
+        }
+        DB_WARNING("remove segment, path:%s, size:%ld", segment->path.c_str(), segment->size);
+    }
+}
+
+braft::LogStorage* SegmentLogStorage::new_instance(const std::string& uri) const {
+    std::string string_region_id;
+    if (parse_segment_log_uri(uri, string_region_id) != 0) {
+        DB_FATAL("parse uri fail, uri:%s", uri.c_str());
+        return NULL;
+    }
+    int64_t region_id = boost::lexical_cast<int64_t>(string_region_id);
+    if (SegmentLogManager::get_instance()->init() != 0) {
+        DB_FATAL("init segment log manager fail, region_id: %ld", region_id);
+        return NULL;
+    }
+    braft::LogStorage* instance = new(std::nothrow) SegmentLogStorage(region_id);
+    if (instance == NULL) {
+        DB_FATAL("new log_storage instance fail, region_id: %ld", region_id);
+    }
+    return instance;
+}
+
+int SegmentLogStorage::init(braft::ConfigurationManager* configuration_manager) {
+    TimeCost time_cost;
+    _manager = SegmentLogManager::get_instance();
+    _log = _manager->get_region_log(_region_id);
+    std::vector<std::pair<int64_t, SegmentEntryPos>> conf_entries;
+    int64_t first_log_index = 0;
+    int64_t last_log_index = 0;
+    {
+        BAIDU_SCOPED_LOCK(_log->mutex);
+        for (size_t i = 0; i < _log->entries.size(); ++i) {
+            if (_log->entries[i].type == braft::ENTRY_TYPE_CONFIGURATION) {
+                conf_entries.emplace_back(_log->first_index + i, _log->entries[i]);
+            }
+        }
+        first_log_index = _log->first_index;
+        last_log_index = _log->last_index();
+    }
+    for (auto& pair : conf_entries) {
+        std::string value;
+        if (_manager->read_record(pair.second, _region_id, pair.first, &value) != 0) {
+            return -1;
+        }
+        scoped_refptr<braft::LogEntry> entry = new braft::LogEntry();
+        entry->id = braft::LogId(pair.first, pair.second.term);
+        if (_parse_meta(entry, value) != 0) {
+            DB_FATAL("Fail to parse meta at index:%ld, region_id: %ld",
+                        pair.first, _region_id);
+            return -1;
+        }
+        braft::ConfigurationEntry conf_entry;
+        conf_entry.id = entry->id;
+        conf_entry.conf = *(entry->peers);
+        if (entry->old_peers) {
+            conf_entry.old_conf = *(entry->old_peers);
+        }
+        configuration_manager->add(conf_entry);
+    }
+    DB_WARNING("region_id: %ld, first_log_index:%ld, last_log_index:%ld, time_cost: %ld",
+                _region_id, first_log_index, last_log_index, time_cost.get_time());
+    return 0;
+}
+
+int64_t SegmentLogStorage::first_log_index() {
+    BAIDU_SCOPED_LOCK(_log->mutex);
+    return _log->first_index;
+}
+
+int64_t SegmentLogStorage::last_log_index() {
+    BAIDU_SCOPED_LOCK(_log->mutex);
+    return _log->last_index();
+}
+
+braft::LogEntry* SegmentLogStorage::get_entry(const int64_t index) {
+    SegmentEntryPos pos;
+    {
+        BAIDU_SCOPED_LOCK(_log->mutex);
+        if (index < _log->first_index || index > _log->last_index()) {
+            DB_WARNING("index out of range, index:%ld, first_log_index:%ld, "
+                    "last_log_index:%ld, region_id: %ld",
+                    index, _log->first_index, _log->last_index(), _region_id);
+            return NULL;
+        }
+        pos = _log->entries[index - _log->first_index];
+    }
+    std::string value;
+    if (_manager->read_record(pos, _region_id, index, &value) != 0) {
+        return NULL;
+    }
+    braft::LogEntry* entry = new braft::LogEntry;
+    entry->AddRef();
+    entry->type = (braft::EntryType)pos.type;
+    entry->id = braft::LogId(index, pos.term);
+    switch (entry->type) {
+        case braft::ENTRY_TYPE_DATA:
+            entry->data.append(value);
+            break;
+        case braft::ENTRY_TYPE_CONFIGURATION:
+            if (_parse_meta(entry, value) != 0) {
+                entry->Release();
+                entry = NULL;
+            }
+            break;
+        case braft::ENTRY_TYPE_NO_OP:
+            if (value.size() != 0) {
+                DB_FATAL("Data of NO_OP must be empty, log index:%ld of region id:%ld",
+                        index, _region_id);
+                entry->Release();
+                entry = NULL;
+            }
+            break;
+        default:
+            DB_FATAL("Unknown entry type, log index:%ld of region id:%ld",
+                    index, _region_id);
+            entry->Release();
+            entry = NULL;
+            break;
+    }
+    return entry;
+}
+
+int64_t SegmentLogStorage::get_term(const int64_t index) {
+    BAIDU_SCOPED_LOCK(_log->mutex);
+    if (index < _log->first_index || index > _log->last_index()) {
+        return 0;
+    }
+    return _log->entries[index - _log->first_index].term;
+}
+
+int SegmentLogStorage::append_entry(const braft::LogEntry* entry) {
+    std::vector<braft::LogEntry*> entries;
+    entries.push_back(const_cast<braft::LogEntry*>(entry));
+    return append_entries(entries, nullptr) == 1 ? 0 : -1;
+}
+
+int SegmentLogStorage::append_entries(const std::vector<braft::LogEntry*>& entries,
+        braft::IOMetric* metric) {
+    TimeCost time_cost;
+    if (entries.empty()) {
+        return 0;
+    }
+    if (last_log_index() + 1 != entries.front()->id.index) {
+        DB_FATAL("There's gap betwenn appending entries and last_log_index,"
+                " last_log_index: %ld, entry_log_index: %ld, region_id: %ld",
+                last_log_index(), entries.front()->id.index, _region_id);
+        return -1;
+    }
+    SegmentAppendTask task;
+    task.region_id = _region_id;
+    task.max_index = entries.back()->id.index;
+    std::vector<SegmentEntryPos> positions;
+    positions.reserve(entries.size());
+    for (auto entry : entries) {
+        butil::IOBuf data;
+        if (entry->type == braft::ENTRY_TYPE_CONFIGURATION) {
+            braft::ConfigurationPBMeta meta;
+            for (auto& peer : *entry->peers) {
+                meta.add_peers(peer.to_string());
+            }
+            if (entry->old_peers != nullptr) {
+                for (auto& peer : *entry->old_peers) {
+                    meta.add_old_peers(peer.to_string());
+                }
+            }
+            butil::IOBufAsZeroCopyOutputStream wrapper(&data);
+            if (!meta.SerializeToZeroCopyStream(&wrapper)) {
+                DB_FATAL("Fail to serialize ConfigurationPBMeta, region_id: %ld", _region_id);
+                return -1;
+            }
+        } else if (entry->type == braft::ENTRY_TYPE_DATA) {
+            data = entry->data;
+        }
+        size_t offset = task.data.size();
+        SegmentLogManager::encode_record(entry->type, _region_id, entry->id.index,
+                entry->id.term, data, &task.data);
+        positions.push_back({0, (int64_t)offset, (uint32_t)(task.data.size() - offset),
+                (int32_t)entry->type, entry->id.term});
+    }
+    if (_manager->append(&task) != 0) {
+        DB_FATAL("append segment log fail, region_id: %ld", _region_id);
+        return -1;
+    }
+    {
+        BAIDU_SCOPED_LOCK(_log->mutex);
+        for (auto& pos : positions) {
+            pos.segment_id = task.segment_id;
+            pos.offset += task.offset;
+            _log->entries.push_back(pos);
+        }
+    }
+    DB_DEBUG("append segment log, region_id: %ld, entries:%lu, time_cost:%ld",
+            _region_id, entries.size(), time_cost.get_time());
+    return entries.size();
+}
+
+int SegmentLogStorage::truncate_prefix(const int64_t first_index_kept) {
+    if (first_index_kept <= first_log_index()) {
+        return 0;
+    }
+    if (_manager->append_marker(_region_id, SEGMENT_TRUNCATE_PREFIX, first_index_kept) != 0) {
+        return -1;
+    }
+    {
+        BAIDU_SCOPED_LOCK(_log->mutex);
+        while (!_log->entries.empty() && _log->first_index < first_index_kept) {
+            _log->entries.pop_front();
+            ++_log->first_index;
+        }
+        if (_log->entries.empty()) {
+            _log->first_index = first_index_kept;
+        }
+    }
+    _manager->gc_segments();
+    return 0;
+}
+
+int SegmentLogStorage::truncate_suffix(const int64_t last_index_kept) {
+    if (_manager->append_marker(_region_id, SEGMENT_TRUNCATE_SUFFIX, last_index_kept) != 0) {
+        return -1;
+    }
+    BAIDU_SCOPED_LOCK(_log->mutex);
+    while (!_log->entries.empty() && _log->last_index() > last_index_kept) {
+        _log->entries.pop_back();
+    }
+    return 0;
+}
+
+int SegmentLogStorage::reset(const int64_t next_log_index) {
+    if (next_log_index <= 0) {
+        DB_FATAL("Invalid next_log_index:%ld, region_id: %ld", next_log_index, _region_id);
+        return EINVAL;
+    }
+    if (_manager->append_marker(_region_id, SEGMENT_RESET, next_log_index) != 0) {
+        return -1;
+    }
+    {
+        BAIDU_SCOPED_LOCK(_log->mutex);
+        _log->entries.clear();
+        _log->first_index = next_log_index;
+    }
+    _manager->gc_segments();
+    return 0;
+}
+
+int SegmentLogStorage::_parse_meta(braft::LogEntry* entry, const std::string& value) {
+    braft::ConfigurationPBMeta meta;
+    if (!meta.ParseFromString(value)) {
+        DB_FATAL("Fail to parse ConfigurationPBMeta, region_id: %ld", _region_id);
+        return -1;
+    }
+    entry->peers = new std::vector<braft::PeerId>;
+    for (int j = 0; j < meta.peers_size(); ++j) {
+        entry->peers->push_back(braft::PeerId(meta.peers(j)));
+    }
+    if (meta.old_peers_size() > 0) {
+        entry->old_peers = new std::vector<braft::PeerId>;
+        for (int i = 0; i < meta.old_peers_size(); i++) {
+            entry->old_peers->push_back(braft::PeerId(meta.old_peers(i)));
+        }
+    }
+    return 0;
+}
+
+} //namespace baikaldb
+
+/* vim: set expandtab ts=4 sw=4 sts=4 tw=100: */
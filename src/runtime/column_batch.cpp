@@ -0,0 +1,605 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "column_batch.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace baikaldb {
+DEFINE_bool(use_column_batch, false, "use columnar batch in scan/filter/agg/sort/packet");
+
+void ColumnVector::reserve(size_t capacity) {
+    switch (_storage) {
+        case CS_INT:
+            _int_data.reserve(capacity);
+            break;
+        case CS_UINT:
+            _uint_data.reserve(capacity);
+            break;
+        case CS_DOUBLE:
+            _double_data.reserve(capacity);
+            break;
+        case CS_STRING:
+            _string_data.reserve(capacity);
+            break;
+    }
+    _null_bitmap.reserve((capacity + 63) / 64);
+}
+
+void ColumnVector::resize(size_t size) {
+    switch (_storage) {
+        case CS_INT:
+            _int_data.resize(size, 0);
+            break;
+        case CS_UINT:
+            _uint_data.resize(size, 0);
+            break;
+        case CS_DOUBLE:
+            _double_data.resize(size, 0);
+            break;
+        case CS_STRING:
+            _string_data.resize(size);
+            break;
+    }
+    // 新增的行默认为null，新word全置1，已有word中_size之后的位从未被清过
+    _null_bitmap.resize((size + 63) / 64, ~0ULL);
+    _size = size;
+}
+
+void ColumnVector::set_value(size_t idx, const ExprValue& value) {
+    if (value.is_null()) {
+        set_null(idx);
+        return;
+    }
+    ExprValue tmp = value;
+    tmp.cast_to(_type);
+    switch (_storage) {
+        case CS_INT:
+            _int_data[idx] = tmp.get_numberic<int64_t>();
+            break;
+        case CS_UINT:
+            _uint_data[idx] = tmp.get_numberic<uint64_t>();
+            break;
+        case CS_DOUBLE:
+            _double_data[idx] = tmp.get_numberic<double>();
+            break;
+        case CS_STRING:
+            _string_data[idx].swap(tmp.str_val);
+            break;
+    }
+    set_not_null(idx);
+}
+
+ExprValue ColumnVector::get_value(size_t idx) const {
+    if (is_null(idx)) {
+        return ExprValue::Null();
+    }
+    ExprValue value(_type);
+    switch (_type) {
+        case pb::BOOL:
+            value._u.bool_val = _int_data[idx] != 0;
+            break;
+        case pb::INT8:
+            value._u.int8_val = _int_data[idx];
+            break;
+        case pb::INT16:
+            value._u.int16_val = _int_data[idx];
+            break;
+        case pb::INT32:
+        case pb::TIME:
+            value._u.int32_val = _int_data[idx];
+            break;
+        case pb::INT64:
+            value._u.int64_val = _int_data[idx];
+            break;
+        case pb::UINT8:
+            value._u.uint8_val = _uint_data[idx];
+            break;
+        case pb::UINT16:
+            value._u.uint16_val = _uint_data[idx];
+            break;
+        case pb::UINT32:
+        case pb::DATE:
+        case pb::TIMESTAMP:
+            value._u.uint32_val = _uint_data[idx];
+            break;
+        case pb::UINT64:
+        case pb::DATETIME:
+            value._u.uint64_val = _uint_data[idx];
+            break;
+        case pb::FLOAT:
+            value._u.float_val = _double_data[idx];
+            break;
+        case pb::DOUBLE:
+            value._u.double_val = _double_data[idx];
+            break;
+        default:
+            value.str_val = _string_data[idx];
+            break;
+    }
+    return value;
+}
+
+void ColumnVector::fill_value(const ExprValue& value, const std::vector<uint32_t>* selection) {
+    if (value.is_null()) {
+        for_each_selected(_size, selection, [this](size_t idx) {
+            set_null(idx);
+        });
+        return;
+    }
+    ExprValue tmp = value;
+    tmp.cast_to(_type);
+    switch (_storage) {
+        case CS_INT: {
+            int64_t v = tmp.get_numberic<int64_t>();
+            int64_t* data = _int_data.data();
+            for_each_selected(_size, selection, [data, v](size_t idx) {
+                data[idx] = v;
+            });
+            break;
+        }
+        case CS_UINT: {
+            uint64_t v = tmp.get_numberic<uint64_t>();
+            uint64_t* data = _uint_data.data();
+            for_each_selected(_size, selection, [data, v](size_t idx) {
+                data[idx] = v;
+            });
+            break;
+        }
+        case CS_DOUBLE: {
+            double v = tmp.get_numberic<double>();
+            double* data = _double_data.data();
+            for_each_selected(_size, selection, [data, v](size_t idx) {
+                data[idx] = v;
+            });
+            break;
+        }
+        case CS_STRING: {
+            std::string* data = _string_data.data();
+            for_each_selected(_size, selection, [data, &tmp](size_t idx) {
+                data[idx] = tmp.str_val;
+            });
+            break;
+        }
+    }
+    for_each_selected(_size, selection, [this](size_t idx) {
+        set_not_null(idx);
+    });
+}
+
+void ColumnVector::copy_from(const ColumnVector& src, const std::vector<uint32_t>* selection) {
+    if (!column_type_compatible(src._type, _type)) {
+        for_each_selected(_size, selection, [this, &src](size_t idx) {
+            set_value(idx, src.get_value(idx));
+        });
+        return;
+    }
+    if (selection == nullptr) {
+        switch (_storage) {
+            case CS_INT:
+                std::copy(src._int_data.begin(), src._int_data.begin() + _size, _int_data.begin());
+                break;
+            case CS_UINT:
+                std::copy(src._uint_data.begin(), src._uint_data.begin() + _size, _uint_data.begin());
+                break;
+            case CS_DOUBLE:
+                std::copy(src._double_data.begin(), src._double_data.begin() + _size,
+                        _double_data.begin());
+                break;
+            case CS_STRING:
+                std::copy(src._string_data.begin(), src._string_data.begin() + _size,
+                        _string_data.begin());
+                break;
+        }
+        std::copy(src._null_bitmap.begin(), src._null_bitmap.begin() + _null_bitmap.size(),
+                _null_bitmap.begin());
+        return;
+    }
+    for (uint32_t idx : *selection) {
+        switch (_storage) {
+            case CS_INT:
+                _int_data[idx] = src._int_data[idx];
+                break;
+            case CS_UINT:
+                _uint_data[idx] = src._uint_data[idx];
+                break;
+            case CS_DOUBLE:
+                _double_data[idx] = src._double_data[idx];
+                break;
+            case CS_STRING:
+                _string_data[idx] = src._string_data[idx];
+                break;
+        }
+        if (src.is_null(idx)) {
+            set_null(idx);
+        } else {
+            set_not_null(idx);
+        }
+    }
+}
+
+void ColumnVector::append_from(const ColumnVector& src, const std::vector<uint32_t>* selection) {
+    size_t start = _size;
+    size_t dst_idx = start;
+    resize(start + (selection == nullptr ? src._size : selection->size()));
+    if (!column_type_compatible(src._type, _type)) {
+        for_each_selected(src._size, selection, [this, &src, &dst_idx](size_t idx) {
+            set_value(dst_idx++, src.get_value(idx));
+        });
+        return;
+    }
+    // 新增的行默认为null，只需要设置非null的行
+    switch (_storage) {
+        case CS_INT:
+            for_each_selected(src._size, selection, [this, &src, &dst_idx](size_t idx) {
+                _int_data[dst_idx++] = src._int_data[idx];
+            });
+            break;
+        case CS_UINT:
+            for_each_selected(src._size, selection, [this, &src, &dst_idx](size_t idx) {
+                _uint_data[dst_idx++] = src._uint_data[idx];
+            });
+            break;
+        case CS_DOUBLE:
+            for_each_selected(src._size, selection, [this, &src, &dst_idx](size_t idx) {
+                _double_data[dst_idx++] = src._double_data[idx];
+            });
+            break;
+        case CS_STRING:
+            for_each_selected(src._size, selection, [this, &src, &dst_idx](size_t idx) {
+                _string_data[dst_idx++] = src._string_data[idx];
+            });
+            break;
+    }
+    dst_idx = start;
+    for_each_selected(src._size, selection, [this, &src, &dst_idx](size_t idx) {
+        if (!src.is_null(idx)) {
+            set_not_null(dst_idx);
+        }
+        ++dst_idx;
+    });
+}
+
+void ColumnVector::to_pb(pb::ColumnValues* values) const {
+    for (auto word : _null_bitmap) {
+        values->add_null_bitmap(word);
+    }
+    switch (_storage) {
+        case CS_INT:
+            values->mutable_int_values()->Reserve(_size);
+            for (size_t i = 0; i < _size; i++) {
+                values->add_int_values(_int_data[i]);
+            }
+            break;
+        case CS_UINT:
+            values->mutable_uint_values()->Reserve(_size);
+            for (size_t i = 0; i < _size; i++) {
+                values->add_uint_values(_uint_data[i]);
+            }
+            break;
+        case CS_DOUBLE:
+            values->mutable_double_values()->Reserve(_size);
+            for (size_t i = 0; i < _size; i++) {
+                values->add_double_values(_double_data[i]);
+            }
+            break;
+        case CS_STRING: {
+            // 不同值超过一半时字典没有收益
+            std::unordered_map<std::string, uint32_t> dict;
+            std::vector<const std::string*> dict_values;
+            std::vector<uint32_t> dict_ids;
+            dict_ids.reserve(_size);
+            bool use_dict = true;
+            for (size_t i = 0; i < _size; i++) {
+                auto iter = dict.find(_string_data[i]);
+                if (iter == dict.end()) {
+                    if (dict.size() >= _size / 2 + 1) {
+                        use_dict = false;
+                        break;
+                    }
+                    iter = dict.emplace(_string_data[i], dict_values.size()).first;
+                    dict_values.push_back(&iter->first);
+                }
+                dict_ids.push_back(iter->second);
+            }
+            if (use_dict) {
+                for (auto value : dict_values) {
+                    values->add_string_values(*value);
+                }
+                values->mutable_dict_ids()->Reserve(_size);
+                for (auto id : dict_ids) {
+                    values->add_dict_ids(id);
+                }
+            } else {
+                for (size_t i = 0; i < _size; i++) {
+                    values->add_string_values(_string_data[i]);
+                }
+            }
+            break;
+        }
+    }
+}
+
+int ColumnVector::from_pb(const pb::ColumnValues& values, size_t size) {
+    resize(size);
+    if (values.null_bitmap_size() != (int)_null_bitmap.size()) {
+        return -1;
+    }
+    for (size_t i = 0; i < _null_bitmap.size(); i++) {
+        _null_bitmap[i] = values.null_bitmap(i);
+    }
+    switch (_storage) {
+        case CS_INT:
+            if (values.int_values_size() != (int)size) {
+                return -1;
+            }
+            for (size_t i = 0; i < size; i++) {
+                _int_data[i] = values.int_values(i);
+            }
+            break;
+        case CS_UINT:
+            if (values.uint_values_size() != (int)size) {
+                return -1;
+            }
+            for (size_t i = 0; i < size; i++) {
+                _uint_data[i] = values.uint_values(i);
+            }
+            break;
+        case CS_DOUBLE:
+            if (values.double_values_size() != (int)size) {
+                return -1;
+            }
+            for (size_t i = 0; i < size; i++) {
+                _double_data[i] = values.double_values(i);
+            }
+            break;
+        case CS_STRING:
+            if (values.dict_ids_size() > 0) {
+                if (values.dict_ids_size() != (int)size) {
+                    return -1;
+                }
+                for (size_t i = 0; i < size; i++) {
+                    uint32_t id = values.dict_ids(i);
+                    if (id >= (uint32_t)values.string_values_size()) {
+                        return -1;
+                    }
+                    _string_data[i] = values.string_values(id);
+                }
+            } else {
+                if (values.string_values_size() != (int)size) {
+                    return -1;
+                }
+                for (size_t i = 0; i < size; i++) {
+                    _string_data[i] = values.string_values(i);
+                }
+            }
+            break;
+    }
+    return 0;
+}
+
+int ColumnBatch::init(const std::vector<pb::TupleDescriptor>& tuple_descs) {
+    _columns.clear();
+    for (auto& tuple_desc : tuple_descs) {
+        int32_t tuple_id = tuple_desc.tuple_id();
+        if (tuple_id < 0) {
+            DB_WARNING("invalid tuple_id:%d", tuple_id);
+            return -1;
+        }
+        if (tuple_id >= (int32_t)_columns.size()) {
+            _columns.resize(tuple_id + 1);
+        }
+        int32_t max_slot_id = 0;
+        for (auto& slot : tuple_desc.slots()) {
+            max_slot_id = std::max(max_slot_id, slot.slot_id());
+        }
+        auto& columns = _columns[tuple_id];
+        columns.resize(max_slot_id);
+        for (auto& slot : tuple_desc.slots()) {
+            columns[slot.slot_id() - 1] = ColumnVector(slot.slot_type());
+            columns[slot.slot_id() - 1].reserve(_capacity);
+        }
+    }
+    _is_inited = true;
+    clear();
+    return 0;
+}
+
+size_t ColumnBatch::add_row() {
+    for (auto& columns : _columns) {
+        for (auto& column : columns) {
+            column.append_null();
+        }
+    }
+    if (!_all_selected) {
+        _selection.push_back(_size);
+    }
+    return _size++;
+}
+
+void ColumnBatch::clear() {
+    for (auto& columns : _columns) {
+        for (auto& column : columns) {
+            column.clear();
+        }
+    }
+    _selection.clear();
+    _all_selected = true;
+    _size = 0;
+}
+
+std::vector<uint32_t>* ColumnBatch::mutable_selection() {
+    if (_all_selected) {
+        _selection.resize(_size);
+        for (size_t i = 0; i < _size; i++) {
+            _selection[i] = i;
+        }
+        _all_selected = false;
+    }
+    return &_selection;
+}
+
+void ColumnBatch::skip_rows(size_t num_skip_rows) {
+    if (num_skip_rows == 0) {
+        return;
+    }
+    std::vector<uint32_t>* selection = mutable_selection();
+    if (num_skip_rows >= selection->size()) {
+        selection->clear();
+        return;
+    }
+    selection->erase(selection->begin(), selection->begin() + num_skip_rows);
+}
+
+void ColumnBatch::keep_first_rows(size_t num_keep_rows) {
+    if (num_keep_rows >= selected_size()) {
+        return;
+    }
+    mutable_selection()->resize(num_keep_rows);
+}
+
+int ColumnBatch::append_tuple(int32_t tuple_id, MemRow* row, size_t idx) {
+    if (tuple_id < 0 || tuple_id >= (int32_t)_columns.size()) {
+        return -1;
+    }
+    auto& columns = _columns[tuple_id];
+    for (size_t slot_idx = 0; slot_idx < columns.size(); slot_idx++) {
+        columns[slot_idx].set_value(idx, row->get_value(tuple_id, slot_idx + 1));
+    }
+    return 0;
+}
+
+int ColumnBatch::append_row(MemRow* row) {
+    size_t idx = add_row();
+    for (size_t tuple_id = 0; tuple_id < _columns.size(); tuple_id++) {
+        if (row->get_tuple(tuple_id) == nullptr) {
+            continue;
+        }
+        append_tuple(tuple_id, row, idx);
+    }
+    return 0;
+}
+
+int ColumnBatch::append_row_batch(RowBatch& batch) {
+    for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+        int ret = append_row(batch.get_row().get());
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int ColumnBatch::append_batch(const ColumnBatch& src) {
+    if (src._columns.size() != _columns.size()) {
+        return -1;
+    }
+    for (size_t tuple_id = 0; tuple_id < _columns.size(); tuple_id++) {
+        if (src._columns[tuple_id].size() != _columns[tuple_id].size()) {
+            return -1;
+        }
+    }
+    const std::vector<uint32_t>* selection = src.selection();
+    for (size_t tuple_id = 0; tuple_id < _columns.size(); tuple_id++) {
+        auto& columns = _columns[tuple_id];
+        for (size_t slot_idx = 0; slot_idx < columns.size(); slot_idx++) {
+            columns[slot_idx].append_from(src._columns[tuple_id][slot_idx], selection);
+        }
+    }
+    size_t selected = src.selected_size();
+    if (!_all_selected) {
+        for (size_t i = 0; i < selected; i++) {
+            _selection.push_back(_size + i);
+        }
+    }
+    _size += selected;
+    return 0;
+}
+
+void ColumnBatch::fill_row(size_t idx, MemRow* row) {
+    for (size_t tuple_id = 0; tuple_id < _columns.size(); tuple_id++) {
+        if (row->get_tuple(tuple_id) == nullptr) {
+            continue;
+        }
+        auto& columns = _columns[tuple_id];
+        for (size_t slot_idx = 0; slot_idx < columns.size(); slot_idx++) {
+            row->set_value(tuple_id, slot_idx + 1, columns[slot_idx].get_value(idx));
+        }
+    }
+}
+
+void ColumnBatch::fill_slots(size_t idx, const std::vector<std::pair<int32_t, int32_t>>& slots,
+        MemRow* row) {
+    for (auto& slot : slots) {
+        row->set_value(slot.first, slot.second, get_value(idx, slot.first, slot.second));
+    }
+}
+
+std::unique_ptr<MemRow> ColumnBatch::to_mem_row(size_t idx, MemRowDescriptor* desc) {
+    std::unique_ptr<MemRow> row = desc->fetch_mem_row();
+    fill_row(idx, row.get());
+    return row;
+}
+
+int ColumnBatch::to_row_batch(MemRowDescriptor* desc, RowBatch* batch) {
+    size_t selected = selected_size();
+    for (size_t i = 0; i < selected; i++) {
+        batch->move_row(to_mem_row(selected_idx(i), desc));
+    }
+    return 0;
+}
+
+void ColumnBatch::to_pb(pb::ColumnarRows* rows) const {
+    rows->set_row_count(_size);
+    for (size_t tuple_id = 0; tuple_id < _columns.size(); tuple_id++) {
+        auto& columns = _columns[tuple_id];
+        for (size_t slot_idx = 0; slot_idx < columns.size(); slot_idx++) {
+            pb::ColumnValues* values = rows->add_columns();
+            values->set_tuple_id(tuple_id);
+            values->set_slot_id(slot_idx + 1);
+            columns[slot_idx].to_pb(values);
+        }
+    }
+}
+
+int ColumnBatch::from_pb(const pb::ColumnarRows& rows) {
+    clear();
+    if (rows.row_count() < 0) {
+        return -1;
+    }
+    _size = rows.row_count();
+    // 没有传输的列保持全null
+    for (auto& columns : _columns) {
+        for (auto& column : columns) {
+            column.resize(_size);
+        }
+    }
+    for (auto& values : rows.columns()) {
+        ColumnVector* column = get_column(values.tuple_id(), values.slot_id());
+        if (column == nullptr) {
+            DB_WARNING("column not found, tuple_id:%d, slot_id:%d", 
+                    values.tuple_id(), values.slot_id());
+            return -1;
+        }
+        if (column->from_pb(values, _size) < 0) {
+            DB_WARNING("decode column fail, tuple_id:%d, slot_id:%d", 
+                    values.tuple_id(), values.slot_id());
+            return -1;
+        }
+    }
+    return 0;
+}
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
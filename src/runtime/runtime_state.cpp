@@ -19,6 +19,8 @@
 
 namespace baikaldb {
 DEFINE_int32(per_txn_max_num_locks, 1000000, "max num locks per txn default 100w");
+DEFINE_int64(query_memory_limit, 1024 * 1024 * 1024LL, 
+        "memory budget per query for sort/agg/join, spill to disk when exceeded, 0 means no limit");
 RuntimeState::~RuntimeState() {}
 
 int RuntimeState::init(const pb::StoreReq& req,
@@ -105,6 +107,41 @@ int RuntimeState::init(QueryContext* ctx, DataBuffer* send_buf) {
     _is_inited = true;
     return 0;
 }
+int RuntimeState::init(RuntimeState* parent) {
+    set_client_conn(parent->client_conn());
+    txn_id = parent->txn_id;
+    seq_id = parent->seq_id;
+    explain_type = parent->explain_type;
+    scan_class = parent->scan_class;
+    is_full_export = parent->is_full_export;
+    _log_id = parent->log_id();
+    _is_cancelled = parent->is_cancelled();
+    _single_sql_autocommit = parent->single_sql_autocommit();
+    _optimize_1pc = parent->optimize_1pc();
+    _tuple_descs = parent->tuple_descs();
+    if (_tuple_descs.size() > 0) {
+        // 相同的tuple描述共享layout，子state取的行可以交给父state的算子使用
+        int ret = _mem_row_desc.init(_tuple_descs);
+        if (ret < 0) {
+            DB_WARNING("_mem_row_desc init fail");
+            return -1;
+        }
+    }
+    _is_inited = true;
+    return 0;
+}
+
+void RuntimeState::merge_sub_state(RuntimeState* sub) {
+    inc_num_scan_rows(sub->num_scan_rows());
+    inc_num_filter_rows(sub->num_filter_rows());
+    if (!sub->optimize_1pc()) {
+        _optimize_1pc = false;
+    }
+    if (sub->error_code != ER_ERROR_FIRST) {
+        error_code = sub->error_code;
+        error_msg.str(sub->error_msg.str());
+    }
+}
 /*
 int RuntimeState::init(const pb::CachePlan& commit_plan) {
     txn_id = _client_conn->txn_id;
@@ -13,8 +13,109 @@
 // limitations under the License.
 
 #include "sorter.h"
+#include "runtime_state.h"
 
 namespace baikaldb {
+Sorter::~Sorter() {
+    if (_state != nullptr) {
+        _state->release_memory(_mem_bytes);
+    }
+}
+
+int Sorter::add_batch(std::shared_ptr<RowBatch>& batch) {
+    batch->reset();
+    if (_state != nullptr && !_comp->need_not_compare()) {
+        int64_t bytes = estimate_bytes(batch.get());
+        if (!_state->try_consume_memory(bytes)) {
+            if (!_min_heap.empty()) {
+                int ret = spill();
+                if (ret < 0) {
+                    return ret;
+                }
+            }
+            _state->consume_memory(bytes);
+        }
+        _mem_bytes += bytes;
+    }
+    _min_heap.push_back(batch);
+    return 0;
+}
+
+// 抽样计算序列化大小，避免每行都反射一遍
+int64_t Sorter::estimate_bytes(RowBatch* batch) {
+    static const size_t SAMPLE_ROWS = 16;
+    static const int64_t TUPLE_OVERHEAD = 64;
+    size_t rows = batch->size();
+    if (rows == 0) {
+        return 0;
+    }
+    size_t step = std::max(rows / SAMPLE_ROWS, (size_t)1);
+    size_t sampled = 0;
+    int64_t bytes = 0;
+    size_t i = 0;
+    for (batch->reset(); !batch->is_traverse_over(); batch->next(), i++) {
+        if (i % step != 0) {
+            continue;
+        }
+        MemRow* row = batch->get_row().get();
+        for (int32_t tuple_id = 0; tuple_id < _mem_row_desc->tuple_size(); tuple_id++) {
+            auto tuple = row->get_tuple(tuple_id);
+            if (tuple != nullptr) {
+                bytes += tuple->ByteSize() + TUPLE_OVERHEAD;
+            }
+        }
+        ++sampled;
+    }
+    batch->reset();
+    return bytes * rows / sampled;
+}
+
+// 内存中的batch排序归并后写成一个run
+int Sorter::spill() {
+    TimeCost cost;
+    if (_min_heap.size() == 1) {
+        _min_heap[0]->sort(_comp);
+    } else if (_min_heap.size() > 1) {
+        multi_sort();
+        make_heap();
+    }
+    std::string path = SpillFile::make_path("sort", _state->log_id());
+    if (path.empty()) {
+        return -1;
+    }
+    std::shared_ptr<SpillFile> run = std::make_shared<SpillFile>(path, _mem_row_desc);
+    int ret = run->open_write();
+    if (ret < 0) {
+        return ret;
+    }
+    bool eos = false;
+    while (!eos) {
+        RowBatch batch;
+        ret = merge_next(&batch, &eos);
+        if (ret < 0) {
+            return ret;
+        }
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            ret = run->append(batch.get_row().get());
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+    ret = run->finish_write();
+    if (ret < 0) {
+        return ret;
+    }
+    _min_heap.clear();
+    _state->release_memory(_mem_bytes);
+    _mem_bytes = 0;
+    _spill_bytes += run->bytes();
+    _runs.push_back(run);
+    DB_WARNING("sort spill run:%lu bytes:%ld cost:%ld, log_id:%lu", 
+            _runs.size(), run->bytes(), cost.get_time(), _state->log_id());
+    return 0;
+}
+
 int Sorter::get_next(RowBatch* batch, bool* eos) {
     if (_min_heap.size() == 0) {
         *eos = true;
@@ -28,6 +129,15 @@ int Sorter::get_next(RowBatch* batch, bool* eos) {
         ++_idx;
         return 0;
     }
+    TimeCost cost;
+    int ret = merge_next(batch, eos);
+    if (!_runs.empty()) {
+        _merge_time += cost.get_time();
+    }
+    return ret;
+}
+
+int Sorter::merge_next(RowBatch* batch, bool* eos) {
     while (1) {
         if (batch->is_full()) {
             return 0;
@@ -38,8 +148,21 @@ int Sorter::get_next(RowBatch* batch, bool* eos) {
         }
         batch->move_row(std::move(_min_heap[0]->get_row()));
         _min_heap[0]->next();
-        //堆顶batch遍历完后，pop出去
+        //堆顶batch遍历完后，如果来自run则继续读，否则pop出去
         if (_min_heap[0]->is_traverse_over()) {
+            auto iter = _run_readers.find(_min_heap[0].get());
+            if (iter != _run_readers.end()) {
+                _min_heap[0]->clear();
+                int ret = iter->second->read(_min_heap[0].get());
+                if (ret < 0) {
+                    return ret;
+                }
+                if (_min_heap[0]->size() > 0) {
+                    shiftdown(0);
+                    continue;
+                }
+                _run_readers.erase(iter);
+            }
             iter_swap(_min_heap.begin(), _min_heap.end() - 1);
             _min_heap.pop_back();
             if (!_min_heap.empty()) {
@@ -51,16 +174,44 @@ int Sorter::get_next(RowBatch* batch, bool* eos) {
     }
     return 0;
 }
-void Sorter::sort() {
+
+int Sorter::sort() {
     if (_comp->need_not_compare()) {
-        return;
+        return 0;
+    }
+    if (_runs.empty()) {
+        if (_min_heap.size() == 1) {
+            _min_heap[0]->sort(_comp);
+        } else if (_min_heap.size() > 1) {
+            multi_sort();
+            make_heap();
+        }
+        return 0;
     }
+    // 有落盘的run，内存中剩余的batch和所有run一起k路归并
     if (_min_heap.size() == 1) {
         _min_heap[0]->sort(_comp);
     } else if (_min_heap.size() > 1) {
         multi_sort();
-        make_heap();
     }
+    for (auto& run : _runs) {
+        int ret = run->open_read();
+        if (ret < 0) {
+            return ret;
+        }
+        std::shared_ptr<RowBatch> batch = std::make_shared<RowBatch>();
+        ret = run->read(batch.get());
+        if (ret < 0) {
+            return ret;
+        }
+        if (batch->size() == 0) {
+            continue;
+        }
+        _run_readers[batch.get()] = run;
+        _min_heap.push_back(batch);
+    }
+    make_heap();
+    return 0;
 }
 void Sorter::merge_sort() {
     if (_comp->need_not_compare()) {
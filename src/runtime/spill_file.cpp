@@ -0,0 +1,146 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "spill_file.h"
+#include <atomic>
+#ifdef BAIDU_INTERNAL
+#include <base/files/file_util.h>
+#include <base/files/file_enumerator.h>
+#else
+#include <butil/files/file_util.h>
+#include <butil/files/file_enumerator.h>
+#endif
+
+namespace baikaldb {
+DEFINE_string(spill_dir, "./spill", "local dir for sort/agg/join spill files");
+
+SpillFile::~SpillFile() {
+    if (_out.is_open()) {
+        _out.close();
+    }
+    if (_in.is_open()) {
+        _in.close();
+    }
+    butil::DeleteFile(butil::FilePath(_path), false);
+}
+
+int SpillFile::open_write() {
+    _out.open(_path, std::ios::binary | std::ios::trunc);
+    if (!_out.is_open()) {
+        DB_WARNING("open spill file fail, path:%s", _path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+int SpillFile::append(MemRow* row) {
+    for (int32_t tuple_id = 0; tuple_id < _mem_row_desc->tuple_size(); tuple_id++) {
+        _buf.clear();
+        row->to_string(tuple_id, &_buf);
+        uint32_t len = _buf.size();
+        _out.write((const char*)&len, sizeof(len));
+        _out.write(_buf.data(), len);
+        _bytes += sizeof(len) + len;
+    }
+    if (!_out.good()) {
+        DB_WARNING("write spill file fail, path:%s", _path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+int SpillFile::finish_write() {
+    _out.close();
+    if (_out.fail()) {
+        DB_WARNING("close spill file fail, path:%s", _path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+int SpillFile::open_read() {
+    // 可以重复打开，从头读
+    if (_in.is_open()) {
+        _in.close();
+    }
+    _in.clear();
+    _in.open(_path, std::ios::binary);
+    if (!_in.is_open()) {
+        DB_WARNING("open spill file fail, path:%s", _path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+int SpillFile::read(RowBatch* batch) {
+    while (!batch->is_full()) {
+        uint32_t len = 0;
+        if (!_in.read((char*)&len, sizeof(len))) {
+            if (_in.eof() && _in.gcount() == 0) {
+                return 0;
+            }
+            DB_WARNING("read spill file fail, path:%s", _path.c_str());
+            return -1;
+        }
+        std::unique_ptr<MemRow> row = _mem_row_desc->fetch_mem_row();
+        for (int32_t tuple_id = 0; tuple_id < _mem_row_desc->tuple_size(); tuple_id++) {
+            if (tuple_id > 0 && !_in.read((char*)&len, sizeof(len))) {
+                DB_WARNING("read spill file fail, path:%s", _path.c_str());
+                return -1;
+            }
+            _buf.resize(len);
+            if (len > 0 && !_in.read(&_buf[0], len)) {
+                DB_WARNING("read spill file fail, path:%s", _path.c_str());
+                return -1;
+            }
+            row->from_string(tuple_id, _buf);
+        }
+        batch->move_row(std::move(row));
+    }
+    return 0;
+}
+
+std::string SpillFile::make_path(const std::string& prefix, uint64_t log_id) {
+    static std::atomic<uint64_t> seq(0);
+    butil::FilePath dir(FLAGS_spill_dir);
+    if (!butil::DirectoryExists(dir) && !butil::CreateDirectory(dir)) {
+        DB_WARNING("create spill dir fail, dir:%s", FLAGS_spill_dir.c_str());
+        return "";
+    }
+    return FLAGS_spill_dir + "/" + prefix + "_" + std::to_string(log_id) + "_" +
+        std::to_string(seq++);
+}
+
+void SpillFile::clean_spill_dir() {
+    butil::FilePath dir(FLAGS_spill_dir);
+    if (!butil::DirectoryExists(dir)) {
+        return;
+    }
+    // 只删make_path生成的文件，spill_dir配错时不误删其他文件
+    int64_t count = 0;
+    for (const char* pattern : {"sort_*", "agg_*", "join_*"}) {
+        butil::FileEnumerator files(dir, false, butil::FileEnumerator::FILES, pattern);
+        for (butil::FilePath path = files.Next(); !path.empty(); path = files.Next()) {
+            if (butil::DeleteFile(path, false)) {
+                ++count;
+            } else {
+                DB_WARNING("delete stale spill file fail, path:%s", path.value().c_str());
+            }
+        }
+    }
+    DB_WARNING("clean spill dir:%s, deleted %ld stale files", FLAGS_spill_dir.c_str(), count);
+}
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -0,0 +1,57 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "topn_sorter.h"
+#include <algorithm>
+
+namespace baikaldb {
+DEFINE_int64(topn_max_limit, 100000, "use top-n heap for order by limit when limit <= topn_max_limit");
+
+void TopNSorter::add_batch(RowBatch* batch) {
+    auto less = _comp->get_less_func();
+    for (batch->reset(); !batch->is_traverse_over(); batch->next()) {
+        std::unique_ptr<MemRow>& row = batch->get_row();
+        if ((int64_t)_heap.size() < _limit) {
+            _heap.push_back(std::move(row));
+            std::push_heap(_heap.begin(), _heap.end(), less);
+            continue;
+        }
+        if (!_comp->less(row.get(), _heap[0].get())) {
+            ++_discard_rows;
+            continue;
+        }
+        std::pop_heap(_heap.begin(), _heap.end(), less);
+        _heap.back() = std::move(row);
+        std::push_heap(_heap.begin(), _heap.end(), less);
+        ++_discard_rows;
+    }
+    batch->clear();
+}
+
+void TopNSorter::sort() {
+    std::sort_heap(_heap.begin(), _heap.end(), _comp->get_less_func());
+    _idx = 0;
+}
+
+int TopNSorter::get_next(RowBatch* batch, bool* eos) {
+    while (_idx < _heap.size() && !batch->is_full()) {
+        batch->move_row(std::move(_heap[_idx]));
+        ++_idx;
+    }
+    *eos = _idx >= _heap.size();
+    return 0;
+}
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -96,7 +96,11 @@ int Backup::dump_sst_file(BackupInfo& backup_info) {
 int Backup::backup_datainfo_to_file(const std::string& path, int64_t& file_size) {
     uint64_t row = 0;
     RocksWrapper* db = RocksWrapper::get_instance();
-    rocksdb::Options options = db->get_options(db->get_data_handle()); 
+    rocksdb::ColumnFamilyHandle* data_cf = db->get_data_handle();
+    if (auto region_ptr = _region.lock()) {
+        data_cf = region_ptr->get_data_cf();
+    }
+    rocksdb::Options options = db->get_options(data_cf); 
 
     std::unique_ptr<SstFileWriter> writer(new SstFileWriter(options));
     rocksdb::ExternalSstFileInfo sst_file_info;
@@ -110,6 +114,8 @@ int Backup::backup_datainfo_to_file(const std::string& path, int64_t& file_size)
     rocksdb::ReadOptions read_options;
     read_options.prefix_same_as_start = false;
     read_options.total_order_seek = true;
+    set_scan_read_options(SCAN_BACKUP, &read_options);
+    ScanCacheStat cache_stat(SCAN_BACKUP);
     std::string prefix;
     MutTableKey key;
 
@@ -119,7 +125,7 @@ int Backup::backup_datainfo_to_file(const std::string& path, int64_t& file_size)
     rocksdb::Slice upper_bound_slice = key.data();
     read_options.iterate_upper_bound = &upper_bound_slice;
 
-    std::unique_ptr<rocksdb::Iterator> iter(RocksWrapper::get_instance()->new_iterator(read_options, db->get_data_handle()));
+    std::unique_ptr<rocksdb::Iterator> iter(RocksWrapper::get_instance()->new_iterator(read_options, data_cf));
     for (iter->Seek(prefix); iter->Valid(); iter->Next()) {
         auto s = writer->put(iter->key(), iter->value());       
         if (!s.ok()) {
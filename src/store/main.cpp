@@ -27,6 +27,7 @@
 #include "reverse_common.h"
 #include "fn_manager.h"
 #include "schema_factory.h"
+#include "spill_file.h"
 
 namespace baikaldb {
 DECLARE_int32(store_port);
@@ -102,6 +103,8 @@ int main(int argc, char **argv) {
         DB_FATAL("SchemaFactory init failed");
         return -1;
     }
+    // 上次退出时没来得及删除的落盘文件
+    baikaldb::SpillFile::clean_spill_dir();
 
     //add service
     brpc::Server server;
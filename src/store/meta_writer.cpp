@@ -37,6 +37,8 @@ const std::string MetaWriter::DOING_SNAPSHOT_IDENTIFY(1, 0x07);
 const std::string MetaWriter::REGION_DDL_INFO_IDENTIFY(1, 0x08);
 
 const std::string MetaWriter::ROLLBACKED_TXN_IDENTIFY(1, 0x09);
+//key: META_IDENIFY + region_id + identify : data column family name
+const std::string MetaWriter::DATA_CF_IDENTIFY(1, 0x0A);
 
 int MetaWriter::init_meta_info(const pb::RegionInfo& region_info) {
     std::vector<std::string> keys;
@@ -100,6 +102,16 @@ int MetaWriter::update_region_ddl_info(const pb::StoreRegionDdlInfo& region_ddl_
     }
     return 0; 
 }
+int MetaWriter::update_data_cf(int64_t region_id, const std::string& cf_name) {
+    auto status = _rocksdb->put(MetaWriter::write_options, _meta_cf,
+                    rocksdb::Slice(data_cf_key(region_id)), rocksdb::Slice(cf_name));
+    if (!status.ok()) {
+        DB_FATAL("write update_data_cf fail, err_msg: %s, region_id: %ld",
+                status.ToString().c_str(), region_id);
+        return -1;
+    }
+    return 0;
+}
 int MetaWriter::update_num_table_lines(int64_t region_id, int64_t num_table_lines) {
     auto status = _rocksdb->put(MetaWriter::write_options, _meta_cf,
                     rocksdb::Slice(num_table_lines_key(region_id)), 
@@ -156,8 +168,13 @@ int MetaWriter::write_doing_snapshot(int64_t region_id) {
     }
     return 0;
 }
-int MetaWriter::write_batch(rocksdb::WriteBatch* updates, int64_t region_id) {
-    auto status = _rocksdb->write(MetaWriter::write_options, updates);
+int MetaWriter::write_batch(rocksdb::WriteBatch* updates, int64_t region_id, bool skip_lock) {
+    rocksdb::Status status;
+    if (skip_lock) {
+        status = _rocksdb->write_skip_lock(MetaWriter::write_options, updates);
+    } else {
+        status = _rocksdb->write(MetaWriter::write_options, updates);
+    }
     if (!status.ok()) {
         DB_FATAL("write batch fail, err_msg: %s, region_id: %ld",
                     status.ToString().c_str(), region_id);
@@ -262,6 +279,7 @@ int MetaWriter::clear_all_meta_info(int64_t drop_region_id) {
     batch.Delete(_meta_cf, applied_index_key(drop_region_id));
     batch.Delete(_meta_cf, num_table_lines_key(drop_region_id));
     batch.Delete(_meta_cf, doing_snapshot_key(drop_region_id));
+    batch.Delete(_meta_cf, data_cf_key(drop_region_id));
     auto status = _rocksdb->write(options, &batch);
     if (!status.ok()) {
         DB_FATAL("drop region fail, error: code=%d, msg=%s, region_id: %ld", 
@@ -492,6 +510,19 @@ int MetaWriter::read_region_ddl_info(int64_t region_id, pb::StoreRegionDdlInfo&
     }
     return 0;
 }
+int MetaWriter::read_data_cf(int64_t region_id, std::string& cf_name) {
+    rocksdb::ReadOptions options;
+    auto status = _rocksdb->get(options, _meta_cf, rocksdb::Slice(data_cf_key(region_id)), &cf_name);
+    if (status.IsNotFound()) {
+        return 1;
+    }
+    if (!status.ok()) {
+        DB_WARNING("region_id: %ld read data cf fail, err_msg: %s",
+                region_id, status.ToString().c_str());
+        return -1;
+    }
+    return 0;
+}
 int MetaWriter::read_doing_snapshot(int64_t region_id) {
     std::string value;
     rocksdb::ReadOptions options;
@@ -534,6 +565,13 @@ std::string MetaWriter::region_ddl_info_key(int64_t region_id) const {
     key.append_char(MetaWriter::REGION_DDL_INFO_IDENTIFY.data(), 1);
     return key.data();
 }
+std::string MetaWriter::data_cf_key(int64_t region_id) const {
+    MutTableKey key;
+    key.append_char(MetaWriter::META_IDENTIFY.data(), 1);
+    key.append_i64(region_id);
+    key.append_char(MetaWriter::DATA_CF_IDENTIFY.data(), 1);
+    return key.data();
+}
 std::string MetaWriter::applied_index_key(int64_t region_id) const {
     MutTableKey key;
     key.append_char(MetaWriter::META_IDENTIFY.data(), 1);
@@ -14,17 +14,20 @@
 
 #include "region.h"
 #include <algorithm>
+#include <tuple>
 #include <fstream>
 #include <boost/filesystem.hpp>
 #include "table_key.h"
 #include "runtime_state.h"
 #include "mem_row_descriptor.h"
 #include "exec_node.h"
+#include "column_batch.h"
 #include "table_record.h"
 #include "my_raft_log_storage.h"
 #include "log_entry_reader.h"
 #include "raft_log_compaction_filter.h"
 #include "split_compaction_filter.h"
+#include "sst_file_writer.h"
 #include "rpc_sender.h"
 #include "concurrency.h"
 #include "store.h"
@@ -51,7 +54,7 @@ namespace baikaldb {
 DEFINE_int32(election_timeout_ms, 1000, "raft election timeout(ms)");
 DEFINE_int32(skew, 5, "split skew, default : 45% - 55%");
 DEFINE_int32(reverse_level2_len, 5000, "reverse index level2 length, default : 5000");
-DEFINE_string(log_uri, "myraftlog://my_raft_log?id=", "raft log uri");
+DEFINE_string(log_uri, "myraftlog://my_raft_log?id=", "raft log uri, mysegmentlog://my_raft_log?id= for shared segment log");
 //不兼容配置，默认用写到rocksdb的信息; raft自带的local://./raft_data/stable/region_
 DEFINE_string(stable_uri, "myraftmeta://my_raft_meta?id=", "raft stable path");
 DEFINE_string(snapshot_uri, "local://./raft_data/snapshot", "raft snapshot path");
@@ -60,6 +63,14 @@ DEFINE_int64(disable_write_wait_timeout_us, 1000 * 1000,
 DEFINE_int64(real_writing_wait_timeout_us, 1000 * 1000, 
         "real writing wait timeout(us) default 1s");
 DEFINE_int32(snapshot_interval_s, 600, "raft snapshot interval(s)");
+DEFINE_int32(select_cursor_timeout_s, 60, "select cursor will be released after the baikaldb "
+        "connection that opened it reads no page from this store for this(s)");
+DEFINE_bool(split_use_sst, true, "write split data of new region to sst files and ingest them");
+DEFINE_int32(split_sst_sub_ranges, 8, "max sub ranges of primary index written in parallel when split");
+DEFINE_bool(split_key_use_sst_meta, true, "choose split key by sst file boundaries and approximate sizes");
+DEFINE_int32(split_key_min_sst_files, 4, "fallback to scanning pk when region has fewer sst files");
+DEFINE_bool(apply_batch_1pc, true, "apply consecutive 1pc dml log entries in one rocksdb txn");
+DEFINE_int32(apply_batch_1pc_max_entries, 64, "max 1pc dml log entries in one apply batch");
 DEFINE_int32(snapshot_timed_wait, 120 * 1000 * 1000LL, "snapshot timed wait default 120S");
 DEFINE_int64(snapshot_diff_lines, 10000, "save_snapshot when num_table_lines diff");
 DEFINE_int64(snapshot_diff_logs, 2000, "save_snapshot when log entries diff");
@@ -68,6 +79,8 @@ DEFINE_int64(snapshot_log_exec_time_s, 60, "save_snapshot when log entries apply
 DEFINE_int64(split_duration_us, 3600 * 1000 * 1000LL, "split duration time : 3600s");
 DEFINE_int64(compact_delete_lines, 200000, "compact when _num_delete_lines > compact_delete_lines");
 DECLARE_int64(print_time_us);
+DECLARE_bool(ttl_compaction_filter);
+DECLARE_bool(use_column_batch);
 //const size_t  Region::REGION_MIN_KEY_SIZE = sizeof(int64_t) * 2 + sizeof(uint8_t);
 const uint8_t Region::PRIMARY_INDEX_FLAG = 0x01;                                   
 const uint8_t Region::SECOND_INDEX_FLAG = 0x02;
@@ -101,9 +114,40 @@ int Region::init(bool new_region, int32_t snapshot_times) {
     });
 
     _backup.set_info(get_ptr(), _region_id);
-    _data_cf = _rocksdb->get_data_handle();
     _meta_cf = _rocksdb->get_meta_info_handle();
     _meta_writer = MetaWriter::get_instance();
+    _data_cf = _rocksdb->get_data_handle(get_table_id());
+    if (_data_cf == nullptr) {
+        DB_FATAL("region_id: %ld get data cf fail", _region_id);
+        return -1;
+    }
+    // 数据cf在region生命周期内不能变化，记录在meta中，配置变化时拒绝启动
+    std::string data_cf_name = _data_cf->GetName();
+    if (!new_region) {
+        int ret = _meta_writer->read_data_cf(_region_id, data_cf_name);
+        if (ret < 0) {
+            DB_FATAL("region_id: %ld read data cf fail", _region_id);
+            return -1;
+        }
+        if (ret > 0) {
+            // 没有记录的老region数据都在默认的数据cf，补上记录
+            data_cf_name = RocksWrapper::DATA_CF;
+            if (_meta_writer->update_data_cf(_region_id, data_cf_name) != 0) {
+                DB_FATAL("region_id: %ld write data cf fail", _region_id);
+                return -1;
+            }
+        }
+        if (data_cf_name != _data_cf->GetName()) {
+            DB_FATAL("region_id: %ld data cf mismatch, recorded: %s, routed: %s, "
+                    "check rocks_data_cf_conf and table resource_tag",
+                    _region_id, data_cf_name.c_str(), _data_cf->GetName().c_str());
+            return -1;
+        }
+    } else if (_meta_writer->update_data_cf(_region_id, data_cf_name) != 0) {
+        DB_FATAL("region_id: %ld write data cf fail", _region_id);
+        return -1;
+    }
+    static_cast<RocksdbFileSystemAdaptor*>(_snapshot_adaptor.get())->set_data_cf(_data_cf);
     TimeCost time_cost;
     _resource.reset(new RegionResource);
     //如果是新建region需要
@@ -240,7 +284,7 @@ int Region::init(bool new_region, int32_t snapshot_times) {
     options.snapshot_uri = FLAGS_snapshot_uri + "/region_" + 
                                 boost::lexical_cast<std::string>(_region_id);
     options.snapshot_file_system_adaptor = &_snapshot_adaptor;
-    _txn_pool.init(_region_id, _use_ttl);
+    _txn_pool.init(_region_id, _use_ttl, _data_cf);
     if (_node.init(options) != 0) {
         DB_FATAL("raft node init fail, region_id: %ld, region_info:%s", 
                  _region_id, pb2json(_region_info).c_str());
@@ -1014,6 +1058,9 @@ void Region::query(google::protobuf::RpcController* controller,
     if (cntl->has_log_id()) { 
         log_id = cntl->log_id();
     }
+    if (request->op_type() == pb::OP_SELECT && request->compress_response()) {
+        cntl->set_response_compress_type(brpc::COMPRESS_TYPE_SNAPPY);
+    }
     if (request->op_type() == pb::OP_TXN_QUERY_STATE) {
         exec_txn_query_state(controller, request, response, done_guard.release());
         return;
@@ -1035,6 +1082,11 @@ void Region::query(google::protobuf::RpcController* controller,
         return;
     }
     response->set_leader(butil::endpoint2str(_node.leader_id().addr).c_str()); // 每次都返回leader
+    // 游标续读和关闭只访问已打开的执行树和快照，分裂或版本变化后仍可继续
+    if (request->op_type() == pb::OP_SELECT && request->cursor_id() != 0) {
+        select_cursor(*request, *response);
+        return;
+    }
     if (validate_version(request, response) == false) {
         //add_version的第二次或者打三次重试，需要把num_table_line返回回去
         if (request->op_type() == pb::OP_ADD_VERSION_FOR_SPLIT_REGION) {
@@ -1724,6 +1776,188 @@ void Region::dml_1pc(const pb::StoreReq& request, pb::OpType op_type,
     }
 }
 
+static void set_dml_closure_response(braft::Closure* done, const pb::StoreRes& res) {
+    if (done == nullptr) {
+        return;
+    }
+    pb::StoreRes* response = ((DMLClosure*)done)->response;
+    response->set_errcode(res.errcode());
+    if (res.has_errmsg()) {
+        response->set_errmsg(res.errmsg());
+    }
+    if (res.has_mysql_errcode()) {
+        response->set_mysql_errcode(res.mysql_errcode());
+    }
+    if (res.has_leader()) {
+        response->set_leader(res.leader());
+    }
+    if (res.has_affected_rows()) {
+        response->set_affected_rows(res.affected_rows());
+    }
+    if (res.has_scan_rows()) {
+        response->set_scan_rows(res.scan_rows());
+    }
+    if (res.has_filter_rows()) {
+        response->set_filter_rows(res.filter_rows());
+    }
+}
+
+bool Region::can_batch_1pc(const pb::StoreReq& request) {
+    if (!FLAGS_apply_batch_1pc) {
+        return false;
+    }
+    pb::OpType op_type = request.op_type();
+    if (op_type != pb::OP_INSERT && op_type != pb::OP_DELETE && op_type != pb::OP_UPDATE) {
+        return false;
+    }
+    if (request.txn_infos_size() > 0 && request.txn_infos(0).txn_id() != 0) {
+        return false;
+    }
+    return !request.is_trace() && request.plan().nodes_size() > 0;
+}
+
+// 批内每条日志设一个save point，单条执行失败只回滚自己，整批一次commit
+void Region::dml_1pc_batch(std::vector<Apply1pcEntry>& entries) {
+    if (entries.size() == 1) {
+        Apply1pcEntry& entry = entries[0];
+        pb::StoreRes res;
+        dml_1pc(entry.request, entry.request.op_type(), entry.request.plan(),
+                entry.request.tuples(), res, entry.index, entry.term);
+        set_dml_closure_response(entry.done, res);
+        if (entry.done) {
+            braft::run_closure_in_bthread(entry.done);
+        }
+        entries.clear();
+        return;
+    }
+    TimeCost cost;
+    Concurrency::get_instance()->service_write_concurrency.increase_wait();
+    ON_SCOPE_EXIT([]() {
+        Concurrency::get_instance()->service_write_concurrency.decrease_broadcast();
+    });
+    int64_t wait_cost = cost.get_time();
+    // 与dml_1pc一致，失败回滚的日志不推进applied_index，只记录最后一条成功的日志
+    int64_t applied_index = 0;
+    std::vector<pb::StoreRes> results(entries.size());
+    SmartTransaction txn;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const pb::StoreReq& request = entries[i].request;
+        pb::StoreRes& res = results[i];
+        uint64_t db_conn_id = request.db_conn_id();
+        if (db_conn_id == 0) {
+            db_conn_id = butil::fast_rand();
+        }
+        SmartState state_ptr = std::make_shared<RuntimeState>();
+        RuntimeState& state = *state_ptr;
+        {
+            BAIDU_SCOPED_LOCK(_ptr_mutex);
+            state.set_resource(_resource);
+        }
+        int ret = state.init(request, request.plan(), request.tuples(), &_txn_pool, false);
+        if (ret < 0) {
+            res.set_errcode(pb::EXEC_FAIL);
+            res.set_errmsg("RuntimeState init fail");
+            DB_FATAL("RuntimeState init fail, region_id: %ld, applied_index: %ld",
+                        _region_id, entries[i].index);
+            continue;
+        }
+        _state_pool.set(db_conn_id, state_ptr);
+        ON_SCOPE_EXIT(([this, db_conn_id]() {
+            _state_pool.remove(db_conn_id);
+        }));
+        if (txn == nullptr) {
+            txn = state.create_txn_if_null();
+            txn->set_region_info(&_region_info);
+        } else {
+            state.set_txn(txn);
+        }
+        int seq_id = i + 1;
+        txn->set_seq_id(seq_id);
+        txn->set_save_point();
+        {
+            BAIDU_SCOPED_LOCK(_reverse_index_map_lock);
+            state.set_reverse_index_map(_reverse_index_map);
+        }
+        ExecNode* root = nullptr;
+        ret = ExecNode::create_tree(request.plan(), &root);
+        if (ret < 0) {
+            ExecNode::destroy_tree(root);
+            txn->rollback_to_point(seq_id);
+            res.set_errcode(pb::EXEC_FAIL);
+            res.set_errmsg("create plan fail");
+            DB_FATAL("create plan fail, region_id: %ld, applied_index: %ld",
+                    _region_id, entries[i].index);
+            continue;
+        }
+        ret = root->open(&state);
+        root->close(&state);
+        ExecNode::destroy_tree(root);
+        if (ret < 0) {
+            txn->rollback_to_point(seq_id);
+            res.set_errcode(pb::EXEC_FAIL);
+            if (state.error_code != ER_ERROR_FIRST) {
+                res.set_mysql_errcode(state.error_code);
+                res.set_errmsg(state.error_msg.str());
+            } else {
+                res.set_errmsg("plan open fail");
+            }
+            DB_WARNING("plan open fail, region_id: %ld, applied_index: %ld, error_code: %d",
+                    _region_id, entries[i].index, state.error_code);
+            continue;
+        }
+        txn->num_increase_rows += state.num_increase_rows();
+        res.set_errcode(pb::SUCCESS);
+        res.set_affected_rows(ret);
+        res.set_scan_rows(state.num_scan_rows());
+        res.set_filter_rows(state.num_filter_rows());
+        applied_index = entries[i].index;
+    }
+    if (applied_index == 0) {
+        // 整批都失败，没有需要提交的数据，也不写meta
+        if (txn != nullptr) {
+            txn->rollback();
+        }
+    } else {
+        int64_t txn_num_increase_rows = txn->num_increase_rows;
+        int64_t tmp_num_table_lines = _num_table_lines + txn_num_increase_rows;
+        _meta_writer->write_meta_index_and_num_table_lines(_region_id, applied_index,
+                tmp_num_table_lines, txn);
+        auto status = txn->commit();
+        if (status.ok()) {
+            if (txn_num_increase_rows < 0) {
+                _num_delete_lines -= txn_num_increase_rows;
+            }
+            _num_table_lines = tmp_num_table_lines;
+        } else {
+            txn->rollback();
+            DB_FATAL("txn commit failed, region_id: %ld, applied_index: %ld, errcode:%d, msg:%s",
+                    _region_id, applied_index, status.code(), status.ToString().c_str());
+            for (auto& res : results) {
+                if (res.errcode() == pb::SUCCESS) {
+                    res.Clear();
+                    res.set_errcode(pb::EXEC_FAIL);
+                    res.set_errmsg("txn commit failed.");
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < entries.size(); ++i) {
+        set_dml_closure_response(entries[i].done, results[i]);
+        if (entries[i].done) {
+            braft::run_closure_in_bthread(entries[i].done);
+        }
+    }
+    int64_t dml_cost = cost.get_time();
+    Store::get_instance()->dml_time_cost << dml_cost;
+    if (dml_cost > FLAGS_print_time_us) {
+        DB_NOTICE("dml batch time_cost:%ld, region_id: %ld, entries:%lu, num_table_lines:%ld, "
+                  "applied_index:%ld, wait_cost:%ld",
+                  dml_cost, _region_id, entries.size(), _num_table_lines.load(),
+                  applied_index, wait_cost);
+    }
+    entries.clear();
+}
+
 void Region::kv_apply_raft(RuntimeState* state, SmartTransaction txn) {
     pb::StoreReq* raft_req = txn->get_raftreq(); 
     raft_req->set_op_type(pb::OP_KV_BATCH);
@@ -1750,9 +1984,112 @@ void Region::kv_apply_raft(RuntimeState* state, SmartTransaction txn) {
 
 
 void Region::select(const pb::StoreReq& request, pb::StoreRes& response) {
+    if (request.cursor_id() != 0) {
+        select_cursor(request, response);
+        return;
+    }
     select(request, request.plan(), request.tuples(), response);
 }
 
+void SelectCursorConsumers::touch(uint64_t db_conn_id) {
+    if (db_conn_id == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _active_time[db_conn_id].reset();
+}
+
+bool SelectCursorConsumers::is_idle(uint64_t db_conn_id, int64_t timeout_us) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    // 清理早已不活跃的连接
+    if (_last_sweep.get_time() > timeout_us) {
+        for (auto iter = _active_time.begin(); iter != _active_time.end();) {
+            if (iter->second.get_time() > 2 * timeout_us) {
+                iter = _active_time.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+        _last_sweep.reset();
+    }
+    auto iter = _active_time.find(db_conn_id);
+    return iter == _active_time.end() || iter->second.get_time() > timeout_us;
+}
+
+void Region::select_cursor(const pb::StoreReq& request, pb::StoreRes& response) {
+    int64_t cursor_id = request.cursor_id();
+    SelectCursorConsumers::get_instance()->touch(request.db_conn_id());
+    SmartCursor cursor;
+    {
+        // 读取期间从map中摘掉，避免被并发请求或超时清理访问
+        std::lock_guard<std::mutex> lock(_cursor_mutex);
+        auto iter = _select_cursors.find(cursor_id);
+        if (iter != _select_cursors.end()) {
+            cursor = iter->second;
+            _select_cursors.erase(iter);
+        }
+    }
+    if (request.close_cursor()) {
+        response.set_errcode(pb::SUCCESS);
+        return;
+    }
+    if (cursor == nullptr) {
+        response.set_errcode(pb::EXEC_FAIL);
+        response.set_errmsg("select cursor not exist");
+        DB_WARNING("select cursor not exist, region_id: %ld, cursor_id: %ld, log_id: %lu",
+                _region_id, cursor_id, request.log_id());
+        return;
+    }
+    RuntimeState& state = *cursor->state;
+    for (auto& tuple : state.tuple_descs()) {
+        response.add_tuple_ids(tuple.tuple_id());
+    }
+    bool page_eos = true;
+    int rows = select_normal(state, cursor->root, response, request.page_rows(), &page_eos,
+            request.columnar_rows());
+    if (rows < 0) {
+        response.set_errcode(pb::EXEC_FAIL);
+        response.set_errmsg("plan exec fail");
+        DB_FATAL("plan exec fail, region_id: %ld, cursor_id: %ld", _region_id, cursor_id);
+        return;
+    }
+    response.set_errcode(pb::SUCCESS);
+    response.set_affected_rows(rows);
+    response.set_scan_rows(state.num_scan_rows() - cursor->scan_rows);
+    response.set_filter_rows(state.num_filter_rows() - cursor->filter_rows);
+    if (!page_eos) {
+        cursor->scan_rows = state.num_scan_rows();
+        cursor->filter_rows = state.num_filter_rows();
+        cursor->active_time.reset();
+        response.set_cursor_id(cursor_id);
+        std::lock_guard<std::mutex> lock(_cursor_mutex);
+        _select_cursors[cursor_id] = cursor;
+    }
+}
+
+void Region::clear_expired_cursors() {
+    std::vector<SmartCursor> expired_cursors;
+    {
+        std::lock_guard<std::mutex> lock(_cursor_mutex);
+        int64_t timeout_us = FLAGS_select_cursor_timeout_s * 1000 * 1000LL;
+        for (auto iter = _select_cursors.begin(); iter != _select_cursors.end();) {
+            auto& cursor = iter->second;
+            // 老版本baikaldb不带连接id时按游标自己的空闲时间判断
+            bool expired = cursor->db_conn_id == 0 ? cursor->active_time.get_time() > timeout_us
+                : SelectCursorConsumers::get_instance()->is_idle(cursor->db_conn_id, timeout_us);
+            if (expired) {
+                DB_WARNING("select cursor expired, region_id: %ld, cursor_id: %ld",
+                        _region_id, iter->first);
+                expired_cursors.push_back(iter->second);
+                iter = _select_cursors.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+    // 游标在锁外析构，close执行树和回滚事务
+}
+
 void Region::select(const pb::StoreReq& request, 
         const pb::Plan& plan,
         const RepeatedPtrField<pb::TupleDescriptor>& tuples,
@@ -1805,6 +2142,11 @@ void Region::select(const pb::StoreReq& request,
         DB_FATAL("RuntimeState init fail, region_id: %ld", _region_id);
         return;
     }
+    if (request.has_analyze_info()) {
+        state.scan_class = SCAN_ANALYZE;
+    } else if (request.full_export()) {
+        state.scan_class = SCAN_EXPORT;
+    }
     _state_pool.set(db_conn_id, state_ptr);
     ON_SCOPE_EXIT(([this, db_conn_id]() {
         _state_pool.remove(db_conn_id);
@@ -1891,10 +2233,16 @@ void Region::select(const pb::StoreReq& request,
         response.add_tuple_ids(tuple.tuple_id());
     }
 
+    // 非事务的普通select可以分页返回，没读完的执行树保存为游标
+    int64_t page_rows = 0;
+    if (is_new_txn && !is_trace && request.page_rows() > 0) {
+        page_rows = request.page_rows();
+    }
+    bool page_eos = true;
     if (request.has_analyze_info()) {
         rows = select_sample(state, root, request.analyze_info(), response);
     } else {
-        rows = select_normal(state, root, response);
+        rows = select_normal(state, root, response, page_rows, &page_eos, request.columnar_rows());
     }
     if (rows < 0) {
         root->close(&state);
@@ -1906,8 +2254,34 @@ void Region::select(const pb::StoreReq& request,
     }
 
     //DB_NOTICE("select rows:%d", rows);
-    root->close(&state);
-    ExecNode::destroy_tree(root);
+    if (!page_eos && request.probe_page()) {
+        // 预读的region一页读不完时不占用游标，等baikaldb消费到这个region时再打开
+        response.clear_row_values();
+        response.clear_columnar_rows();
+        response.set_page_incomplete(true);
+        rows = 0;
+        page_eos = true;
+    }
+    if (!page_eos) {
+        SmartCursor cursor = std::make_shared<SelectCursor>();
+        cursor->state = state_ptr;
+        cursor->root = root;
+        cursor->txn = txn;
+        cursor->db_conn_id = request.db_conn_id();
+        SelectCursorConsumers::get_instance()->touch(cursor->db_conn_id);
+        cursor->scan_rows = state.num_scan_rows();
+        cursor->filter_rows = state.num_filter_rows();
+        int64_t cursor_id = ++_cursor_id_gen;
+        {
+            std::lock_guard<std::mutex> lock(_cursor_mutex);
+            _select_cursors[cursor_id] = cursor;
+        }
+        auto_rollback.release();
+        response.set_cursor_id(cursor_id);
+    } else {
+        root->close(&state);
+        ExecNode::destroy_tree(root);
+    }
     response.set_errcode(pb::SUCCESS);
     // 非事务select，不用commit。
     //if (is_new_txn) {
@@ -1920,13 +2294,46 @@ void Region::select(const pb::StoreReq& request,
     desc += " rows:" + std::to_string(rows);    
 }
 
-int Region::select_normal(RuntimeState& state, ExecNode* root, pb::StoreRes& response) {
+int Region::select_normal(RuntimeState& state, ExecNode* root, pb::StoreRes& response,
+        int64_t page_rows, bool* page_eos, bool columnar_rows) {
     bool eos = false;
     int rows = 0;
     int ret = 0;
     MemRowDescriptor* mem_row_desc = state.mem_row_desc();
+    ColumnBatch column_batch;
+    if (columnar_rows) {
+        ret = column_batch.init(state.tuple_descs());
+        if (ret < 0) {
+            DB_FATAL("column batch init fail, region_id: %ld", _region_id);
+            return -1;
+        }
+    }
 
+    ColumnBatch page_batch;
+    bool column_exec = columnar_rows && FLAGS_use_column_batch;
+    if (column_exec) {
+        page_batch.init(state.tuple_descs());
+        page_batch.set_capacity(state.row_batch_capacity());
+    }
     while (!eos) {
+        if (column_exec) {
+            // 执行树直接产出列存batch，按列追加到结果，不经过MemRow
+            page_batch.clear();
+            ret = root->get_next_column(&state, &page_batch, &eos);
+            if (ret < 0) {
+                DB_FATAL("plan get_next_column fail, region_id: %ld", _region_id);
+                return -1;
+            }
+            rows += page_batch.selected_size();
+            if (column_batch.append_batch(page_batch) < 0) {
+                DB_FATAL("append column batch fail, region_id: %ld", _region_id);
+                return -1;
+            }
+            if (page_rows > 0 && rows >= page_rows && !eos) {
+                break;
+            }
+            continue;
+        }
         RowBatch batch;
         batch.set_capacity(state.row_batch_capacity());
         ret = root->get_next(&state, &batch, &eos);
@@ -1941,14 +2348,27 @@ int Region::select_normal(RuntimeState& state, ExecNode* root, pb::StoreRes& res
                 DB_FATAL("row is null; region_id: %ld, rows:%d", _region_id, rows);
                 continue;
             }
+            if (columnar_rows) {
+                column_batch.append_row(row);
+                continue;
+            }
             pb::RowValue* row_value = response.add_row_values();
             for (int i = 0; i < mem_row_desc->tuple_size(); i++) {
                 std::string* tuple_value = row_value->add_tuple_values();
                 row->to_string(i, tuple_value);
             }
         }
+        // 按batch边界分页，不会丢行
+        if (page_rows > 0 && rows >= page_rows && !eos) {
+            break;
+        }
+    }
+    if (page_eos != nullptr) {
+        *page_eos = eos;
+    }
+    if (columnar_rows) {
+        column_batch.to_pb(response.mutable_columnar_rows());
     }
-
     return rows;
 }
 
@@ -2152,6 +2572,7 @@ void Region::set_can_add_peer() {
 }
 
 void Region::on_apply(braft::Iterator& iter) {
+    std::vector<Apply1pcEntry> batch_1pc;
     for (; iter.valid(); iter.next()) {
         braft::Closure* done = iter.done();
         brpc::ClosureGuard done_guard(done);
@@ -2176,6 +2597,22 @@ void Region::on_apply(braft::Iterator& iter) {
         }
         _applied_index = iter.index();
         int64_t term = iter.term();
+        if (can_batch_1pc(request)) {
+            batch_1pc.emplace_back();
+            Apply1pcEntry& entry = batch_1pc.back();
+            entry.request.Swap(&request);
+            entry.done = done_guard.release();
+            entry.index = iter.index();
+            entry.term = term;
+            if ((int32_t)batch_1pc.size() >= FLAGS_apply_batch_1pc_max_entries) {
+                dml_1pc_batch(batch_1pc);
+            }
+            continue;
+        }
+        // 保证apply顺序，先执行攒下的dml
+        if (!batch_1pc.empty()) {
+            dml_1pc_batch(batch_1pc);
+        }
 
         pb::StoreRes res;
         switch (op_type) {
@@ -2215,27 +2652,7 @@ void Region::on_apply(braft::Iterator& iter) {
                 }
                 dml_1pc(request, request.op_type(), request.plan(), request.tuples(), 
                     res, iter.index(), iter.term());
-                if (done) {
-                    ((DMLClosure*)done)->response->set_errcode(res.errcode());
-                    if (res.has_errmsg()) {
-                        ((DMLClosure*)done)->response->set_errmsg(res.errmsg());
-                    }
-                      if (res.has_mysql_errcode()) {
-                            ((DMLClosure*)done)->response->set_mysql_errcode(res.mysql_errcode());
-                        }
-                    if (res.has_leader()) {
-                        ((DMLClosure*)done)->response->set_leader(res.leader());
-                    }
-                    if (res.has_affected_rows()) {
-                        ((DMLClosure*)done)->response->set_affected_rows(res.affected_rows());
-                    }
-                    if (res.has_scan_rows()) {
-                        ((DMLClosure*)done)->response->set_scan_rows(res.scan_rows());
-                    }
-                    if (res.has_filter_rows()) {
-                        ((DMLClosure*)done)->response->set_filter_rows(res.filter_rows());
-                    }
-                }
+                set_dml_closure_response(done, res);
                 //DB_WARNING("dml_1pc %s", res.trace_nodes().DebugString().c_str());
                 break;
             }
@@ -2295,6 +2712,9 @@ void Region::on_apply(braft::Iterator& iter) {
             braft::run_closure_in_bthread(done_guard.release());
         }
     }
+    if (!batch_1pc.empty()) {
+        dml_1pc_batch(batch_1pc);
+    }
 }
 
 void Region::apply_kv_in_txn(const pb::StoreReq& request, braft::Closure* done, 
@@ -2803,6 +3223,55 @@ void Region::adjustkey_and_add_version(const pb::StoreReq& request,
     set_region_with_update_range(region_info_mem);   
 }
 
+// 分裂出去的主键范围已经在新region上，直接DeleteRange，不依赖compaction filter
+// 二级索引不按主键有序，仍由SplitCompactionFilter清理
+int Region::remove_split_range(const std::string& start_key, const std::string& end_key,
+        rocksdb::WriteBatch* batch) {
+    if (!FLAGS_split_use_sst) {
+        return 0;
+    }
+    std::vector<MutTableKey> prefixes;
+    int64_t table_id = get_table_id();
+    if (_is_global_index) {
+        prefixes.emplace_back();
+        prefixes.back().append_i64(_region_id).append_i64(get_global_index_id());
+    } else {
+        prefixes.emplace_back();
+        prefixes.back().append_i64(_region_id).append_i64(table_id);
+        TableInfo table_info = _factory->get_table_info(table_id);
+        // 只有cstore表的非主键列单独存储
+        if (table_info.engine == pb::ROCKSDB_CSTORE) {
+            IndexInfo pk_info = _factory->get_index_info(table_id);
+            std::set<int32_t> pri_field_ids;
+            for (auto& field_info : pk_info.fields) {
+                pri_field_ids.insert(field_info.id);
+            }
+            for (auto& field_info : table_info.fields) {
+                if (pri_field_ids.count(field_info.id) != 0) {
+                    continue;
+                }
+                prefixes.emplace_back();
+                prefixes.back().append_i64(_region_id);
+                prefixes.back().append_i32(_region_info.table_id()).append_i32(field_info.id);
+            }
+        }
+    }
+    for (auto& prefix : prefixes) {
+        MutTableKey begin_key(prefix);
+        MutTableKey range_end_key(prefix);
+        begin_key.append_index(start_key);
+        if (end_key.empty()) {
+            range_end_key.append_u64(0xFFFFFFFFFFFFFFFF);
+        } else {
+            range_end_key.append_index(end_key);
+        }
+        batch->DeleteRange(_data_cf, begin_key.data(), range_end_key.data());
+    }
+    DB_WARNING("remove split range, region_id: %ld, prefixes:%lu",
+            _region_id, prefixes.size());
+    return prefixes.size();
+}
+
 void Region::validate_and_add_version(const pb::StoreReq& request, 
                                       braft::Closure* done, 
                                       int64_t applied_index, 
@@ -2811,8 +3280,9 @@ void Region::validate_and_add_version(const pb::StoreReq& request,
     batch.Put(_meta_writer->get_handle(), 
                 _meta_writer->applied_index_key(_region_id), 
                 _meta_writer->encode_applied_index(applied_index));
-    ON_SCOPE_EXIT(([this, &batch]() {
-            _meta_writer->write_batch(&batch, _region_id);
+    bool has_range_delete = false;
+    ON_SCOPE_EXIT(([this, &batch, &has_range_delete]() {
+            _meta_writer->write_batch(&batch, _region_id, has_range_delete);
             DB_WARNING("write metainfo when add version, region_id: %ld", _region_id); 
         }));
     if (request.split_term() != term || request.split_end_index() + 1 != applied_index) {
@@ -2844,9 +3314,11 @@ void Region::validate_and_add_version(const pb::StoreReq& request,
                 _region_info.version(), request.region_version(),
                 _num_table_lines.load(), request.reduce_num_lines(),
                 applied_index, term);
+    std::string old_end_key = _region_info.end_key();
     set_region_with_update_range(region_info_mem);
     // 分裂后的老region需要删除范围
     _reverse_remove_range = true;
+    has_range_delete = remove_split_range(request.end_key(), old_end_key, &batch) > 0;
     _num_table_lines -= request.reduce_num_lines();
     batch.Put(_meta_writer->get_handle(), _meta_writer->num_table_lines_key(_region_id), _meta_writer->encode_num_table_lines(_num_table_lines));
     for (auto& txn_info : request.txn_infos()) {
@@ -3342,7 +3814,7 @@ int Region::on_snapshot_load(braft::SnapshotReader* reader) {
 
 int Region::ingest_sst(const std::string& data_sst_file, const std::string& meta_sst_file) {
     if (boost::filesystem::exists(boost::filesystem::path(data_sst_file))) {
-        int ret_data = RegionControl::ingest_data_sst(data_sst_file, _region_id);
+        int ret_data = RegionControl::ingest_data_sst(data_sst_file, _region_id, _data_cf);
         if (ret_data < 0) {
             DB_FATAL("ingest sst fail, region_id: %ld", _region_id);
             return -1;
@@ -3413,7 +3885,7 @@ void Region::reverse_merge() {
 // dump the the tuples in this region in format {{k1:v1},{k2:v2},{k3,v3}...}
 // used for debug
 std::string Region::dump_hex() {
-    auto data_cf = _rocksdb->get_data_handle();
+    auto data_cf = _data_cf;
     if (data_cf == nullptr) {
         DB_WARNING("get rocksdb data column family failed, region_id: %ld", _region_id);
         return "{}";
@@ -3424,7 +3896,8 @@ std::string Region::dump_hex() {
     //key.append_i64(_region_id);
     rocksdb::ReadOptions read_option;
     //read_option.prefix_same_as_start = true;
-    std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_option, RocksWrapper::DATA_CF));
+    read_option.total_order_seek = true;
+    std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_option, data_cf));
 
     std::string dump_str("{");
     for (iter->SeekToFirst();
@@ -3462,8 +3935,8 @@ bool Region::has_sst_data(int64_t* seek_table_lines) {
     }
     rocksdb::Slice upper_bound_slice = upper_bound.data();
     rocksdb::ReadOptions read_options;
-    read_options.prefix_same_as_start = true;
-    read_options.total_order_seek = false;
+    read_options.prefix_same_as_start = false;
+    read_options.total_order_seek = true;
     // TODO iterate_upper_bound边界判断，其他地方也需要改写
     read_options.iterate_upper_bound = &upper_bound_slice;
     std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_options, _data_cf));
@@ -3872,6 +4345,36 @@ void Region::get_split_key_for_tail_split() {
 }
 
 //开始发送数据
+// 用data cf中sst文件的起始key作为边界，把从start_key开始的同一index前缀切成最多n段
+// 只读文件元信息，不扫描数据；边界落在region范围外时对应子范围为空
+void Region::get_split_sub_ranges(const std::string& start_key, int n,
+        std::vector<std::string>* bounds) {
+    if (n <= 1 || start_key.size() < 2 * sizeof(int64_t)) {
+        return;
+    }
+    rocksdb::Slice prefix(start_key.data(), 2 * sizeof(int64_t));
+    std::vector<rocksdb::LiveFileMetaData> metas;
+    _rocksdb->get_db()->GetLiveFilesMetaData(&metas);
+    std::vector<std::string> keys;
+    for (auto& meta : metas) {
+        if (meta.column_family_name != _data_cf->GetName()) {
+            continue;
+        }
+        rocksdb::Slice key(meta.smallestkey);
+        if (key.starts_with(prefix) && key.compare(start_key) > 0) {
+            keys.push_back(meta.smallestkey);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    size_t num = std::min(keys.size(), (size_t)(n - 1));
+    for (size_t i = 1; i <= num; ++i) {
+        bounds->push_back(keys[i * keys.size() / (num + 1)]);
+    }
+    auto last = std::unique(bounds->begin(), bounds->end());
+    bounds->erase(last, bounds->end());
+}
+
 void Region::write_local_rocksdb_for_split() {
     if (_shutdown) {
         return;
@@ -3930,12 +4433,88 @@ void Region::write_local_rocksdb_for_split() {
 
     IndexInfo pk_info = _factory->get_index_info(main_table_id);
 
-    ConcurrencyBthread copy_bth(5, &BTHREAD_ATTR_SMALL);
+    // 新region的数据先写成sst文件，全部写完后一次ingest，不走memtable
+    std::string sst_path;
+    if (FLAGS_split_use_sst) {
+        sst_path = std::string(FLAGS_snapshot_uri, FLAGS_snapshot_uri.find("//") + 2) +
+            "/split_sst_" + std::to_string(_split_param.new_region_id);
+        try {
+            boost::filesystem::remove_all(sst_path);
+            boost::filesystem::create_directories(sst_path);
+        } catch (boost::filesystem::filesystem_error& e) {
+            DB_FATAL("create split sst path fail, path:%s, err:%s, region_id: %ld",
+                    sst_path.c_str(), e.what(), _region_id);
+            start_thread_to_remove_region(_split_param.new_region_id, _split_param.instance);
+            return;
+        }
+    }
+    ON_SCOPE_EXIT(([&sst_path]() {
+        if (!sst_path.empty()) {
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(sst_path, ec);
+        }
+    }));
+    std::vector<std::string> sst_files;
+    bthread::Mutex sst_mutex;
+    std::atomic<int64_t> sst_seq(0);
+    std::atomic<int64_t> pk_write_lines(0);
+    // 写新region的kv，sst模式下每个子范围一个文件
+    auto open_writer = [this, &sst_path, &sst_seq](std::unique_ptr<SstFileWriter>& writer,
+            std::string& sst_file) -> int {
+        sst_file = sst_path + "/" + std::to_string(sst_seq.fetch_add(1)) + ".sst";
+        writer.reset(new SstFileWriter(_rocksdb->get_options(_data_cf)));
+        auto s = writer->open(sst_file);
+        if (!s.ok()) {
+            DB_FATAL("open split sst fail, file:%s, err:%s, region_id: %ld",
+                    sst_file.c_str(), s.ToString().c_str(), _region_id);
+            return -1;
+        }
+        return 0;
+    };
+    auto finish_writer = [this, &sst_files, &sst_mutex](std::unique_ptr<SstFileWriter>& writer,
+            const std::string& sst_file) -> int {
+        if (writer == nullptr) {
+            return 0;
+        }
+        auto s = writer->finish();
+        if (!s.ok()) {
+            DB_FATAL("finish split sst fail, file:%s, err:%s, region_id: %ld",
+                    sst_file.c_str(), s.ToString().c_str(), _region_id);
+            return -1;
+        }
+        BAIDU_SCOPED_LOCK(sst_mutex);
+        sst_files.push_back(sst_file);
+        return 0;
+    };
+
+    // index_id, [lower_key, upper_key)，upper_key为空表示到index结尾
+    std::vector<std::tuple<int64_t, std::string, std::string>> ranges;
     for (int64_t index_id : indices) {
-        auto read_and_write = [this, &pk_info, &write_sst_lines, 
-                                index_id, new_region] () {
-            MutTableKey table_prefix;
-            table_prefix.append_i64(_region_id).append_i64(index_id);
+        IndexInfo index_info = _factory->get_index_info(index_id);
+        MutTableKey table_prefix;
+        table_prefix.append_i64(_region_id).append_i64(index_id);
+        if (index_info.type == pb::I_PRIMARY || _is_global_index) {
+            table_prefix.append_index(_split_param.split_key);
+        }
+        // 主键按sst文件边界切成多个子范围并发写
+        std::vector<std::string> bounds;
+        bounds.push_back(table_prefix.data());
+        if ((index_info.type == pb::I_PRIMARY || _is_global_index) && FLAGS_split_use_sst) {
+            get_split_sub_ranges(table_prefix.data(), FLAGS_split_sst_sub_ranges, &bounds);
+        }
+        for (size_t i = 0; i < bounds.size(); ++i) {
+            ranges.emplace_back(index_id, bounds[i], i + 1 < bounds.size() ? bounds[i + 1] : "");
+        }
+    }
+
+    ConcurrencyBthread copy_bth(5, &BTHREAD_ATTR_SMALL);
+    for (auto& range : ranges) {
+        int64_t index_id = std::get<0>(range);
+        std::string lower_key = std::get<1>(range);
+        std::string upper_key = std::get<2>(range);
+        auto read_and_write = [this, &pk_info, &write_sst_lines, &pk_write_lines,
+                                &open_writer, &finish_writer,
+                                index_id, new_region, lower_key, upper_key] () {
             rocksdb::WriteOptions write_options;
             TimeCost cost;
             int64_t num_write_lines = 0;
@@ -3944,19 +4523,23 @@ void Region::write_local_rocksdb_for_split() {
             int64_t level1_lines = 0;
             int64_t level2_lines = 0;
             int64_t level3_lines = 0;
+            // data cf的prefix比region_id+index_id长，全序遍历并设置index的上界
+            MutTableKey index_upper_bound;
+            index_upper_bound.append_i64(_region_id).append_i64(index_id + 1);
+            rocksdb::Slice index_upper_bound_slice(index_upper_bound.data());
             rocksdb::ReadOptions read_options;
-            read_options.prefix_same_as_start = true;
-            read_options.total_order_seek = false;
+            read_options.prefix_same_as_start = false;
+            read_options.total_order_seek = true;
+            read_options.iterate_upper_bound = &index_upper_bound_slice;
             read_options.snapshot = _split_param.snapshot;
            
             IndexInfo index_info = _factory->get_index_info(index_id);
             std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_options, _data_cf));
-            if (index_info.type == pb::I_PRIMARY || _is_global_index) {
-                table_prefix.append_index(_split_param.split_key);
-            }
+            std::unique_ptr<SstFileWriter> writer;
+            std::string sst_file;
             std::string end_key = get_end_key();
             int64_t count = 0;
-            for (iter->Seek(table_prefix.data()); iter->Valid(); iter->Next()) {
+            for (iter->Seek(lower_key); iter->Valid(); iter->Next()) {
                 ++count;
                 if (count % 1000 == 0) {
                     // 大region split中重置time_cost，防止version=0超时删除
@@ -3969,6 +4552,9 @@ void Region::write_local_rocksdb_for_split() {
                     start_thread_to_remove_region(_split_param.new_region_id, _split_param.instance);
                     return;
                 }
+                if (!upper_key.empty() && iter->key().compare(upper_key) >= 0) {
+                    break;
+                }
                 //int ret1 = 0; 
                 rocksdb::Slice key_slice(iter->key());
                 key_slice.remove_prefix(2 * sizeof(int64_t));
@@ -3997,7 +4583,17 @@ void Region::write_local_rocksdb_for_split() {
                 }
                 MutTableKey key(iter->key());
                 key.replace_i64(_split_param.new_region_id, 0);
-                auto s = _rocksdb->put(write_options, _data_cf, key.data(), iter->value());
+                rocksdb::Status s;
+                if (FLAGS_split_use_sst) {
+                    if (writer == nullptr && open_writer(writer, sst_file) != 0) {
+                        _split_param.err_code = -1;
+                        start_thread_to_remove_region(_split_param.new_region_id, _split_param.instance);
+                        return;
+                    }
+                    s = writer->put(key.data(), iter->value());
+                } else {
+                    s = _rocksdb->put(write_options, _data_cf, key.data(), iter->value());
+                }
                 if (!s.ok()) {
                     DB_FATAL("index %ld, old region_id: %ld write to new region_id: %ld failed, status: %s", 
                     index_id, _region_id, _split_param.new_region_id, s.ToString().c_str());
@@ -4007,9 +4603,14 @@ void Region::write_local_rocksdb_for_split() {
                 }
                 num_write_lines++;
             }
+            if (finish_writer(writer, sst_file) != 0) {
+                _split_param.err_code = -1;
+                start_thread_to_remove_region(_split_param.new_region_id, _split_param.instance);
+                return;
+            }
             write_sst_lines += num_write_lines;
             if (index_info.type == pb::I_PRIMARY || _is_global_index) {
-                _split_param.reduce_num_lines = num_write_lines;
+                pk_write_lines += num_write_lines;
             }
             DB_WARNING("scan index:%ld, cost=%ld, lines=%ld, skip:%ld, region_id: %ld "
                     "level lines=[%ld,%ld,%ld]", 
@@ -4032,7 +4633,7 @@ void Region::write_local_rocksdb_for_split() {
                 continue;
             }
             auto read_and_write_column = [this, &pk_info, &write_sst_lines,
-                                   field_id] () {
+                                   &open_writer, &finish_writer, field_id] () {
                 MutTableKey table_prefix;
                 table_prefix.append_i64(_region_id);
                 table_prefix.append_i32(_region_info.table_id()).append_i32(field_id);
@@ -4040,12 +4641,19 @@ void Region::write_local_rocksdb_for_split() {
                 TimeCost cost;
                 int64_t num_write_lines = 0;
                 int64_t skip_write_lines = 0;
+                MutTableKey column_upper_bound;
+                column_upper_bound.append_i64(_region_id);
+                column_upper_bound.append_i32(_region_info.table_id()).append_i32(field_id + 1);
+                rocksdb::Slice column_upper_bound_slice(column_upper_bound.data());
                 rocksdb::ReadOptions read_options;
-                read_options.prefix_same_as_start = true;
-                read_options.total_order_seek = false;
+                read_options.prefix_same_as_start = false;
+                read_options.total_order_seek = true;
+                read_options.iterate_upper_bound = &column_upper_bound_slice;
                 read_options.snapshot = _split_param.snapshot;
 
                 std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_options, _data_cf));
+                std::unique_ptr<SstFileWriter> writer;
+                std::string sst_file;
                 table_prefix.append_index(_split_param.split_key);
                 int64_t count = 0;
                 for (iter->Seek(table_prefix.data()); iter->Valid(); iter->Next()) {
@@ -4066,7 +4674,16 @@ void Region::write_local_rocksdb_for_split() {
                     }
                     MutTableKey key(iter->key());
                     key.replace_i64(_split_param.new_region_id, 0);
-                    auto s = _rocksdb->put(write_options, _data_cf, key.data(), iter->value());
+                    rocksdb::Status s;
+                    if (FLAGS_split_use_sst) {
+                        if (writer == nullptr && open_writer(writer, sst_file) != 0) {
+                            _split_param.err_code = -1;
+                            return;
+                        }
+                        s = writer->put(key.data(), iter->value());
+                    } else {
+                        s = _rocksdb->put(write_options, _data_cf, key.data(), iter->value());
+                    }
                     if (!s.ok()) {
                         DB_FATAL("index %ld, old region_id: %ld write to new region_id: %ld failed, status: %s",
                         field_id, _region_id, _split_param.new_region_id, s.ToString().c_str());
@@ -4075,6 +4692,10 @@ void Region::write_local_rocksdb_for_split() {
                     }
                     num_write_lines++;
                 }
+                if (finish_writer(writer, sst_file) != 0) {
+                    _split_param.err_code = -1;
+                    return;
+                }
                 write_sst_lines += num_write_lines;
                 DB_WARNING("scan filed:%d, cost=%ld, lines=%ld, skip:%ld, region_id: %ld",
                             field_id, cost.get_time(), num_write_lines, skip_write_lines, _region_id);
@@ -4087,6 +4708,21 @@ void Region::write_local_rocksdb_for_split() {
     if (_split_param.err_code != 0) {
         return;
     }
+    _split_param.reduce_num_lines = pk_write_lines.load();
+    if (!sst_files.empty()) {
+        TimeCost ingest_cost;
+        rocksdb::IngestExternalFileOptions ifo;
+        ifo.move_files = true;
+        auto res = _rocksdb->ingest_external_file(_data_cf, sst_files, ifo);
+        if (!res.ok()) {
+            DB_FATAL("ingest split sst fail, files:%lu, err:%s, region_id: %ld, new_region_id: %ld",
+                    sst_files.size(), res.ToString().c_str(), _region_id, _split_param.new_region_id);
+            start_thread_to_remove_region(_split_param.new_region_id, _split_param.instance);
+            return;
+        }
+        DB_WARNING("ingest split sst, files:%lu, cost:%ld, region_id: %ld, new_region_id: %ld",
+                sst_files.size(), ingest_cost.get_time(), _region_id, _split_param.new_region_id);
+    }
     DB_WARNING("region split success when write sst file to new region,"
               "region_id: %ld, new_region_id: %ld, instance:%s, write_sst_lines:%ld, time_cost:%ld",
               _region_id, 
@@ -4661,65 +5297,76 @@ void Region::complete_split() {
     }
 }
 
+int Region::parse_split_log_entry(const RaftLogEntry& entry, int64_t expected_term,
+        int64_t new_region_id, pb::StoreReq* store_req) {
+    if (entry.term != expected_term) {
+        DB_FATAL("term not equal to expect_term, term:%ld, expect_term:%ld, log_index:%ld", 
+                  entry.term, expected_term, entry.index);
+        return -1;
+    }
+    if ((braft::EntryType)entry.type != braft::ENTRY_TYPE_DATA) {
+        DB_FATAL("log entry is not data, log_index:%ld", entry.index);
+        return 0;
+    }
+    if (!store_req->ParseFromString(entry.data)) {
+        DB_FATAL("Fail to parse request fail, split fail, log_index:%ld", entry.index);
+        return -1;
+    }
+    // 加指令的时候这边要加上
+    if (store_req->op_type() != pb::OP_INSERT
+            && store_req->op_type() != pb::OP_DELETE
+            && store_req->op_type() != pb::OP_UPDATE
+            && store_req->op_type() != pb::OP_PREPARE
+            && store_req->op_type() != pb::OP_PREPARE_V2
+            && store_req->op_type() != pb::OP_ROLLBACK
+            && store_req->op_type() != pb::OP_COMMIT
+            && store_req->op_type() != pb::OP_NONE
+            && store_req->op_type() != pb::OP_KV_BATCH) {
+        DB_WARNING("unexpected store_req:%s, log_index:%ld", 
+                 pb2json(*store_req).c_str(), entry.index);
+        return -1;
+    }
+    if (store_req->op_type() == pb::OP_KV_BATCH) {
+        store_req->set_op_type(pb::OP_KV_BATCH_SPLIT);
+    }
+    store_req->set_region_id(new_region_id);
+    store_req->set_region_version(0);
+    return 1;
+}
+
 int Region::get_log_entry_for_split(const int64_t split_start_index, 
                                     const int64_t expected_term,
                                     std::vector<pb::StoreReq>& requests, 
                                     int64_t& split_end_index) {
     TimeCost cost;
     int64_t start_index = split_start_index;
-    MutTableKey log_data_key;
-    log_data_key.append_i64(_region_id).append_u8(MyRaftLogStorage::LOG_DATA_IDENTIFY).append_i64(split_start_index);
-    rocksdb::ReadOptions opt;
-    opt.prefix_same_as_start = true;
-    opt.total_order_seek = false;
-    std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(opt, RocksWrapper::RAFT_LOG_CF));
-    iter->Seek(log_data_key.data());
+    // raft log可能在RAFT_LOG_CF或者共享segment文件中，统一通过LogEntryReader读取
+    std::vector<RaftLogEntry> entries;
     // 小batch发送
-    for (int i = 0; iter->Valid() && i < 10000; iter->Next(), i++) {
-        TableKey key(iter->key());
-        int64_t log_index = key.extract_i64(sizeof(int64_t) + 1);
-        if (log_index != start_index) {
+    int ret = LogEntryReader::get_instance()->read_log_entries(_region_id, split_start_index,
+            10000, entries);
+    if (ret < 0) {
+        DB_FATAL("read log entries fail, region_id: %ld, start_index:%ld",
+                _region_id, split_start_index);
+        return -1;
+    }
+    for (auto& entry : entries) {
+        if (entry.index != start_index) {
             DB_FATAL("log index not continueous, start_index:%ld, log_index:%ld, region_id: %ld", 
-                    start_index, log_index, _region_id);
-            return -1;
-        }
-        rocksdb::Slice value_slice(iter->value());
-        LogHead head(iter->value());
-        value_slice.remove_prefix(MyRaftLogStorage::LOG_HEAD_SIZE); 
-        if (head.term != expected_term) {
-            DB_FATAL("term not equal to expect_term, term:%ld, expect_term:%ld, region_id: %ld", 
-                      head.term, expected_term, _region_id);
+                    start_index, entry.index, _region_id);
             return -1;
         }
-        if ((braft::EntryType)head.type != braft::ENTRY_TYPE_DATA) {
-            DB_FATAL("log entry is not data, log_index:%ld, region_id: %ld", log_index, _region_id);
-            continue;
-        }
         pb::StoreReq store_req;
-        if (!store_req.ParseFromArray(value_slice.data(), value_slice.size())) {
-            DB_FATAL("Fail to parse request fail, split fail, region_id: %ld", _region_id);
+        int parse_ret = parse_split_log_entry(entry, expected_term,
+                _split_param.new_region_id, &store_req);
+        if (parse_ret < 0) {
+            DB_FATAL("parse split log entry fail, region_id: %ld, log_index:%ld",
+                    _region_id, entry.index);
             return -1;
         }
-        // 加指令的时候这边要加上
-        if (store_req.op_type() != pb::OP_INSERT
-                && store_req.op_type() != pb::OP_DELETE
-                && store_req.op_type() != pb::OP_UPDATE
-                && store_req.op_type() != pb::OP_PREPARE
-                && store_req.op_type() != pb::OP_PREPARE_V2
-                && store_req.op_type() != pb::OP_ROLLBACK
-                && store_req.op_type() != pb::OP_COMMIT
-                && store_req.op_type() != pb::OP_NONE
-                && store_req.op_type() != pb::OP_KV_BATCH) {
-            DB_WARNING("unexpected store_req:%s, region_id: %ld", 
-                     pb2json(store_req).c_str(), _region_id);
-            return -1;
+        if (parse_ret > 0) {
+            requests.push_back(store_req);
         }
-        if (store_req.op_type() == pb::OP_KV_BATCH) {
-            store_req.set_op_type(pb::OP_KV_BATCH_SPLIT);
-        }
-        store_req.set_region_id(_split_param.new_region_id);
-        store_req.set_region_version(0);
-        requests.push_back(store_req);
         ++start_index;
     }
     split_end_index = start_index - 1;
@@ -4727,7 +5374,104 @@ int Region::get_log_entry_for_split(const int64_t split_start_index,
             "split_start_index:%ld, split_end_index:%ld, applied_index:%ld", 
             cost.get_time(), _region_id, split_start_index, split_end_index, _applied_index);
     // ture还有数据，false没数据了
-    return iter->Valid() ? 1 : 0;
+    return ret;
+}
+
+// 以主键范围内sst文件的边界作为候选分裂点，用GetApproximateSizes按数据量选择最接近一半的点
+// 只读取sst元信息，不扫描数据；候选点不足或偏斜过大时返回-1，由调用方退化为扫描
+int Region::get_split_key_by_sst_meta(std::string& split_key) {
+    int64_t tableid = _region_info.table_id();
+    MutTableKey prefix;
+    prefix.append_i64(_region_id).append_i64(tableid);
+    std::string start_key = prefix.data() + _region_info.start_key();
+    std::string end_key;
+    if (_region_info.end_key().empty()) {
+        MutTableKey end;
+        end.append_i64(_region_id).append_i64(tableid + 1);
+        end_key = end.data();
+    } else {
+        end_key = prefix.data() + _region_info.end_key();
+    }
+    rocksdb::Slice prefix_slice(prefix.data());
+    std::vector<rocksdb::LiveFileMetaData> metas;
+    _rocksdb->get_db()->GetLiveFilesMetaData(&metas);
+    std::vector<std::string> candidates;
+    int file_count = 0;
+    for (auto& meta : metas) {
+        if (meta.column_family_name != _data_cf->GetName()) {
+            continue;
+        }
+        if (meta.largestkey.compare(start_key) < 0 || meta.smallestkey.compare(end_key) >= 0) {
+            continue;
+        }
+        ++file_count;
+        for (auto* key : {&meta.smallestkey, &meta.largestkey}) {
+            if (rocksdb::Slice(*key).starts_with(prefix_slice)
+                    && key->compare(start_key) > 0 && key->compare(end_key) < 0) {
+                candidates.push_back(*key);
+            }
+        }
+    }
+    if (file_count < FLAGS_split_key_min_sst_files || candidates.empty()) {
+        DB_WARNING("region_id: %ld, sst files: %d, candidates: %lu, not enough for split key",
+                _region_id, file_count, candidates.size());
+        return -1;
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // ranges[0]为整个region，其余为[start_key, candidate)
+    size_t range_count = candidates.size() + 1;
+    std::vector<rocksdb::Range> ranges(range_count);
+    std::vector<uint64_t> sizes(range_count, 0);
+    ranges[0] = rocksdb::Range(start_key, end_key);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        ranges[i + 1] = rocksdb::Range(start_key, candidates[i]);
+    }
+    // 包含sst和memtable
+    _rocksdb->get_db()->GetApproximateSizes(_data_cf, ranges.data(), range_count,
+            sizes.data(), uint8_t(3));
+    uint64_t total_size = sizes[0];
+    if (total_size == 0) {
+        return -1;
+    }
+    uint64_t half_size = total_size / 2;
+    size_t best = 0;
+    uint64_t min_diff = UINT64_MAX;
+    for (size_t i = 1; i < range_count; ++i) {
+        uint64_t diff = sizes[i] > half_size ? sizes[i] - half_size : half_size - sizes[i];
+        if (diff < min_diff) {
+            min_diff = diff;
+            best = i;
+        }
+    }
+    // 候选点太粗导致两边数据量偏差超过skew的范围时，退化为扫描
+    int64_t skew = std::max(FLAGS_skew, 5);
+    if (best == 0 || min_diff * 100 > total_size * skew) {
+        DB_WARNING("region_id: %ld, total_size: %lu, min_diff: %lu, sst split key too skewed",
+                _region_id, total_size, min_diff);
+        return -1;
+    }
+    // sst边界可能是已删除的key，找到第一个存在的key
+    rocksdb::Slice end_key_slice(end_key);
+    rocksdb::ReadOptions read_options;
+    read_options.total_order_seek = true;
+    read_options.prefix_same_as_start = false;
+    read_options.iterate_upper_bound = &end_key_slice;
+    std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_options, _data_cf));
+    iter->Seek(candidates[best - 1]);
+    if (!iter->Valid() || !iter->key().starts_with(prefix_slice)
+            || iter->key().compare(end_key) >= 0
+            || iter->key().compare(start_key) <= 0) {
+        DB_WARNING("region_id: %ld, seek sst split key fail", _region_id);
+        return -1;
+    }
+    _split_param.split_key = iter->key().ToString().substr(prefix.size());
+    split_key = _split_param.split_key;
+    DB_WARNING("table_id:%ld, sst files: %d, total_size: %lu, left_size: %lu, split_key:%s, "
+            "region_id: %ld", tableid, file_count, total_size, sizes[best],
+            rocksdb::Slice(split_key).ToString(true).c_str(), _region_id);
+    return 0;
 }
 
 int Region::get_split_key(std::string& split_key) {
@@ -4737,9 +5481,13 @@ int Region::get_split_key(std::string& split_key) {
                     tableid, _region_id);
         return -1;
     }
+    if (FLAGS_split_key_use_sst_meta && get_split_key_by_sst_meta(split_key) == 0) {
+        return 0;
+    }
+    // 循环中按starts_with判断前缀
     rocksdb::ReadOptions read_options;
-    read_options.total_order_seek = false;
-    read_options.prefix_same_as_start = true;
+    read_options.total_order_seek = true;
+    read_options.prefix_same_as_start = false;
     std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_options, _data_cf));
     MutTableKey key;
 
@@ -5043,12 +5791,16 @@ void Region::write_local_rocksdb_for_ddl() {
         }
     }
 
-    rocksdb::ReadOptions read_options;
-    read_options.prefix_same_as_start = true; 
-    read_options.total_order_seek = false;
-    std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_options, _data_cf));
     MutTableKey table_prefix;
     table_prefix.append_i64(_region_id).append_i64(pk_index_id);
+    MutTableKey upper_bound;
+    upper_bound.append_i64(_region_id).append_i64(pk_index_id + 1);
+    rocksdb::Slice upper_bound_slice(upper_bound.data());
+    rocksdb::ReadOptions read_options;
+    read_options.prefix_same_as_start = false; 
+    read_options.total_order_seek = true;
+    read_options.iterate_upper_bound = &upper_bound_slice;
+    std::unique_ptr<rocksdb::Iterator> iter(_rocksdb->new_iterator(read_options, _data_cf));
 
     ON_SCOPE_EXIT(([this, &is_success, &all_num, &success_num](){
         //完成写入，设置work状态。不走raft，各peer进度不一样。
@@ -5434,7 +6186,7 @@ bool Region::is_wait_ddl() {
     }
     return _ddl_param.is_waiting;
 }
-// 后续要用compaction filter 来维护，现阶段主要有num_table_lines维护问题
+// 开启ttl_compaction_filter时过期数据由compaction丢弃，这里只维护num_table_lines
 void Region::ttl_remove_expired_data() {
     if (!_use_ttl) {
         return;
@@ -5456,6 +6208,22 @@ void Region::ttl_remove_expired_data() {
     ON_SCOPE_EXIT([this]() {
         reset_region_status();
     });
+    if (FLAGS_ttl_compaction_filter) {
+        // 过期数据由compaction丢弃(periodic_compaction_seconds保证冷数据也会被compaction)，
+        // 不再全量扫描，按compaction丢弃的行数调整num_table_lines
+        int64_t expired_lines = TtlCompactionFilter::get_instance()->take_expired_lines(_region_id);
+        if (expired_lines > 0) {
+            int64_t num_table_lines = (_num_table_lines -= expired_lines);
+            if (num_table_lines < 0) {
+                num_table_lines = 0;
+                _num_table_lines = 0;
+            }
+            _meta_writer->update_num_table_lines(_region_id, num_table_lines);
+        }
+        DB_WARNING("ttl expired lines dropped by compaction: %ld, region_id: %ld, num_table_lines: %ld",
+                expired_lines, _region_id, _num_table_lines.load());
+        return;
+    }
     //遍历snapshot，写入索引。
     DB_WARNING("start ttl_remove_expired_data region_id: %lld ", _region_id)
 
@@ -5481,12 +6249,16 @@ void Region::ttl_remove_expired_data() {
     for (int64_t index_id : indices) {
         MutTableKey table_prefix;
         table_prefix.append_i64(_region_id).append_i64(index_id);
+        MutTableKey upper_bound;
+        upper_bound.append_i64(_region_id).append_i64(index_id + 1);
+        rocksdb::Slice upper_bound_slice(upper_bound.data());
         rocksdb::WriteOptions write_options;
         TimeCost cost;
         int64_t num_remove_lines = 0;
         rocksdb::ReadOptions read_options;
-        read_options.prefix_same_as_start = true;
-        read_options.total_order_seek = false;
+        read_options.prefix_same_as_start = false;
+        read_options.total_order_seek = true;
+        read_options.iterate_upper_bound = &upper_bound_slice;
 
         std::string end_key = get_end_key();
         IndexInfo index_info = _factory->get_index_info(index_id);
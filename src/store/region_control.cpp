@@ -20,6 +20,7 @@
 #include "region.h"
 #include "mut_table_key.h"
 #include "my_raft_log_storage.h"
+#include "segment_log_storage.h"
 #include "closure.h"
 #include "raft_control.h"
 
@@ -38,18 +39,21 @@ int RegionControl::remove_data(int64_t drop_region_id) {
     end_key.append_u64(0xFFFFFFFFFFFFFFFF);
 
     auto rocksdb = RocksWrapper::get_instance();
-    auto data_cf = rocksdb->get_data_handle();
-    if (data_cf == nullptr) {
+    // 被删除的region可能已经没有schema，遍历所有数据cf
+    auto data_cfs = rocksdb->get_data_handles();
+    if (data_cfs.empty()) {
         DB_WARNING("get rocksdb data column family failed, region_id: %ld", drop_region_id);
         return -1;
     }
     TimeCost cost;
-    auto res = rocksdb->remove_range(options, data_cf, 
-            start_key.data(), end_key.data());
-    if (!res.ok()) {
-        DB_WARNING("remove_range error: code=%d, msg=%s, region_id: %ld", 
-            res.code(), res.ToString().c_str(), drop_region_id);
-        return -1;
+    for (auto data_cf : data_cfs) {
+        auto res = rocksdb->remove_range(options, data_cf, 
+                start_key.data(), end_key.data());
+        if (!res.ok()) {
+            DB_WARNING("remove_range error: code=%d, msg=%s, region_id: %ld", 
+                res.code(), res.ToString().c_str(), drop_region_id);
+            return -1;
+        }
     }
     DB_WARNING("region clear data, remove_range cost:%ld, region_id: %ld", cost.get_time(), drop_region_id);
     return 0;
@@ -64,8 +68,8 @@ void RegionControl::compact_data(int64_t region_id) {
     end_key.append_u64(0xFFFFFFFFFFFFFFFF);
 
     auto rocksdb = RocksWrapper::get_instance();
-    auto data_cf = rocksdb->get_data_handle();
-    if (data_cf == nullptr) {
+    auto data_cfs = rocksdb->get_data_handles();
+    if (data_cfs.empty()) {
         DB_WARNING("get rocksdb data column family failed, region_id: %ld", region_id);
         return;
     }
@@ -74,10 +78,12 @@ void RegionControl::compact_data(int64_t region_id) {
     rocksdb::Slice end(end_key.data());
     rocksdb::CompactRangeOptions compact_options;
     compact_options.exclusive_manual_compaction = false;
-    auto res = rocksdb->compact_range(compact_options, data_cf, &start, &end);
-    if (!res.ok()) {
-        DB_WARNING("region_id:%ld, compact_range error: code=%d, msg=%s", 
-                region_id, res.code(), res.ToString().c_str());
+    for (auto data_cf : data_cfs) {
+        auto res = rocksdb->compact_range(compact_options, data_cf, &start, &end);
+        if (!res.ok()) {
+            DB_WARNING("region_id:%ld, compact_range error: code=%d, msg=%s", 
+                    region_id, res.code(), res.ToString().c_str());
+        }
     }
     DB_WARNING("region_id: %ld, compact_range cost:%ld", region_id, cost.get_time());
 }
@@ -105,6 +111,9 @@ int RegionControl::remove_meta(int64_t drop_region_id) {
 
 int RegionControl::remove_log_entry(int64_t drop_region_id) {
     TimeCost cost;
+    if (SegmentLogManager::get_instance()->is_inited()) {
+        SegmentLogManager::get_instance()->remove_region(drop_region_id);
+    }
     rocksdb::WriteOptions options;
     MutTableKey start_key;
     MutTableKey end_key;
@@ -151,10 +160,13 @@ int RegionControl::clear_all_infos_for_region(int64_t drop_region_id) {
     remove_log_entry(drop_region_id);
     return 0;
 }
-int RegionControl::ingest_data_sst(const std::string& data_sst_file, int64_t region_id) {
+int RegionControl::ingest_data_sst(const std::string& data_sst_file, int64_t region_id,
+        rocksdb::ColumnFamilyHandle* data_cf) {
     auto rocksdb = RocksWrapper::get_instance();
     rocksdb::IngestExternalFileOptions ifo;
-    auto data_cf = rocksdb->get_data_handle();
+    if (data_cf == nullptr) {
+        data_cf = rocksdb->get_data_handle();
+    }
     auto res = rocksdb->ingest_external_file(data_cf, {data_sst_file}, ifo);
     if (!res.ok()) {
         DB_WARNING("Error while adding file %s, Error %s, region_id: %ld",
@@ -529,12 +529,18 @@ void Store::compact_region(google::protobuf::RpcController* controller,
                 cf = _rocksdb->get_raft_log_handle();
             }
         }
+        std::vector<rocksdb::ColumnFamilyHandle*> cfs = {cf};
+        if (cf == _rocksdb->get_data_handle()) {
+            cfs = _rocksdb->get_data_handles();
+        }
         rocksdb::CompactRangeOptions compact_options;
         compact_options.exclusive_manual_compaction = false;
-        auto res = _rocksdb->compact_range(compact_options, cf, nullptr, nullptr);
-        if (!res.ok()) {
-            DB_WARNING("compact_range error: code=%d, msg=%s", 
-                    res.code(), res.ToString().c_str());
+        for (auto compact_cf : cfs) {
+            auto res = _rocksdb->compact_range(compact_options, compact_cf, nullptr, nullptr);
+            if (!res.ok()) {
+                DB_WARNING("compact_range error: code=%d, msg=%s", 
+                        res.code(), res.ToString().c_str());
+            }
         }
     } else {
         for (auto region_id : request->region_ids()) {
@@ -693,6 +699,7 @@ void Store::ttl_remove_thread() {
         if (_shutdown) {
             return;
         }
+        // 开启TtlCompactionFilter后不再扫描，只按compaction丢弃的行数调整num_table_lines
         traverse_copy_region_map([](SmartRegion& region) {
             region->ttl_remove_expired_data();
         });
@@ -730,9 +737,12 @@ void Store::flush_memtable_thread() {
         if (!status.ok()) {
             DB_WARNING("flush meta info to rocksdb fail, err_msg:%s", status.ToString().c_str());
         }
-        status = _rocksdb->flush(flush_options, _rocksdb->get_data_handle());
-        if (!status.ok()) {
-            DB_WARNING("flush data to rocksdb fail, err_msg:%s", status.ToString().c_str());
+        for (auto data_cf : _rocksdb->get_data_handles()) {
+            status = _rocksdb->flush(flush_options, data_cf);
+            if (!status.ok()) {
+                DB_WARNING("flush data to rocksdb fail, cf:%s, err_msg:%s",
+                        data_cf->GetName().c_str(), status.ToString().c_str());
+            }
         }
         status = _rocksdb->flush(flush_options, _rocksdb->get_raft_log_handle());
         if (!status.ok()) {
@@ -873,7 +883,11 @@ void Store::print_properties(const std::string& name) {
     auto db = _rocksdb->get_db();
     uint64_t value_data = 0;
     uint64_t value_log = 0;
-    db->GetIntProperty(_rocksdb->get_data_handle(), name, &value_data);
+    for (auto data_cf : _rocksdb->get_data_handles()) {
+        uint64_t value = 0;
+        db->GetIntProperty(data_cf, name, &value);
+        value_data += value;
+    }
     db->GetIntProperty(_rocksdb->get_raft_log_handle(), name, &value_log);
     SELF_TRACE("db_property: %s, data_cf:%lu, log_cf:%lu", name.c_str(), value_data, value_log);
 }
@@ -1035,6 +1049,8 @@ void Store::start_db_statistics() {
 
 int Store::get_used_size_per_region(const std::vector<int64_t>& region_ids,
                                                 uint64_t* region_sizes, int64_t* region_num_lines) {
+    // region的数据可能在独立的column family中
+    std::vector<rocksdb::ColumnFamilyHandle*> data_cfs(region_ids.size(), nullptr);
     for (size_t i = 0; i < region_ids.size(); ++i) {
         auto region = get_region(region_ids[i]);
         if (region == NULL) {
@@ -1042,6 +1058,7 @@ int Store::get_used_size_per_region(const std::vector<int64_t>& region_ids,
             region_sizes[i] = 0;
             continue;
         }
+        data_cfs[i] = region->get_data_cf();
         int64_t num_table_lines = region->get_num_table_lines();
         int32_t num_prepared = region->num_prepared();
         int32_t num_began = region->num_began();
@@ -1056,10 +1073,6 @@ int Store::get_used_size_per_region(const std::vector<int64_t>& region_ids,
         //            num_prepared, num_began);
     }
 
-    auto data_cf = _rocksdb->get_data_handle();
-    if (nullptr == data_cf) {
-        return -1;
-    }
     int64_t region_count = region_ids.size();
     boost::scoped_array<rocksdb::Range> ranges(new (std::nothrow)rocksdb::Range[region_count]);
     if (ranges.get() == nullptr) {
@@ -1080,7 +1093,11 @@ int Store::get_used_size_per_region(const std::vector<int64_t>& region_ids,
                     rocksdb::Slice(end.data()).ToString(true).c_str());
     }
     //GetApproximateSizes 得不到准确的数
-    //_rocksdb->get_db()->GetApproximateSizes(data_cf, ranges.get(), region_count, region_sizes, uint8_t(3));
+    //for (size_t i = 0; i < region_ids.size(); ++i) {
+    //    if (data_cfs[i] != nullptr) {
+    //        _rocksdb->get_db()->GetApproximateSizes(data_cfs[i], &ranges[i], 1, &region_sizes[i], uint8_t(3));
+    //    }
+    //}
     for (size_t i = 0; i < region_ids.size(); ++i) {
         SELF_TRACE("region_id: %ld, size:%lu", region_ids[i], region_sizes[i]);
     }
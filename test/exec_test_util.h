@@ -0,0 +1,122 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// 执行层单测共用的内存数据源和描述符构造，每个tuple有(key, value)两个INT64列
+#pragma once
+
+#include <vector>
+#include "runtime_state.h"
+#include "exec_node.h"
+#include "scan_node.h"
+#include "expr_value.h"
+
+namespace baikaldb {
+typedef std::vector<std::pair<int64_t, int64_t>> KeyValues;
+
+inline ExprValue int64_value(int64_t v) {
+    ExprValue value(pb::INT64);
+    value._u.int64_val = v;
+    return value;
+}
+
+inline KeyValues make_rows(int64_t count, int64_t key_mod) {
+    KeyValues rows;
+    for (int64_t i = 0; i < count; ++i) {
+        rows.push_back(std::make_pair(i % key_mod, i));
+    }
+    return rows;
+}
+
+inline pb::TupleDescriptor make_tuple(int32_t tuple_id, int64_t table_id) {
+    pb::TupleDescriptor tuple;
+    tuple.set_tuple_id(tuple_id);
+    tuple.set_table_id(table_id);
+    for (int32_t slot_id = 1; slot_id <= 2; ++slot_id) {
+        pb::SlotDescriptor* slot = tuple.add_slots();
+        slot->set_slot_id(slot_id);
+        slot->set_slot_type(pb::INT64);
+        slot->set_tuple_id(tuple_id);
+        slot->set_field_id(slot_id);
+    }
+    return tuple;
+}
+
+inline void add_slot_ref(pb::Expr* expr, int32_t tuple_id, int32_t slot_id) {
+    pb::ExprNode* node = expr->add_nodes();
+    node->set_node_type(pb::SLOT_REF);
+    node->set_col_type(pb::INT64);
+    node->set_num_children(0);
+    node->mutable_derive_node()->set_tuple_id(tuple_id);
+    node->mutable_derive_node()->set_slot_id(slot_id);
+}
+
+// 从*idx开始把rows填进batch，返回是否已读完
+inline bool fill_rows(RuntimeState* state, int32_t tuple_id, const KeyValues& rows,
+        size_t* idx, RowBatch* batch) {
+    while (*idx < rows.size() && !batch->is_full()) {
+        std::unique_ptr<MemRow> row = state->mem_row_desc()->fetch_mem_row();
+        row->set_value(tuple_id, 1, int64_value(rows[*idx].first));
+        row->set_value(tuple_id, 2, int64_value(rows[*idx].second));
+        batch->move_row(std::move(row));
+        ++(*idx);
+    }
+    return *idx >= rows.size();
+}
+
+// 从内存返回(key, value)两列，每次open从头返回，eos时像fetcher一样累加扫描行数。
+// 节点类型不是SCAN_NODE，join不会对它重新做索引选择和路由
+class MemRowsNode : public ExecNode {
+public:
+    MemRowsNode(int32_t tuple_id, const KeyValues& rows) : _tuple_id(tuple_id), _rows(rows) {
+        pb::PlanNode pb_node;
+        pb_node.set_node_type(pb::DUAL_SCAN_NODE);
+        pb_node.set_num_children(0);
+        pb_node.set_limit(-1);
+        init(pb_node);
+    }
+    virtual int open(RuntimeState* state) {
+        _idx = 0;
+        return 0;
+    }
+    virtual int get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
+        *eos = fill_rows(state, _tuple_id, _rows, &_idx, batch);
+        if (*eos) {
+            state->inc_num_scan_rows(_rows.size());
+        }
+        return 0;
+    }
+private:
+    int32_t _tuple_id;
+    KeyValues _rows;
+    size_t _idx = 0;
+};
+
+// 同MemRowsNode，但作为SCAN_NODE挂在计划里，替代真实的scan节点
+class MemScanNode : public ScanNode {
+public:
+    explicit MemScanNode(const KeyValues& rows) : _rows(rows) {}
+    virtual int open(RuntimeState* state) {
+        _idx = 0;
+        return ScanNode::open(state);
+    }
+    virtual int get_next(RuntimeState* state, RowBatch* batch, bool* eos) {
+        *eos = fill_rows(state, _tuple_id, _rows, &_idx, batch);
+        return 0;
+    }
+private:
+    KeyValues _rows;
+    size_t _idx = 0;
+};
+}
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -0,0 +1,89 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// plan cache相关单测共用的表结构和连接构造
+#pragma once
+
+#include <gtest/gtest.h>
+#include "query_context.h"
+#include "schema_factory.h"
+#include "network_socket.h"
+
+namespace baikaldb {
+static const int64_t TEST_TABLE_ID = 1;
+static const int64_t TEST_DB_ID = 222;
+
+// test_table(id INT64 primary key, name STRING)，version变化会让缓存的模板失效
+inline void update_schema(int64_t version) {
+    pb::SchemaInfo info;
+    info.set_namespace_name("test_namespace");
+    info.set_database("test_database");
+    info.set_table_name("test_table");
+    info.set_partition_num(1);
+    info.set_namespace_id(111);
+    info.set_database_id(TEST_DB_ID);
+    pb::FieldInfo* field = info.add_fields();
+    field->set_field_name("id");
+    field->set_field_id(1);
+    field->set_mysql_type(pb::INT64);
+    field = info.add_fields();
+    field->set_field_name("name");
+    field->set_field_id(2);
+    field->set_mysql_type(pb::STRING);
+    pb::IndexInfo* index_pk = info.add_indexs();
+    index_pk->set_index_type(pb::I_PRIMARY);
+    index_pk->set_index_name("pk_index");
+    index_pk->add_field_ids(1);
+    index_pk->set_index_id(TEST_TABLE_ID);
+    info.set_table_id(TEST_TABLE_ID);
+    info.set_version(version);
+    SchemaFactory::get_instance()->update_table(info);
+}
+
+class PlanTestBase : public testing::Test {
+protected:
+    static void SetUpTestCase() {
+        SchemaFactory::get_instance()->init();
+        update_schema(1);
+    }
+    virtual void SetUp() {
+        _user.reset(new UserInfo);
+        _user->namespace_ = "test_namespace";
+        _user->username = "test_user";
+        _user->database[TEST_DB_ID] = pb::WRITE;
+    }
+    std::unique_ptr<NetworkSocket> make_conn() {
+        std::unique_ptr<NetworkSocket> conn(new NetworkSocket);
+        conn->user_info = _user;
+        return conn;
+    }
+    std::unique_ptr<QueryContext> make_ctx(NetworkSocket* conn, uint8_t cmd) {
+        std::unique_ptr<QueryContext> ctx(new QueryContext(_user, "test_database"));
+        ctx->mysql_cmd = cmd;
+        ctx->client_conn = conn;
+        ctx->get_runtime_state()->set_client_conn(conn);
+        return ctx;
+    }
+    // 第idx个参数绑定到执行树上的值，没有绑定返回-1
+    static int64_t bound_int(QueryContext* ctx, int idx) {
+        auto iter = ctx->placeholders.find(idx);
+        if (iter == ctx->placeholders.end() || iter->second == nullptr) {
+            return -1;
+        }
+        return iter->second->get_value(nullptr).get_numberic<int64_t>();
+    }
+    std::shared_ptr<UserInfo> _user;
+};
+}
+/* vim: set ts=4 sw=4 sts=4 tw=100 */
@@ -0,0 +1,219 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <iostream>
+#include "column_batch.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+
+TEST(test_column_vector, case_all) {
+    ColumnVector int_col(pb::INT32);
+    for (int i = 0; i < 100; i++) {
+        if (i % 3 == 0) {
+            int_col.append_null();
+        } else {
+            ExprValue v(pb::INT32);
+            v._u.int32_val = i;
+            int_col.append_value(v);
+        }
+    }
+    EXPECT_EQ(100U, int_col.size());
+    EXPECT_EQ(2U, int_col.null_bitmap_words());
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(i % 3 == 0, int_col.is_null(i));
+        if (i % 3 != 0) {
+            EXPECT_EQ(i, int_col.get_value(i).get_numberic<int32_t>());
+        }
+    }
+
+    ColumnVector str_col(pb::STRING);
+    ExprValue s(pb::STRING);
+    s.str_val = "baikaldb";
+    str_col.append_value(s);
+    ExprValue num(pb::INT64);
+    num._u.int64_val = 123;
+    str_col.append_value(num);
+    EXPECT_EQ("baikaldb", str_col.get_value(0).get_string());
+    EXPECT_EQ("123", str_col.get_value(1).get_string());
+    str_col.set_null(0);
+    EXPECT_TRUE(str_col.get_value(0).is_null());
+}
+
+TEST(test_column_batch, case_all) {
+    pb::TupleDescriptor tuple_desc;
+    tuple_desc.set_tuple_id(0);
+    auto slot = tuple_desc.add_slots();
+    slot->set_tuple_id(0);
+    slot->set_slot_id(1);
+    slot->set_slot_type(pb::INT64);
+    slot = tuple_desc.add_slots();
+    slot->set_tuple_id(0);
+    slot->set_slot_id(2);
+    slot->set_slot_type(pb::STRING);
+    std::vector<pb::TupleDescriptor> tuple_descs = {tuple_desc};
+
+    ColumnBatch batch;
+    batch.set_capacity(10);
+    EXPECT_EQ(0, batch.init(tuple_descs));
+    for (int i = 0; i < 10; i++) {
+        size_t idx = batch.add_row();
+        ExprValue v(pb::INT64);
+        v._u.int64_val = i;
+        batch.get_column(0, 1)->set_value(idx, v);
+    }
+    EXPECT_TRUE(batch.is_full());
+    EXPECT_EQ(nullptr, batch.get_column(0, 3));
+    EXPECT_TRUE(batch.get_value(5, 0, 2).is_null());
+
+    std::vector<uint32_t> selection = {1, 3, 5, 7, 9};
+    batch.set_selection(selection);
+    EXPECT_EQ(5U, batch.selected_size());
+    batch.skip_rows(1);
+    batch.keep_first_rows(2);
+    EXPECT_EQ(2U, batch.selected_size());
+    EXPECT_EQ(3, batch.get_value(batch.selected_idx(0), 0, 1).get_numberic<int64_t>());
+    EXPECT_EQ(5, batch.get_value(batch.selected_idx(1), 0, 1).get_numberic<int64_t>());
+
+    batch.clear();
+    EXPECT_EQ(0U, batch.size());
+    EXPECT_TRUE(batch.all_selected());
+}
+
+TEST(test_column_copy, case_all) {
+    ColumnVector src(pb::INT32);
+    src.resize(70);
+    for (size_t i = 0; i < 70; i += 2) {
+        ExprValue v(pb::INT32);
+        v._u.int32_val = i;
+        src.set_value(i, v);
+    }
+    // INT32 -> INT64 直接拷贝
+    ColumnVector dst(pb::INT64);
+    dst.resize(70);
+    dst.copy_from(src, nullptr);
+    EXPECT_TRUE(dst.is_null(69));
+    EXPECT_EQ(68, dst.int_data()[68]);
+    // INT32 -> STRING 逐行cast
+    std::vector<uint32_t> selection = {2, 3, 66};
+    ColumnVector str(pb::STRING);
+    str.resize(70);
+    str.copy_from(src, &selection);
+    EXPECT_EQ("66", str.get_value(66).get_string());
+    EXPECT_TRUE(str.is_null(3));
+
+    ColumnVector lit(pb::DOUBLE);
+    lit.resize(70);
+    ExprValue v(pb::INT64);
+    v._u.int64_val = 7;
+    lit.fill_value(v, &selection);
+    EXPECT_EQ(7.0, lit.double_data()[66]);
+    EXPECT_FALSE(lit.is_null(2));
+    EXPECT_TRUE(lit.is_null(4));
+}
+
+TEST(test_column_append, case_all) {
+    pb::TupleDescriptor tuple_desc;
+    tuple_desc.set_tuple_id(0);
+    auto slot = tuple_desc.add_slots();
+    slot->set_tuple_id(0);
+    slot->set_slot_id(1);
+    slot->set_slot_type(pb::INT64);
+    slot = tuple_desc.add_slots();
+    slot->set_tuple_id(0);
+    slot->set_slot_id(2);
+    slot->set_slot_type(pb::STRING);
+    std::vector<pb::TupleDescriptor> tuple_descs = {tuple_desc};
+
+    ColumnBatch page;
+    EXPECT_EQ(0, page.init(tuple_descs));
+    for (int i = 0; i < 100; i++) {
+        size_t idx = page.add_row();
+        ExprValue v(pb::INT64);
+        v._u.int64_val = i;
+        page.get_column(0, 1)->set_value(idx, v);
+        if (i % 2 == 0) {
+            ExprValue s(pb::STRING);
+            s.str_val = "s" + std::to_string(i);
+            page.get_column(0, 2)->set_value(idx, s);
+        }
+    }
+    ColumnBatch result;
+    EXPECT_EQ(0, result.init(tuple_descs));
+    EXPECT_EQ(0, result.append_batch(page));
+    // 只追加被选中的行
+    std::vector<uint32_t> selection = {3, 64, 98};
+    page.set_selection(selection);
+    EXPECT_EQ(0, result.append_batch(page));
+    EXPECT_EQ(103U, result.size());
+    EXPECT_EQ(99, result.get_value(99, 0, 1).get_numberic<int64_t>());
+    EXPECT_TRUE(result.get_value(99, 0, 2).is_null());
+    EXPECT_EQ(3, result.get_value(100, 0, 1).get_numberic<int64_t>());
+    EXPECT_TRUE(result.get_value(100, 0, 2).is_null());
+    EXPECT_EQ("s64", result.get_value(101, 0, 2).get_string());
+    EXPECT_EQ(98, result.get_value(102, 0, 1).get_numberic<int64_t>());
+
+    ColumnBatch other;
+    EXPECT_EQ(0, other.init(std::vector<pb::TupleDescriptor>{}));
+    EXPECT_EQ(-1, result.append_batch(other));
+}
+
+TEST(test_column_pb, case_all) {
+    ColumnVector int_col(pb::INT64);
+    ColumnVector str_col(pb::STRING);
+    ColumnVector uniq_col(pb::STRING);
+    for (int i = 0; i < 100; i++) {
+        ExprValue v(pb::INT64);
+        v._u.int64_val = -i;
+        int_col.append_value(v);
+        ExprValue s(pb::STRING);
+        s.str_val = "v" + std::to_string(i % 3);
+        str_col.append_value(s);
+        s.str_val = "u" + std::to_string(i);
+        uniq_col.append_value(s);
+    }
+    int_col.set_null(7);
+    pb::ColumnValues values;
+    int_col.to_pb(&values);
+    ColumnVector int_dst(pb::INT64);
+    EXPECT_EQ(0, int_dst.from_pb(values, 100));
+    EXPECT_TRUE(int_dst.is_null(7));
+    EXPECT_EQ(-99, int_dst.int_data()[99]);
+    EXPECT_EQ(-1, int_dst.from_pb(values, 99));
+
+    // 重复值多时字典编码
+    values.Clear();
+    str_col.to_pb(&values);
+    EXPECT_EQ(3, values.string_values_size());
+    EXPECT_EQ(100, values.dict_ids_size());
+    ColumnVector str_dst(pb::STRING);
+    EXPECT_EQ(0, str_dst.from_pb(values, 100));
+    EXPECT_EQ("v2", str_dst.get_value(5).get_string());
+
+    values.Clear();
+    uniq_col.to_pb(&values);
+    EXPECT_EQ(100, values.string_values_size());
+    EXPECT_EQ(0, values.dict_ids_size());
+    ColumnVector uniq_dst(pb::STRING);
+    EXPECT_EQ(0, uniq_dst.from_pb(values, 100));
+    EXPECT_EQ("u42", uniq_dst.get_value(42).get_string());
+}
+
+}  // namespace baikaldb
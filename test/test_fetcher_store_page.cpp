@@ -0,0 +1,352 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <mutex>
+#include <brpc/server.h>
+#include "fetcher_store.h"
+#include "network_socket.h"
+#include "mem_row_descriptor.h"
+#include "column_batch.h"
+
+namespace baikaldb {
+DECLARE_int64(select_page_rows);
+DECLARE_int64(max_select_rows);
+DECLARE_bool(select_columnar_rows);
+DECLARE_int32(retry_interval_us);
+DECLARE_int32(select_stream_region_window);
+
+static const int TEST_PORT = 8125;
+static const int64_t REGION_ID = 1;
+static const int64_t PAGE_ROWS = 10;
+
+static std::vector<pb::TupleDescriptor> make_tuples() {
+    pb::TupleDescriptor tuple;
+    tuple.set_tuple_id(0);
+    tuple.set_table_id(1);
+    pb::SlotDescriptor* slot = tuple.add_slots();
+    slot->set_slot_id(1);
+    slot->set_slot_type(pb::INT64);
+    slot->set_tuple_id(0);
+    return std::vector<pb::TupleDescriptor>(1, tuple);
+}
+
+// 按游标分页返回region_id*1000+0..rows-1，lose_cursor_page>0时读到该页时丢失游标(模拟store重启或游标超时)
+class FakeStore : public pb::StoreService {
+public:
+    FakeStore() {
+        auto tuples = make_tuples();
+        _desc.init(tuples);
+        _column_batch.init(tuples);
+    }
+    virtual void query(google::protobuf::RpcController* controller,
+            const pb::StoreReq* request, pb::StoreRes* response,
+            google::protobuf::Closure* done) {
+        brpc::ClosureGuard done_guard(done);
+        std::lock_guard<std::mutex> lock(_mutex);
+        int64_t offset = 0;
+        int64_t rows = total_rows;
+        if (region_rows.count(request->region_id()) > 0) {
+            rows = region_rows[request->region_id()];
+        }
+        if (request->cursor_id() == 0) {
+            ++scan_count;
+            last_page_rows = request->page_rows();
+        } else {
+            auto iter = _cursors.find(request->cursor_id());
+            if (request->close_cursor()) {
+                ++close_count;
+                if (iter != _cursors.end()) {
+                    _cursors.erase(iter);
+                }
+                response->set_errcode(pb::SUCCESS);
+                return;
+            }
+            if (iter == _cursors.end() || ++_page_count == lose_cursor_page) {
+                if (iter != _cursors.end()) {
+                    _cursors.erase(iter);
+                }
+                response->set_errcode(pb::EXEC_FAIL);
+                response->set_errmsg("select cursor not exist");
+                return;
+            }
+            offset = iter->second;
+            _cursors.erase(iter);
+        }
+        int64_t end = std::min(offset + request->page_rows(), rows);
+        if (request->page_rows() <= 0) {
+            end = rows;
+        }
+        response->set_errcode(pb::SUCCESS);
+        if (request->probe_page() && end < rows) {
+            response->set_page_incomplete(true);
+            return;
+        }
+        response->add_tuple_ids(0);
+        _column_batch.clear();
+        for (int64_t i = offset; i < end; ++i) {
+            std::unique_ptr<MemRow> row = _desc.fetch_mem_row();
+            ExprValue value(pb::INT64);
+            value._u.int64_val = request->region_id() * 1000 + i;
+            row->set_value(0, 1, value);
+            if (request->columnar_rows()) {
+                _column_batch.append_row(row.get());
+                continue;
+            }
+            row->to_string(0, response->add_row_values()->add_tuple_values());
+        }
+        if (request->columnar_rows()) {
+            _column_batch.to_pb(response->mutable_columnar_rows());
+        }
+        response->set_scan_rows(end - offset);
+        if (end < rows) {
+            int64_t cursor_id = ++_cursor_seq;
+            _cursors[cursor_id] = end;
+            max_cursor_count = std::max(max_cursor_count, _cursors.size());
+            response->set_cursor_id(cursor_id);
+        }
+    }
+    void reset(int64_t rows, int lose_page) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        total_rows = rows;
+        lose_cursor_page = lose_page;
+        region_rows.clear();
+        scan_count = 0;
+        close_count = 0;
+        last_page_rows = -1;
+        max_cursor_count = 0;
+        _page_count = 0;
+        _cursors.clear();
+    }
+    size_t cursor_count() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _cursors.size();
+    }
+    int64_t total_rows = 0;
+    int lose_cursor_page = 0;
+    std::map<int64_t, int64_t> region_rows;
+    int scan_count = 0;
+    int close_count = 0;
+    int64_t last_page_rows = -1;
+    size_t max_cursor_count = 0;
+private:
+    std::mutex _mutex;
+    MemRowDescriptor _desc;
+    ColumnBatch _column_batch;
+    std::map<int64_t, int64_t> _cursors;
+    int64_t _cursor_seq = 0;
+    int _page_count = 0;
+};
+
+static FakeStore* g_store = nullptr;
+
+class FetcherStorePageTest : public testing::Test {
+protected:
+    virtual void SetUp() {
+        FLAGS_select_page_rows = PAGE_ROWS;
+        FLAGS_max_select_rows = 10000000;
+        FLAGS_select_stream_region_window = 1;
+        FLAGS_select_columnar_rows = false;
+        _conn.reset(new NetworkSocket);
+        *_state.mutable_tuple_descs() = make_tuples();
+        _state.mem_row_desc()->init(*_state.mutable_tuple_descs());
+        _state.set_client_conn(_conn.get());
+        pb::PlanNode pb_node;
+        pb_node.set_node_type(pb::LIMIT_NODE);
+        pb_node.set_limit(-1);
+        pb_node.set_num_children(0);
+        _node.init(pb_node);
+        _info = make_region(REGION_ID, "", "");
+    }
+    static pb::RegionInfo make_region(int64_t region_id, const std::string& start_key,
+            const std::string& end_key) {
+        pb::RegionInfo info;
+        info.set_region_id(region_id);
+        info.set_table_id(1);
+        info.set_main_table_id(1);
+        info.set_version(1);
+        info.set_start_key(start_key);
+        info.set_end_key(end_key);
+        std::string addr = "127.0.0.1:" + std::to_string(TEST_PORT);
+        info.add_peers(addr);
+        info.set_leader(addr);
+        return info;
+    }
+    ErrorType first_page(FetcherStore& fetcher) {
+        return fetcher.send_request(&_state, &_node, _info, REGION_ID, REGION_ID,
+                _state.log_id(), 0, 0, 0, pb::OP_SELECT);
+    }
+    static std::vector<int64_t> ids(RowBatch* batch, std::vector<int64_t> result = {}) {
+        for (batch->reset(); !batch->is_traverse_over(); batch->next()) {
+            result.push_back(batch->get_row()->get_value(0, 1).get_numberic<int64_t>());
+        }
+        return result;
+    }
+    static std::vector<int64_t> range(int64_t n, int64_t region_id = REGION_ID,
+            std::vector<int64_t> result = {}) {
+        for (int64_t i = 0; i < n; ++i) {
+            result.push_back(region_id * 1000 + i);
+        }
+        return result;
+    }
+    std::unique_ptr<NetworkSocket> _conn;
+    RuntimeState _state;
+    ExecNode _node;
+    pb::RegionInfo _info;
+};
+
+TEST_F(FetcherStorePageTest, non_stream_not_paged) {
+    // 需要全部数据(如排序)时一次返回，store端不留游标
+    g_store->reset(45, 0);
+    FetcherStore fetcher;
+    ASSERT_EQ(E_OK, first_page(fetcher));
+    EXPECT_EQ(0, g_store->last_page_rows);
+    EXPECT_EQ(0U, g_store->max_cursor_count);
+    EXPECT_FALSE(fetcher.has_more_pages(REGION_ID));
+    EXPECT_EQ(range(45), ids(fetcher.region_batch[REGION_ID].get()));
+    EXPECT_EQ(1, g_store->scan_count);
+}
+
+TEST_F(FetcherStorePageTest, stream_region_window) {
+    // 窗口外一页读不完的region消费到时才打开游标，一页读完的region直接返回
+    g_store->reset(25, 0);
+    g_store->region_rows[3] = 5;
+    std::map<int64_t, pb::RegionInfo> region_infos;
+    region_infos[1] = make_region(1, "", "b");
+    region_infos[2] = make_region(2, "b", "c");
+    region_infos[3] = make_region(3, "c", "");
+    FetcherStore fetcher;
+    fetcher.stream_select = true;
+    ASSERT_EQ(0, fetcher.run(&_state, region_infos, &_node, 0, pb::OP_SELECT));
+    EXPECT_EQ(3, g_store->scan_count);
+    EXPECT_EQ(1U, g_store->cursor_count());
+    EXPECT_EQ(1U, fetcher.pending_regions.size());
+
+    std::vector<int64_t> result;
+    int64_t region_id = 0;
+    std::shared_ptr<RowBatch> batch;
+    while (fetcher.next_stream_region(&_state, &region_id, &batch) == 0) {
+        result = ids(batch.get(), result);
+        while (fetcher.has_more_pages(region_id)) {
+            RowBatch page;
+            ASSERT_EQ(0, fetcher.fetch_next_page(&_state, region_id, &page));
+            result = ids(&page, result);
+        }
+    }
+    EXPECT_EQ(range(5, 3, range(25, 2, range(25, 1))), result);
+    EXPECT_EQ(4, g_store->scan_count);
+    EXPECT_EQ(1U, g_store->max_cursor_count);
+    EXPECT_EQ(0U, g_store->cursor_count());
+}
+
+TEST_F(FetcherStorePageTest, stream_columnar_result) {
+    // 交给列存流水线时列存页原样保留，不转换成MemRow
+    g_store->reset(25, 0);
+    FLAGS_select_columnar_rows = true;
+    FetcherStore fetcher;
+    fetcher.stream_select = true;
+    fetcher.column_result = true;
+    ASSERT_EQ(E_OK, first_page(fetcher));
+    int64_t region_id = 0;
+    std::shared_ptr<RowBatch> batch;
+    std::shared_ptr<pb::ColumnarRows> columnar_rows;
+    ASSERT_EQ(0, fetcher.next_stream_region(&_state, &region_id, &batch, &columnar_rows));
+    EXPECT_EQ(REGION_ID, region_id);
+    EXPECT_EQ(0U, batch->size());
+    ASSERT_TRUE(columnar_rows != nullptr);
+    EXPECT_EQ(PAGE_ROWS, columnar_rows->row_count());
+
+    RowBatch page;
+    std::shared_ptr<pb::ColumnarRows> next_rows;
+    ASSERT_EQ(0, fetcher.fetch_next_page(&_state, REGION_ID, &page, &next_rows));
+    EXPECT_EQ(0U, page.size());
+    ASSERT_TRUE(next_rows != nullptr);
+    EXPECT_EQ(2 * PAGE_ROWS, fetcher.row_cnt);
+
+    RowBatch rows;
+    ASSERT_EQ(0, fetcher.decode_columnar_rows(&_state, *columnar_rows, &rows));
+    ASSERT_EQ(0, fetcher.decode_columnar_rows(&_state, *next_rows, &rows));
+    EXPECT_EQ(range(2 * PAGE_ROWS), ids(&rows));
+    fetcher.close_cursors(&_state);
+    EXPECT_EQ(0U, g_store->cursor_count());
+}
+
+TEST_F(FetcherStorePageTest, stream_cursor_lost) {
+    // 流式读已经返回过行，游标丢失时返回可重试的错误
+    g_store->reset(45, 2);
+    FetcherStore fetcher;
+    fetcher.stream_select = true;
+    ASSERT_EQ(E_OK, first_page(fetcher));
+    std::vector<int64_t> result = ids(fetcher.region_batch[REGION_ID].get());
+    ASSERT_TRUE(fetcher.has_more_pages(REGION_ID));
+    RowBatch batch;
+    ASSERT_EQ(0, fetcher.fetch_next_page(&_state, REGION_ID, &batch));
+    result = ids(&batch, result);
+    EXPECT_EQ(range(2 * PAGE_ROWS), result);
+    RowBatch lost_batch;
+    EXPECT_EQ(-1, fetcher.fetch_next_page(&_state, REGION_ID, &lost_batch));
+    EXPECT_EQ(ER_QUERY_INTERRUPTED, _state.error_code);
+    EXPECT_FALSE(fetcher.has_more_pages(REGION_ID));
+    EXPECT_EQ(1, g_store->scan_count);
+}
+
+TEST_F(FetcherStorePageTest, stream_max_select_rows) {
+    // 后续页同样受max_select_rows限制，超限时释放store端游标
+    g_store->reset(100, 0);
+    FLAGS_max_select_rows = 25;
+    FetcherStore fetcher;
+    fetcher.stream_select = true;
+    ASSERT_EQ(E_OK, first_page(fetcher));
+    RowBatch batch1;
+    ASSERT_EQ(0, fetcher.fetch_next_page(&_state, REGION_ID, &batch1));
+    EXPECT_EQ(20, fetcher.row_cnt);
+    RowBatch batch2;
+    EXPECT_EQ(-1, fetcher.fetch_next_page(&_state, REGION_ID, &batch2));
+    EXPECT_EQ(ER_SQL_TOO_BIG, _state.error_code);
+    EXPECT_FALSE(fetcher.has_more_pages(REGION_ID));
+    EXPECT_EQ(1, g_store->close_count);
+    EXPECT_EQ(0U, g_store->cursor_count());
+
+    // 全量导出不受限制
+    g_store->reset(100, 0);
+    _state.is_full_export = true;
+    FetcherStore export_fetcher;
+    export_fetcher.stream_select = true;
+    ASSERT_EQ(E_OK, first_page(export_fetcher));
+    while (export_fetcher.has_more_pages(REGION_ID)) {
+        RowBatch batch;
+        ASSERT_EQ(0, export_fetcher.fetch_next_page(&_state, REGION_ID, &batch));
+    }
+    EXPECT_EQ(100, export_fetcher.row_cnt);
+}
+}  // namespace baikaldb
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    baikaldb::FLAGS_select_columnar_rows = false;
+    baikaldb::FLAGS_retry_interval_us = 0;
+    baikaldb::SchemaFactory::get_instance()->init();
+    brpc::Server server;
+    baikaldb::g_store = new baikaldb::FakeStore;
+    if (server.AddService(baikaldb::g_store, brpc::SERVER_OWNS_SERVICE) != 0
+            || server.Start(baikaldb::TEST_PORT, NULL) != 0) {
+        DB_FATAL("start fake store fail");
+        return -1;
+    }
+    int ret = RUN_ALL_TESTS();
+    server.Stop(0);
+    server.Join();
+    return ret;
+}
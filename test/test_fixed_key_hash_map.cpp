@@ -0,0 +1,75 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <iostream>
+#include "fixed_key_hash_map.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+
+TEST(test_fixed_key_hash_map, case_all) {
+    FixedKeyHashMap<2, std::vector<int>> hash_map;
+    for (int i = 0; i < 100000; i++) {
+        FixedKey<2> key;
+        key.clear();
+        ExprValue value(pb::INT64);
+        value._u.int64_val = i % 5000;
+        key.set_value(0, value);
+        hash_map[key].push_back(i);
+    }
+    EXPECT_EQ(5000U, hash_map.size());
+    FixedKey<2> key;
+    key.clear();
+    ExprValue value(pb::INT32);
+    value._u.int32_val = 42;
+    key.set_value(0, value);
+    ASSERT_TRUE(hash_map.seek(key) != nullptr);
+    EXPECT_EQ(20U, hash_map.seek(key)->size());
+
+    // null与0不同
+    FixedKey<2> null_key;
+    null_key.clear();
+    null_key.set_value(0, ExprValue::Null());
+    FixedKey<2> zero_key;
+    zero_key.clear();
+    value._u.int32_val = 0;
+    zero_key.set_value(0, value);
+    EXPECT_FALSE(null_key == zero_key);
+    EXPECT_TRUE(hash_map.seek(null_key) == nullptr);
+
+    hash_map.clear();
+    EXPECT_EQ(0U, hash_map.size());
+    EXPECT_TRUE(hash_map.seek(zero_key) == nullptr);
+}
+
+TEST(test_fixed_key_words, case_all) {
+    EXPECT_EQ(2U, fixed_key_words({pb::INT32}));
+    EXPECT_EQ(4U, fixed_key_words({pb::INT64, pb::DOUBLE, pb::DATETIME}));
+    EXPECT_EQ(8U, fixed_key_words({pb::INT64, pb::INT64, pb::INT64, pb::INT64}));
+    EXPECT_EQ(0U, fixed_key_words({pb::INT64, pb::STRING}));
+    EXPECT_EQ(0U, fixed_key_words({}));
+    EXPECT_TRUE(fixed_key_type_compatible(pb::INT32, pb::INT64));
+    EXPECT_TRUE(fixed_key_type_compatible(pb::UINT32, pb::UINT64));
+    EXPECT_FALSE(fixed_key_type_compatible(pb::INT64, pb::UINT64));
+    EXPECT_FALSE(fixed_key_type_compatible(pb::DATE, pb::DATETIME));
+    EXPECT_FALSE(fixed_key_type_compatible(pb::STRING, pb::STRING));
+}
+
+}  // namespace baikaldb
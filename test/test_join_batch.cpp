@@ -0,0 +1,337 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <mutex>
+#include <brpc/server.h>
+#include "schema_factory.h"
+#include "runtime_state.h"
+#include "join_node.h"
+#include "rocksdb_scan_node.h"
+#include "select_manager_node.h"
+#include "network_socket.h"
+#include "expr.h"
+#include "exec_test_util.h"
+
+namespace baikaldb {
+DECLARE_int32(join_in_batch_size);
+DECLARE_bool(join_batch_prefetch);
+DECLARE_int64(hash_join_min_outer_rows);
+DECLARE_bool(use_column_batch);
+
+static const int TEST_PORT = 8126;
+static const int64_t INNER_TABLE_ID = 2;
+
+// 内表(tuple 1)所在的store，不解析下推的in条件，返回全部行由join按key匹配。
+// fail_request>0时第fail_request个请求返回错误
+class InnerStore : public pb::StoreService {
+public:
+    InnerStore() {
+        std::vector<pb::TupleDescriptor> tuples = {make_tuple(0, 1), make_tuple(1, INNER_TABLE_ID)};
+        _desc.init(tuples);
+    }
+    virtual void query(google::protobuf::RpcController* controller,
+            const pb::StoreReq* request, pb::StoreRes* response,
+            google::protobuf::Closure* done) {
+        brpc::ClosureGuard done_guard(done);
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (++request_count == fail_request) {
+            response->set_errcode(pb::EXEC_FAIL);
+            response->set_mysql_errcode(ER_LOCK_WAIT_TIMEOUT);
+            response->set_errmsg("inner store fail");
+            return;
+        }
+        response->set_errcode(pb::SUCCESS);
+        response->add_tuple_ids(1);
+        for (auto& kv : rows) {
+            std::unique_ptr<MemRow> row = _desc.fetch_mem_row();
+            row->set_value(1, 1, int64_value(kv.first));
+            row->set_value(1, 2, int64_value(kv.second));
+            row->to_string(1, response->add_row_values()->add_tuple_values());
+        }
+        response->set_scan_rows(rows.size());
+    }
+    void reset(const KeyValues& inner, int fail) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        rows = inner;
+        request_count = 0;
+        fail_request = fail;
+    }
+    KeyValues rows;
+    int request_count = 0;
+    int fail_request = 0;
+private:
+    std::mutex _mutex;
+    MemRowDescriptor _desc;
+};
+
+static InnerStore* g_inner_store = nullptr;
+
+// 内表注册到SchemaFactory，主键为第1列，只有一个region
+static void init_inner_table() {
+    pb::SchemaInfo info;
+    info.set_namespace_name("test_namespace");
+    info.set_database("test_database");
+    info.set_table_name("inner_table");
+    info.set_partition_num(1);
+    info.set_namespace_id(1);
+    info.set_database_id(1);
+    for (int32_t field_id = 1; field_id <= 2; ++field_id) {
+        pb::FieldInfo* field = info.add_fields();
+        field->set_field_name("f" + std::to_string(field_id));
+        field->set_field_id(field_id);
+        field->set_mysql_type(pb::INT64);
+    }
+    pb::IndexInfo* index_pk = info.add_indexs();
+    index_pk->set_index_type(pb::I_PRIMARY);
+    index_pk->set_index_name("pk_index");
+    index_pk->add_field_ids(1);
+    index_pk->set_index_id(INNER_TABLE_ID);
+    info.set_table_id(INNER_TABLE_ID);
+    info.set_version(1);
+    SchemaFactory::get_instance()->update_table(info);
+
+    RegionVec regions;
+    pb::RegionInfo* region = regions.Add();
+    region->set_region_id(1);
+    region->set_table_id(INNER_TABLE_ID);
+    region->set_main_table_id(INNER_TABLE_ID);
+    region->set_partition_id(0);
+    region->set_version(1);
+    region->set_conf_version(1);
+    region->set_start_key("");
+    region->set_end_key("");
+    std::string addr = "127.0.0.1:" + std::to_string(TEST_PORT);
+    region->add_peers(addr);
+    region->set_leader(addr);
+    SchemaFactory::get_instance()->update_regions_double_buffer_sync(regions);
+}
+
+// 和baikaldb生成的计划一样，内表为select_manager -> scan，join时重新做索引选择和路由
+static ExecNode* make_scan_inner() {
+    pb::PlanNode scan_pb;
+    scan_pb.set_node_type(pb::SCAN_NODE);
+    scan_pb.set_num_children(0);
+    scan_pb.set_limit(-1);
+    pb::ScanNode* scan = scan_pb.mutable_derive_node()->mutable_scan_node();
+    scan->set_tuple_id(1);
+    scan->set_table_id(INNER_TABLE_ID);
+    scan->set_engine(pb::ROCKSDB);
+    RocksdbScanNode* scan_node = new RocksdbScanNode;
+    if (scan_node->init(scan_pb) != 0) {
+        delete scan_node;
+        return nullptr;
+    }
+    pb::PlanNode manager_pb;
+    manager_pb.set_node_type(pb::SELECT_MANAGER_NODE);
+    manager_pb.set_num_children(1);
+    manager_pb.set_limit(-1);
+    SelectManagerNode* manager_node = new SelectManagerNode;
+    manager_node->init(manager_pb);
+    manager_node->add_child(scan_node);
+    scan_node->set_related_manager_node(manager_node);
+    return manager_node;
+}
+
+struct JoinResult {
+    std::vector<std::string> rows;
+    int scan_rows = 0;
+    // 内表上加了下推的in条件，hash join时不下推
+    bool in_pushdown = false;
+    MysqlErrCode error_code = ER_ERROR_FIRST;
+};
+
+// batch_size为0时整个驱动表生成一个in条件下推；scan_inner时内表从g_inner_store读取
+static int run_join(pb::JoinType join_type, const KeyValues& outer, const KeyValues& inner,
+        int32_t batch_size, bool prefetch, JoinResult* result, bool scan_inner = false) {
+    FLAGS_join_in_batch_size = batch_size;
+    FLAGS_join_batch_prefetch = prefetch;
+    NetworkSocket conn;
+    RuntimeState state;
+    state.set_client_conn(&conn);
+    state.mutable_tuple_descs()->push_back(make_tuple(0, 1));
+    state.mutable_tuple_descs()->push_back(make_tuple(1, INNER_TABLE_ID));
+    if (state.mem_row_desc()->init(*state.mutable_tuple_descs()) != 0) {
+        return -1;
+    }
+    pb::PlanNode pb_node;
+    pb_node.set_node_type(pb::JOIN_NODE);
+    pb_node.set_num_children(2);
+    pb_node.set_limit(-1);
+    pb::JoinNode* join = pb_node.mutable_derive_node()->mutable_join_node();
+    join->set_join_type(join_type);
+    join->add_left_tuple_ids(0);
+    join->add_right_tuple_ids(1);
+    pb::Expr* cond = join->add_conditions();
+    pb::ExprNode* eq = cond->add_nodes();
+    eq->set_node_type(pb::FUNCTION_CALL);
+    eq->set_col_type(pb::BOOL);
+    eq->set_num_children(2);
+    eq->mutable_fn()->set_name("eq_int64_int64");
+    eq->mutable_fn()->set_fn_op(parser::FT_EQ);
+    add_slot_ref(cond, 0, 1);
+    add_slot_ref(cond, 1, 1);
+
+    JoinNode join_node;
+    if (join_node.init(pb_node) != 0) {
+        return -1;
+    }
+    join_node.add_child(new MemRowsNode(0, outer));
+    ExecNode* inner_node = scan_inner ? make_scan_inner() : new MemRowsNode(1, inner);
+    if (inner_node == nullptr) {
+        return -1;
+    }
+    join_node.add_child(inner_node);
+    int ret = join_node.open(&state);
+    bool eos = false;
+    while (ret == 0 && !eos) {
+        RowBatch batch;
+        ret = join_node.get_next(&state, &batch, &eos);
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            MemRow* row = batch.get_row().get();
+            std::string str;
+            for (int32_t tuple_id = 0; tuple_id <= 1; ++tuple_id) {
+                for (int32_t slot_id = 1; slot_id <= 2; ++slot_id) {
+                    ExprValue value = row->get_value(tuple_id, slot_id);
+                    str += value.is_null() ? "NULL" : std::to_string(value.get_numberic<int64_t>());
+                    str += ",";
+                }
+            }
+            result->rows.push_back(str);
+        }
+    }
+    result->in_pushdown = join_node.children(1)->node_type() == pb::TABLE_FILTER_NODE;
+    join_node.close(&state);
+    result->scan_rows = state.num_scan_rows();
+    result->error_code = state.error_code;
+    std::sort(result->rows.begin(), result->rows.end());
+    return ret;
+}
+
+TEST(test_join_batch, batch_vs_single_in) {
+    // 驱动表1000行按64行一批，最后一批不满；内表有驱动表里没有的key
+    KeyValues outer = make_rows(1000, 300);
+    KeyValues inner = make_rows(800, 350);
+    const int32_t batch_size = 64;
+    const int batch_cnt = (outer.size() + batch_size - 1) / batch_size;
+    for (auto join_type : {pb::INNER_JOIN, pb::LEFT_JOIN}) {
+        JoinResult single;
+        ASSERT_EQ(0, run_join(join_type, outer, inner, 0, false, &single));
+        EXPECT_FALSE(single.rows.empty());
+        EXPECT_EQ((int)(outer.size() + inner.size()), single.scan_rows);
+        for (bool prefetch : {false, true}) {
+            JoinResult batched;
+            ASSERT_EQ(0, run_join(join_type, outer, inner, batch_size, prefetch, &batched));
+            EXPECT_EQ(single.rows, batched.rows) << "join_type:" << join_type
+                    << " prefetch:" << prefetch;
+            // 预取bthread的扫描行数不能丢
+            EXPECT_EQ((int)(outer.size() + inner.size() * batch_cnt), batched.scan_rows);
+        }
+    }
+}
+
+TEST(test_join_batch, batch_boundary) {
+    // 驱动表行数正好是批大小的整数倍，以及同一个key跨越批边界
+    KeyValues outer = make_rows(256, 3);
+    KeyValues inner = make_rows(10, 5);
+    for (auto join_type : {pb::INNER_JOIN, pb::LEFT_JOIN}) {
+        JoinResult single;
+        ASSERT_EQ(0, run_join(join_type, outer, inner, 0, false, &single));
+        for (int32_t batch_size : {1, 64, 255}) {
+            JoinResult batched;
+            ASSERT_EQ(0, run_join(join_type, outer, inner, batch_size, true, &batched));
+            EXPECT_EQ(single.rows, batched.rows) << "join_type:" << join_type
+                    << " batch_size:" << batch_size;
+        }
+    }
+}
+
+TEST(test_join_batch, hash_join_by_fetched_rows) {
+    // 是否改用hash join看驱动表实际取到的行数
+    KeyValues small_outer = make_rows(100, 30);
+    KeyValues large_outer = make_rows(3000, 300);
+    KeyValues inner = make_rows(800, 350);
+    int64_t min_outer_rows = FLAGS_hash_join_min_outer_rows;
+    for (auto join_type : {pb::INNER_JOIN, pb::LEFT_JOIN}) {
+        for (auto* outer : {&small_outer, &large_outer}) {
+            FLAGS_hash_join_min_outer_rows = 0;
+            JoinResult expected;
+            ASSERT_EQ(0, run_join(join_type, *outer, inner, 0, false, &expected));
+            EXPECT_TRUE(expected.in_pushdown);
+            FLAGS_hash_join_min_outer_rows = 1000;
+            JoinResult result;
+            ASSERT_EQ(0, run_join(join_type, *outer, inner, 0, false, &result));
+            EXPECT_EQ(expected.rows, result.rows) << "join_type:" << join_type
+                    << " outer_rows:" << outer->size();
+            EXPECT_EQ(outer == &small_outer, result.in_pushdown);
+        }
+    }
+    FLAGS_hash_join_min_outer_rows = min_outer_rows;
+}
+
+TEST(test_join_batch, scan_inner_prefetch) {
+    // 内表走索引选择、路由和fetcher，预取bthread写的是自己的state，
+    // 扫描行数和错误码在切换批次时合并回join的state
+    KeyValues outer = make_rows(300, 100);
+    KeyValues inner = make_rows(50, 120);
+    const int32_t batch_size = 64;
+    const int batch_cnt = (outer.size() + batch_size - 1) / batch_size;
+    for (auto join_type : {pb::INNER_JOIN, pb::LEFT_JOIN}) {
+        g_inner_store->reset(inner, 0);
+        JoinResult single;
+        ASSERT_EQ(0, run_join(join_type, outer, inner, 0, false, &single, true));
+        EXPECT_EQ(1, g_inner_store->request_count);
+        EXPECT_FALSE(single.rows.empty());
+        for (bool prefetch : {false, true}) {
+            g_inner_store->reset(inner, 0);
+            JoinResult batched;
+            ASSERT_EQ(0, run_join(join_type, outer, inner, batch_size, prefetch, &batched, true));
+            EXPECT_EQ(batch_cnt, g_inner_store->request_count);
+            EXPECT_EQ(single.rows, batched.rows) << "join_type:" << join_type
+                    << " prefetch:" << prefetch;
+            EXPECT_EQ((int)(outer.size() + inner.size() * batch_cnt), batched.scan_rows);
+            EXPECT_EQ(ER_ERROR_FIRST, batched.error_code);
+        }
+    }
+    // 第3批在预取bthread里失败
+    for (bool prefetch : {false, true}) {
+        g_inner_store->reset(inner, 3);
+        JoinResult failed;
+        EXPECT_NE(0, run_join(pb::INNER_JOIN, outer, inner, batch_size, prefetch, &failed, true));
+        EXPECT_EQ(ER_LOCK_WAIT_TIMEOUT, failed.error_code) << "prefetch:" << prefetch;
+    }
+}
+}  // namespace baikaldb
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    baikaldb::FLAGS_use_column_batch = false;
+    // 不走hash join
+    baikaldb::FLAGS_hash_join_min_outer_rows = 0;
+    baikaldb::SchemaFactory::get_instance()->init();
+    baikaldb::init_inner_table();
+    brpc::Server server;
+    baikaldb::g_inner_store = new baikaldb::InnerStore;
+    if (server.AddService(baikaldb::g_inner_store, brpc::SERVER_OWNS_SERVICE) != 0
+            || server.Start(baikaldb::TEST_PORT, NULL) != 0) {
+        DB_FATAL("start inner store fail");
+        return -1;
+    }
+    int ret = RUN_ALL_TESTS();
+    server.Stop(0);
+    server.Join();
+    return ret;
+}
@@ -0,0 +1,177 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <mutex>
+#include <set>
+#include <vector>
+#include "common.h"
+#include "mem_row_descriptor.h"
+#include "mem_row.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+static ExprValue int64_value(int64_t v) {
+    ExprValue value(pb::INT64);
+    value._u.int64_val = v;
+    return value;
+}
+
+static std::vector<pb::TupleDescriptor> make_tuples(pb::PrimitiveType slot_type) {
+    std::vector<pb::TupleDescriptor> tuple_desc;
+    for (int idx = 0; idx < 2; idx++) {
+        pb::TupleDescriptor tuple;
+        tuple.set_tuple_id(idx);
+        tuple.set_table_id(idx);
+        for (int jdx = 1; jdx <= 3; ++jdx) {
+            pb::SlotDescriptor* slot = tuple.add_slots();
+            slot->set_slot_id(jdx);
+            slot->set_slot_type(slot_type);
+            slot->set_tuple_id(idx);
+        }
+        tuple_desc.push_back(tuple);
+    }
+    return tuple_desc;
+}
+
+TEST(test_mem_row_layout, layout_cache_hit) {
+    auto tuples = make_tuples(pb::INT64);
+    MemRowDescriptor desc1;
+    MemRowDescriptor desc2;
+    ASSERT_EQ(0, desc1.init(tuples));
+    ASSERT_EQ(0, desc2.init(tuples));
+    auto row1 = desc1.fetch_mem_row();
+    auto row2 = desc2.fetch_mem_row();
+    // 相同的tuple/slot共享编译好的layout
+    EXPECT_EQ(row1->get_tuple(0)->GetDescriptor(), row2->get_tuple(0)->GetDescriptor());
+    EXPECT_EQ(row1->get_tuple(1)->GetDescriptor(), row2->get_tuple(1)->GetDescriptor());
+
+    auto other_tuples = make_tuples(pb::STRING);
+    MemRowDescriptor desc3;
+    ASSERT_EQ(0, desc3.init(other_tuples));
+    auto row3 = desc3.fetch_mem_row();
+    EXPECT_NE(row1->get_tuple(0)->GetDescriptor(), row3->get_tuple(0)->GetDescriptor());
+}
+
+TEST(test_mem_row_layout, tuple_recycle) {
+    auto tuples = make_tuples(pb::INT64);
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, desc.init(tuples));
+    auto row = desc.fetch_mem_row();
+    ASSERT_EQ(0, row->set_value(0, 1, int64_value(100)));
+    ASSERT_EQ(0, row->set_value(1, 2, int64_value(200)));
+    google::protobuf::Message* tuple0 = row->get_tuple(0);
+    google::protobuf::Message* tuple1 = row->get_tuple(1);
+    row.reset();
+
+    // 同一线程上复用被释放的message，且内容已清空
+    auto recycled = desc.fetch_mem_row();
+    EXPECT_EQ(tuple0, recycled->get_tuple(0));
+    EXPECT_EQ(tuple1, recycled->get_tuple(1));
+    EXPECT_TRUE(recycled->get_value(0, 1).is_null());
+    EXPECT_TRUE(recycled->get_value(1, 2).is_null());
+
+    // 同一个message不会同时分给两行
+    auto fresh = desc.fetch_mem_row();
+    EXPECT_NE(tuple0, fresh->get_tuple(0));
+}
+
+TEST(test_mem_row_layout, row_outlive_descriptor) {
+    auto tuples = make_tuples(pb::INT64);
+    std::unique_ptr<MemRow> row;
+    {
+        MemRowDescriptor desc;
+        ASSERT_EQ(0, desc.init(tuples));
+        row = desc.fetch_mem_row();
+    }
+    // 行持有layout引用，descriptor释放后仍可使用和析构
+    ASSERT_EQ(0, row->set_value(0, 3, int64_value(7)));
+    EXPECT_EQ(7, row->get_value(0, 3).get_numberic<int64_t>());
+    row.reset();
+}
+
+TEST(test_mem_row_layout, concurrent_fetch) {
+    // 和并行扫描一样，多个bthread用同一个descriptor取行，行交给另一个线程析构，
+    // 复用的tuple不能同时分给两行，也不能残留上一行的值
+    auto tuples = make_tuples(pb::INT64);
+    MemRowDescriptor desc;
+    ASSERT_EQ(0, desc.init(tuples));
+    const int worker_num = 8;
+    const int rounds = 20;
+    const int rows_per_round = 500;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<MemRow>> rows;
+    std::vector<int> dirty(worker_num, 0);
+    for (int round = 0; round < rounds; ++round) {
+        BthreadCond cond;
+        for (int w = 0; w < worker_num; ++w) {
+            cond.increase();
+            Bthread bth;
+            bth.run([&, w]() {
+                std::vector<std::unique_ptr<MemRow>> local;
+                for (int i = 0; i < rows_per_round; ++i) {
+                    std::unique_ptr<MemRow> row = desc.fetch_mem_row();
+                    if (!row->get_value(0, 1).is_null() || !row->get_value(1, 2).is_null()) {
+                        ++dirty[w];
+                    }
+                    int64_t v = (int64_t)w * rows_per_round + i;
+                    row->set_value(0, 1, int64_value(v));
+                    row->set_value(1, 2, int64_value(-v));
+                    local.push_back(std::move(row));
+                    if (i % 50 == 0) {
+                        // 让出，worker可能换到别的pthread上继续
+                        bthread_yield();
+                    }
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto& row : local) {
+                    rows.push_back(std::move(row));
+                }
+                cond.decrease_signal();
+            });
+        }
+        cond.wait();
+        ASSERT_EQ((size_t)worker_num * rows_per_round, rows.size());
+        // 在bthread里检查并析构，tuple回到worker pthread的空闲列表，下一轮被复用
+        BthreadCond consume_cond;
+        consume_cond.increase();
+        Bthread consumer;
+        consumer.run([&]() {
+            std::vector<bool> seen(worker_num * rows_per_round, false);
+            std::set<google::protobuf::Message*> messages;
+            for (auto& row : rows) {
+                int64_t v = row->get_value(0, 1).get_numberic<int64_t>();
+                if (v < 0 || v >= (int64_t)seen.size() || seen[v]) {
+                    ADD_FAILURE() << "unexpected value:" << v;
+                    continue;
+                }
+                seen[v] = true;
+                EXPECT_EQ(-v, row->get_value(1, 2).get_numberic<int64_t>());
+                EXPECT_TRUE(messages.insert(row->get_tuple(0)).second);
+            }
+            rows.clear();
+            consume_cond.decrease_signal();
+        });
+        consume_cond.wait();
+    }
+    for (int w = 0; w < worker_num; ++w) {
+        EXPECT_EQ(0, dirty[w]) << "worker:" << w;
+    }
+}
+}  // namespace baikaldb
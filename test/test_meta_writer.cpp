@@ -181,6 +181,18 @@ TEST_F(MetaWriterTest, test_encode) {
     ASSERT_EQ(ret, -1);
 }
 
+TEST_F(MetaWriterTest, test_data_cf) {
+    int64_t region_id = 12;
+    std::string cf_name;
+    // 没有记录(老版本创建的region)与读取失败区分开
+    ASSERT_EQ(1, _writer->read_data_cf(region_id, cf_name));
+    ASSERT_EQ(0, _writer->update_data_cf(region_id, baikaldb::RocksWrapper::DATA_CF));
+    ASSERT_EQ(0, _writer->read_data_cf(region_id, cf_name));
+    ASSERT_EQ(baikaldb::RocksWrapper::DATA_CF, cf_name);
+    ASSERT_EQ(0, _writer->clear_meta_info(region_id));
+    ASSERT_EQ(1, _writer->read_data_cf(region_id, cf_name));
+}
+
 int main(int argc, char** argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
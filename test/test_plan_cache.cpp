@@ -0,0 +1,230 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <iostream>
+#include "plan_cache.h"
+#include "literal.h"
+#include "plan_test_util.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+DECLARE_int32(plan_cache_max_params);
+
+// 模拟一个COM_QUERY连接
+class PlanCacheTest : public PlanTestBase {
+protected:
+    virtual void SetUp() {
+        PlanTestBase::SetUp();
+        _conn = make_conn();
+    }
+    std::unique_ptr<QueryContext> make_ctx(const std::string& sql) {
+        std::unique_ptr<QueryContext> ctx = PlanTestBase::make_ctx(_conn.get(), COM_QUERY);
+        ctx->sql = sql;
+        return ctx;
+    }
+    static std::string col_name(QueryContext* ctx, int idx) {
+        if (ctx->plan.nodes_size() == 0 || ctx->plan.nodes(0).node_type() != pb::PACKET_NODE) {
+            return "";
+        }
+        auto& packet_node = ctx->plan.nodes(0).derive_node().packet_node();
+        if (idx >= packet_node.col_names_size()) {
+            return "";
+        }
+        return packet_node.col_names(idx);
+    }
+    std::unique_ptr<NetworkSocket> _conn;
+};
+
+TEST_F(PlanCacheTest, hit_and_rebind) {
+    PlanCache* cache = PlanCache::get_instance();
+    auto ctx1 = make_ctx("select id, name from test_table where id = 10");
+    ASSERT_EQ(0, cache->analyze(ctx1.get()));
+    EXPECT_FALSE(ctx1->stat_info.hit_cache);
+    EXPECT_EQ(TEST_TABLE_ID, ctx1->stat_info.table_id);
+    EXPECT_EQ(10, bound_int(ctx1.get(), 0));
+
+    // 相同模板不同字面量命中，各自的树绑定各自的参数
+    auto ctx2 = make_ctx("select id, name from test_table where id = 20;");
+    ASSERT_EQ(0, cache->analyze(ctx2.get()));
+    EXPECT_TRUE(ctx2->stat_info.hit_cache);
+    EXPECT_EQ(20, bound_int(ctx2.get(), 0));
+    EXPECT_EQ(10, bound_int(ctx1.get(), 0));
+    EXPECT_NE(ctx1->root, ctx2->root);
+    EXPECT_EQ(ctx1->plan.nodes_size(), ctx2->plan.nodes_size());
+
+    auto ctx3 = make_ctx("select id from test_table where id in (1, 2, 3)");
+    ASSERT_EQ(0, cache->analyze(ctx3.get()));
+    EXPECT_FALSE(ctx3->stat_info.hit_cache);
+    auto ctx4 = make_ctx("select id from test_table where id in (4, 5, 6)");
+    ASSERT_EQ(0, cache->analyze(ctx4.get()));
+    EXPECT_TRUE(ctx4->stat_info.hit_cache);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(i + 1, bound_int(ctx3.get(), i));
+        EXPECT_EQ(i + 4, bound_int(ctx4.get(), i));
+    }
+    // in列表长度不同是另一个模板
+    auto ctx5 = make_ctx("select id from test_table where id in (4, 5)");
+    ASSERT_EQ(0, cache->analyze(ctx5.get()));
+    EXPECT_FALSE(ctx5->stat_info.hit_cache);
+}
+
+TEST_F(PlanCacheTest, select_field_names) {
+    // 结果列名来自select表达式的原文，select列表里的字面量不能参数化
+    PlanCache* cache = PlanCache::get_instance();
+    auto ctx1 = make_ctx("select id + 1, name from test_table where id = 10");
+    ASSERT_EQ(0, cache->analyze(ctx1.get()));
+    auto ctx2 = make_ctx("select id + 2, name from test_table where id = 10");
+    ASSERT_EQ(0, cache->analyze(ctx2.get()));
+    EXPECT_FALSE(ctx2->stat_info.hit_cache);
+    auto ctx3 = make_ctx("select id + 1, name from test_table where id = 20");
+    ASSERT_EQ(0, cache->analyze(ctx3.get()));
+    EXPECT_TRUE(ctx3->stat_info.hit_cache);
+    EXPECT_EQ(20, bound_int(ctx3.get(), 0));
+
+    std::string name1 = col_name(ctx1.get(), 0);
+    std::string name2 = col_name(ctx2.get(), 0);
+    EXPECT_NE(std::string::npos, name1.find("1"));
+    EXPECT_NE(std::string::npos, name2.find("2"));
+    EXPECT_EQ(std::string::npos, name2.find("?"));
+    EXPECT_EQ(name1, col_name(ctx3.get(), 0));
+    EXPECT_EQ("name", col_name(ctx3.get(), 1));
+}
+
+TEST_F(PlanCacheTest, schema_version_change) {
+    PlanCache* cache = PlanCache::get_instance();
+    auto ctx1 = make_ctx("select name from test_table where id = 1");
+    ASSERT_EQ(0, cache->analyze(ctx1.get()));
+    EXPECT_FALSE(ctx1->stat_info.hit_cache);
+    auto ctx2 = make_ctx("select name from test_table where id = 2");
+    ASSERT_EQ(0, cache->analyze(ctx2.get()));
+    EXPECT_TRUE(ctx2->stat_info.hit_cache);
+
+    // DDL后旧模板失效，重新生成后再次命中
+    update_schema(2);
+    auto ctx3 = make_ctx("select name from test_table where id = 3");
+    ASSERT_EQ(0, cache->analyze(ctx3.get()));
+    EXPECT_FALSE(ctx3->stat_info.hit_cache);
+    EXPECT_EQ(3, bound_int(ctx3.get(), 0));
+    auto ctx4 = make_ctx("select name from test_table where id = 4");
+    ASSERT_EQ(0, cache->analyze(ctx4.get()));
+    EXPECT_TRUE(ctx4->stat_info.hit_cache);
+    EXPECT_EQ(4, bound_int(ctx4.get(), 0));
+}
+
+TEST_F(PlanCacheTest, uncacheable) {
+    PlanCache* cache = PlanCache::get_instance();
+    // 没有表的sql不缓存，但第一次生成的模板直接用于本次执行
+    auto ctx1 = make_ctx("select 1 = 1");
+    ASSERT_EQ(0, cache->analyze(ctx1.get()));
+    EXPECT_FALSE(ctx1->stat_info.hit_cache);
+    EXPECT_GT(ctx1->plan.nodes_size(), 0);
+    // 之后直接走正常流程，不再生成模板
+    auto ctx2 = make_ctx("select 1 = 1");
+    EXPECT_EQ(1, cache->analyze(ctx2.get()));
+    EXPECT_EQ(0, ctx2->plan.nodes_size());
+
+    // 表不存在时模板生成失败，交给正常流程报错
+    auto ctx3 = make_ctx("select id from no_such_table where id = 1");
+    EXPECT_EQ(1, cache->analyze(ctx3.get()));
+}
+
+TEST(test_normalize_sql, max_params) {
+    int32_t max_params = FLAGS_plan_cache_max_params;
+    FLAGS_plan_cache_max_params = 3;
+    std::string normalized;
+    std::vector<pb::ExprNode> params;
+    EXPECT_EQ(0, PlanCache::normalize_sql("select * from t where id in (1, 2, 3)",
+            &normalized, &params));
+    EXPECT_EQ(3U, params.size());
+    normalized.clear();
+    params.clear();
+    EXPECT_EQ(-1, PlanCache::normalize_sql("select * from t where id in (1, 2, 3, 4, 5)",
+            &normalized, &params));
+    EXPECT_LE(params.size(), 3U);
+    FLAGS_plan_cache_max_params = max_params;
+}
+
+TEST(test_normalize_sql, case_all) {
+    std::string normalized;
+    std::vector<pb::ExprNode> params;
+    EXPECT_EQ(0, PlanCache::normalize_sql(
+            "select a,  b from t where id = 12 and name='it''s' and c between 1.5 and 3 limit 10;",
+            &normalized, &params));
+    EXPECT_EQ("select a, b from t where id = ? and name=? and c between ? and ? limit 10",
+            normalized);
+    ASSERT_EQ(4U, params.size());
+    EXPECT_EQ(pb::INT_LITERAL, params[0].node_type());
+    EXPECT_EQ(12, params[0].derive_node().int_val());
+    EXPECT_EQ("it's", params[1].derive_node().string_val());
+    EXPECT_EQ(pb::DOUBLE_LITERAL, params[2].node_type());
+    EXPECT_EQ(3, params[3].derive_node().int_val());
+
+    // IN/VALUES列表中只替换单独的元素
+    normalized.clear();
+    params.clear();
+    EXPECT_EQ(0, PlanCache::normalize_sql(
+            "insert into t (a, b) values (1, 'x'), (-2, now())", &normalized, &params));
+    EXPECT_EQ("insert into t (a, b) values (?, ?), (-2, now())", normalized);
+    EXPECT_EQ(2U, params.size());
+
+    normalized.clear();
+    params.clear();
+    EXPECT_EQ(0, PlanCache::normalize_sql(
+            "select * from `t` where id in (1,2,3) and f(4) > 0x10 and b = 99999999999999999999",
+            &normalized, &params));
+    EXPECT_EQ("select * from `t` where id in (?,?,?) and f(4) > 0x10 and b = 99999999999999999999",
+            normalized);
+    EXPECT_EQ(3U, params.size());
+
+    // select列表、SET、ORDER BY里的字面量不替换，子查询的条件照常替换
+    normalized.clear();
+    params.clear();
+    EXPECT_EQ(0, PlanCache::normalize_sql(
+            "select a = 1, b in (1, 2), 'x' from t where (c = 2 or d in (3)) and e in "
+            "(select f from t2 where g = 4) order by a = 5",
+            &normalized, &params));
+    EXPECT_EQ("select a = 1, b in (1, 2), 'x' from t where (c = ? or d in (?)) and e in "
+            "(select f from t2 where g = ?) order by a = 5", normalized);
+    EXPECT_EQ(3U, params.size());
+
+    normalized.clear();
+    params.clear();
+    EXPECT_EQ(0, PlanCache::normalize_sql(
+            "update t set a = 1 where id = 2", &normalized, &params));
+    EXPECT_EQ("update t set a = 1 where id = ?", normalized);
+    EXPECT_EQ(1U, params.size());
+
+    normalized.clear();
+    params.clear();
+    EXPECT_EQ(0, PlanCache::normalize_sql(
+            "select * from t1 join t2 on t1.a = 1 and t2.b = t1.b having c > 3",
+            &normalized, &params));
+    EXPECT_EQ("select * from t1 join t2 on t1.a = ? and t2.b = t1.b having c > ?", normalized);
+    EXPECT_EQ(2U, params.size());
+
+    // 不支持的sql
+    EXPECT_EQ(-1, PlanCache::normalize_sql("select * from t where a = ?", &normalized, &params));
+    EXPECT_EQ(-1, PlanCache::normalize_sql("select @a", &normalized, &params));
+    EXPECT_EQ(-1, PlanCache::normalize_sql("select 1 /* x */", &normalized, &params));
+    EXPECT_EQ(-1, PlanCache::normalize_sql("select 'a\\'b'", &normalized, &params));
+    EXPECT_EQ(-1, PlanCache::normalize_sql("show tables", &normalized, &params));
+}
+
+}  // namespace baikaldb
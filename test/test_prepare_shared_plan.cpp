@@ -0,0 +1,151 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include "prepare_planner.h"
+#include "plan_cache.h"
+#include "packet_node.h"
+#include "literal.h"
+#include "plan_test_util.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+static const std::string TEST_SQL = "select id, name from test_table where id = ?";
+
+static pb::ExprNode int_param(int64_t value) {
+    pb::ExprNode node;
+    node.set_node_type(pb::INT_LITERAL);
+    node.set_col_type(pb::INT64);
+    node.set_num_children(0);
+    node.mutable_derive_node()->set_int_val(value);
+    return node;
+}
+
+// 每个连接走COM_STMT_PREPARE/COM_STMT_EXECUTE
+class PrepareSharedPlanTest : public PlanTestBase {
+protected:
+    std::shared_ptr<QueryContext> prepare(NetworkSocket* conn) {
+        auto ctx = make_ctx(conn, COM_STMT_PREPARE);
+        ctx->stmt_type = parser::NT_NEW_PREPARE;
+        ctx->sql = TEST_SQL;
+        PreparePlanner planner(ctx.get());
+        if (planner.plan() != 0) {
+            return nullptr;
+        }
+        return conn->prepared_plans[ctx->prepare_stmt_name];
+    }
+    // 返回绑定到执行树上的参数，失败返回-1
+    int64_t execute(NetworkSocket* conn, const std::string& stmt_name, int64_t id) {
+        auto ctx = make_ctx(conn, COM_STMT_EXECUTE);
+        ctx->stmt_type = parser::NT_EXEC_PREPARE;
+        ctx->prepare_stmt_name = stmt_name;
+        ctx->param_values.push_back(int_param(id));
+        PreparePlanner planner(ctx.get());
+        if (planner.plan() != 0) {
+            return -1;
+        }
+        return bound_int(ctx.get(), 0);
+    }
+    static size_t field_count(QueryContext* ctx) {
+        return static_cast<PacketNode*>(ctx->root->get_node(pb::PACKET_NODE))->field_count();
+    }
+};
+
+TEST_F(PrepareSharedPlanTest, lazy_select_tree) {
+    auto conn1 = make_conn();
+    auto conn2 = make_conn();
+    auto handle1 = prepare(conn1.get());
+    auto handle2 = prepare(conn2.get());
+    ASSERT_TRUE(handle1 != nullptr);
+    ASSERT_TRUE(handle2 != nullptr);
+    std::string stmt1 = std::to_string(conn1->stmt_id);
+    std::string stmt2 = std::to_string(conn2->stmt_id);
+    // 句柄只引用模板，prepare ok用到的列信息和参数个数在模板上
+    EXPECT_EQ(handle1->shared_plan, handle2->shared_plan);
+    EXPECT_TRUE(handle1->root == nullptr);
+    EXPECT_TRUE(handle2->root == nullptr);
+    EXPECT_EQ(1U, handle1->shared_plan->num_params);
+    EXPECT_EQ(2U, handle1->shared_plan->fields.size());
+
+    // 第一次execute时生成连接自己的select树，之后复用
+    EXPECT_EQ(5, execute(conn1.get(), stmt1, 5));
+    ExecNode* root1 = handle1->root;
+    ASSERT_TRUE(root1 != nullptr);
+    EXPECT_NE(handle1->shared_plan->prepare_ctx->root, root1);
+    EXPECT_EQ(6, execute(conn1.get(), stmt1, 6));
+    EXPECT_EQ(root1, handle1->root);
+    EXPECT_TRUE(handle2->root == nullptr);
+    EXPECT_EQ(7, execute(conn2.get(), stmt2, 7));
+    ASSERT_TRUE(handle2->root != nullptr);
+    EXPECT_NE(root1, handle2->root);
+    EXPECT_EQ(2U, field_count(handle2.get()));
+
+    // 一个连接关闭语句不影响另一个连接
+    conn1->prepared_plans.erase(stmt1);
+    handle1.reset();
+    EXPECT_EQ(8, execute(conn2.get(), stmt2, 8));
+}
+
+TEST_F(PrepareSharedPlanTest, concurrent_execute) {
+    const int conn_num = 4;
+    const int loop = 200;
+    std::vector<std::unique_ptr<NetworkSocket>> conns;
+    for (int i = 0; i < conn_num; ++i) {
+        conns.push_back(make_conn());
+        ASSERT_TRUE(prepare(conns.back().get()) != nullptr);
+    }
+    std::vector<int> errors(conn_num, 0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < conn_num; ++i) {
+        threads.emplace_back([this, i, loop, &conns, &errors]() {
+            NetworkSocket* conn = conns[i].get();
+            std::string stmt_name = std::to_string(conn->stmt_id);
+            for (int j = 0; j < loop; ++j) {
+                int64_t id = i * loop + j;
+                if (execute(conn, stmt_name, id) != id) {
+                    ++errors[i];
+                }
+                // 偶尔重新prepare，新句柄重新生成select树
+                if (j % 50 == 0 && prepare(conn) == nullptr) {
+                    ++errors[i];
+                }
+                stmt_name = std::to_string(conn->stmt_id);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (int i = 0; i < conn_num; ++i) {
+        EXPECT_EQ(0, errors[i]) << "conn:" << i;
+    }
+
+    // 表结构变化后各连接重新挂载新模板
+    update_schema(2);
+    auto handle = conns[0]->prepared_plans[std::to_string(conns[0]->stmt_id)];
+    ASSERT_TRUE(handle != nullptr);
+    EXPECT_EQ(3, execute(conns[0].get(), std::to_string(conns[0]->stmt_id), 3));
+    EXPECT_TRUE(handle->root != nullptr);
+    EXPECT_TRUE(PlanCache::get_instance()->check_version(handle->shared_plan));
+    EXPECT_EQ(2U, handle->shared_plan->fields.size());
+    EXPECT_EQ(2U, field_count(handle.get()));
+}
+
+}  // namespace baikaldb
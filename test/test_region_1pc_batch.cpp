@@ -0,0 +1,176 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <google/protobuf/stubs/common.h>
+#include "region.h"
+#include "closure.h"
+#include "meta_writer.h"
+#include "rocks_wrapper.h"
+#include "schema_factory.h"
+#include "my_raft_log.h"
+
+namespace baikaldb {
+DECLARE_string(snapshot_uri);
+
+static const int TEST_PORT = 8123;
+static const int64_t TABLE_ID = 1;
+static const std::string TEST_DATA_PATH = "./region_1pc_batch_test";
+
+static SmartRegion new_region(int64_t region_id) {
+    pb::RegionInfo region_info;
+    region_info.set_region_id(region_id);
+    region_info.set_table_id(TABLE_ID);
+    region_info.set_table_name("test_namespace.test_database.test_table");
+    region_info.set_partition_id(0);
+    region_info.set_replica_num(1);
+    region_info.set_version(1);
+    region_info.set_conf_version(1);
+    region_info.set_start_key("");
+    region_info.set_end_key("");
+    std::string address = "127.0.0.1:" + std::to_string(TEST_PORT);
+    region_info.add_peers(address);
+    butil::EndPoint addr;
+    butil::str2endpoint(address.c_str(), &addr);
+    SmartRegion region(new Region(RocksWrapper::get_instance(), SchemaFactory::get_instance(),
+                address, braft::GroupId("region_" + std::to_string(region_id)),
+                braft::PeerId(addr, 0), region_info, region_id));
+    if (region->init(true, 0) != 0) {
+        return nullptr;
+    }
+    return region;
+}
+
+static void notify(BthreadCond* cond) {
+    cond->decrease_signal();
+}
+
+// ok为true时生成一个不写数据、执行成功的计划，否则生成一个create_tree失败的计划
+static void add_entry(std::vector<Apply1pcEntry>& entries, std::vector<pb::StoreRes>& responses,
+        BthreadCond& cond, int64_t region_id, int64_t index, bool ok) {
+    entries.emplace_back();
+    Apply1pcEntry& entry = entries.back();
+    entry.index = index;
+    entry.term = 1;
+    entry.request.set_op_type(pb::OP_INSERT);
+    entry.request.set_region_id(region_id);
+    entry.request.set_region_version(1);
+    pb::PlanNode* node = entry.request.mutable_plan()->add_nodes();
+    node->set_node_type(ok ? pb::LIMIT_NODE : pb::FETCHER_NODE);
+    node->set_limit(-1);
+    node->set_num_children(0);
+    DMLClosure* done = new DMLClosure;
+    done->op_type = pb::OP_INSERT;
+    done->response = &responses[entries.size() - 1];
+    cond.increase();
+    done->done = google::protobuf::NewCallback(&notify, &cond);
+    entry.done = done;
+}
+
+TEST(test_region_1pc_batch, mixed_result) {
+    const int64_t region_id = 1;
+    SmartRegion region = new_region(region_id);
+    ASSERT_TRUE(region != nullptr);
+    MetaWriter* writer = MetaWriter::get_instance();
+    ASSERT_EQ(0, writer->update_apply_index(region_id, 9));
+
+    // 10 成功，11 失败，12 成功，13 失败：applied_index只推进到最后一条成功的日志
+    std::vector<pb::StoreRes> responses(4);
+    std::vector<Apply1pcEntry> entries;
+    BthreadCond cond;
+    for (int64_t i = 0; i < 4; ++i) {
+        add_entry(entries, responses, cond, region_id, 10 + i, i % 2 == 0);
+    }
+    region->dml_1pc_batch(entries);
+    cond.wait();
+    EXPECT_TRUE(entries.empty());
+    EXPECT_EQ(pb::SUCCESS, responses[0].errcode());
+    EXPECT_EQ(pb::EXEC_FAIL, responses[1].errcode());
+    EXPECT_EQ("create plan fail", responses[1].errmsg());
+    EXPECT_EQ(pb::SUCCESS, responses[2].errcode());
+    EXPECT_EQ(pb::EXEC_FAIL, responses[3].errcode());
+    EXPECT_EQ(12, writer->read_applied_index(region_id));
+
+    // 整批失败不写meta
+    std::vector<pb::StoreRes> fail_responses(2);
+    for (int64_t i = 0; i < 2; ++i) {
+        add_entry(entries, fail_responses, cond, region_id, 14 + i, false);
+    }
+    region->dml_1pc_batch(entries);
+    cond.wait();
+    EXPECT_EQ(pb::EXEC_FAIL, fail_responses[0].errcode());
+    EXPECT_EQ(pb::EXEC_FAIL, fail_responses[1].errcode());
+    EXPECT_EQ(12, writer->read_applied_index(region_id));
+
+    // 单条批次走dml_1pc，成功后推进applied_index
+    std::vector<pb::StoreRes> single_response(1);
+    add_entry(entries, single_response, cond, region_id, 16, true);
+    region->dml_1pc_batch(entries);
+    cond.wait();
+    EXPECT_EQ(pb::SUCCESS, single_response[0].errcode());
+    EXPECT_EQ(16, writer->read_applied_index(region_id));
+    region->shutdown();
+    region->join();
+}
+}  // namespace baikaldb
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    boost::filesystem::remove_all(baikaldb::TEST_DATA_PATH);
+    baikaldb::FLAGS_snapshot_uri = "local://" + baikaldb::TEST_DATA_PATH + "/snapshot";
+    baikaldb::register_myraft_extension();
+    baikaldb::RocksWrapper* rocksdb = baikaldb::RocksWrapper::get_instance();
+    if (rocksdb->init(baikaldb::TEST_DATA_PATH + "/rocks_db") != 0) {
+        DB_FATAL("rocksdb init fail");
+        return -1;
+    }
+    baikaldb::MetaWriter::get_instance()->init(rocksdb, rocksdb->get_meta_info_handle());
+    baikaldb::SchemaFactory* factory = baikaldb::SchemaFactory::get_instance();
+    factory->init();
+    baikaldb::pb::SchemaInfo info;
+    info.set_namespace_name("test_namespace");
+    info.set_database("test_database");
+    info.set_table_name("test_table");
+    info.set_namespace_id(1);
+    info.set_database_id(1);
+    info.set_table_id(baikaldb::TABLE_ID);
+    info.set_version(1);
+    info.set_partition_num(1);
+    baikaldb::pb::FieldInfo* field = info.add_fields();
+    field->set_field_name("id");
+    field->set_field_id(1);
+    field->set_mysql_type(baikaldb::pb::INT64);
+    baikaldb::pb::IndexInfo* index_pk = info.add_indexs();
+    index_pk->set_index_type(baikaldb::pb::I_PRIMARY);
+    index_pk->set_index_name("pk_index");
+    index_pk->add_field_ids(1);
+    index_pk->set_index_id(baikaldb::TABLE_ID);
+    factory->update_table(info);
+
+    // region的raft node需要注册在rpc server上
+    brpc::Server server;
+    butil::EndPoint addr;
+    addr.ip = butil::IP_ANY;
+    addr.port = baikaldb::TEST_PORT;
+    if (braft::add_service(&server, addr) != 0 || server.Start(addr, NULL) != 0) {
+        DB_FATAL("start raft server fail");
+        return -1;
+    }
+    int ret = RUN_ALL_TESTS();
+    server.Stop(0);
+    server.Join();
+    return ret;
+}
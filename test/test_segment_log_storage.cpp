@@ -0,0 +1,364 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#include "segment_log_storage.h"
+#include "log_entry_reader.h"
+#include "region.h"
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    // 恢复和gc的用例需要全新的SegmentLogManager，在重新exec的子进程中执行
+    testing::FLAGS_gtest_death_test_style = "threadsafe";
+    return RUN_ALL_TESTS();
+}
+
+namespace baikaldb {
+DECLARE_string(segment_log_path);
+DECLARE_int64(segment_log_max_bytes);
+
+static const std::string TEST_LOG_PATH = "./segment_log_test";
+
+// 进程内第一次打开时初始化SegmentLogManager，clean为false时从path中已有的segment恢复
+static braft::LogStorage* open_storage(int64_t region_id,
+        const std::string& path = TEST_LOG_PATH, bool clean = true) {
+    static SegmentLogStorage segment_log_storage;
+    if (!SegmentLogManager::get_instance()->is_inited()) {
+        if (clean) {
+            boost::filesystem::remove_all(path);
+        }
+        FLAGS_segment_log_path = path;
+    }
+    braft::LogStorage* storage = segment_log_storage.new_instance(
+            "mysegmentlog://my_raft_log?id=" + std::to_string(region_id));
+    if (storage == nullptr) {
+        return nullptr;
+    }
+    braft::ConfigurationManager* configuration_manager = new braft::ConfigurationManager;
+    if (storage->init(configuration_manager) != 0) {
+        delete storage;
+        return nullptr;
+    }
+    return storage;
+}
+
+static int append_data(braft::LogStorage* storage, int64_t index, int64_t term,
+        const pb::StoreReq& req) {
+    scoped_refptr<braft::LogEntry> entry = new braft::LogEntry();
+    entry->type = braft::ENTRY_TYPE_DATA;
+    entry->id = braft::LogId(index, term);
+    butil::IOBufAsZeroCopyOutputStream wrapper(&entry->data);
+    if (!req.SerializeToZeroCopyStream(&wrapper)) {
+        return -1;
+    }
+    return storage->append_entry(entry.get());
+}
+
+static int append_index(braft::LogStorage* storage, int64_t index, int64_t term) {
+    pb::StoreReq req;
+    req.set_op_type(pb::OP_INSERT);
+    req.set_region_id(0);
+    // 用region_version记录日志的index，读出来时校验
+    req.set_region_version(index);
+    return append_data(storage, index, term, req);
+}
+
+// 读出index对应的日志并校验内容，返回其term，失败返回-1
+static int64_t check_entry(braft::LogStorage* storage, int64_t index) {
+    braft::LogEntry* entry = storage->get_entry(index);
+    if (entry == nullptr) {
+        return -1;
+    }
+    int64_t term = entry->id.term;
+    pb::StoreReq req;
+    butil::IOBufAsZeroCopyInputStream wrapper(entry->data);
+    if (entry->type != braft::ENTRY_TYPE_DATA || !req.ParseFromZeroCopyStream(&wrapper)
+            || req.region_version() != index || storage->get_term(index) != term) {
+        term = -1;
+    }
+    entry->Release();
+    return term;
+}
+
+static size_t segment_file_count(const std::string& path) {
+    size_t count = 0;
+    boost::filesystem::directory_iterator end_iter;
+    for (boost::filesystem::directory_iterator iter(path); iter != end_iter; ++iter) {
+        if (iter->path().filename().string().compare(0, 4, "log_") == 0) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+static int append_no_op(braft::LogStorage* storage, int64_t index, int64_t term) {
+    scoped_refptr<braft::LogEntry> entry = new braft::LogEntry();
+    entry->type = braft::ENTRY_TYPE_NO_OP;
+    entry->id = braft::LogId(index, term);
+    return storage->append_entry(entry.get());
+}
+
+// 分裂时新region的增量日志必须能从segment存储中读到
+TEST(test_segment_log_storage, split_replay) {
+    const int64_t region_id = 1001;
+    const int64_t new_region_id = 1002;
+    std::unique_ptr<braft::LogStorage> storage(open_storage(region_id));
+    ASSERT_TRUE(storage != nullptr);
+    ASSERT_EQ(0, append_no_op(storage.get(), 1, 2));
+    for (int64_t index = 2; index <= 5; ++index) {
+        pb::StoreReq req;
+        req.set_op_type(index == 5 ? pb::OP_KV_BATCH : pb::OP_INSERT);
+        req.set_region_id(region_id);
+        req.set_region_version(3);
+        ASSERT_EQ(0, append_data(storage.get(), index, 2, req));
+    }
+
+    // 分批读取，第一批后面还有日志
+    std::vector<RaftLogEntry> entries;
+    EXPECT_EQ(1, LogEntryReader::get_instance()->read_log_entries(region_id, 1, 3, entries));
+    ASSERT_EQ(3U, entries.size());
+    EXPECT_EQ(1, entries[0].index);
+    EXPECT_EQ(braft::ENTRY_TYPE_NO_OP, entries[0].type);
+    EXPECT_EQ(2, entries[1].term);
+    entries.clear();
+    EXPECT_EQ(0, LogEntryReader::get_instance()->read_log_entries(region_id, 4, 10, entries));
+    ASSERT_EQ(2U, entries.size());
+    EXPECT_EQ(5, entries[1].index);
+
+    entries.clear();
+    EXPECT_EQ(0, LogEntryReader::get_instance()->read_log_entries(region_id, 1, 10, entries));
+    std::vector<pb::StoreReq> requests;
+    for (auto& entry : entries) {
+        pb::StoreReq req;
+        int ret = Region::parse_split_log_entry(entry, 2, new_region_id, &req);
+        ASSERT_GE(ret, 0);
+        if (ret > 0) {
+            requests.push_back(req);
+        }
+    }
+    // no-op被跳过，其余日志都转发给新region
+    ASSERT_EQ(4U, requests.size());
+    for (auto& req : requests) {
+        EXPECT_EQ(new_region_id, req.region_id());
+        EXPECT_EQ(0, req.region_version());
+    }
+    EXPECT_EQ(pb::OP_INSERT, requests[0].op_type());
+    EXPECT_EQ(pb::OP_KV_BATCH_SPLIT, requests[3].op_type());
+
+    // term变化说明期间发生过切主，分裂失败
+    pb::StoreReq req;
+    EXPECT_EQ(-1, Region::parse_split_log_entry(entries[1], 3, new_region_id, &req));
+}
+
+TEST(test_segment_log_storage, append) {
+    const int64_t region_id = 2001;
+    std::unique_ptr<braft::LogStorage> storage(open_storage(region_id));
+    ASSERT_TRUE(storage != nullptr);
+    EXPECT_EQ(1, storage->first_log_index());
+    EXPECT_EQ(0, storage->last_log_index());
+    for (int64_t index = 1; index <= 10; ++index) {
+        ASSERT_EQ(0, append_index(storage.get(), index, index <= 5 ? 1 : 2));
+    }
+    // 不连续的日志拒绝写入
+    EXPECT_NE(0, append_index(storage.get(), 12, 2));
+
+    std::vector<braft::LogEntry*> entries;
+    for (int64_t index = 11; index <= 20; ++index) {
+        braft::LogEntry* entry = new braft::LogEntry();
+        entry->AddRef();
+        entry->type = braft::ENTRY_TYPE_DATA;
+        entry->id = braft::LogId(index, 3);
+        pb::StoreReq req;
+        req.set_op_type(pb::OP_INSERT);
+        req.set_region_id(0);
+        req.set_region_version(index);
+        butil::IOBufAsZeroCopyOutputStream wrapper(&entry->data);
+        ASSERT_TRUE(req.SerializeToZeroCopyStream(&wrapper));
+        entries.push_back(entry);
+    }
+    EXPECT_EQ(10, storage->append_entries(entries, nullptr));
+    for (auto entry : entries) {
+        entry->Release();
+    }
+
+    EXPECT_EQ(1, storage->first_log_index());
+    EXPECT_EQ(20, storage->last_log_index());
+    for (int64_t index = 1; index <= 20; ++index) {
+        EXPECT_EQ(index <= 5 ? 1 : (index <= 10 ? 2 : 3), check_entry(storage.get(), index));
+    }
+    EXPECT_TRUE(storage->get_entry(21) == nullptr);
+    EXPECT_EQ(0, storage->get_term(21));
+}
+
+TEST(test_segment_log_storage, truncate) {
+    const int64_t region_id = 2002;
+    std::unique_ptr<braft::LogStorage> storage(open_storage(region_id));
+    ASSERT_TRUE(storage != nullptr);
+    for (int64_t index = 1; index <= 10; ++index) {
+        ASSERT_EQ(0, append_index(storage.get(), index, 1));
+    }
+
+    // 切主后截断未提交的日志，新leader的日志覆盖写入
+    ASSERT_EQ(0, storage->truncate_suffix(7));
+    EXPECT_EQ(7, storage->last_log_index());
+    EXPECT_TRUE(storage->get_entry(8) == nullptr);
+    ASSERT_EQ(0, append_index(storage.get(), 8, 2));
+    EXPECT_EQ(8, storage->last_log_index());
+    EXPECT_EQ(2, check_entry(storage.get(), 8));
+    EXPECT_EQ(1, check_entry(storage.get(), 7));
+
+    // snapshot之后删除旧日志
+    ASSERT_EQ(0, storage->truncate_prefix(4));
+    EXPECT_EQ(4, storage->first_log_index());
+    EXPECT_EQ(8, storage->last_log_index());
+    EXPECT_TRUE(storage->get_entry(3) == nullptr);
+    EXPECT_EQ(0, storage->get_term(3));
+    EXPECT_EQ(1, check_entry(storage.get(), 4));
+
+    // 全部截断后从first_index_kept继续写
+    ASSERT_EQ(0, storage->truncate_prefix(9));
+    EXPECT_EQ(9, storage->first_log_index());
+    EXPECT_EQ(8, storage->last_log_index());
+    ASSERT_EQ(0, append_index(storage.get(), 9, 2));
+    EXPECT_EQ(2, check_entry(storage.get(), 9));
+}
+
+TEST(test_segment_log_storage, reset) {
+    const int64_t region_id = 2003;
+    std::unique_ptr<braft::LogStorage> storage(open_storage(region_id));
+    ASSERT_TRUE(storage != nullptr);
+    for (int64_t index = 1; index <= 5; ++index) {
+        ASSERT_EQ(0, append_index(storage.get(), index, 1));
+    }
+    // 安装snapshot后日志从next_log_index开始
+    ASSERT_EQ(0, storage->reset(100));
+    EXPECT_EQ(100, storage->first_log_index());
+    EXPECT_EQ(99, storage->last_log_index());
+    EXPECT_TRUE(storage->get_entry(5) == nullptr);
+    EXPECT_NE(0, append_index(storage.get(), 6, 1));
+    ASSERT_EQ(0, append_index(storage.get(), 100, 3));
+    EXPECT_EQ(3, check_entry(storage.get(), 100));
+}
+
+static const std::string CRASH_LOG_PATH = "./segment_log_crash_test";
+
+// 写入多个segment后不做任何清理直接退出，并在最后一个segment尾部留下写了一半的记录
+static void write_and_crash() {
+    FLAGS_segment_log_max_bytes = 1024;
+    std::unique_ptr<braft::LogStorage> storage(open_storage(3001, CRASH_LOG_PATH));
+    std::unique_ptr<braft::LogStorage> other(open_storage(3002, CRASH_LOG_PATH));
+    if (storage == nullptr || other == nullptr) {
+        ::_exit(1);
+    }
+    for (int64_t index = 1; index <= 40; ++index) {
+        if (append_index(storage.get(), index, 1) != 0
+                || append_index(other.get(), index, 1) != 0) {
+            ::_exit(1);
+        }
+    }
+    if (storage->truncate_prefix(5) != 0 || storage->truncate_suffix(30) != 0
+            || append_index(storage.get(), 31, 2) != 0 || other->reset(50) != 0) {
+        ::_exit(1);
+    }
+    if (segment_file_count(CRASH_LOG_PATH) < 3) {
+        ::_exit(1);
+    }
+    std::string last_segment;
+    boost::filesystem::directory_iterator end_iter;
+    for (boost::filesystem::directory_iterator iter(CRASH_LOG_PATH); iter != end_iter; ++iter) {
+        last_segment = std::max(last_segment, iter->path().string());
+    }
+    int fd = ::open(last_segment.c_str(), O_WRONLY | O_APPEND);
+    char torn[SegmentLogManager::RECORD_HEAD_SIZE / 2];
+    memset(torn, 0xAB, sizeof(torn));
+    if (fd < 0 || ::write(fd, torn, sizeof(torn)) != (ssize_t)sizeof(torn)) {
+        ::_exit(1);
+    }
+    ::_exit(0);
+}
+
+static void recover_and_check() {
+    FLAGS_segment_log_max_bytes = 1024;
+    std::unique_ptr<braft::LogStorage> storage(open_storage(3001, CRASH_LOG_PATH, false));
+    std::unique_ptr<braft::LogStorage> other(open_storage(3002, CRASH_LOG_PATH, false));
+    ASSERT_TRUE(storage != nullptr);
+    ASSERT_TRUE(other != nullptr);
+    EXPECT_EQ(5, storage->first_log_index());
+    EXPECT_EQ(31, storage->last_log_index());
+    for (int64_t index = 5; index <= 31; ++index) {
+        EXPECT_EQ(index <= 30 ? 1 : 2, check_entry(storage.get(), index));
+    }
+    EXPECT_EQ(50, other->first_log_index());
+    EXPECT_EQ(49, other->last_log_index());
+    // 截掉的半条记录不影响继续写入
+    ASSERT_EQ(0, append_index(storage.get(), 32, 2));
+    ASSERT_EQ(0, append_index(other.get(), 50, 2));
+    EXPECT_EQ(2, check_entry(storage.get(), 32));
+    EXPECT_EQ(2, check_entry(other.get(), 50));
+    ::_exit(::testing::Test::HasFailure() ? 1 : 0);
+}
+
+TEST(test_segment_log_storage, recover_after_crash) {
+    EXPECT_EXIT(write_and_crash(), ::testing::ExitedWithCode(0), "");
+    EXPECT_EXIT(recover_and_check(), ::testing::ExitedWithCode(0), "");
+}
+
+static const std::string GC_LOG_PATH = "./segment_log_gc_test";
+
+static void gc_and_check() {
+    FLAGS_segment_log_max_bytes = 1024;
+    std::unique_ptr<braft::LogStorage> storage(open_storage(4001, GC_LOG_PATH));
+    std::unique_ptr<braft::LogStorage> other(open_storage(4002, GC_LOG_PATH));
+    ASSERT_TRUE(storage != nullptr);
+    ASSERT_TRUE(other != nullptr);
+    ASSERT_EQ(0, append_index(other.get(), 1, 1));
+    for (int64_t index = 1; index <= 60; ++index) {
+        ASSERT_EQ(0, append_index(storage.get(), index, 1));
+    }
+    ASSERT_GE(segment_file_count(GC_LOG_PATH), 4U);
+
+    // other的日志还在第一个segment里，不能回收
+    ASSERT_EQ(0, storage->truncate_prefix(55));
+    size_t count = segment_file_count(GC_LOG_PATH);
+    ASSERT_GE(count, 4U);
+    EXPECT_EQ(1, check_entry(other.get(), 1));
+
+    ASSERT_EQ(0, other->truncate_prefix(2));
+    ASSERT_EQ(0, storage->truncate_prefix(56));
+    EXPECT_LT(segment_file_count(GC_LOG_PATH), count);
+    for (int64_t index = 56; index <= 60; ++index) {
+        EXPECT_EQ(1, check_entry(storage.get(), index));
+    }
+
+    // 删除region后它的日志不再阻止回收
+    ASSERT_EQ(0, append_index(other.get(), 2, 1));
+    for (int64_t index = 61; index <= 100; ++index) {
+        ASSERT_EQ(0, append_index(storage.get(), index, 1));
+    }
+    ASSERT_EQ(0, storage->truncate_prefix(101));
+    count = segment_file_count(GC_LOG_PATH);
+    ASSERT_GE(count, 2U);
+    SegmentLogManager::get_instance()->remove_region(4002);
+    EXPECT_LT(segment_file_count(GC_LOG_PATH), count);
+    ::_exit(::testing::Test::HasFailure() ? 1 : 0);
+}
+
+TEST(test_segment_log_storage, gc) {
+    EXPECT_EXIT(gc_and_check(), ::testing::ExitedWithCode(0), "");
+}
+}  // namespace baikaldb
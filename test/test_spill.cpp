@@ -0,0 +1,279 @@
+// Copyright (c) 2018-present Baidu, Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include "schema_factory.h"
+#include "runtime_state.h"
+#include "scan_node.h"
+#include "join_node.h"
+#include "agg_node.h"
+#include "sorter.h"
+#include "expr.h"
+#include "exec_test_util.h"
+
+namespace baikaldb {
+DECLARE_int64(query_memory_limit);
+DECLARE_int64(hash_join_min_outer_rows);
+DECLARE_int32(join_spill_max_depth);
+DECLARE_bool(use_column_batch);
+DECLARE_string(spill_dir);
+DECLARE_int64(agg_spill_min_bytes);
+
+static const int64_t OUTER_TABLE_ID = 1;
+static const int64_t INNER_TABLE_ID = 2;
+// 超过这个预算必然落盘
+static const int64_t TINY_MEMORY_LIMIT = 4 * 1024;
+
+// tuple 0/1: 外表/内表的(key, value)，tuple 2: agg结果(count, sum)
+static void init_state(RuntimeState* state) {
+    state->mutable_tuple_descs()->push_back(make_tuple(0, OUTER_TABLE_ID));
+    state->mutable_tuple_descs()->push_back(make_tuple(1, INNER_TABLE_ID));
+    state->mutable_tuple_descs()->push_back(make_tuple(2, 0));
+    ASSERT_EQ(0, state->mem_row_desc()->init(*state->mutable_tuple_descs()));
+}
+
+static ExecNode* make_scan(int32_t tuple_id, int64_t table_id, const KeyValues& rows) {
+    pb::PlanNode pb_node;
+    pb_node.set_node_type(pb::SCAN_NODE);
+    pb_node.set_num_children(0);
+    pb_node.set_limit(-1);
+    pb_node.mutable_derive_node()->mutable_scan_node()->set_tuple_id(tuple_id);
+    pb_node.mutable_derive_node()->mutable_scan_node()->set_table_id(table_id);
+    MemScanNode* scan = new MemScanNode(rows);
+    scan->init(pb_node);
+    return scan;
+}
+
+static std::string row_to_string(MemRow* row, const std::vector<std::pair<int32_t, int32_t>>& slots) {
+    std::string str;
+    for (auto& slot : slots) {
+        ExprValue value = row->get_value(slot.first, slot.second);
+        str += value.is_null() ? "NULL" : std::to_string(value.get_numberic<int64_t>());
+        str += ",";
+    }
+    return str;
+}
+
+static int drain(RuntimeState* state, ExecNode* node,
+        const std::vector<std::pair<int32_t, int32_t>>& slots, std::vector<std::string>* result) {
+    bool eos = false;
+    while (!eos) {
+        RowBatch batch;
+        int ret = node->get_next(state, &batch, &eos);
+        if (ret < 0) {
+            return ret;
+        }
+        for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+            result->push_back(row_to_string(batch.get_row().get(), slots));
+        }
+    }
+    return 0;
+}
+
+static int run_join(pb::JoinType join_type, const KeyValues& outer, const KeyValues& inner,
+        int64_t memory_limit, std::vector<std::string>* result) {
+    FLAGS_query_memory_limit = memory_limit;
+    RuntimeState state;
+    init_state(&state);
+    pb::PlanNode pb_node;
+    pb_node.set_node_type(pb::JOIN_NODE);
+    pb_node.set_num_children(2);
+    pb_node.set_limit(-1);
+    pb::JoinNode* join = pb_node.mutable_derive_node()->mutable_join_node();
+    join->set_join_type(join_type);
+    join->add_left_tuple_ids(0);
+    join->add_right_tuple_ids(1);
+    pb::Expr* cond = join->add_conditions();
+    pb::ExprNode* eq = cond->add_nodes();
+    eq->set_node_type(pb::FUNCTION_CALL);
+    eq->set_col_type(pb::BOOL);
+    eq->set_num_children(2);
+    eq->mutable_fn()->set_name("eq_int64_int64");
+    eq->mutable_fn()->set_fn_op(parser::FT_EQ);
+    add_slot_ref(cond, 0, 1);
+    add_slot_ref(cond, 1, 1);
+
+    JoinNode join_node;
+    if (join_node.init(pb_node) != 0) {
+        return -1;
+    }
+    join_node.add_child(make_scan(0, OUTER_TABLE_ID, outer));
+    join_node.add_child(make_scan(1, INNER_TABLE_ID, inner));
+    int ret = join_node.open(&state);
+    if (ret == 0) {
+        ret = drain(&state, &join_node, {{0, 1}, {0, 2}, {1, 1}, {1, 2}}, result);
+    }
+    join_node.close(&state);
+    std::sort(result->begin(), result->end());
+    return ret;
+}
+
+static int run_agg(const KeyValues& rows, int64_t memory_limit, std::vector<std::string>* result) {
+    FLAGS_query_memory_limit = memory_limit;
+    RuntimeState state;
+    init_state(&state);
+    pb::PlanNode pb_node;
+    pb_node.set_node_type(pb::AGG_NODE);
+    pb_node.set_num_children(1);
+    pb_node.set_limit(-1);
+    pb::AggNode* agg = pb_node.mutable_derive_node()->mutable_agg_node();
+    agg->set_agg_tuple_id(2);
+    add_slot_ref(agg->add_group_exprs(), 0, 1);
+    // count(*) -> (2, 1), sum(value) -> (2, 2)
+    pb::ExprNode* count_star = agg->add_agg_funcs()->add_nodes();
+    count_star->set_node_type(pb::AGG_EXPR);
+    count_star->set_col_type(pb::INT64);
+    count_star->set_num_children(0);
+    count_star->mutable_fn()->set_name("count_star");
+    count_star->mutable_fn()->set_fn_op(0);
+    count_star->mutable_derive_node()->set_tuple_id(2);
+    count_star->mutable_derive_node()->set_slot_id(1);
+    count_star->mutable_derive_node()->set_intermediate_slot_id(1);
+    pb::Expr* sum_expr = agg->add_agg_funcs();
+    pb::ExprNode* sum = sum_expr->add_nodes();
+    sum->set_node_type(pb::AGG_EXPR);
+    sum->set_col_type(pb::INT64);
+    sum->set_num_children(1);
+    sum->mutable_fn()->set_name("sum");
+    sum->mutable_fn()->set_fn_op(0);
+    sum->mutable_derive_node()->set_tuple_id(2);
+    sum->mutable_derive_node()->set_slot_id(2);
+    sum->mutable_derive_node()->set_intermediate_slot_id(2);
+    add_slot_ref(sum_expr, 0, 2);
+
+    AggNode agg_node;
+    if (agg_node.init(pb_node) != 0) {
+        return -1;
+    }
+    agg_node.add_child(make_scan(0, OUTER_TABLE_ID, rows));
+    int ret = agg_node.open(&state);
+    if (ret == 0) {
+        ret = drain(&state, &agg_node, {{0, 1}, {2, 1}, {2, 2}}, result);
+    }
+    agg_node.close(&state);
+    std::sort(result->begin(), result->end());
+    return ret;
+}
+
+static int run_sort(const KeyValues& rows, int64_t memory_limit, int64_t* spill_runs,
+        std::vector<std::string>* result) {
+    FLAGS_query_memory_limit = memory_limit;
+    RuntimeState state;
+    init_state(&state);
+    std::vector<ExprNode*> order_exprs;
+    std::vector<bool> is_asc = {true, false};
+    std::vector<bool> is_null_first = {false, false};
+    for (int32_t slot_id = 1; slot_id <= 2; ++slot_id) {
+        pb::Expr expr;
+        add_slot_ref(&expr, 0, slot_id);
+        ExprNode* slot_ref = nullptr;
+        if (ExprNode::create_tree(expr, &slot_ref) != 0) {
+            return -1;
+        }
+        order_exprs.push_back(slot_ref);
+    }
+    MemRowCompare comp(order_exprs, is_asc, is_null_first);
+    int ret = 0;
+    {
+        Sorter sorter(&comp);
+        sorter.enable_spill(&state, state.mem_row_desc());
+        MemScanNode* scan = static_cast<MemScanNode*>(make_scan(0, OUTER_TABLE_ID, rows));
+        scan->open(&state);
+        bool eos = false;
+        while (!eos && ret == 0) {
+            std::shared_ptr<RowBatch> batch = std::make_shared<RowBatch>();
+            ret = scan->get_next(&state, batch.get(), &eos);
+            if (ret == 0 && batch->size() > 0) {
+                ret = sorter.add_batch(batch);
+            }
+        }
+        delete scan;
+        if (ret == 0) {
+            ret = sorter.sort();
+        }
+        *spill_runs = sorter.spill_runs();
+        eos = false;
+        while (!eos && ret == 0) {
+            RowBatch batch;
+            ret = sorter.get_next(&batch, &eos);
+            for (batch.reset(); !batch.is_traverse_over(); batch.next()) {
+                result->push_back(row_to_string(batch.get_row().get(), {{0, 1}, {0, 2}}));
+            }
+        }
+    }
+    for (auto expr : order_exprs) {
+        ExprNode::destroy_tree(expr);
+    }
+    return ret;
+}
+
+TEST(test_spill, hash_join) {
+    KeyValues outer = make_rows(3000, 700);
+    KeyValues inner = make_rows(2000, 900);
+    for (auto join_type : {pb::INNER_JOIN, pb::LEFT_JOIN}) {
+        std::vector<std::string> in_memory;
+        std::vector<std::string> spilled;
+        ASSERT_EQ(0, run_join(join_type, outer, inner, 0, &in_memory));
+        ASSERT_EQ(0, run_join(join_type, outer, inner, TINY_MEMORY_LIMIT, &spilled));
+        EXPECT_FALSE(in_memory.empty());
+        EXPECT_EQ(in_memory, spilled);
+    }
+}
+
+TEST(test_spill, hash_join_skew) {
+    // 所有build行同一个key，再次切分也放不下，需要报错而不是无限切分或超出预算
+    KeyValues outer = make_rows(3000, 10);
+    KeyValues inner = make_rows(2000, 1);
+    std::vector<std::string> result;
+    EXPECT_NE(0, run_join(pb::INNER_JOIN, outer, inner, TINY_MEMORY_LIMIT, &result));
+}
+
+TEST(test_spill, agg) {
+    KeyValues rows = make_rows(5000, 1500);
+    std::vector<std::string> in_memory;
+    std::vector<std::string> spilled;
+    ASSERT_EQ(0, run_agg(rows, 0, &in_memory));
+    ASSERT_EQ(0, run_agg(rows, TINY_MEMORY_LIMIT, &spilled));
+    EXPECT_EQ(1500u, in_memory.size());
+    EXPECT_EQ(in_memory, spilled);
+}
+
+TEST(test_spill, sort) {
+    KeyValues rows = make_rows(5000, 300);
+    std::random_shuffle(rows.begin(), rows.end());
+    std::vector<std::string> in_memory;
+    std::vector<std::string> spilled;
+    int64_t runs = 0;
+    ASSERT_EQ(0, run_sort(rows, 0, &runs, &in_memory));
+    EXPECT_EQ(0, runs);
+    ASSERT_EQ(0, run_sort(rows, TINY_MEMORY_LIMIT, &runs, &spilled));
+    EXPECT_GT(runs, 0);
+    EXPECT_EQ(5000u, in_memory.size());
+    EXPECT_EQ(in_memory, spilled);
+}
+}  // namespace baikaldb
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    baikaldb::FLAGS_use_column_batch = false;
+    // 驱动表取到第一批行后就改用hash join
+    baikaldb::FLAGS_hash_join_min_outer_rows = 1;
+    baikaldb::FLAGS_spill_dir = "./spill_test";
+    // 不保留最小内存，保证agg在小预算下落盘
+    baikaldb::FLAGS_agg_spill_min_bytes = 0;
+    baikaldb::SchemaFactory::get_instance()->init();
+    return RUN_ALL_TESTS();
+}